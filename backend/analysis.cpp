@@ -0,0 +1,1384 @@
+/*
+ * analysis.cpp: Background code discovery and control-flow graph cache
+ *
+ * ar_analysis_start() snapshots every CPU's code memory on the calling
+ * thread (each map entry backed by a source region; banked windows are
+ * enumerated through get_bank_address), then hands the snapshot to a
+ * worker thread.  The worker decodes recursively from the queued roots,
+ * recording per-byte flags (instruction length, block leader/end,
+ * function entry) and transfer edges.  After each batch of roots it
+ * rescans the flags of the segments that batch changed for basic blocks,
+ * then rederives block successors and function ownership.  A copy without
+ * the raw bytes is published under g_mutex for queries from the UI/TCP
+ * threads; unchanged segments share their flags with the previous copy.
+ *
+ * Each segment also carries the cross-references made by its code,
+ * sorted by target, and each space a merged index of them.  Only segments
+ * whose flags changed are re-extracted.  ar_analysis_refresh() re-reads
+ * code pages and compares their CRC32 against the snapshot; changed pages
+ * are sent to the worker, which drops the instructions overlapping them
+ * and re-decodes from their leaders.  Where the core reports dirty pages,
+ * a code page verified by the previous refresh is only re-read if its
+ * 4 KB page was written since.
+ *
+ * Executed PCs are buffered on the core thread and handed over once per
+ * frame; those outside known code become roots and are kept as coverage.
+ *
+ * Cache file (<rombase>.analysis):
+ *   "ARAN" u32 version, u32 rom crc32, u64 rom size, u64 payload size,
+ *   then a zlib stream of the per-CPU segment flags, edges and coverage.
+ *   Each segment's flags carry the CRC32 of the bytes they describe; on
+ *   load, segments whose bytes differ (RAM, patched code) are dropped
+ *   along with the edges and coverage inside them.  Rewritten at most every CACHE_SAVE_INTERVAL while results change, and
+ *   when the worker stops.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <zlib.h>
+
+#include "analysis.hpp"
+#include "backend.hpp"
+#include "dirty.hpp"
+#include "memreader.hpp"
+#include "registers.hpp"
+#include "sys.hpp"
+#include "xref.hpp"
+
+/* Snapshot budget across all CPUs and the bank enumeration limit */
+static constexpr uint64_t MAX_SNAPSHOT_BYTES = 64ull << 20;
+static constexpr int64_t  MAX_BANKS = 512;
+
+/* ROM files larger than this are checksummed over their first
+ * CHECKSUM_LIMIT bytes plus their size */
+static constexpr uint64_t CHECKSUM_LIMIT = 64ull << 20;
+
+static constexpr uint32_t CACHE_VERSION = 2;
+
+/* Minimum time between cache rewrites while results keep changing */
+static constexpr std::chrono::seconds CACHE_SAVE_INTERVAL{10};
+
+/* Executed PCs buffered per frame, the direct-mapped filter of recently
+ * noted ones, and the most awaiting the worker */
+static constexpr unsigned EXEC_BUFFER = 1u << 14;
+static constexpr unsigned EXEC_FILTER = 1u << 14;
+static constexpr size_t   EXEC_BACKLOG = 4 * EXEC_BUFFER;
+
+/* Granularity of change detection in ar_analysis_refresh() */
+static constexpr uint64_t PAGE_SIZE = 256;
+
+/* Per-byte flags */
+enum : uint8_t {
+    B_LEN    = 0x07,    /* instruction length, on its first byte only */
+    B_CODE   = 0x08,    /* byte belongs to a decoded instruction */
+    B_LEADER = 0x10,    /* instruction starts a basic block */
+    B_END    = 0x20,    /* instruction ends a basic block */
+    B_FUNC   = 0x40,    /* function entry */
+    B_CALL   = 0x80,    /* instruction is a call */
+};
+
+struct Segment {
+    uint64_t base;
+    uint64_t size;
+    int64_t  bank;
+    int      window;        /* memory map entry index, -1 without a map */
+    bool     live;          /* mapped when the snapshot was taken */
+    rd_Memory const *source;        /* read back by ar_analysis_refresh() */
+    uint64_t source_base;
+    std::vector<uint8_t> bytes;     /* worker copy only */
+    std::vector<uint8_t> flags;     /* worker copy only */
+    std::shared_ptr<const std::vector<uint8_t>> shared; /* flags as published */
+    std::vector<uint32_t> page_crc; /* CRC32 of each PAGE_SIZE page */
+    std::vector<ar_xref> refs;      /* worker copy only, sorted by target */
+    bool dirty = true;              /* flags changed since last published */
+};
+
+/* Derived from one segment's flags by rebuild(), worker copy only */
+struct SegBlocks {
+    std::vector<ar_basic_block> blocks;     /* no successors or owner */
+    std::vector<uint64_t>       entries;    /* function entry addresses */
+    uint64_t                    insns = 0;
+};
+
+struct Space {
+    std::string   id;
+    rd_Cpu const *cpu;      /* identity only; never dereferenced by the worker */
+    unsigned      type;
+    unsigned      max_insn;
+    unsigned      alignment;
+    unsigned      delay_slots;
+    std::vector<Segment>     segs;
+    std::vector<ar_cfg_edge> edges;
+
+    /* Derived by rebuild() */
+    std::vector<SegBlocks>      seg_blocks; /* per segment, worker copy only */
+    std::vector<ar_basic_block> blocks;     /* sorted by (bank, start) */
+    std::vector<ar_xref>        xrefs;      /* sorted by target */
+    uint64_t insns = 0;
+    uint64_t funcs = 0;
+};
+
+struct Root {
+    unsigned space;
+    uint64_t addr;
+    bool     func;
+};
+
+/* Changed page found by ar_analysis_refresh() */
+struct Patch {
+    unsigned generation;
+    unsigned space;
+    unsigned seg;
+    uint64_t off;
+    std::vector<uint8_t> bytes;
+};
+
+static std::mutex              g_mutex;
+static std::condition_variable g_cv;
+static std::condition_variable g_idle_cv;
+static std::thread             g_worker;
+static std::atomic<bool>       g_stop{false};
+static std::atomic<bool>       g_busy{false};
+
+/* Executed PC noted on the core thread */
+struct ExecPc {
+    rd_Cpu const *cpu;
+    uint64_t      pc;
+};
+
+/* Owned by the worker while it runs.  Coverage: executed PCs that were
+ * not known code, per space. */
+static std::vector<Space>                        g_work;
+static std::string                               g_cache_path;
+static std::string                               g_rom_path;
+static std::vector<std::unordered_set<uint64_t>> g_coverage;
+
+/* Guarded by g_mutex */
+static std::vector<Space>          g_results;
+static std::vector<Root>           g_pending;
+static std::vector<Patch>          g_patches;
+static std::vector<ExecPc>         g_executed;
+static unsigned                    g_generation = 0;
+static std::vector<rd_Cpu const *> g_cpus;
+
+/* Core thread only: ar_analysis_note_exec() and ar_analysis_flush_exec()
+ * both run there, so the buffer needs no lock.  g_exec_restart is bumped
+ * by each start so the filter forgets what the previous run was told. */
+static ExecPc                g_exec[EXEC_BUFFER];
+static unsigned              g_exec_count = 0;
+static ExecPc                g_exec_filter[EXEC_FILTER];
+static unsigned              g_exec_filter_run = 0;
+static std::atomic<unsigned> g_exec_restart{0};
+
+/* Per source region, for ar_analysis_refresh(): its dirty pages and the
+ * code pages (by source address) the last refresh verified.  Guarded by
+ * g_refresh_mutex and dropped when g_generation moves on. */
+struct Verified {
+    DirtyPages                   dirty;
+    bool                         tracked = false;
+    std::unordered_set<uint64_t> pages;
+};
+static std::mutex                                      g_refresh_mutex;
+static unsigned                                        g_refresh_generation = 0;
+static std::unordered_map<rd_Memory const *, Verified> g_verified;
+
+/* ======================================================================== */
+/* Segment lookup                                                            */
+/* ======================================================================== */
+
+static bool seg_covers(const Segment &s, uint64_t addr) {
+    return addr >= s.base && addr - s.base < s.size;
+}
+
+/* Segment mapped at addr when the snapshot was taken */
+static int live_seg(const Space &sp, uint64_t addr) {
+    int any = -1;
+    for (size_t i = 0; i < sp.segs.size(); i++) {
+        if (!seg_covers(sp.segs[i], addr)) continue;
+        if (sp.segs[i].live) return (int)i;
+        if (any < 0) any = (int)i;
+    }
+    return any;
+}
+
+/* Segment holding addr in the given bank (bank < 0: live mapping) */
+static int find_seg(const Space &sp, uint64_t addr, int64_t bank) {
+    if (bank < 0) return live_seg(sp, addr);
+    for (size_t i = 0; i < sp.segs.size(); i++) {
+        auto &s = sp.segs[i];
+        if (seg_covers(s, addr) && (s.bank == bank || s.bank < 0))
+            return (int)i;
+    }
+    return -1;
+}
+
+/* Flow stays in the current bank while it stays inside the same window;
+ * anything else lands in whatever was mapped at snapshot time. */
+static int target_seg(const Space &sp, int from, uint64_t addr) {
+    if (seg_covers(sp.segs[from], addr)) return from;
+    return live_seg(sp, addr);
+}
+
+static const Space *find_space(const std::vector<Space> &spaces,
+                               rd_Cpu const *cpu) {
+    for (auto &sp : spaces)
+        if (sp.cpu == cpu || sp.id == cpu->v1.id)
+            return &sp;
+    return nullptr;
+}
+
+static int64_t bank_for_addr(const std::vector<rd_MemoryMap> &maps,
+                             uint64_t addr) {
+    for (auto &m : maps)
+        if (addr >= m.base_addr && addr < m.base_addr + m.size)
+            return m.bank;
+    return -1;
+}
+
+static std::vector<rd_MemoryMap> fetch_map(rd_Memory const *mem) {
+    std::vector<rd_MemoryMap> maps;
+    if (mem && mem->v1.get_memory_map_count && mem->v1.get_memory_map) {
+        unsigned count = mem->v1.get_memory_map_count(mem);
+        if (count > 0) {
+            maps.resize(count);
+            mem->v1.get_memory_map(mem, maps.data());
+        }
+    }
+    return maps;
+}
+
+/* ======================================================================== */
+/* Snapshot                                                                  */
+/* ======================================================================== */
+
+static uint32_t page_crc(const uint8_t *data, uint64_t size) {
+    return (uint32_t)crc32(crc32(0L, Z_NULL, 0), data, (uInt)size);
+}
+
+static void add_segment(Space &sp, const rd_MemoryMap &m, int64_t bank,
+                        int window, bool live, uint64_t &budget) {
+    if (m.size == 0 || m.size > budget) return;
+    Segment s{ m.base_addr, m.size, bank, window, live, m.source,
+               m.source_base_addr, {}, {}, {}, {}, {} };
+    s.bytes.resize(m.size);
+    ar_mem_read(m.source, m.source_base_addr, m.size, s.bytes.data());
+    s.flags.assign(m.size, 0);
+    for (uint64_t off = 0; off < m.size; off += PAGE_SIZE)
+        s.page_crc.push_back(page_crc(s.bytes.data() + off,
+                                      std::min(PAGE_SIZE, m.size - off)));
+    budget -= m.size;
+    sp.segs.push_back(std::move(s));
+}
+
+static void snapshot(Space &sp, rd_Memory const *mem, uint64_t &budget) {
+    auto maps = fetch_map(mem);
+
+    if (maps.empty()) {
+        rd_MemoryMap whole = { 0, mem->v1.size, mem, 0, -1 };
+        add_segment(sp, whole, -1, -1, true, budget);
+        return;
+    }
+
+    for (unsigned i = 0; i < maps.size(); i++) {
+        auto &m = maps[i];
+        if (!m.source) continue;    /* I/O or otherwise unbacked */
+
+        bool banked = false;
+        if (mem->v1.get_bank_address && m.bank >= 0) {
+            std::unordered_set<uint64_t> seen;
+            for (int64_t b = 0; b < MAX_BANKS; b++) {
+                rd_MemoryMap bm;
+                if (!mem->v1.get_bank_address(mem, m.base_addr, b, &bm) ||
+                    !bm.source)
+                    break;
+                if (bm.source_base_addr + bm.size > bm.source->v1.size)
+                    break;
+                if (!seen.insert(bm.source_base_addr).second)
+                    continue;   /* mirror of a bank already taken */
+                add_segment(sp, bm, b, (int)i, b == m.bank, budget);
+                banked = true;
+            }
+        }
+        if (!banked)
+            add_segment(sp, m, m.bank, (int)i, true, budget);
+    }
+}
+
+/* ======================================================================== */
+/* Discovery (worker)                                                        */
+/* ======================================================================== */
+
+struct Work {
+    int      seg;
+    uint64_t addr;
+    bool     func;
+};
+
+/* Decode straight-line code from pc until flow leaves it.  Targets are
+ * pushed onto stack.  Returns true if any flags changed. */
+static bool walk(Space &sp, int si, uint64_t pc, std::vector<Work> &stack) {
+    Segment &s = sp.segs[si];
+    bool changed = false;
+    int slots = -1;         /* delay slots left before a pending transfer */
+    bool stop = false;      /* pending transfer is unconditional */
+
+    while (seg_covers(s, pc)) {
+        uint64_t off = pc - s.base;
+        uint8_t f = s.flags[off];
+
+        if (f & B_LEN) {
+            /* Fell into known code: that instruction starts a block */
+            if (!(f & B_LEADER)) { s.flags[off] |= B_LEADER; changed = true; }
+            break;
+        }
+        if ((f & B_CODE) || pc % sp.alignment) break;
+
+        size_t n = (size_t)std::min<uint64_t>(sp.max_insn, s.size - off);
+        auto insns = arch::disassemble(
+            std::span<const uint8_t>(s.bytes.data() + off, n), pc, sp.type);
+        if (insns.empty() || insns[0].is_error) break;
+        const arch::Instruction &insn = insns[0];
+
+        unsigned len = insn.length;
+        bool overlap = false;
+        for (unsigned k = 1; k < len; k++)
+            if (s.flags[off + k] & B_CODE) overlap = true;
+        if (overlap) break;
+
+        s.flags[off] = (uint8_t)((f & ~B_LEN) | len | B_CODE |
+                                 (insn.is_call ? B_CALL : 0));
+        for (unsigned k = 1; k < len; k++)
+            s.flags[off + k] |= B_CODE;
+        changed = true;
+
+        if (insn.has_target) {
+            ar_edge_kind kind = insn.is_call    ? AR_EDGE_CALL
+                              : insn.breaks_flow ? AR_EDGE_JUMP
+                              : AR_EDGE_BRANCH;
+            int ti = target_seg(sp, si, insn.target);
+            sp.edges.push_back({ pc, s.bank, insn.target,
+                                 ti >= 0 ? sp.segs[ti].bank : -1, kind });
+            if (ti >= 0)
+                stack.push_back({ ti, insn.target, insn.is_call });
+        }
+
+        bool transfers = insn.breaks_flow || (insn.has_target && !insn.is_call);
+        if (slots > 0)
+            slots--;
+        else if (transfers) {
+            slots = (int)sp.delay_slots;
+            stop = insn.breaks_flow;
+        }
+
+        uint64_t next = pc + len;
+        if (slots == 0) {
+            s.flags[off] |= B_END;
+            if (stop) break;
+            /* Conditional branch: the fall-through starts a new block */
+            sp.edges.push_back({ pc, s.bank, next, s.bank, AR_EDGE_FALL });
+            if (seg_covers(s, next))
+                s.flags[next - s.base] |= B_LEADER;
+            slots = -1;
+        }
+        pc = next;
+    }
+    if (changed) s.dirty = true;
+    return changed;
+}
+
+static bool discover(Space &sp, uint64_t addr, bool func) {
+    int si = live_seg(sp, addr);
+    if (si < 0) return false;
+
+    bool changed = false;
+    std::vector<Work> stack{ { si, addr, func } };
+    while (!stack.empty() && !g_stop) {
+        Work w = stack.back();
+        stack.pop_back();
+
+        Segment &s = sp.segs[w.seg];
+        uint8_t &f = s.flags[w.addr - s.base];
+        if ((f & B_CODE) && !(f & B_LEN))
+            continue;   /* target lands inside another instruction */
+
+        uint8_t mark = B_LEADER | (w.func ? B_FUNC : 0);
+        if ((f & mark) != mark) { f |= mark; s.dirty = true; changed = true; }
+        if (f & B_LEN) continue;
+
+        changed |= walk(sp, w.seg, w.addr, stack);
+    }
+    return changed;
+}
+
+/* ======================================================================== */
+/* Blocks and functions (worker)                                             */
+/* ======================================================================== */
+
+static bool edge_less(const ar_cfg_edge &a, const ar_cfg_edge &b) {
+    if (a.from_bank != b.from_bank) return a.from_bank < b.from_bank;
+    if (a.from != b.from) return a.from < b.from;
+    if (a.to != b.to) return a.to < b.to;
+    return a.kind < b.kind;
+}
+
+static bool block_less(const ar_basic_block &a, const ar_basic_block &b) {
+    if (a.bank != b.bank) return a.bank < b.bank;
+    return a.start < b.start;
+}
+
+static int block_index(const std::vector<ar_basic_block> &blocks,
+                       int64_t bank, uint64_t addr) {
+    ar_basic_block key{ addr, addr, bank, 0, {} };
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), key, block_less);
+    if (it == blocks.begin()) return -1;
+    --it;
+    if (it->bank != bank || addr < it->start || addr >= it->end) return -1;
+    return (int)(it - blocks.begin());
+}
+
+/* Blocks, function entries and instruction count of one segment from its
+ * flags; fall-through edges between blocks go to sp.edges */
+static void rebuild_segment(Space &sp, const Segment &s, SegBlocks &d) {
+    d.blocks.clear();
+    d.entries.clear();
+    d.insns = 0;
+
+    bool open = false;
+    ar_basic_block cur{};
+    uint64_t last = 0;
+    uint64_t off = 0;
+    while (off < s.size) {
+        uint8_t f = s.flags[off];
+        unsigned len = f & B_LEN;
+        if (!len) {
+            if (open) { d.blocks.push_back(cur); open = false; }
+            off++;
+            continue;
+        }
+        uint64_t a = s.base + off;
+        if (open && (f & B_LEADER)) {
+            sp.edges.push_back({ last, s.bank, a, s.bank, AR_EDGE_FALL });
+            d.blocks.push_back(cur);
+            open = false;
+        }
+        if (!open) {
+            cur = { a, a, s.bank, UINT64_MAX, {} };
+            open = true;
+        }
+        if (f & B_FUNC) d.entries.push_back(a);
+        d.insns++;
+        last = a;
+        off += len;
+        cur.end = s.base + off;
+        if (f & B_END) { d.blocks.push_back(cur); open = false; }
+    }
+    if (open) d.blocks.push_back(cur);
+}
+
+/* Rescan the segments whose flags changed, then rederive the space's
+ * blocks, successors and function ownership from all of them */
+static void rebuild(Space &sp) {
+    if (sp.seg_blocks.size() != sp.segs.size())
+        sp.seg_blocks.assign(sp.segs.size(), {});
+    for (size_t i = 0; i < sp.segs.size(); i++)
+        if (sp.segs[i].dirty) rebuild_segment(sp, sp.segs[i], sp.seg_blocks[i]);
+
+    /* Edges stay sorted between rebuilds; new ones are appended */
+    auto mid = std::is_sorted_until(sp.edges.begin(), sp.edges.end(), edge_less);
+    std::sort(mid, sp.edges.end(), edge_less);
+    std::inplace_merge(sp.edges.begin(), mid, sp.edges.end(), edge_less);
+    sp.edges.erase(std::unique(sp.edges.begin(), sp.edges.end(),
+        [](const ar_cfg_edge &a, const ar_cfg_edge &b) {
+            return a.from_bank == b.from_bank && a.from == b.from &&
+                   a.to == b.to && a.kind == b.kind;
+        }), sp.edges.end());
+
+    sp.blocks.clear();
+    sp.insns = 0;
+    std::vector<std::pair<int64_t, uint64_t>> entries;
+    for (size_t i = 0; i < sp.segs.size(); i++) {
+        const SegBlocks &d = sp.seg_blocks[i];
+        sp.blocks.insert(sp.blocks.end(), d.blocks.begin(), d.blocks.end());
+        for (uint64_t a : d.entries) entries.push_back({ sp.segs[i].bank, a });
+        sp.insns += d.insns;
+    }
+    std::sort(sp.blocks.begin(), sp.blocks.end(), block_less);
+
+    for (auto &b : sp.blocks) {
+        ar_cfg_edge key{ b.start, b.bank, 0, 0, AR_EDGE_FALL };
+        auto it = std::lower_bound(sp.edges.begin(), sp.edges.end(), key,
+                                   edge_less);
+        for (; it != sp.edges.end() && it->from_bank == b.bank &&
+               it->from < b.end; ++it)
+            b.succ.push_back(*it);
+    }
+
+    /* Function ownership: claim entry blocks first so that a tail jump
+     * into another function does not swallow its body. */
+    std::vector<int> queue;
+    for (auto &[bank, addr] : entries) {
+        int bi = block_index(sp.blocks, bank, addr);
+        if (bi >= 0 && sp.blocks[bi].start == addr) {
+            sp.blocks[bi].func = addr;
+            queue.push_back(bi);
+        }
+    }
+    sp.funcs = queue.size();
+    while (!queue.empty()) {
+        int bi = queue.back();
+        queue.pop_back();
+        uint64_t func = sp.blocks[bi].func;
+        for (auto &e : sp.blocks[bi].succ) {
+            if (e.kind == AR_EDGE_CALL) continue;
+            int ni = block_index(sp.blocks, e.to_bank, e.to);
+            if (ni < 0 || sp.blocks[ni].func != UINT64_MAX) continue;
+            sp.blocks[ni].func = func;
+            queue.push_back(ni);
+        }
+    }
+}
+
+/* ======================================================================== */
+/* Changed code and cross-references (worker)                                */
+/* ======================================================================== */
+
+/* Copy a changed page into the snapshot and drop every instruction that
+ * overlaps it, along with their edges.  The dropped instructions' block
+ * leaders (and the first of them, which code may fall into) are queued
+ * for re-decoding.  Returns true if any code was dropped. */
+static bool apply_patch(const Patch &p, std::vector<Root> &roots) {
+    if (p.space >= g_work.size()) return false;
+    Space &sp = g_work[p.space];
+    if (p.seg >= sp.segs.size()) return false;
+    Segment &s = sp.segs[p.seg];
+    if (p.off + p.bytes.size() > s.size) return false;
+
+    memcpy(s.bytes.data() + p.off, p.bytes.data(), p.bytes.size());
+    s.page_crc[p.off / PAGE_SIZE] = page_crc(p.bytes.data(), p.bytes.size());
+
+    uint64_t lo = p.off >= sp.max_insn - 1 ? p.off - (sp.max_insn - 1) : 0;
+    uint64_t hi = p.off + p.bytes.size();
+    uint64_t first = UINT64_MAX, last = 0;
+    for (uint64_t off = lo; off < hi; off++) {
+        uint8_t f = s.flags[off];
+        unsigned len = f & B_LEN;
+        if (!len || off + len <= p.off) continue;
+        bool head = first == UINT64_MAX;
+        if (head) first = off;
+        if (head || (f & B_LEADER))
+            roots.push_back({ p.space, s.base + off, (f & B_FUNC) != 0 });
+        memset(s.flags.data() + off, 0, len);
+        last = off + len;
+        off += len - 1;
+    }
+    if (first == UINT64_MAX) return false;
+
+    uint64_t from = s.base + first, to = s.base + last;
+    std::erase_if(sp.edges, [&](const ar_cfg_edge &e) {
+        return e.from_bank == s.bank && e.from >= from && e.from < to;
+    });
+    s.dirty = true;
+    return true;
+}
+
+static void extract_segment(Space &sp, int si) {
+    Segment &s = sp.segs[si];
+    s.refs.clear();
+
+    xref::HiTracker hi;
+    std::vector<xref::Ref> refs;
+    uint64_t off = 0;
+    while (off < s.size) {
+        uint8_t f = s.flags[off];
+        unsigned len = f & B_LEN;
+        if (!len) { off++; continue; }
+        if (f & B_LEADER) hi.reset();
+
+        uint64_t pc = s.base + off;
+        std::span<const uint8_t> raw(s.bytes.data() + off, len);
+        auto insns = arch::disassemble(raw, pc, sp.type);
+        if (!insns.empty()) {
+            refs.clear();
+            xref::extract(insns[0], sp.type, raw, hi, refs);
+            for (auto &r : refs) {
+                int ti = target_seg(sp, si, r.to);
+                if (r.kind == AR_XREF_IMM && ti < 0)
+                    continue;   /* immediate outside mapped memory */
+                s.refs.push_back({ r.to, pc, s.bank,
+                                   ti >= 0 ? sp.segs[ti].bank : -1, r.kind });
+            }
+        }
+        off += len;
+    }
+    xref::sort(s.refs);
+}
+
+static void index_xrefs(Space &sp) {
+    bool any = false;
+    for (size_t i = 0; i < sp.segs.size(); i++) {
+        if (!sp.segs[i].dirty) continue;
+        extract_segment(sp, (int)i);
+        any = true;
+    }
+    if (!any) return;
+
+    std::vector<const std::vector<ar_xref> *> parts;
+    for (auto &s : sp.segs)
+        if (!s.refs.empty()) parts.push_back(&s.refs);
+    sp.xrefs = xref::merge(parts);
+}
+
+/* Share a copy of the results with the query threads.  Flags are copied
+ * only for segments changed since the last publish. */
+static void publish(void) {
+    std::vector<Space> copy;
+    copy.reserve(g_work.size());
+    for (auto &sp : g_work) {
+        Space c;
+        c.id = sp.id;
+        c.cpu = sp.cpu;
+        c.type = sp.type;
+        c.max_insn = sp.max_insn;
+        c.alignment = sp.alignment;
+        c.delay_slots = sp.delay_slots;
+        for (auto &s : sp.segs) {
+            if (s.dirty || !s.shared) {
+                s.shared = std::make_shared<const std::vector<uint8_t>>(s.flags);
+                s.dirty = false;
+            }
+            c.segs.push_back({ s.base, s.size, s.bank, s.window, s.live,
+                               s.source, s.source_base, {}, {}, s.shared,
+                               s.page_crc, {}, false });
+        }
+        c.edges = sp.edges;
+        c.blocks = sp.blocks;
+        c.xrefs = sp.xrefs;
+        c.insns = sp.insns;
+        c.funcs = sp.funcs;
+        copy.push_back(std::move(c));
+    }
+    std::lock_guard lock(g_mutex);
+    g_results.swap(copy);
+}
+
+/* ======================================================================== */
+/* Cache file                                                                */
+/* ======================================================================== */
+
+static bool rom_checksum(const std::string &path, uint32_t *crc,
+                         uint64_t *size) {
+    if (path.empty()) return false;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::vector<uint8_t> buf(1 << 20);
+    uLong c = crc32(0L, Z_NULL, 0);
+    uint64_t total = 0;
+    size_t n;
+    while (total < CHECKSUM_LIMIT &&
+           (n = fread(buf.data(), 1, buf.size(), f)) > 0) {
+        c = crc32(c, buf.data(), (uInt)n);
+        total += n;
+    }
+    fseek(f, 0, SEEK_END);
+    long end = ftell(f);
+    fclose(f);
+    *crc = (uint32_t)c;
+    *size = end > 0 ? (uint64_t)end : total;
+    return true;
+}
+
+static void put_u(std::vector<uint8_t> &out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static uint64_t get_u(const uint8_t *&p, const uint8_t *end, int bytes,
+                      bool &ok) {
+    if (end - p < bytes) { ok = false; return 0; }
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+    p += bytes;
+    return v;
+}
+
+static uint32_t bytes_crc(const std::vector<uint8_t> &bytes) {
+    return (uint32_t)crc32(crc32(0L, Z_NULL, 0), bytes.data(), (uInt)bytes.size());
+}
+
+static void save_cache(uint32_t crc, uint64_t rom_size) {
+    if (g_cache_path.empty()) return;
+
+    std::vector<std::vector<uint64_t>> coverage;
+    for (auto &c : g_coverage)
+        coverage.emplace_back(c.begin(), c.end());
+
+    std::vector<uint8_t> raw;
+    put_u(raw, g_work.size(), 4);
+    for (size_t i = 0; i < g_work.size(); i++) {
+        auto &sp = g_work[i];
+        put_u(raw, sp.id.size(), 4);
+        raw.insert(raw.end(), sp.id.begin(), sp.id.end());
+        put_u(raw, sp.segs.size(), 4);
+        for (auto &s : sp.segs) {
+            put_u(raw, s.base, 8);
+            put_u(raw, s.size, 8);
+            put_u(raw, (uint64_t)s.bank, 8);
+            put_u(raw, bytes_crc(s.bytes), 4);
+            raw.insert(raw.end(), s.flags.begin(), s.flags.end());
+        }
+        put_u(raw, sp.edges.size(), 4);
+        for (auto &e : sp.edges) {
+            put_u(raw, e.from, 8);
+            put_u(raw, (uint64_t)e.from_bank, 8);
+            put_u(raw, e.to, 8);
+            put_u(raw, (uint64_t)e.to_bank, 8);
+            put_u(raw, e.kind, 1);
+        }
+        static const std::vector<uint64_t> none;
+        const auto &cov = i < coverage.size() ? coverage[i] : none;
+        put_u(raw, cov.size(), 4);
+        for (uint64_t pc : cov)
+            put_u(raw, pc, 8);
+    }
+
+    uLongf zlen = compressBound(raw.size());
+    std::vector<uint8_t> z(zlen);
+    if (compress2(z.data(), &zlen, raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK)
+        return;
+
+    std::vector<uint8_t> hdr = { 'A', 'R', 'A', 'N' };
+    put_u(hdr, CACHE_VERSION, 4);
+    put_u(hdr, crc, 4);
+    put_u(hdr, rom_size, 8);
+    put_u(hdr, raw.size(), 8);
+
+    std::string tmp = g_cache_path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    bool ok = fwrite(hdr.data(), 1, hdr.size(), f) == hdr.size() &&
+              fwrite(z.data(), 1, zlen, f) == zlen;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), g_cache_path.c_str()) != 0) {
+        remove(tmp.c_str());
+        fprintf(stderr, "[arret] Failed to write %s\n", g_cache_path.c_str());
+    }
+}
+
+/* Merge cached flags/edges into g_work; cached coverage becomes roots. */
+static bool load_cache(uint32_t crc, uint64_t rom_size) {
+    if (g_cache_path.empty()) return false;
+    FILE *f = fopen(g_cache_path.c_str(), "rb");
+    if (!f) return false;
+    std::vector<uint8_t> file;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        file.insert(file.end(), chunk, chunk + n);
+    fclose(f);
+
+    bool ok = true;
+    const uint8_t *p = file.data(), *end = p + file.size();
+    if (file.size() < 28 || memcmp(p, "ARAN", 4) != 0) return false;
+    p += 4;
+    if (get_u(p, end, 4, ok) != CACHE_VERSION) return false;
+    if (get_u(p, end, 4, ok) != crc) return false;
+    if (get_u(p, end, 8, ok) != rom_size) return false;
+    uLongf raw_size = (uLongf)get_u(p, end, 8, ok);
+
+    std::vector<uint8_t> raw(raw_size);
+    if (uncompress(raw.data(), &raw_size, p, (uLong)(end - p)) != Z_OK ||
+        raw_size != raw.size())
+        return false;
+
+    p = raw.data();
+    end = p + raw.size();
+    std::vector<Root> roots;
+    std::vector<std::vector<uint64_t>> coverage(g_work.size());
+    unsigned nspaces = (unsigned)get_u(p, end, 4, ok);
+    for (unsigned i = 0; ok && i < nspaces; i++) {
+        uint64_t idlen = get_u(p, end, 4, ok);
+        if (!ok || (uint64_t)(end - p) < idlen) return false;
+        std::string id((const char *)p, idlen);
+        p += idlen;
+
+        Space *sp = nullptr;
+        unsigned si = 0;
+        for (; si < g_work.size(); si++)
+            if (g_work[si].id == id) { sp = &g_work[si]; break; }
+
+        /* Segments whose cached flags still describe their bytes */
+        std::vector<char> loaded(sp ? sp->segs.size() : 0, 0);
+        unsigned nsegs = (unsigned)get_u(p, end, 4, ok);
+        for (unsigned j = 0; ok && j < nsegs; j++) {
+            uint64_t base = get_u(p, end, 8, ok);
+            uint64_t size = get_u(p, end, 8, ok);
+            int64_t bank = (int64_t)get_u(p, end, 8, ok);
+            uint32_t seg_crc = (uint32_t)get_u(p, end, 4, ok);
+            if (!ok || (uint64_t)(end - p) < size) return false;
+            for (size_t k = 0; sp && k < sp->segs.size(); k++) {
+                auto &s = sp->segs[k];
+                if (s.base == base && s.size == size && s.bank == bank &&
+                    bytes_crc(s.bytes) == seg_crc) {
+                    s.flags.assign(p, p + size);
+                    loaded[k] = 1;
+                }
+            }
+            p += size;
+        }
+
+        unsigned nedges = (unsigned)get_u(p, end, 4, ok);
+        for (unsigned j = 0; ok && j < nedges; j++) {
+            ar_cfg_edge e;
+            e.from = get_u(p, end, 8, ok);
+            e.from_bank = (int64_t)get_u(p, end, 8, ok);
+            e.to = get_u(p, end, 8, ok);
+            e.to_bank = (int64_t)get_u(p, end, 8, ok);
+            e.kind = (ar_edge_kind)get_u(p, end, 1, ok);
+            if (!sp) continue;
+            int si_from = find_seg(*sp, e.from, e.from_bank);
+            if (si_from >= 0 && loaded[si_from]) sp->edges.push_back(e);
+        }
+
+        unsigned ncov = (unsigned)get_u(p, end, 4, ok);
+        for (unsigned j = 0; ok && j < ncov; j++) {
+            uint64_t pc = get_u(p, end, 8, ok);
+            int si_pc = sp ? live_seg(*sp, pc) : -1;
+            if (si_pc >= 0 && loaded[si_pc]) {
+                coverage[si].push_back(pc);
+                roots.push_back({ si, pc, false });
+            }
+        }
+    }
+    if (!ok) return false;
+
+    for (size_t i = 0; i < coverage.size() && i < g_coverage.size(); i++)
+        g_coverage[i].insert(coverage[i].begin(), coverage[i].end());
+    std::lock_guard lock(g_mutex);
+    g_pending.insert(g_pending.end(), roots.begin(), roots.end());
+    return true;
+}
+
+/* ======================================================================== */
+/* Worker                                                                    */
+/* ======================================================================== */
+
+/* Executed PCs outside known code become roots, once each.  Returns true
+ * if coverage grew. */
+static bool note_executed(const std::vector<ExecPc> &executed,
+                          const std::vector<rd_Cpu const *> &cpus,
+                          std::vector<Root> &roots) {
+    bool grew = false;
+    for (auto &e : executed) {
+        unsigned i = 0;
+        while (i < cpus.size() && cpus[i] != e.cpu) i++;
+        if (i >= g_work.size() || i >= g_coverage.size()) continue;
+        const Space &sp = g_work[i];
+        int si = live_seg(sp, e.pc);
+        if (si >= 0 && (sp.segs[si].flags[e.pc - sp.segs[si].base] & B_LEN))
+            continue;
+        if (g_coverage[i].insert(e.pc).second) {
+            roots.push_back({ i, e.pc, false });
+            grew = true;
+        }
+    }
+    return grew;
+}
+
+static void worker_main(bool use_cache) {
+    uint32_t crc = 0;
+    uint64_t rom_size = 0;
+    bool have_crc = rom_checksum(g_rom_path, &crc, &rom_size);
+    bool first = true;
+
+    /* Results changed since the cache was last written, first at
+     * changed_at */
+    bool unsaved = false;
+    auto changed_at = std::chrono::steady_clock::now();
+
+    if (use_cache && have_crc && load_cache(crc, rom_size)) {
+        for (auto &sp : g_work) { rebuild(sp); index_xrefs(sp); }
+        publish();
+        fprintf(stderr, "[arret] Loaded analysis cache from %s\n",
+                g_cache_path.c_str());
+    }
+
+    for (;;) {
+        std::vector<Root> roots;
+        std::vector<Patch> patches;
+        std::vector<ExecPc> executed;
+        std::vector<rd_Cpu const *> cpus;
+        unsigned generation;
+        {
+            std::unique_lock lock(g_mutex);
+            auto ready = [] {
+                return g_stop || !g_pending.empty() || !g_patches.empty() ||
+                       !g_executed.empty();
+            };
+            if (!unsaved)
+                g_cv.wait(lock, ready);
+            else if (!g_cv.wait_until(lock, changed_at + CACHE_SAVE_INTERVAL, ready)) {
+                /* Quiet for a while: write what has changed */
+                lock.unlock();
+                save_cache(crc, rom_size);
+                unsaved = false;
+                continue;
+            }
+            if (g_stop) break;
+            roots.swap(g_pending);
+            patches.swap(g_patches);
+            executed.swap(g_executed);
+            cpus = g_cpus;
+            generation = g_generation;
+            g_busy = true;
+        }
+
+        bool changed = false;
+        for (auto &p : patches)
+            if (p.generation == generation)
+                changed |= apply_patch(p, roots);
+        bool grew = note_executed(executed, cpus, roots);
+        for (auto &r : roots) {
+            if (g_stop) break;
+            if (r.space < g_work.size())
+                changed |= discover(g_work[r.space], r.addr, r.func);
+        }
+        if (g_stop) {
+            unsaved = false;    /* the interrupted batch is incomplete */
+            break;
+        }
+
+        if (changed) {
+            for (auto &sp : g_work) { rebuild(sp); index_xrefs(sp); }
+            publish();
+        }
+        if (have_crc && (changed || grew) && !unsaved) {
+            unsaved = true;
+            changed_at = std::chrono::steady_clock::now();
+        }
+        if (unsaved && std::chrono::steady_clock::now() - changed_at >=
+                           CACHE_SAVE_INTERVAL) {
+            save_cache(crc, rom_size);
+            unsaved = false;
+        }
+        if (first) {
+            uint64_t insns = 0, blocks = 0, funcs = 0;
+            for (auto &sp : g_work) {
+                insns += sp.insns;
+                blocks += sp.blocks.size();
+                funcs += sp.funcs;
+            }
+            fprintf(stderr, "[arret] Analysis: %lu instructions, %lu blocks, "
+                    "%lu functions\n", (unsigned long)insns,
+                    (unsigned long)blocks, (unsigned long)funcs);
+            first = false;
+        }
+        {
+            std::lock_guard lock(g_mutex);
+            g_busy = false;
+        }
+        g_idle_cv.notify_all();
+    }
+    if (unsaved) save_cache(crc, rom_size);
+    g_busy = false;
+    g_idle_cv.notify_all();
+}
+
+static void stop_worker(void) {
+    {
+        std::lock_guard lock(g_mutex);
+        g_stop = true;
+    }
+    g_cv.notify_all();
+    if (g_worker.joinable()) g_worker.join();
+    g_stop = false;
+}
+
+static bool start_analysis(bool use_cache) {
+    rd_System const *sys = ar_debug_system();
+    if (!sys || !ar_content_loaded()) return false;
+
+    /* Keep coverage gathered so far this session */
+    std::vector<std::pair<std::string, std::unordered_set<uint64_t>>> prev_cov;
+    stop_worker();
+    for (size_t i = 0; i < g_work.size() && i < g_coverage.size(); i++)
+        prev_cov.push_back({ g_work[i].id, std::move(g_coverage[i]) });
+
+    const sys::Sys *desc = sys::sys_for_desc(sys->v1.description);
+    std::vector<Space> spaces;
+    std::vector<Root> roots;
+    std::vector<rd_Cpu const *> cpus;
+    std::vector<std::unordered_set<uint64_t>> coverage;
+    uint64_t budget = MAX_SNAPSHOT_BYTES;
+
+    for (unsigned i = 0; i < sys->v1.num_cpus; i++) {
+        rd_Cpu const *cpu = sys->v1.cpus[i];
+        const arch::Arch *a = arch::arch_for_cpu(cpu->v1.type);
+        rd_Memory const *mem = cpu->v1.memory_region;
+        if (!a || !mem) continue;
+
+        Space sp;
+        sp.id = cpu->v1.id;
+        sp.cpu = cpu;
+        sp.type = cpu->v1.type;
+        sp.max_insn = a->max_insn_size;
+        sp.alignment = a->alignment ? a->alignment : 1;
+        sp.delay_slots = a->branch_delay_slots;
+        snapshot(sp, mem, budget);
+
+        unsigned idx = (unsigned)spaces.size();
+        int pc_reg = ar_reg_pc(cpu->v1.type);
+        if (pc_reg >= 0)
+            roots.push_back({ idx, cpu->v1.get_register(cpu, (unsigned)pc_reg),
+                              false });
+        if (cpu->v1.is_main && desc) {
+            for (unsigned k = 0; k < desc->num_entry_points; k++)
+                roots.push_back({ idx, desc->entry_points[k], true });
+            for (unsigned k = 0; k < desc->num_entry_vectors; k++) {
+                uint64_t v = desc->entry_vectors[k];
+                uint8_t vec[2];
+                ar_mem_read(mem, v, 2, vec);
+                uint64_t target = vec[0] | (vec[1] << 8);
+                roots.push_back({ idx, target, true });
+            }
+        }
+
+        std::unordered_set<uint64_t> cov;
+        for (auto &[id, pcs] : prev_cov)
+            if (id == sp.id) cov = std::move(pcs);
+        for (uint64_t pc : cov)
+            roots.push_back({ idx, pc, false });
+        coverage.push_back(std::move(cov));
+
+        cpus.push_back(cpu);
+        spaces.push_back(std::move(sp));
+    }
+
+    /* Execute breakpoints */
+    unsigned bp_count = ar_bp_count();
+    if (bp_count > 0) {
+        std::vector<ar_breakpoint> bps(bp_count);
+        unsigned n = ar_bp_list(bps.data(), bp_count);
+        for (unsigned i = 0; i < n; i++) {
+            if (!(bps[i].flags & AR_BP_EXECUTE)) continue;
+            rd_Cpu const *cpu = ar_debug_cpu();
+            for (unsigned k = 0; k < cpus.size(); k++) {
+                if (bps[i].cpu_id[0] ? spaces[k].id == bps[i].cpu_id
+                                     : cpus[k] == cpu) {
+                    roots.push_back({ k, bps[i].address, false });
+                    break;
+                }
+            }
+        }
+    }
+
+    if (spaces.empty()) return false;
+
+    const char *base = ar_rompath_base();
+    g_cache_path = (base && base[0]) ? std::string(base) + ".analysis" : "";
+    const char *rom = ar_rompath();
+    g_rom_path = rom ? rom : "";
+    g_work = std::move(spaces);
+    g_coverage = std::move(coverage);
+    {
+        std::lock_guard lock(g_mutex);
+        g_results.clear();
+        g_cpus = std::move(cpus);
+        g_pending = std::move(roots);
+        g_patches.clear();
+        g_executed.clear();
+        g_generation++;
+    }
+    g_exec_restart++;
+    g_worker = std::thread(worker_main, use_cache);
+    return true;
+}
+
+/* ======================================================================== */
+/* Public API                                                                */
+/* ======================================================================== */
+
+bool ar_analysis_start(void) {
+    return start_analysis(false);
+}
+
+bool ar_analysis_auto_start(void) {
+    return start_analysis(true);
+}
+
+void ar_analysis_stop(void) {
+    stop_worker();
+    g_work.clear();
+    g_coverage.clear();
+    std::lock_guard lock(g_mutex);
+    g_results.clear();
+    g_pending.clear();
+    g_patches.clear();
+    g_executed.clear();
+    g_generation++;
+    g_cpus.clear();
+}
+
+void ar_analysis_note_exec(rd_Cpu const *cpu, uint64_t pc) {
+    unsigned run = g_exec_restart.load(std::memory_order_relaxed);
+    if (run != g_exec_filter_run) {
+        std::fill(std::begin(g_exec_filter), std::end(g_exec_filter),
+                  ExecPc{ nullptr, 0 });
+        g_exec_filter_run = run;
+    }
+
+    /* Loops run the same few PCs over and over */
+    uint64_t h = (pc ^ (uint64_t)(uintptr_t)cpu) * 0x9E3779B97F4A7C15ull;
+    ExecPc &seen = g_exec_filter[(h >> 50) & (EXEC_FILTER - 1)];
+    if (seen.cpu == cpu && seen.pc == pc) return;
+    if (g_exec_count == EXEC_BUFFER) return;   /* noted again next frame */
+    seen = { cpu, pc };
+    g_exec[g_exec_count++] = { cpu, pc };
+}
+
+void ar_analysis_flush_exec(void) {
+    if (g_exec_count == 0) return;
+    {
+        std::lock_guard lock(g_mutex);
+        size_t room = g_executed.size() < EXEC_BACKLOG
+                      ? EXEC_BACKLOG - g_executed.size() : 0;
+        size_t n = std::min<size_t>(g_exec_count, room);
+        if (!g_cpus.empty())
+            g_executed.insert(g_executed.end(), g_exec, g_exec + n);
+    }
+    g_exec_count = 0;
+    g_cv.notify_one();
+}
+
+void ar_analysis_get_stats(ar_analysis_stats *out) {
+    if (!out) return;
+    *out = {};
+    std::lock_guard lock(g_mutex);
+    out->running = g_busy || !g_pending.empty() || !g_patches.empty() ||
+                   !g_executed.empty();
+    for (auto &sp : g_results) {
+        out->instructions += sp.insns;
+        out->blocks += sp.blocks.size();
+        out->functions += sp.funcs;
+        out->edges += sp.edges.size();
+        out->xrefs += sp.xrefs.size();
+    }
+}
+
+bool ar_analysis_refresh(void) {
+    struct Check {
+        unsigned space, seg;
+        uint64_t off, len;
+        rd_Memory const *source;
+        uint64_t source_addr;
+        uint32_t crc;
+    };
+    std::vector<Check> checks;
+    unsigned generation;
+    {
+        std::lock_guard lock(g_mutex);
+        generation = g_generation;
+        for (unsigned i = 0; i < g_results.size(); i++) {
+            auto &segs = g_results[i].segs;
+            for (unsigned j = 0; j < segs.size(); j++) {
+                auto &s = segs[j];
+                for (uint64_t off = 0; off < s.size; off += PAGE_SIZE) {
+                    uint64_t len = std::min(PAGE_SIZE, s.size - off);
+                    auto f = s.shared->begin() + off;
+                    if (std::none_of(f, f + len,
+                            [](uint8_t b) { return b & B_CODE; }))
+                        continue;   /* only code pages matter */
+                    checks.push_back({ i, j, off, len, s.source,
+                                       s.source_base + off,
+                                       s.page_crc[off / PAGE_SIZE] });
+                }
+            }
+        }
+    }
+
+    std::lock_guard refresh_lock(g_refresh_mutex);
+    if (g_refresh_generation != generation) {
+        g_verified.clear();
+        g_refresh_generation = generation;
+    }
+
+    /* Pages verified last time, for sources the core tracks; those not
+     * written since need no reading */
+    std::unordered_map<rd_Memory const *, std::unordered_set<uint64_t>> prev;
+    for (auto &c : checks) {
+        if (prev.count(c.source)) continue;
+        Verified &v = g_verified[c.source];
+        v.dirty.set_memory(c.source);
+        v.tracked = v.dirty.update();
+        prev[c.source] = std::move(v.pages);
+        v.pages.clear();
+    }
+
+    std::vector<Patch> patches;
+    uint8_t buf[PAGE_SIZE];
+    for (auto &c : checks) {
+        Verified &v = g_verified[c.source];
+        if (v.tracked) {
+            v.pages.insert(c.source_addr);
+            if (prev[c.source].count(c.source_addr) &&
+                !v.dirty.changed(c.source_addr, c.len))
+                continue;
+        }
+        ar_mem_read(c.source, c.source_addr, c.len, buf);
+        if (page_crc(buf, c.len) == c.crc) continue;
+        patches.push_back({ generation, c.space, c.seg, c.off,
+                            std::vector<uint8_t>(buf, buf + c.len) });
+    }
+    if (patches.empty()) return false;
+
+    {
+        std::lock_guard lock(g_mutex);
+        if (generation != g_generation) return false;
+        g_patches.insert(g_patches.end(),
+                         std::make_move_iterator(patches.begin()),
+                         std::make_move_iterator(patches.end()));
+    }
+    g_cv.notify_one();
+    return true;
+}
+
+bool ar_analysis_wait_idle(unsigned timeout_ms) {
+    std::unique_lock lock(g_mutex);
+    return g_idle_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [] {
+        return !g_busy && g_pending.empty() && g_patches.empty() &&
+               g_executed.empty();
+    });
+}
+
+bool ar_analysis_block_at(rd_Cpu const *cpu, uint64_t addr, int64_t bank,
+                          ar_basic_block *out) {
+    if (!cpu || !out) return false;
+    if (bank < 0)
+        bank = bank_for_addr(fetch_map(cpu->v1.memory_region), addr);
+
+    std::lock_guard lock(g_mutex);
+    const Space *sp = find_space(g_results, cpu);
+    if (!sp) return false;
+    int bi = block_index(sp->blocks, bank, addr);
+    if (bi < 0) return false;
+    *out = sp->blocks[bi];
+    return true;
+}
+
+std::vector<ar_xref> ar_analysis_xrefs_to(rd_Cpu const *cpu, uint64_t addr,
+                                          int64_t bank) {
+    std::vector<ar_xref> out;
+    if (!cpu) return out;
+    std::lock_guard lock(g_mutex);
+    const Space *sp = find_space(g_results, cpu);
+    if (!sp) return out;
+    for (auto &r : xref::find(sp->xrefs, addr))
+        if (bank < 0 || r.to_bank < 0 || r.to_bank == bank)
+            out.push_back(r);
+    return out;
+}
+
+/* Decode data at base_addr honouring the analysed flags of the bank that
+ * bank_of(addr) names; with code_only, unanalysed bytes become DB */
+template <typename BankOf>
+static std::vector<arch::Instruction> disassemble_known(
+    rd_Cpu const *cpu, std::span<const uint8_t> data, uint64_t base_addr,
+    BankOf bank_of, bool code_only)
+{
+    if (!cpu) return {};
+    unsigned type = cpu->v1.type;
+    const arch::Arch *a = arch::arch_for_cpu(type);
+
+    /* Copy the flags covering the window */
+    std::vector<uint8_t> flags(data.size(), 0);
+    bool any = false;
+    {
+        std::lock_guard lock(g_mutex);
+        const Space *sp = find_space(g_results, cpu);
+        int si = -1;
+        int64_t si_bank = -1;
+        for (size_t i = 0; sp && i < data.size(); i++) {
+            uint64_t addr = base_addr + i;
+            int64_t bank = bank_of(addr);
+            if (si < 0 || si_bank != bank || !seg_covers(sp->segs[si], addr)) {
+                si = find_seg(*sp, addr, bank);
+                si_bank = bank;
+            }
+            if (si < 0 || !sp->segs[si].shared) continue;
+            flags[i] = (*sp->segs[si].shared)[addr - sp->segs[si].base];
+            if (flags[i]) any = true;
+        }
+    }
+    if (!any || !a) return arch::disassemble(data, base_addr, type);
+
+    std::vector<arch::Instruction> out;
+    auto emit_db = [&](size_t pos) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "DB $%02X", data[pos]);
+        out.push_back({ base_addr + pos, 1, buf, false, false, 0, true });
+    };
+
+    size_t pos = 0;
+    bool leading = true;
+    while (pos < data.size()) {
+        uint8_t f = flags[pos];
+        if ((f & B_CODE) && !(f & B_LEN)) {
+            /* Tail of a known instruction */
+            if (!leading) emit_db(pos);
+            pos++;
+            continue;
+        }
+        leading = false;
+
+        if (!(f & B_LEN) && code_only) {
+            emit_db(pos);
+            pos++;
+            continue;
+        }
+
+        size_t n = std::min<size_t>(a->max_insn_size, data.size() - pos);
+        auto insns = arch::disassemble(data.subspan(pos, n),
+                                       base_addr + pos, type);
+        if (insns.empty()) break;
+        arch::Instruction &insn = insns[0];
+        if (!(f & B_LEN)) {
+            /* Unknown bytes: never decode across the start of known code */
+            bool clash = false;
+            for (size_t k = 1; k < insn.length && pos + k < data.size(); k++)
+                if (flags[pos + k] & B_CODE) clash = true;
+            if (clash) { emit_db(pos); pos++; continue; }
+        }
+
+        pos += insn.length ? insn.length : 1;
+        out.push_back(std::move(insn));
+    }
+    return out;
+}
+
+std::vector<arch::Instruction> ar_analysis_disassemble(
+    rd_Cpu const *cpu, std::span<const uint8_t> data, uint64_t base_addr)
+{
+    if (!cpu) return {};
+    auto maps = fetch_map(cpu->v1.memory_region);
+    return disassemble_known(cpu, data, base_addr,
+        [&](uint64_t addr) { return bank_for_addr(maps, addr); }, false);
+}
+
+std::vector<arch::Instruction> ar_analysis_disassemble_bank(
+    rd_Cpu const *cpu, std::span<const uint8_t> data, uint64_t base_addr,
+    int64_t bank, bool code_only)
+{
+    return disassemble_known(cpu, data, base_addr,
+        [bank](uint64_t) { return bank; }, code_only);
+}
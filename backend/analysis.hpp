@@ -0,0 +1,127 @@
+/*
+ * analysis.h: Background code discovery
+ *
+ * Recursive-descent disassembly seeded from reset/interrupt vectors,
+ * executed PCs and execute breakpoints.  A worker thread walks a snapshot
+ * of each CPU's code memory (every bank of banked windows) and builds
+ * basic blocks, functions and control-flow edges per (cpu, bank), plus
+ * an index of cross-references made by the analysed code.
+ * Results are persisted as <rombase>.analysis, keyed by the ROM's CRC32,
+ * so the next session starts from the cached graph.
+ */
+
+#ifndef AR_ANALYSIS_H
+#define AR_ANALYSIS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "retrodebug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Snapshot code memory of every CPU and restart analysis from scratch,
+ * ignoring the on-disk cache.  Call while the core is not running a frame. */
+bool ar_analysis_start(void);
+
+/* As ar_analysis_start, but seed from <rombase>.analysis when its
+ * checksum matches the loaded ROM.  Called after content load. */
+bool ar_analysis_auto_start(void);
+
+/* Stop the worker and drop all results (content unload / shutdown). */
+void ar_analysis_stop(void);
+
+/* Record an executed PC (core thread).  PCs are buffered without locking,
+ * up to a fixed number per frame, and PCs outside known code become new
+ * roots for the worker. */
+void ar_analysis_note_exec(rd_Cpu const *cpu, uint64_t pc);
+
+/* Hand the buffered PCs to the worker (core thread, at the end of each
+ * frame and when the core pauses). */
+void ar_analysis_flush_exec(void);
+
+typedef struct ar_analysis_stats {
+    bool     running;         /* worker is processing roots */
+    uint64_t instructions;
+    uint64_t blocks;
+    uint64_t functions;
+    uint64_t edges;
+    uint64_t xrefs;
+} ar_analysis_stats;
+
+void ar_analysis_get_stats(ar_analysis_stats *out);
+
+/* Re-read analysed code pages and queue those whose contents changed since
+ * the snapshot (self-modifying code, pokes, RAM loads) for re-decoding.
+ * Returns true if anything was queued.  Call while the core is not
+ * running a frame. */
+bool ar_analysis_refresh(void);
+
+/* Wait up to timeout_ms for the worker to drain its queue.  Returns true
+ * if it is idle. */
+bool ar_analysis_wait_idle(unsigned timeout_ms);
+
+#ifdef __cplusplus
+}
+
+#include <span>
+#include <vector>
+
+#include "arch.hpp"
+#include "xref.hpp"
+
+enum ar_edge_kind : uint8_t {
+    AR_EDGE_FALL,       /* sequential flow into the next block */
+    AR_EDGE_BRANCH,     /* conditional branch taken */
+    AR_EDGE_JUMP,       /* unconditional jump */
+    AR_EDGE_CALL,       /* subroutine call */
+};
+
+struct ar_cfg_edge {
+    uint64_t from;          /* address of the transferring instruction */
+    int64_t  from_bank;
+    uint64_t to;
+    int64_t  to_bank;       /* -1 for unbanked or unanalysed memory */
+    ar_edge_kind kind;
+};
+
+struct ar_basic_block {
+    uint64_t start;
+    uint64_t end;           /* exclusive */
+    int64_t  bank;          /* -1 for unbanked memory */
+    uint64_t func;          /* owning function entry, UINT64_MAX if none */
+    std::vector<ar_cfg_edge> succ;
+};
+
+/* Basic block containing addr in the CPU's address space.  bank < 0 means
+ * whichever bank is currently mapped.  Returns false if addr is not in
+ * analysed code. */
+bool ar_analysis_block_at(rd_Cpu const *cpu, uint64_t addr, int64_t bank,
+                          ar_basic_block *out);
+
+/* References to addr in the CPU's address space, sorted by referencing
+ * bank and address.  bank < 0 matches references into any bank. */
+std::vector<ar_xref> ar_analysis_xrefs_to(rd_Cpu const *cpu, uint64_t addr,
+                                          int64_t bank);
+
+/* Disassemble data read from cpu's memory region at base_addr, honouring
+ * known instruction boundaries: bytes belonging to an instruction that
+ * starts before the window are skipped, and linear decoding never runs
+ * over the start of a known instruction (those bytes become DB).  Falls
+ * back to plain arch::disassemble when nothing in range is analysed. */
+std::vector<arch::Instruction> ar_analysis_disassemble(
+    rd_Cpu const *cpu, std::span<const uint8_t> data, uint64_t base_addr);
+
+/* As ar_analysis_disassemble for the given bank of the window (-1 for
+ * unbanked memory) rather than the one mapped now.  With code_only, bytes
+ * the analysis has not reached come out as one-byte DB entries instead of
+ * being decoded, once anything in the window is known code. */
+std::vector<arch::Instruction> ar_analysis_disassemble_bank(
+    rd_Cpu const *cpu, std::span<const uint8_t> data, uint64_t base_addr,
+    int64_t bank, bool code_only);
+
+#endif /* __cplusplus */
+
+#endif /* AR_ANALYSIS_H */
@@ -25,8 +25,9 @@ struct Instruction {
 
     bool     breaks_flow;     // Unconditional non-sequential flow (JP, JR uncond, RET, RETI)
     bool     has_target;      // True if target is valid
-    uint64_t target;          // Computed jump destination (JP/JR variants only)
+    uint64_t target;          // Computed jump/call destination
     bool     is_error;        // Invalid/undefined opcode
+    bool     is_call = false; // Subroutine call (CALL, RST, JSR, JAL...); returns to next insn
 };
 
 /* ---- Register layout descriptors (for Qt register pane) ---- */
@@ -61,6 +62,7 @@ struct StackFrame {
     uint64_t pc;            // Return address (caller's PC)
     uint64_t sp;            // Stack pointer at this frame
     uint64_t func_addr;     // Estimated function start (UINT64_MAX if unknown)
+    bool     interrupt = false; // Frame above was entered by an interrupt
 };
 
 enum class StackTraceStatus {
@@ -77,6 +79,21 @@ struct StackTrace {
     StackTraceStatus        status;
 };
 
+/* ---- Control-flow classification (shadow call stack) ---- */
+
+enum class FlowKind {
+    NONE,                   // Sequential or local flow
+    CALL,                   // Subroutine call, possibly conditional (CALL cc, BGEZAL)
+    RETURN,                 // Subroutine/interrupt return, possibly conditional
+    INDIRECT,               // Register-indirect jump (JP HL, JMP (a), JR rs)
+};
+
+struct Flow {
+    FlowKind kind;
+    uint8_t  length;        // Byte length of the instruction
+    uint8_t  return_offset; // CALL: callee returns to pc + return_offset
+};
+
 /* ---- Architecture descriptor ---- */
 
 struct Arch {
@@ -93,6 +110,9 @@ struct Arch {
     const char *const *calling_conventions;  // nullptr-terminated list; first is default
     StackTrace (*stack_trace_fn)(rd_Cpu const *cpu, unsigned max_depth,
                                  unsigned cc_index);
+
+    // Classify the instruction at bytes[0..max_insn_size) without formatting it
+    Flow (*flow_fn)(const uint8_t *bytes);
 };
 
 const Arch *arch_for_cpu(unsigned cpu_type);
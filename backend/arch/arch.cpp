@@ -29,6 +29,11 @@ extern const unsigned r3000a_num_reg_layout;
 extern const TraceReg r3000a_trace_regs[];
 extern const unsigned r3000a_num_trace_regs;
 
+// Forward declarations for control-flow classifiers
+Flow lr35902_flow(const uint8_t *bytes);
+Flow mos6502_flow(const uint8_t *bytes);
+Flow r3000a_flow(const uint8_t *bytes);
+
 // Forward declarations for R3000A stack trace
 extern const char *r3000a_cc_names[];
 StackTrace r3000a_stack_trace(rd_Cpu const *cpu, unsigned max_depth,
@@ -44,17 +49,17 @@ static const ArchEntry arch_table[] = {
     { { RD_CPU_LR35902, 3, 1,
         lr35902_reg_layout, lr35902_num_reg_layout,
         lr35902_trace_regs, lr35902_num_trace_regs, 0,
-        nullptr, nullptr },
+        nullptr, nullptr, lr35902_flow },
       dis_lr35902 },
     { { RD_CPU_6502, 3, 1,
         mos6502_reg_layout, mos6502_num_reg_layout,
         nullptr, 0, 0,
-        nullptr, nullptr },
+        nullptr, nullptr, mos6502_flow },
       dis_6502 },
     { { RD_CPU_R3000A, 4, 4,
         r3000a_reg_layout, r3000a_num_reg_layout,
         r3000a_trace_regs, r3000a_num_trace_regs, 1,
-        r3000a_cc_names, r3000a_stack_trace },
+        r3000a_cc_names, r3000a_stack_trace, r3000a_flow },
       dis_r3000a },
 };
 
@@ -22,6 +22,8 @@ enum : uint8_t {
     F_BREAKS     = 1 << 0,   // Unconditional non-sequential flow
     F_TARGET     = 1 << 1,   // has absolute jump target
     F_REL_TARGET = 1 << 2,   // has relative jump target (compute addr + 2 + signed imm)
+    F_CALL       = 1 << 3,   // subroutine call
+    F_RST        = 1 << 4,   // restart vector target encoded in opcode bits 3-5
 };
 
 struct OpEntry {
@@ -255,36 +257,36 @@ static const OpEntry base_ops[256] = {
     { "POP BC",          0, F_NONE },       // C1
     { "JP NZ,$@%04X",    2, F_TARGET },     // C2
     { "JP $@%04X",       2, F_BREAKS | F_TARGET }, // C3
-    { "CALL NZ,$@%04X",  2, F_NONE },       // C4
+    { "CALL NZ,$@%04X",  2, F_TARGET | F_CALL }, // C4
     { "PUSH BC",         0, F_NONE },       // C5
     { "ADD A,$%02X",     1, F_NONE },       // C6
-    { "RST $00",         0, F_NONE },       // C7
+    { "RST $00",         0, F_CALL | F_RST }, // C7
     { "RET Z",           0, F_NONE },       // C8
     { "RET",             0, F_BREAKS },     // C9
     { "JP Z,$@%04X",     2, F_TARGET },     // CA
     { nullptr,           0, 0 },            // CB (prefix, handled separately)
-    { "CALL Z,$@%04X",   2, F_NONE },       // CC
-    { "CALL $@%04X",     2, F_NONE },       // CD
+    { "CALL Z,$@%04X",   2, F_TARGET | F_CALL }, // CC
+    { "CALL $@%04X",     2, F_TARGET | F_CALL }, // CD
     { "ADC A,$%02X",     1, F_NONE },       // CE
-    { "RST $08",         0, F_NONE },       // CF
+    { "RST $08",         0, F_CALL | F_RST }, // CF
 
     // 0xD0-0xDF
     { "RET NC",          0, F_NONE },       // D0
     { "POP DE",          0, F_NONE },       // D1
     { "JP NC,$@%04X",    2, F_TARGET },     // D2
     UND,                                    // D3
-    { "CALL NC,$@%04X",  2, F_NONE },       // D4
+    { "CALL NC,$@%04X",  2, F_TARGET | F_CALL }, // D4
     { "PUSH DE",         0, F_NONE },       // D5
     { "SUB $%02X",       1, F_NONE },       // D6
-    { "RST $10",         0, F_NONE },       // D7
+    { "RST $10",         0, F_CALL | F_RST }, // D7
     { "RET C",           0, F_NONE },       // D8
     { "RETI",            0, F_BREAKS },     // D9
     { "JP C,$@%04X",     2, F_TARGET },     // DA
     UND,                                    // DB
-    { "CALL C,$@%04X",   2, F_NONE },       // DC
+    { "CALL C,$@%04X",   2, F_TARGET | F_CALL }, // DC
     UND,                                    // DD
     { "SBC A,$%02X",     1, F_NONE },       // DE
-    { "RST $18",         0, F_NONE },       // DF
+    { "RST $18",         0, F_CALL | F_RST }, // DF
 
     // 0xE0-0xEF
     { "LDH ($@FF%02X),A", 1, F_NONE },     // E0
@@ -294,7 +296,7 @@ static const OpEntry base_ops[256] = {
     UND,                                    // E4
     { "PUSH HL",         0, F_NONE },       // E5
     { "AND $%02X",       1, F_NONE },       // E6
-    { "RST $20",         0, F_NONE },       // E7
+    { "RST $20",         0, F_CALL | F_RST }, // E7
     { "ADD SP,$%02X",    1, F_NONE },       // E8
     { "JP HL",           0, F_BREAKS },     // E9
     { "LD ($@%04X),A",   2, F_NONE },       // EA
@@ -302,7 +304,7 @@ static const OpEntry base_ops[256] = {
     UND,                                    // EC
     UND,                                    // ED
     { "XOR $%02X",       1, F_NONE },       // EE
-    { "RST $28",         0, F_NONE },       // EF
+    { "RST $28",         0, F_CALL | F_RST }, // EF
 
     // 0xF0-0xFF
     { "LDH A,($@FF%02X)", 1, F_NONE },     // F0
@@ -312,7 +314,7 @@ static const OpEntry base_ops[256] = {
     UND,                                    // F4
     { "PUSH AF",         0, F_NONE },       // F5
     { "OR $%02X",        1, F_NONE },       // F6
-    { "RST $30",         0, F_NONE },       // F7
+    { "RST $30",         0, F_CALL | F_RST }, // F7
     { "LD HL,SP+$%02X",  1, F_NONE },      // F8
     { "LD SP,HL",        0, F_NONE },       // F9
     { "LD A,($@%04X)",   2, F_NONE },       // FA
@@ -320,7 +322,7 @@ static const OpEntry base_ops[256] = {
     UND,                                    // FC
     UND,                                    // FD
     { "CP $%02X",        1, F_NONE },       // FE
-    { "RST $38",         0, F_NONE },       // FF
+    { "RST $38",         0, F_CALL | F_RST }, // FF
 };
 
 // CB-prefix register names (indexed by low 3 bits)
@@ -426,19 +428,47 @@ std::vector<Instruction> dis_lr35902(std::span<const uint8_t> data,
             target = imm;
             snprintf(buf, sizeof(buf), e.fmt, imm);
             has_target = true;
+        } else if (e.flags & F_RST) {
+            target = op & 0x38;
+            snprintf(buf, sizeof(buf), "%s", e.fmt);
+            has_target = true;
         } else if (e.imm_bytes > 0) {
             snprintf(buf, sizeof(buf), e.fmt, imm);
         } else {
             snprintf(buf, sizeof(buf), "%s", e.fmt);
         }
 
-        out.push_back({ addr, total, buf, breaks, has_target, target, false });
+        out.push_back({ addr, total, buf, breaks, has_target, target, false,
+                        (e.flags & F_CALL) != 0 });
         pos += total;
     }
 
     return out;
 }
 
+/* ======================================================================== */
+/* Control-flow classification                                               */
+/* ======================================================================== */
+
+Flow lr35902_flow(const uint8_t *bytes)
+{
+    uint8_t op = bytes[0];
+    const OpEntry &e = base_ops[op];
+    uint8_t total = e.fmt ? 1 + e.imm_bytes : 1;
+
+    if (e.flags & F_CALL)
+        return { FlowKind::CALL, total, total };
+    switch (op) {
+    case 0xC0: case 0xC8: case 0xD0: case 0xD8:    // RET cc
+    case 0xC9: case 0xD9:                          // RET, RETI
+        return { FlowKind::RETURN, 1, 0 };
+    case 0xE9:                                     // JP HL
+        return { FlowKind::INDIRECT, 1, 0 };
+    default:
+        return { FlowKind::NONE, total, 0 };
+    }
+}
+
 /* ======================================================================== */
 /* Register layout (for Qt register pane)                                    */
 /* ======================================================================== */
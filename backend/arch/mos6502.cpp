@@ -21,6 +21,7 @@ enum : uint8_t {
     F_BREAKS     = 1 << 0,   // Unconditional non-sequential flow
     F_TARGET     = 1 << 1,   // has absolute jump target
     F_REL_TARGET = 1 << 2,   // has relative jump target (compute addr + 2 + signed imm)
+    F_CALL       = 1 << 3,   // subroutine call
 };
 
 struct OpEntry {
@@ -70,7 +71,7 @@ static const OpEntry ops_6502[256] = {
     UND,                                        // 1F
 
     // 0x20-0x2F
-    { "JSR $@%04X",         2, F_NONE },       // 20
+    { "JSR $@%04X",         2, F_TARGET | F_CALL }, // 20
     { "AND ($@%02X,X)",     1, F_NONE },       // 21
     UND,                                        // 22
     UND,                                        // 23
@@ -383,13 +384,37 @@ std::vector<Instruction> dis_6502(std::span<const uint8_t> data,
             snprintf(buf, sizeof(buf), "%s", e.fmt);
         }
 
-        out.push_back({ addr, total, buf, breaks, has_target, target, false });
+        out.push_back({ addr, total, buf, breaks, has_target, target, false,
+                        (e.flags & F_CALL) != 0 });
         pos += total;
     }
 
     return out;
 }
 
+/* ======================================================================== */
+/* Control-flow classification                                               */
+/* ======================================================================== */
+
+Flow mos6502_flow(const uint8_t *bytes)
+{
+    uint8_t op = bytes[0];
+    const OpEntry &e = ops_6502[op];
+    uint8_t total = e.fmt ? 1 + e.imm_bytes : 1;
+
+    if (e.flags & F_CALL)
+        return { FlowKind::CALL, total, total };
+    switch (op) {
+    case 0x40:                                     // RTI
+    case 0x60:                                     // RTS
+        return { FlowKind::RETURN, 1, 0 };
+    case 0x6C:                                     // JMP ($nnnn)
+        return { FlowKind::INDIRECT, 3, 0 };
+    default:
+        return { FlowKind::NONE, total, 0 };
+    }
+}
+
 /* ======================================================================== */
 /* Register layout (for Qt register pane)                                    */
 /* ======================================================================== */
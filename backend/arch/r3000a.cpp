@@ -117,6 +117,7 @@ static Instruction decode_special(uint32_t w, uint64_t addr)
     bool breaks = false;
     bool has_target = false;
     uint64_t target = 0;
+    bool is_call = false;
 
     switch (funct) {
     /* Shift immediate */
@@ -156,6 +157,7 @@ static Instruction decode_special(uint32_t w, uint64_t addr)
         } else {
             snprintf(buf, sizeof(buf), "JALR %s,%s", gpr_name[rd], gpr_name[rs]);
         }
+        is_call = true;
         break;
 
     /* System */
@@ -241,7 +243,7 @@ static Instruction decode_special(uint32_t w, uint64_t addr)
         return { addr, 4, buf, false, false, 0, true };
     }
 
-    return { addr, 4, buf, breaks, has_target, target, false };
+    return { addr, 4, buf, breaks, has_target, target, false, is_call };
 }
 
 /* ======================================================================== */
@@ -274,7 +276,8 @@ static Instruction decode_regimm(uint32_t w, uint64_t addr)
         return { addr, 4, buf, false, false, 0, true };
     }
 
-    return { addr, 4, buf, false, true, target, false };
+    /* BLTZAL/BGEZAL link RA like JAL */
+    return { addr, 4, buf, false, true, target, false, (rt & 0x10) != 0 };
 }
 
 /* ======================================================================== */
@@ -410,6 +413,7 @@ std::vector<Instruction> dis_r3000a(std::span<const uint8_t> data,
         bool has_target = false;
         uint64_t target = 0;
         bool is_error = false;
+        bool is_call = false;
 
         unsigned op = field_op(w);
 
@@ -437,6 +441,7 @@ std::vector<Instruction> dis_r3000a(std::span<const uint8_t> data,
             snprintf(buf, sizeof(buf), "JAL $@%08X", (uint32_t)t);
             has_target = true;
             target = t;
+            is_call = true;
             break;
         }
 
@@ -607,13 +612,43 @@ std::vector<Instruction> dis_r3000a(std::span<const uint8_t> data,
             break;
         }
 
-        out.push_back({ addr, 4, buf, breaks, has_target, target, is_error });
+        out.push_back({ addr, 4, buf, breaks, has_target, target, is_error,
+                        is_call });
         pos += 4;
     }
 
     return out;
 }
 
+/* ======================================================================== */
+/* Control-flow classification                                               */
+/* ======================================================================== */
+
+// Linking instructions return past their delay slot (pc + 8)
+Flow r3000a_flow(const uint8_t *bytes)
+{
+    uint32_t w = (uint32_t)bytes[0]
+               | ((uint32_t)bytes[1] << 8)
+               | ((uint32_t)bytes[2] << 16)
+               | ((uint32_t)bytes[3] << 24);
+
+    switch (field_op(w)) {
+    case 0x00:
+        if (field_funct(w) == 0x08)     // JR
+            return { field_rs(w) == 31 ? FlowKind::RETURN : FlowKind::INDIRECT, 4, 0 };
+        if (field_funct(w) == 0x09)     // JALR
+            return { FlowKind::CALL, 4, 8 };
+        break;
+    case 0x01:
+        if (field_rt(w) == 0x10 || field_rt(w) == 0x11)    // BLTZAL, BGEZAL
+            return { FlowKind::CALL, 4, 8 };
+        break;
+    case 0x03:                          // JAL
+        return { FlowKind::CALL, 4, 8 };
+    }
+    return { FlowKind::NONE, 4, 0 };
+}
+
 /* ======================================================================== */
 /* Register layout (for Qt register pane)                                    */
 /* ======================================================================== */
@@ -5,12 +5,22 @@
  * looking for the function prologue pattern:
  *   addiu sp, sp, -N   (0x27BDxxxx, imm16 negative)
  *   sw ra, offset(sp)  (0xAFBFxxxx)
+ *
+ * Scans read code in bulk (ar_mem_read) and their results are cached per
+ * function until its code bytes change, so repeated unwinds of the same
+ * stack cost one read and hash per frame.
  */
 
 #include "arch.hpp"
 #include "retrodebug.h"
+#include "memreader.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
 
 namespace arch {
 
@@ -22,8 +32,16 @@ static constexpr uint32_t KUSEG_BASE = 0x00000000;
 static constexpr uint32_t KSEG0_BASE = 0x80000000;
 static constexpr uint32_t KSEG1_BASE = 0xA0000000;
 
-static constexpr unsigned MAX_SCAN_INSNS = 2000;
+// Backward prologue scan budget, in instructions.  Starts at DEFAULT and
+// follows the largest function seen (x2); a scan that runs out of budget
+// is retried once with the budget doubled, up to MAX.
+static constexpr unsigned MIN_SCAN_INSNS     = 256;
+static constexpr unsigned DEFAULT_SCAN_INSNS = 2000;
+static constexpr unsigned MAX_SCAN_INSNS     = 16384;
 static constexpr uint32_t MAX_FRAME_SIZE = 0x10000; // 64KB
+static constexpr uint32_t RA_SAVE_WINDOW = 40;      // bytes after the prologue
+static constexpr unsigned SCAN_CHUNK     = 256;     // words per bulk read
+static constexpr size_t   MAX_CACHED_FUNCS = 8192;
 
 static bool is_ram_addr(uint32_t addr) {
     uint32_t off;
@@ -35,16 +53,177 @@ static bool is_ram_addr(uint32_t addr) {
     return true;
 }
 
+static uint32_t word_at(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
 static uint32_t read32(rd_Memory const *mem, uint32_t addr) {
-    uint8_t b0 = mem->v1.peek(mem, addr + 0, false);
-    uint8_t b1 = mem->v1.peek(mem, addr + 1, false);
-    uint8_t b2 = mem->v1.peek(mem, addr + 2, false);
-    uint8_t b3 = mem->v1.peek(mem, addr + 3, false);
-    return (uint32_t)b0 | ((uint32_t)b1 << 8) | ((uint32_t)b2 << 16) | ((uint32_t)b3 << 24);
+    uint8_t b[4];
+    ar_mem_read(mem, addr, 4, b);
+    return word_at(b);
+}
+
+// FNV-1a over 64-bit lanes (code windows are word-sized)
+static uint64_t hash_bytes(const uint8_t *p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        h = (h ^ v) * 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    for (; i < n; i++)
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+/* ======================================================================== */
+/* Prologue analysis cache                                                   */
+/* ======================================================================== */
+
+// One entry per function found by a backward scan.  PCs in (start, end]
+// scanned back to start without meeting another prologue, so they share
+// the result.  hash covers the code bytes [start, end): the entry is
+// dropped as soon as any of them changes (overlays, self-modifying code).
+struct FuncInfo {
+    uint32_t end;
+    uint32_t frame_size;
+    uint32_t ra_store;          // address of "sw ra,off(sp)", UINT32_MAX if none
+    uint32_t ra_offset;
+    uint64_t hash;
+};
+
+struct PrologueCache {
+    rd_Memory const *mem = nullptr;
+    std::map<uint32_t, FuncInfo> funcs;
+    unsigned budget = DEFAULT_SCAN_INSNS;
+    std::vector<uint8_t> buf;
+};
+
+static PrologueCache g_cache;
+static std::mutex g_cache_mutex;
+
+static bool still_valid(rd_Memory const *mem, uint32_t start, const FuncInfo &fi) {
+    g_cache.buf.resize(fi.end - start);
+    ar_mem_read(mem, start, fi.end - start, g_cache.buf.data());
+    return hash_bytes(g_cache.buf.data(), g_cache.buf.size()) == fi.hash;
+}
+
+// Look for the "sw ra,off(sp)" following the prologue at start
+static void find_ra_store(rd_Memory const *mem, uint32_t start, FuncInfo &fi) {
+    uint8_t b[RA_SAVE_WINDOW];
+    ar_mem_read(mem, start, RA_SAVE_WINDOW, b);
+    fi.ra_store = UINT32_MAX;
+    fi.ra_offset = 0;
+    for (uint32_t off = 0; off < RA_SAVE_WINDOW; off += 4) {
+        uint32_t insn = word_at(b + off);
+        // sw ra, offset(sp) = 0xAFBF____
+        if ((insn & 0xFFFF0000) == 0xAFBF0000) {
+            fi.ra_store = start + off;
+            fi.ra_offset = (uint16_t)(insn & 0xFFFF);
+            return;
+        }
+    }
+}
+
+// Scan backward from pc for "addiu sp,sp,-N", at most budget instructions
+// and never below floor.  Returns the prologue address or UINT32_MAX.
+static uint32_t scan_back(rd_Memory const *mem, uint32_t pc, uint32_t floor,
+                          unsigned budget, uint32_t *frame_size,
+                          bool *reached_floor) {
+    // Compute scan lower bound (KSEG0 base or budget insns back); for
+    // KUSEG addresses, bound similarly
+    uint32_t limit = pc < KSEG0_BASE ? 0 : KSEG0_BASE;
+    if (pc - limit > budget * 4)
+        limit = pc - budget * 4;
+    if (limit < floor) limit = floor;
+    if (limit < 4) limit = 4;
+    *reached_floor = limit == floor;
+
+    uint8_t b[SCAN_CHUNK * 4];
+    uint32_t addr = pc;
+    while (addr > limit) {
+        uint32_t words = (addr - limit) / 4;
+        if (words > SCAN_CHUNK) words = SCAN_CHUNK;
+        if (words == 0) break;
+        uint32_t base = addr - words * 4;
+        ar_mem_read(mem, base, words * 4, b);
+        for (uint32_t i = words; i-- > 0; ) {
+            uint32_t insn = word_at(b + i * 4);
+            // addiu sp, sp, imm16  =  0x27BD____
+            if ((insn & 0xFFFF0000) == 0x27BD0000 && (int16_t)(insn & 0xFFFF) < 0) {
+                *frame_size = (uint32_t)(-(int16_t)(insn & 0xFFFF));
+                return base + i * 4;
+            }
+        }
+        addr = base;
+    }
+    return UINT32_MAX;
+}
+
+// Prologue for the function containing pc, from the cache or a scan.
+// Returns the function start or UINT32_MAX if none was found in budget.
+static uint32_t analyze(rd_Memory const *mem, uint32_t pc, FuncInfo &out) {
+    if (g_cache.mem != mem) {
+        g_cache.funcs.clear();
+        g_cache.mem = mem;
+        g_cache.budget = DEFAULT_SCAN_INSNS;
+    }
+
+    // Nearest function starting below pc
+    auto it = g_cache.funcs.lower_bound(pc);
+    uint32_t floor = 0, cand = UINT32_MAX;
+    if (it != g_cache.funcs.begin()) {
+        --it;
+        if (!still_valid(mem, it->first, it->second)) {
+            g_cache.funcs.erase(it);
+        } else if (pc <= it->second.end) {
+            out = it->second;
+            return it->first;
+        } else {
+            // Only [end, pc) is new: stop there
+            cand = it->first;
+            floor = it->second.end;
+        }
+    }
+
+    uint32_t frame_size = 0;
+    bool reached = false;
+    uint32_t start = scan_back(mem, pc, floor, g_cache.budget, &frame_size, &reached);
+    if (start == UINT32_MAX && !reached && g_cache.budget < MAX_SCAN_INSNS) {
+        g_cache.budget = std::min(g_cache.budget * 2, MAX_SCAN_INSNS);
+        start = scan_back(mem, pc, floor, g_cache.budget, &frame_size, &reached);
+    }
+    if (start == UINT32_MAX && reached && cand != UINT32_MAX) {
+        // No prologue since the cached scan: same function, longer range
+        start = cand;
+        frame_size = g_cache.funcs[cand].frame_size;
+    }
+    if (start == UINT32_MAX) return UINT32_MAX;
+
+    // Track the largest function seen to size the next scans
+    unsigned insns = (pc - start) / 4;
+    unsigned want = std::clamp(insns * 2, MIN_SCAN_INSNS, MAX_SCAN_INSNS);
+    if (want > g_cache.budget) g_cache.budget = want;
+
+    if (g_cache.funcs.size() >= MAX_CACHED_FUNCS)
+        g_cache.funcs.clear();
+
+    FuncInfo &fi = g_cache.funcs[start];
+    fi.end = pc;
+    fi.frame_size = frame_size;
+    find_ra_store(mem, start, fi);
+    g_cache.buf.resize(pc - start);
+    ar_mem_read(mem, start, pc - start, g_cache.buf.data());
+    fi.hash = hash_bytes(g_cache.buf.data(), g_cache.buf.size());
+    out = fi;
+    return start;
 }
 
 StackTrace r3000a_stack_trace(rd_Cpu const *cpu, unsigned max_depth,
                               unsigned /*cc_index*/) {
+    std::lock_guard lock(g_cache_mutex);
     StackTrace result;
     result.status = StackTraceStatus::OK;
 
@@ -75,57 +254,21 @@ StackTrace r3000a_stack_trace(rd_Cpu const *cpu, unsigned max_depth,
             return result;
         }
 
-        // Scan backward from pc looking for prologue
-        uint32_t scan_pc = pc;
-        uint32_t frame_size = 0;
-        uint32_t ra_offset = UINT32_MAX;
-        uint32_t func_start = UINT32_MAX;
-        bool found_addiu_sp = false;
-
-        // Compute scan lower bound (KSEG0 base or 2000 insns back)
-        uint32_t scan_limit_addr = KSEG0_BASE;
-        if (scan_pc - KSEG0_BASE > MAX_SCAN_INSNS * 4)
-            scan_limit_addr = scan_pc - MAX_SCAN_INSNS * 4;
-        // For KUSEG addresses, bound similarly
-        if (scan_pc < KSEG0_BASE) {
-            scan_limit_addr = 0;
-            if (scan_pc > MAX_SCAN_INSNS * 4)
-                scan_limit_addr = scan_pc - MAX_SCAN_INSNS * 4;
-        }
-
-        for (uint32_t addr = scan_pc; addr > scan_limit_addr; addr -= 4) {
-            if (addr < 4) break;
-            uint32_t insn = read32(mem, addr - 4);
-
-            // addiu sp, sp, imm16  =  0x27BD____
-            if ((insn & 0xFFFF0000) == 0x27BD0000) {
-                int16_t imm = (int16_t)(insn & 0xFFFF);
-                if (imm < 0) {
-                    frame_size = (uint32_t)(-imm);
-                    func_start = addr - 4;
-                    found_addiu_sp = true;
-                    break;
-                }
-            }
-        }
+        // Prologue of the function containing pc (cached per function)
+        FuncInfo fi;
+        uint32_t func_start = analyze(mem, pc, fi);
+        bool found_addiu_sp = func_start != UINT32_MAX;
+        uint32_t frame_size = found_addiu_sp ? fi.frame_size : 0;
 
         if (found_addiu_sp && frame_size > MAX_FRAME_SIZE) {
             result.status = StackTraceStatus::SCAN_LIMIT;
             return result;
         }
 
-        // Look for sw ra, offset(sp) near func_start
-        if (found_addiu_sp) {
-            // Scan forward from func_start for sw ra
-            for (uint32_t addr = func_start; addr < func_start + 40 && addr < scan_pc; addr += 4) {
-                uint32_t insn = read32(mem, addr);
-                // sw ra, offset(sp) = 0xAFBF____
-                if ((insn & 0xFFFF0000) == 0xAFBF0000) {
-                    ra_offset = (uint16_t)(insn & 0xFFFF);
-                    break;
-                }
-            }
-        }
+        // RA is on the stack once the "sw ra" after the prologue has run
+        uint32_t ra_offset = UINT32_MAX;
+        if (found_addiu_sp && fi.ra_store < pc)
+            ra_offset = fi.ra_offset;
 
         // Determine next RA
         uint32_t next_ra;
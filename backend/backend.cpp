@@ -21,8 +21,12 @@
 #include <atomic>
 
 #include "backend.hpp"
+#include "analysis.hpp"
 #include "registers.hpp"
+#include "dirty.hpp"
+#include "regions.hpp"
 #include "trace.hpp"
+#include "callstack.hpp"
 
 /* ========================================================================
  * Constants
@@ -84,12 +88,37 @@ static char save_dir[4096]   = ".";
 static char rom_path_saved[4096];
 static char rom_base[4096];
 
-/* Video */
-static uint32_t frame_buf[MAX_PIXELS];
+/* Video: triple-buffered exchange between the core thread (writer) and
+   the frontend thread (reader).  The writer fills its back slot and swaps
+   it into frame_ready with FRAME_FRESH set; the reader swaps its front
+   slot out for a fresh one on acquire.  Neither side ever sees a slot the
+   other is using, and neither waits. */
+struct FrameSlot {
+    uint32_t pixels[MAX_PIXELS];
+    unsigned width, height;
+    uint64_t seq;
+};
+
+#define FRAME_FRESH 4u    /* frame_ready holds an unread frame */
+
+static FrameSlot frame_slots[3];
+static std::atomic<unsigned> frame_ready{1};
+static unsigned frame_back   = 0;   /* core thread */
+static unsigned frame_front  = 2;   /* frontend thread */
+static unsigned frame_readers = 0;  /* frontend thread: nested acquires */
+static uint64_t frame_seq    = 0;
 static unsigned frame_width  = 160;
 static unsigned frame_height = 144;
 static unsigned frame_pitch  = 160 * sizeof(uint32_t);
 
+/* Hand the back slot to the reader and take the stale ready slot back */
+static void frame_publish(void) {
+    frame_slots[frame_back].seq = ++frame_seq;
+    unsigned prev = frame_ready.exchange(frame_back | FRAME_FRESH,
+                                         std::memory_order_acq_rel);
+    frame_back = prev & 3;
+}
+
 /* AV info */
 static struct retro_system_av_info av_info;
 static struct retro_system_info sys_info;
@@ -323,12 +352,20 @@ static void core_video_refresh(const void *data, unsigned width,
     frame_height = capped_h;
     frame_pitch  = pitch;
 
+    FrameSlot &slot = frame_slots[frame_back];
     auto *src = (const uint8_t *)data;
-    for (unsigned y = 0; y < capped_h; y++) {
-        memcpy(&frame_buf[y * capped_w],
-               src + y * pitch,
-               capped_w * sizeof(uint32_t));
+    if (pitch == capped_w * sizeof(uint32_t)) {
+        memcpy(slot.pixels, src, (size_t)capped_w * capped_h * sizeof(uint32_t));
+    } else {
+        for (unsigned y = 0; y < capped_h; y++) {
+            memcpy(&slot.pixels[y * capped_w],
+                   src + y * pitch,
+                   capped_w * sizeof(uint32_t));
+        }
     }
+    slot.width  = capped_w;
+    slot.height = capped_h;
+    frame_publish();
 }
 
 static void core_audio_sample(int16_t left, int16_t right) {
@@ -423,6 +460,10 @@ static bool debug_handle_event(void *user_data, rd_SubscriptionID sub_id,
         return false;
     }
 
+    /* Shadow call stack (never halts) */
+    if (ar_callstack_on_event(sub_id, event))
+        return false;
+
     /* Trace logging (never halts).  Suppress at skip addresses to avoid
        double-logging the instruction where the previous step halted. */
     if (ar_trace_is_sub(sub_id)) {
@@ -432,6 +473,9 @@ static bool debug_handle_event(void *user_data, rd_SubscriptionID sub_id,
             if (it != g_skip_addr.end() && cpu_get_pc(event_cpu) == it->second)
                 return false;
         }
+        if (event->type == RD_EVENT_EXECUTION)
+            ar_analysis_note_exec(event->execution.cpu,
+                                  event->execution.address);
         ar_trace_on_event(sub_id, event);
         return false;
     }
@@ -450,6 +494,10 @@ static bool debug_handle_event(void *user_data, rd_SubscriptionID sub_id,
     }
 
     /* Apply side effects */
+    if (event->type == RD_EVENT_EXECUTION) {
+        ar_analysis_note_exec(event->execution.cpu, event->execution.address);
+        ar_analysis_flush_exec();
+    }
     if (is_step) g_step_complete = true;
     if (is_bp) {
         int bp_id = ar_bp_sub_to_id(sub_id);
@@ -476,6 +524,9 @@ static bool debug_handle_event(void *user_data, rd_SubscriptionID sub_id,
         }
     }
 
+    /* Banks may have switched since the maps were last read */
+    ar_regions_invalidate();
+
     if (event->can_halt) {
         /* Core can halt its run loop and return from retro_run() */
         return true;
@@ -528,6 +579,8 @@ static bool debug_init(void) {
         debug_cpu_ptr = debugger_if_ptr->v1.system->v1.cpus[0];
         debug_mem_ptr = debug_cpu_ptr->v1.memory_region;
         g_has_debug = true;
+        ar_regions_build(debugger_if_ptr->v1.system);
+        ar_dirty_clear();
         fprintf(stderr, "[arret] retrodebug: cpu=%s mem=%s (0x%lx bytes)\n",
                 debug_cpu_ptr->v1.id, debug_mem_ptr->v1.id,
                 (unsigned long)debug_mem_ptr->v1.size);
@@ -638,7 +691,16 @@ bool ar_load_state(int slot) {
     bool ok = core.retro_unserialize(buf, (size_t)sz);
     free(buf);
     if (ok) {
-        memset(frame_buf, 0, sizeof(frame_buf));
+        ar_callstack_reset();
+        ar_regions_invalidate();
+        ar_dirty_invalidate();
+        /* Publish a blank frame: the core thread is idle here, so the
+           back slot is free to write */
+        FrameSlot &blank = frame_slots[frame_back];
+        memset(blank.pixels, 0, (size_t)frame_width * frame_height * sizeof(uint32_t));
+        blank.width  = frame_width;
+        blank.height = frame_height;
+        frame_publish();
         if (frontend_cb.on_video_refresh)
             frontend_cb.on_video_refresh(frontend_cb.user);
         fprintf(stderr, "[arret] Loaded state from slot %d (%s)\n", slot, path);
@@ -653,16 +715,12 @@ bool ar_load_state(int slot) {
 
 rd_Memory const *ar_find_memory_by_id(const char *id) {
     if (!g_has_debug) return NULL;
-    rd_System const *sys = debugger_if_ptr->v1.system;
+    int handle = ar_region_handle(id);
+    if (handle >= 0) return ar_region_memory(handle);
 
-    for (unsigned i = 0; i < sys->v1.num_cpus; i++) {
-        rd_Memory const *m = sys->v1.cpus[i]->v1.memory_region;
-        if (m && strcmp(m->v1.id, id) == 0) return m;
-    }
-    for (unsigned i = 0; i < sys->v1.num_memory_regions; i++) {
-        if (strcmp(sys->v1.memory_regions[i]->v1.id, id) == 0)
-            return sys->v1.memory_regions[i];
-    }
+    /* Not registered: a source that only became mapped after the registry
+       was built (bank switch).  Scan the current maps and remember it. */
+    rd_System const *sys = debugger_if_ptr->v1.system;
     for (unsigned i = 0; i < sys->v1.num_cpus; i++) {
         rd_Memory const *m = sys->v1.cpus[i]->v1.memory_region;
         if (!m || !m->v1.get_memory_map_count || !m->v1.get_memory_map) continue;
@@ -674,6 +732,7 @@ rd_Memory const *ar_find_memory_by_id(const char *id) {
             if (maps[j].source && strcmp(maps[j].source->v1.id, id) == 0) {
                 rd_Memory const *result = maps[j].source;
                 free(maps);
+                ar_region_add(result);
                 return result;
             }
         }
@@ -711,6 +770,8 @@ bool ar_load_core(const char *core_path) {
         dlclose(core.handle);
         g_core_loaded = false;
         g_has_debug = false;
+        ar_regions_clear();
+        ar_dirty_clear();
         debug_cpu_ptr = NULL;
         debug_mem_ptr = NULL;
         debugger_if_ptr = NULL;
@@ -757,6 +818,7 @@ bool ar_load_content(const char *rom_path) {
 
     /* Unload previous content */
     if (g_content_loaded) {
+        ar_analysis_stop();
         core.retro_unload_game();
         g_content_loaded = false;
     }
@@ -792,6 +854,12 @@ bool ar_load_content(const char *rom_path) {
             frame_width, frame_height, av_info.timing.fps);
     fprintf(stderr, "[arret] Audio: %.0f Hz\n", av_info.timing.sample_rate);
 
+    /* Regions and maps may only be complete once content is loaded */
+    if (g_has_debug)
+        ar_regions_build(debugger_if_ptr->v1.system);
+    ar_dirty_clear();
+    ar_callstack_reset();
+
     g_content_loaded = true;
     return true;
 }
@@ -806,13 +874,17 @@ bool ar_init(const char *core_path, const char *rom_path,
 
 void ar_shutdown(void) {
     ar_core_thread_stop();
+    ar_analysis_stop();
     ar_debug_step_end();
+    ar_callstack_enable(false);
     ar_search_free();
     ar_cmd_server_shutdown();
     if (g_content_loaded) { core.retro_unload_game(); g_content_loaded = false; }
     if (g_core_loaded) { core.retro_deinit(); g_core_loaded = false; }
     if (core.handle) { dlclose(core.handle); core.handle = NULL; }
     g_has_debug = false;
+    ar_regions_clear();
+    ar_dirty_clear();
     debug_cpu_ptr = NULL;
     debug_mem_ptr = NULL;
     debugger_if_ptr = NULL;
@@ -836,6 +908,8 @@ void ar_run_frame(void) {
         if (g_core_state == CORE_DONE) g_core_state = CORE_IDLE;
     } else {
         core.retro_run();
+        ar_regions_invalidate();
+        ar_analysis_flush_exec();
         if (g_post_frame_hook) g_post_frame_hook();
     }
 }
@@ -852,6 +926,8 @@ static void core_thread_func() {
         lock.unlock();
 
         core.retro_run();
+        ar_regions_invalidate();
+        ar_analysis_flush_exec();
         if (g_post_frame_hook) g_post_frame_hook();
 
         lock.lock();
@@ -931,7 +1007,32 @@ bool ar_core_blocked(void) {
 /* Public API: state access                                                  */
 /* ======================================================================== */
 
-const uint32_t *ar_frame_buf(void)    { return frame_buf; }
+void ar_frame_acquire(ar_frame *out) {
+    /* Only the outermost acquire may swap: nested readers share a slot */
+    if (frame_readers++ == 0 &&
+        (frame_ready.load(std::memory_order_relaxed) & FRAME_FRESH)) {
+        unsigned prev = frame_ready.exchange(frame_front,
+                                             std::memory_order_acq_rel);
+        frame_front = prev & 3;
+    }
+
+    const FrameSlot &slot = frame_slots[frame_front];
+    out->pixels = slot.pixels;
+    out->seq    = slot.seq;
+    if (slot.seq) {
+        out->width  = slot.width;
+        out->height = slot.height;
+    } else {
+        /* Nothing published yet: a blank frame at the current geometry */
+        out->width  = frame_width;
+        out->height = frame_height;
+    }
+}
+
+void ar_frame_release(void) {
+    if (frame_readers > 0) frame_readers--;
+}
+
 unsigned ar_frame_width(void)         { return frame_width; }
 unsigned ar_frame_height(void)        { return frame_height; }
 const struct retro_system_av_info *ar_av_info(void)  { return &av_info; }
@@ -1148,10 +1249,17 @@ void ar_debug_set_skip(void) {
 
 bool ar_running(void)        { return g_running; }
 void ar_set_running(bool r)  { g_running = r; }
-void ar_reset(void)          { if (g_content_loaded) core.retro_reset(); }
+void ar_reset(void) {
+    if (!g_content_loaded) return;
+    core.retro_reset();
+    ar_callstack_reset();
+    ar_regions_invalidate();
+    ar_dirty_invalidate();
+}
 const ar_frontend_cb *ar_get_frontend_cb(void) { return &frontend_cb; }
 bool ar_core_loaded(void)    { return g_core_loaded; }
 bool ar_content_loaded(void) { return g_content_loaded; }
+const char *ar_rompath(void) { return rom_path_saved; }
 const char *ar_rompath_base(void) { return rom_base; }
 
 /* ======================================================================== */
@@ -1172,5 +1280,7 @@ bool ar_reload_rom(void) {
     core.retro_get_system_av_info(&av_info);
     frame_width  = av_info.geometry.base_width;
     frame_height = av_info.geometry.base_height;
+    ar_regions_invalidate();
+    ar_dirty_invalidate();
     return true;
 }
@@ -27,7 +27,7 @@ extern "C" {
 /* ======================================================================== */
 
 typedef struct ar_frontend_cb {
-    /* Called after each frame is rendered into frame_buf. */
+    /* Called after each frame is published (see ar_frame_acquire). */
     void (*on_video_refresh)(void *user);
 
     /* Called when core changes geometry (SET_GEOMETRY). */
@@ -87,6 +87,7 @@ void ar_shutdown(void);
 /* Query whether core / content are currently loaded. */
 bool ar_core_loaded(void);
 bool ar_content_loaded(void);
+const char *ar_rompath(void);
 const char *ar_rompath_base(void);
 
 /*
@@ -119,14 +120,28 @@ void ar_core_ack_done(void);          /* Transition DONE -> IDLE */
 void ar_core_resume_blocked(void);    /* Resume from BLOCKED (unblock handler) */
 bool ar_core_blocked(void);           /* Convenience: state == BLOCKED */
 
-/* Poll TCP socket and process any pending commands. */
-void ar_check_socket_commands(void);
+/* Poll TCP socket and process any pending commands.
+   Returns the number of commands processed. */
+unsigned ar_check_socket_commands(void);
 
 /* ======================================================================== */
 /* State access                                                              */
 /* ======================================================================== */
 
-const uint32_t         *ar_frame_buf(void);
+/* Latest complete video frame.  The core thread publishes frames into a
+ * triple buffer; acquire hands out the newest one without copying and
+ * keeps it stable (the core writes elsewhere) until the matching release.
+ * Acquire and release are for the frontend thread only; nested pairs
+ * share the same frame. */
+typedef struct ar_frame {
+    const uint32_t *pixels;     /* XRGB8888, width * height, no row padding */
+    unsigned width;
+    unsigned height;
+    uint64_t seq;               /* increases per published frame; 0 = none yet */
+} ar_frame;
+
+void                    ar_frame_acquire(ar_frame *out);
+void                    ar_frame_release(void);
 unsigned                ar_frame_width(void);
 unsigned                ar_frame_height(void);
 const struct retro_system_av_info *ar_av_info(void);
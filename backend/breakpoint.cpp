@@ -30,6 +30,9 @@ static std::set<int> g_sub_failed;
 /* BP IDs to delete after the current frame finishes (deferred from handler) */
 static std::vector<int> g_deferred_deletes;
 
+/* Bumped on every change to the breakpoint list (UI refresh tracking) */
+static unsigned g_generation = 0;
+
 /* Find a CPU by its id string; returns primary CPU if id is NULL or empty */
 static rd_Cpu const *find_cpu(const char *id) {
     if (!id || !id[0]) return ar_debug_cpu();
@@ -43,6 +46,8 @@ static rd_Cpu const *find_cpu(const char *id) {
 }
 
 static void sync_subscriptions(void) {
+    g_generation++;
+
     rd_DebuggerIf *dif = ar_get_debugger_if();
     if (!dif || !dif->v1.subscribe || !dif->v1.unsubscribe) return;
 
@@ -164,6 +169,7 @@ bool ar_bp_set_temporary(int id, bool temporary) {
     auto it = g_bps.find(id);
     if (it == g_bps.end()) return false;
     it->second.temporary = temporary;
+    g_generation++;
     auto_save();
     return true;
 }
@@ -221,6 +227,10 @@ void ar_bp_clear(void) {
     auto_save();
 }
 
+unsigned ar_bp_generation(void) {
+    return g_generation;
+}
+
 bool ar_bp_sub_is_breakpoint(rd_SubscriptionID sub_id) {
     return g_sub_to_bp.find(sub_id) != g_sub_to_bp.end();
 }
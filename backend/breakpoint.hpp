@@ -42,6 +42,9 @@ unsigned ar_bp_list(ar_breakpoint *out, unsigned max);
 unsigned ar_bp_count(void);
 void     ar_bp_clear(void);
 
+/* Changes whenever breakpoints are added, removed or modified */
+unsigned ar_bp_generation(void);
+
 /* Returns true if the given subscription ID belongs to a breakpoint */
 bool     ar_bp_sub_is_breakpoint(rd_SubscriptionID sub_id);
 
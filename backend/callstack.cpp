@@ -0,0 +1,330 @@
+/*
+ * callstack.cpp: Shadow call stack
+ *
+ * Every execution event classifies the instruction at PC (arch flow_fn).
+ * Calls and returns are not applied immediately: whether a conditional
+ * call or return was taken, and where it went, is only known at the next
+ * execution event (after the delay slot on MIPS), so the instruction is
+ * kept as pending and resolved against the next PC.
+ *
+ *   call    taken if the next PC is not the fall-through; pushes
+ *           { return address, callee, SP before the call }
+ *   return  pops to the innermost frame whose return address is the next
+ *           PC; failing that (return address rewritten on the stack), pops
+ *           frames whose SP the stack pointer has climbed back to
+ *   jump    register-indirect jumps (JP HL, JR k0) only pop on an exact
+ *           return address match
+ *
+ * Frames whose SP is below the stack pointer at a new call are dead
+ * (longjmp, stack reset) and are dropped.  Interrupt frames stop that
+ * pruning, since handlers may run on their own stack.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "callstack.hpp"
+#include "backend.hpp"
+#include "memreader.hpp"
+#include "registers.hpp"
+
+/* ========================================================================
+ * State
+ * ======================================================================== */
+
+#define SHADOW_MAX_FRAMES 1024     /* oldest frames dropped beyond this */
+
+struct ShadowFrame {
+    uint64_t ret;           /* caller resumes here */
+    uint64_t func;          /* callee entry (call target / vector) */
+    uint64_t sp;            /* stack pointer before the call */
+    bool     interrupt;
+};
+
+struct Pending {
+    arch::FlowKind kind = arch::FlowKind::NONE;
+    uint64_t pc;
+    uint64_t sp;
+    arch::Flow flow;
+    unsigned delay;         /* execution events left before resolving */
+};
+
+struct ShadowCpu {
+    rd_Cpu const *cpu;
+    const arch::Arch *arch;
+    rd_SubscriptionID sub_id;
+    int sp_reg;             /* register index for SP, or -1 */
+    uint64_t last_pc;
+    Pending pending;
+    std::vector<ShadowFrame> frames;
+    bool truncated;         /* frames were dropped at the bottom */
+};
+
+static std::atomic<bool> g_enabled{false};   /* read unlocked as a fast path */
+static std::vector<ShadowCpu> g_cpus;
+static std::unordered_map<rd_SubscriptionID, int> g_sub_to_cpu;
+static rd_SubscriptionID g_int_sub_id = -1;
+
+/* Events arrive on the core thread; backtraces are read from the UI and
+   command threads */
+static std::mutex g_mutex;
+
+static uint64_t read_sp(const ShadowCpu &sc) {
+    if (sc.sp_reg < 0) return 0;
+    return sc.cpu->v1.get_register(sc.cpu, (unsigned)sc.sp_reg);
+}
+
+static ShadowCpu *cpu_state(rd_Cpu const *cpu) {
+    for (auto &sc : g_cpus)
+        if (sc.cpu == cpu) return &sc;
+    return nullptr;
+}
+
+/* ========================================================================
+ * Stack updates
+ * ======================================================================== */
+
+static void push_frame(ShadowCpu &sc, const ShadowFrame &f) {
+    if (sc.frames.size() >= SHADOW_MAX_FRAMES) {
+        sc.frames.erase(sc.frames.begin(),
+                        sc.frames.begin() + SHADOW_MAX_FRAMES / 4);
+        sc.truncated = true;
+    }
+    sc.frames.push_back(f);
+}
+
+/* Pop to (and including) the innermost frame returning to pc */
+static bool pop_to_return(ShadowCpu &sc, uint64_t pc) {
+    for (size_t i = sc.frames.size(); i-- > 0; ) {
+        if (sc.frames[i].ret == pc) {
+            sc.frames.resize(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void resolve(ShadowCpu &sc, uint64_t next_pc) {
+    Pending &p = sc.pending;
+    switch (p.kind) {
+    case arch::FlowKind::CALL: {
+        uint64_t ret = p.pc + p.flow.return_offset;
+        if (next_pc == ret) break;      /* not taken */
+        while (!sc.frames.empty() && !sc.frames.back().interrupt &&
+               sc.frames.back().sp < p.sp)
+            sc.frames.pop_back();
+        push_frame(sc, { ret, next_pc, p.sp, false });
+        break;
+    }
+    case arch::FlowKind::RETURN:
+        if (next_pc == p.pc + p.flow.length) break;     /* not taken */
+        if (pop_to_return(sc, next_pc)) break;
+        /* The return address was rewritten; without a delay slot the
+           return popped it from the stack, so the stack pointer shows
+           which frames are gone */
+        if (sc.arch->branch_delay_slots == 0 && sc.sp_reg >= 0) {
+            uint64_t sp = read_sp(sc);
+            while (!sc.frames.empty() && !sc.frames.back().interrupt &&
+                   sc.frames.back().sp <= sp)
+                sc.frames.pop_back();
+        }
+        break;
+    case arch::FlowKind::INDIRECT:
+        pop_to_return(sc, next_pc);
+        break;
+    case arch::FlowKind::NONE:
+        break;
+    }
+    p.kind = arch::FlowKind::NONE;
+}
+
+static void on_execution(ShadowCpu &sc, uint64_t pc) {
+    /* The event at a halted PC is delivered again on resume */
+    if (pc == sc.last_pc) return;
+    sc.last_pc = pc;
+
+    if (sc.pending.kind != arch::FlowKind::NONE) {
+        if (sc.pending.delay > 0) {
+            sc.pending.delay--;         /* delay slot */
+            return;
+        }
+        resolve(sc, pc);
+    }
+
+    rd_Memory const *mem = sc.cpu->v1.memory_region;
+    uint8_t buf[16];
+    unsigned n = sc.arch->max_insn_size;
+    if (n > sizeof(buf)) n = sizeof(buf);
+    ar_mem_read(mem, pc, n, buf);
+
+    arch::Flow flow = sc.arch->flow_fn(buf);
+    if (flow.kind == arch::FlowKind::NONE) return;
+
+    Pending &p = sc.pending;
+    p.kind = flow.kind;
+    p.pc = pc;
+    p.flow = flow;
+    p.delay = sc.arch->branch_delay_slots;
+    p.sp = flow.kind == arch::FlowKind::CALL ? read_sp(sc) : 0;
+}
+
+static void on_interrupt(ShadowCpu &sc, const rd_InterruptEvent &intr) {
+    /* An instruction still waiting for its delay slot is re-executed
+       after the handler; anything else resolves against the interrupted
+       PC */
+    if (sc.pending.kind != arch::FlowKind::NONE) {
+        if (sc.pending.delay > 0)
+            sc.pending.kind = arch::FlowKind::NONE;
+        else
+            resolve(sc, intr.return_address);
+    }
+    push_frame(sc, { intr.return_address, intr.vector_address,
+                     read_sp(sc), true });
+    sc.last_pc = UINT64_MAX;
+}
+
+/* ========================================================================
+ * Subscription management
+ * ======================================================================== */
+
+static void unsubscribe_all(rd_DebuggerIf *dif) {
+    for (auto &sc : g_cpus) {
+        if (sc.sub_id >= 0 && dif && dif->v1.unsubscribe)
+            dif->v1.unsubscribe(sc.sub_id);
+        sc.sub_id = -1;
+    }
+    g_sub_to_cpu.clear();
+    if (g_int_sub_id >= 0 && dif && dif->v1.unsubscribe)
+        dif->v1.unsubscribe(g_int_sub_id);
+    g_int_sub_id = -1;
+}
+
+static void sync_subscriptions(void) {
+    rd_DebuggerIf *dif = ar_get_debugger_if();
+    unsubscribe_all(dif);
+    g_cpus.clear();
+
+    rd_System const *sys = ar_debug_system();
+    if (!g_enabled || !sys || !dif || !dif->v1.subscribe) return;
+
+    for (unsigned i = 0; i < sys->v1.num_cpus; i++) {
+        rd_Cpu const *cpu = sys->v1.cpus[i];
+        const arch::Arch *a = arch::arch_for_cpu(cpu->v1.type);
+        if (!a || !a->flow_fn || !cpu->v1.memory_region) continue;
+
+        ShadowCpu sc{};
+        sc.cpu = cpu;
+        sc.arch = a;
+        sc.sp_reg = ar_reg_from_name(cpu->v1.type, "sp");
+        sc.last_pc = UINT64_MAX;
+        sc.truncated = false;
+
+        rd_Subscription sub{};
+        sub.type = RD_EVENT_EXECUTION;
+        sub.execution.cpu = cpu;
+        sub.execution.type = RD_STEP;
+        sub.execution.address_range_begin = 0;
+        sub.execution.address_range_end = UINT64_MAX;
+
+        sc.sub_id = dif->v1.subscribe(&sub);
+        if (sc.sub_id < 0) {
+            fprintf(stderr, "[arret] callstack: failed to subscribe for CPU %s\n",
+                    cpu->v1.id);
+            continue;
+        }
+        g_sub_to_cpu[sc.sub_id] = (int)g_cpus.size();
+        g_cpus.push_back(std::move(sc));
+    }
+
+    rd_Subscription sub{};
+    sub.type = RD_EVENT_INTERRUPT;
+    g_int_sub_id = dif->v1.subscribe(&sub);
+    if (g_int_sub_id < 0)
+        fprintf(stderr, "[arret] callstack: failed to subscribe for interrupts\n");
+}
+
+/* ========================================================================
+ * Public API
+ * ======================================================================== */
+
+bool ar_callstack_enable(bool enable) {
+    if (enable && !ar_has_debug()) return false;
+    std::lock_guard lock(g_mutex);
+    if (g_enabled == enable) return true;
+    g_enabled = enable;
+    sync_subscriptions();
+    return true;
+}
+
+bool ar_callstack_enabled(void) {
+    return g_enabled;
+}
+
+void ar_callstack_reset(void) {
+    std::lock_guard lock(g_mutex);
+    if (g_enabled)
+        sync_subscriptions();
+}
+
+bool ar_callstack_on_event(rd_SubscriptionID sub_id, rd_Event const *event) {
+    if (!g_enabled) return false;
+    std::lock_guard lock(g_mutex);
+    if (!g_enabled) return false;
+    if (sub_id == g_int_sub_id && g_int_sub_id >= 0) {
+        if (event->type == RD_EVENT_INTERRUPT) {
+            ShadowCpu *sc = cpu_state(event->interrupt.cpu);
+            if (sc) on_interrupt(*sc, event->interrupt);
+        }
+        return true;
+    }
+    auto it = g_sub_to_cpu.find(sub_id);
+    if (it == g_sub_to_cpu.end()) return false;
+    if (event->type == RD_EVENT_EXECUTION)
+        on_execution(g_cpus[it->second], event->execution.address);
+    return true;
+}
+
+arch::StackTrace ar_backtrace(rd_Cpu const *cpu, unsigned max_depth,
+                              bool *shadow) {
+    if (shadow) *shadow = false;
+    if (!cpu) return { {}, arch::StackTraceStatus::READ_ERROR };
+
+    {
+        std::lock_guard lock(g_mutex);
+        ShadowCpu *sc = g_enabled ? cpu_state(cpu) : nullptr;
+        if (sc) {
+            if (shadow) *shadow = true;
+
+            arch::StackTrace result;
+            result.status = arch::StackTraceStatus::OK;
+            int pc_reg = ar_reg_pc(cpu->v1.type);
+            uint64_t pc = pc_reg >= 0 ? cpu->v1.get_register(cpu, (unsigned)pc_reg) : 0;
+
+            /* Frame i runs func of shadow frame i and returns to the
+               caller's frame through ret */
+            const auto &frames = sc->frames;
+            size_t n = frames.size();
+            result.frames.push_back({ pc, read_sp(*sc),
+                                      n ? frames[n - 1].func : UINT64_MAX });
+            for (size_t i = n; i-- > 0; ) {
+                if (result.frames.size() > max_depth) {
+                    result.status = arch::StackTraceStatus::MAX_DEPTH;
+                    break;
+                }
+                arch::StackFrame f = { frames[i].ret, frames[i].sp,
+                                       i ? frames[i - 1].func : UINT64_MAX };
+                f.interrupt = frames[i].interrupt;
+                result.frames.push_back(f);
+            }
+            if (sc->truncated && result.status == arch::StackTraceStatus::OK)
+                result.status = arch::StackTraceStatus::MAX_DEPTH;
+            return result;
+        }
+    }
+
+    return arch::stack_trace(cpu, max_depth);
+}
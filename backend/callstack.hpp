@@ -0,0 +1,55 @@
+/*
+ * callstack.h: Shadow call stack
+ *
+ * Maintains one call stack per CPU from the instructions actually
+ * executed: calls push the return address when they are taken, returns
+ * pop to the matching frame, and served interrupts push a frame for the
+ * interrupted code.  Backtraces are then a copy of the stack instead of
+ * a heuristic unwind through memory.
+ *
+ * The module manages its own broad execution subscription for every CPU
+ * and one interrupt subscription while enabled.  Each event costs one
+ * opcode classification; registers are only read on calls and returns.
+ */
+
+#ifndef AR_CALLSTACK_H
+#define AR_CALLSTACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "retrodebug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Enable/disable the shadow stack (default: off).  Enabling starts with
+ * empty stacks: only calls made from then on are known. */
+bool ar_callstack_enable(bool enable);
+bool ar_callstack_enabled(void);
+
+/* Drop all frames (reset, state load, new content) and re-subscribe for
+ * the current CPUs if enabled. */
+void ar_callstack_reset(void);
+
+/* Event routing (called from the debug event handler on the core
+ * thread).  Returns true if sub_id is a shadow-stack subscription. */
+bool ar_callstack_on_event(rd_SubscriptionID sub_id, rd_Event const *event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+#include "arch.hpp"
+
+/* Backtrace for cpu, innermost frame (current PC) first.  Reads the shadow
+ * stack when it is enabled, otherwise falls back to the architecture's
+ * heuristic unwinder (READ_ERROR if there is none).  *shadow reports which
+ * one was used. */
+arch::StackTrace ar_backtrace(rd_Cpu const *cpu, unsigned max_depth = 64,
+                              bool *shadow = nullptr);
+#endif
+
+#endif /* AR_CALLSTACK_H */
@@ -27,10 +27,17 @@
 #include <arpa/inet.h>
 
 #include "backend.hpp"
+#include "analysis.hpp"
+#include "listing.hpp"
+#include "regions.hpp"
+#include "memreader.hpp"
 #include "arch.hpp"
 #include "registers.hpp"
 #include "symbols.hpp"
 #include "trace.hpp"
+#include "callstack.hpp"
+#include "sys/psx_gpu_capture.hpp"
+#include "sys/psx_gpu_stats.hpp"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #pragma GCC diagnostic push
@@ -46,6 +53,26 @@
 
 static int listen_fd = -1;
 
+/* Every command is its own connection, so a symbol batch cannot be tied
+ * to one: a batch begun by "sym batch begin" is committed if no command
+ * arrives for this long (the client quit or crashed mid-batch) */
+#define CMD_BATCH_TIMEOUT_MS 5000
+
+static unsigned       cmd_batch_depth = 0;
+static struct timeval cmd_batch_last;
+
+static void cmd_batch_expire(void) {
+    if (cmd_batch_depth == 0) return;
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    long ms = (now.tv_sec - cmd_batch_last.tv_sec) * 1000 +
+              (now.tv_usec - cmd_batch_last.tv_usec) / 1000;
+    if (ms < CMD_BATCH_TIMEOUT_MS) return;
+    fprintf(stderr, "[arret] Committing symbol batch idle for %ld ms\n", ms);
+    for (; cmd_batch_depth > 0; cmd_batch_depth--)
+        ar_sym_batch_commit();
+}
+
 int ar_cmd_server_init(int port) {
     int fd = socket(AF_INET, SOCK_STREAM, 0);
     if (fd < 0) {
@@ -78,15 +105,16 @@ int ar_cmd_server_init(int port) {
     return fd;
 }
 
-void ar_check_socket_commands(void) {
-    if (listen_fd < 0) return;
+unsigned ar_check_socket_commands(void) {
+    if (listen_fd < 0) return 0;
 
+    unsigned handled = 0;
     struct pollfd pfd = {};
     pfd.fd = listen_fd;
     pfd.events = POLLIN;
     while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
         int client_fd = accept(listen_fd, NULL, NULL);
-        if (client_fd < 0) return;
+        if (client_fd < 0) break;
 
         /* Set read timeout so a stuck client can't block the main loop */
         struct timeval tv = { .tv_sec = 2, .tv_usec = 0 };
@@ -107,10 +135,14 @@ void ar_check_socket_commands(void) {
             ar_process_command(cmd_buf, client_file);
             fflush(client_file);
             fclose(client_file);
+            handled++;
         }
+        gettimeofday(&cmd_batch_last, NULL);
 
         close(client_fd);
     }
+    cmd_batch_expire();
+    return handled;
 }
 
 void ar_cmd_server_shutdown(void) {
@@ -184,6 +216,26 @@ static void json_error_f(FILE *out, const char *fmt, ...) {
     fflush(out);
 }
 
+/* Write s for use inside a JSON string: labels and comments may hold
+ * quotes, backslashes and control characters */
+static void json_escape(FILE *out, const char *s) {
+    for (const char *p = s; *p; p++) {
+        switch (*p) {
+        case '"':  fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out);  break;
+        case '\r': fputs("\\r", out);  break;
+        case '\t': fputs("\\t", out);  break;
+        default:
+            if ((unsigned char)*p < 0x20)
+                fprintf(out, "\\u%04x", (unsigned char)*p);
+            else
+                fputc(*p, out);
+            break;
+        }
+    }
+}
+
 /* ========================================================================
  * Button name mapping
  * ======================================================================== */
@@ -253,7 +305,18 @@ static void do_dump(rd_Memory const *mem, uint64_t start, uint64_t size,
 
     bool first_line = true;
 
+    /* Bytes are read a chunk at a time */
+    uint8_t chunk[4096];
+    uint64_t chunk_start = start, chunk_end = start;
+
     for (uint64_t addr = start; addr < end; addr++) {
+        if (addr == chunk_end) {
+            uint64_t n = end - addr < sizeof(chunk) ? end - addr : sizeof(chunk);
+            ar_mem_read(mem, addr, n, chunk);
+            chunk_start = addr;
+            chunk_end = addr + n;
+        }
+
         bool new_line = false;
 
         if (addr == start) {
@@ -293,7 +356,7 @@ static void do_dump(rd_Memory const *mem, uint64_t start, uint64_t size,
             for (int i = 0; i < pad; i++) fputc(' ', out);
         }
 
-        fprintf(out, "%02X", mem->v1.peek(mem, addr, false));
+        fprintf(out, "%02X", chunk[addr - chunk_start]);
 
         uint64_t next = addr + 1;
         if (next < end) {
@@ -312,51 +375,6 @@ static void do_dump(rd_Memory const *mem, uint64_t start, uint64_t size,
     free(maps);
 }
 
-/* ========================================================================
- * Address marker resolution for disassembly output
- *
- * The disassembler encodes '@' after '$' to mark address operands:
- *   "$@0150" means the hex digits after @ are a memory address.
- * Consumers strip '@' and optionally resolve the address to a symbol.
- * ======================================================================== */
-
-static std::string resolve_addr_markers(const std::string &text,
-                                         const char *mem_id) {
-    std::string result;
-    const char *p = text.c_str();
-    while (*p) {
-        if (*p == '@') {
-            const char *h = p + 1;
-            while ((*h >= '0' && *h <= '9') ||
-                   (*h >= 'A' && *h <= 'F') ||
-                   (*h >= 'a' && *h <= 'f'))
-                h++;
-            if (h > p + 1) {
-                std::string hexStr(p + 1, h);
-                result += hexStr;
-                uint64_t addr = strtoull(hexStr.c_str(), nullptr, 16);
-                if (mem_id) {
-                    auto resolved = ar_sym_resolve(mem_id, addr);
-                    if (resolved) {
-                        const char *label = ar_sym_get_label(resolved->region_id.c_str(), resolved->addr);
-                        if (label) {
-                            result += '[';
-                            result += label;
-                            result += ']';
-                        }
-                    }
-                }
-                p = h;
-            } else {
-                result += *p++;
-            }
-        } else {
-            result += *p++;
-        }
-    }
-    return result;
-}
-
 /* ========================================================================
  * Command processing
  * ======================================================================== */
@@ -621,11 +639,13 @@ void ar_process_command(char *line, FILE *out) {
         if (plen < 1) plen = 1;
         if (plen > 256) plen = 256;
 
+        uint8_t data[256];
+        ar_mem_read(ar_debug_mem(), addr, plen, data);
         fprintf(out, "{\"ok\":true,\"addr\":\"0x%04lx\",\"data\":[",
                (unsigned long)addr);
         for (unsigned i = 0; i < plen; i++) {
             if (i > 0) fprintf(out, ",");
-            fprintf(out, "%u", ar_debug_mem()->v1.peek(ar_debug_mem(), addr + i, false));
+            fprintf(out, "%u", data[i]);
         }
         fprintf(out, "]}\n");
         fflush(out);
@@ -652,6 +672,7 @@ void ar_process_command(char *line, FILE *out) {
             count++;
             tok = strtok(NULL, " \t");
         }
+        ar_regions_invalidate();    /* the write may have switched banks */
         json_ok_f(out, "\"written\":%u", count);
         return;
     }
@@ -830,19 +851,22 @@ void ar_process_command(char *line, FILE *out) {
     /* --- screen [path] --- */
     if (strcmp(cmd, "screen") == 0) {
         const char *path = (nargs >= 2) ? arg1 : "screenshot.png";
-        unsigned w = ar_frame_width();
-        unsigned h = ar_frame_height();
-        const uint32_t *fb = ar_frame_buf();
+        ar_frame frame;
+        ar_frame_acquire(&frame);
+        unsigned w = frame.width;
+        unsigned h = frame.height;
+        const uint32_t *fb = frame.pixels;
 
         unsigned npixels = w * h;
         auto *rgb = (uint8_t *)malloc(npixels * 3);
-        if (!rgb) { json_error_f(out, "out of memory"); return; }
+        if (!rgb) { ar_frame_release(); json_error_f(out, "out of memory"); return; }
         for (unsigned i = 0; i < npixels; i++) {
             uint32_t px = fb[i];
             rgb[i * 3 + 0] = (px >> 16) & 0xFF;
             rgb[i * 3 + 1] = (px >>  8) & 0xFF;
             rgb[i * 3 + 2] =  px        & 0xFF;
         }
+        ar_frame_release();
 
         int ok = stbi_write_png(path, w, h, 3, rgb, w * 3);
         free(rgb);
@@ -1022,13 +1046,13 @@ void ar_process_command(char *line, FILE *out) {
         /* Fetch bytes from memory */
         uint64_t byte_count = end - start + 1;
         std::vector<uint8_t> buf(byte_count);
-        for (uint64_t i = 0; i < byte_count; i++)
-            buf[i] = mem->v1.peek(mem, start + i, false);
+        ar_mem_read(mem, start, byte_count, buf.data());
 
-        /* Disassemble */
-        auto insns = arch::disassemble(
-            std::span<const uint8_t>(buf.data(), buf.size()),
-            start, cpu->v1.type);
+        /* Disassemble (aligned to analysed code in the CPU's own space) */
+        std::span<const uint8_t> bytes(buf.data(), buf.size());
+        auto insns = (mem == cpu->v1.memory_region)
+            ? ar_analysis_disassemble(cpu, bytes, start)
+            : arch::disassemble(bytes, start, cpu->v1.type);
 
         /* Fetch memory map for bank display */
         std::vector<rd_MemoryMap> memMap;
@@ -1094,11 +1118,12 @@ void ar_process_command(char *line, FILE *out) {
                     fprintf(out, "%*s ", bankColW, "");
             }
 
-            /* Instruction (resolve @-marked addresses to symbols) */
-            std::string resolved_text = resolve_addr_markers(insn.text, mem_id);
+            /* Instruction (@-marked operands as label or label+offset) */
+            char text[256];
+            ar_sym_symbolize_text(insn.text.c_str(), mem_id, nullptr, nullptr,
+                                  text, sizeof(text));
             fprintf(out, "%0*lX%c %s",
-                    addr_width, (unsigned long)insn.address,
-                    marker, resolved_text.c_str());
+                    addr_width, (unsigned long)insn.address, marker, text);
 
             /* Comment */
             if (resolved) {
@@ -1131,6 +1156,184 @@ void ar_process_command(char *line, FILE *out) {
         return;
     }
 
+    /* --- analysis [status|start|stop|refresh|block [cpu.]<addr>] --- */
+    if (strcmp(cmd, "analysis") == 0) {
+        if (!ar_has_debug()) { json_error_f(out, "no debug support"); return; }
+
+        if (nargs < 2 || strcmp(arg1, "status") == 0) {
+            ar_analysis_stats st;
+            ar_analysis_get_stats(&st);
+            json_ok_f(out, "\"running\":%s,\"instructions\":%lu,\"blocks\":%lu"
+                          ",\"functions\":%lu,\"edges\":%lu,\"xrefs\":%lu",
+                      st.running ? "true" : "false",
+                      (unsigned long)st.instructions,
+                      (unsigned long)st.blocks,
+                      (unsigned long)st.functions,
+                      (unsigned long)st.edges,
+                      (unsigned long)st.xrefs);
+            return;
+        }
+
+        if (strcmp(arg1, "refresh") == 0) {
+            json_ok_f(out, "\"changed\":%s",
+                      ar_analysis_refresh() ? "true" : "false");
+            return;
+        }
+
+        if (strcmp(arg1, "start") == 0) {
+            if (!ar_content_loaded()) { json_error_f(out, "no content loaded"); return; }
+            if (ar_analysis_start())
+                json_ok_f(out, "\"running\":true");
+            else
+                json_error_f(out, "failed to start analysis");
+            return;
+        }
+
+        if (strcmp(arg1, "stop") == 0) {
+            ar_analysis_stop();
+            json_ok_f(out, "\"running\":false");
+            return;
+        }
+
+        if (strcmp(arg1, "block") == 0) {
+            if (nargs < 3) {
+                json_error_f(out, "usage: analysis block [cpu.]<addr>");
+                return;
+            }
+            rd_Cpu const *cpu = ar_debug_cpu();
+            char addr_s[256];
+            strncpy(addr_s, arg2, sizeof(addr_s) - 1);
+            addr_s[sizeof(addr_s) - 1] = '\0';
+            char *dot = strchr(addr_s, '.');
+            if (dot) {
+                *dot = '\0';
+                rd_System const *sys = ar_debug_system();
+                cpu = nullptr;
+                for (unsigned i = 0; i < sys->v1.num_cpus; i++)
+                    if (strcasecmp(sys->v1.cpus[i]->v1.id, addr_s) == 0)
+                        cpu = sys->v1.cpus[i];
+                if (!cpu) { json_error_f(out, "unknown cpu: %s", addr_s); return; }
+                memmove(addr_s, dot + 1, strlen(dot + 1) + 1);
+            }
+            uint64_t addr = strtoull(addr_s, nullptr, 16);
+
+            ar_basic_block blk;
+            if (!ar_analysis_block_at(cpu, addr, -1, &blk)) {
+                json_error_f(out, "address not in analysed code");
+                return;
+            }
+
+            static const char *const kind_names[] = {
+                "fall", "branch", "jump", "call",
+            };
+            fprintf(out, "{\"ok\":true,\"start\":\"0x%lX\",\"end\":\"0x%lX\""
+                         ",\"bank\":%ld,\"function\":",
+                    (unsigned long)blk.start, (unsigned long)blk.end,
+                    (long)blk.bank);
+            if (blk.func != UINT64_MAX)
+                fprintf(out, "\"0x%lX\"", (unsigned long)blk.func);
+            else
+                fprintf(out, "null");
+            fprintf(out, ",\"successors\":[");
+            for (size_t i = 0; i < blk.succ.size(); i++) {
+                auto &e = blk.succ[i];
+                fprintf(out, "%s{\"from\":\"0x%lX\",\"to\":\"0x%lX\""
+                             ",\"bank\":%ld,\"kind\":\"%s\"}",
+                        i ? "," : "", (unsigned long)e.from,
+                        (unsigned long)e.to, (long)e.to_bank,
+                        kind_names[e.kind]);
+            }
+            fprintf(out, "]}\n");
+            fflush(out);
+            return;
+        }
+
+        json_error_f(out, "usage: analysis [status|start|stop|refresh|block [cpu.]<addr>]");
+        return;
+    }
+
+    /* --- export listing <region> <path> [asm] --- */
+    if (strcmp(cmd, "export") == 0) {
+        if (!ar_has_debug()) { json_error_f(out, "no debug support"); return; }
+        char path[4096] = {0}, mode[16] = {0};
+        if (nargs < 4 || strcmp(arg1, "listing") != 0 ||
+            sscanf(rest, "%4095s %15s", path, mode) < 1) {
+            json_error_f(out, "usage: export listing <region> <path> [asm]");
+            return;
+        }
+        bool asm_compatible = strcmp(mode, "asm") == 0;
+        if (mode[0] && !asm_compatible) {
+            json_error_f(out, "usage: export listing <region> <path> [asm]");
+            return;
+        }
+
+        struct timeval t0, t1;
+        gettimeofday(&t0, NULL);
+        ar_listing_stats st;
+        if (!ar_export_listing(arg2, path, asm_compatible, &st)) {
+            json_error_f(out, "cannot export %s to %s", arg2, path);
+            return;
+        }
+        gettimeofday(&t1, NULL);
+        long ms = (t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_usec - t0.tv_usec) / 1000;
+        json_ok_f(out, "\"path\":\"%s\",\"bytes\":%lu,\"lines\":%lu"
+                       ",\"sections\":%u,\"threads\":%u,\"ms\":%ld",
+                  path, (unsigned long)st.bytes, (unsigned long)st.lines,
+                  st.sections, st.threads, ms);
+        return;
+    }
+
+    /* --- xref [cpu.][bank:]<addr> --- */
+    if (strcmp(cmd, "xref") == 0) {
+        if (!ar_has_debug()) { json_error_f(out, "no debug support"); return; }
+        if (nargs < 2) {
+            json_error_f(out, "usage: xref [cpu.][bank:]<addr>");
+            return;
+        }
+        rd_Cpu const *cpu = ar_debug_cpu();
+        char addr_s[256];
+        strncpy(addr_s, arg1, sizeof(addr_s) - 1);
+        addr_s[sizeof(addr_s) - 1] = '\0';
+        char *dot = strchr(addr_s, '.');
+        if (dot) {
+            *dot = '\0';
+            rd_System const *sys = ar_debug_system();
+            cpu = nullptr;
+            for (unsigned i = 0; i < sys->v1.num_cpus; i++)
+                if (strcasecmp(sys->v1.cpus[i]->v1.id, addr_s) == 0)
+                    cpu = sys->v1.cpus[i];
+            if (!cpu) { json_error_f(out, "unknown cpu: %s", addr_s); return; }
+            memmove(addr_s, dot + 1, strlen(dot + 1) + 1);
+        }
+        int64_t bank = -1;
+        char *colon = strchr(addr_s, ':');
+        if (colon) {
+            *colon = '\0';
+            bank = (int64_t)strtoll(addr_s, nullptr, 16);
+            memmove(addr_s, colon + 1, strlen(colon + 1) + 1);
+        }
+        uint64_t addr = strtoull(addr_s, nullptr, 16);
+
+        /* Pick up code changed since the snapshot before answering */
+        if (ar_analysis_refresh())
+            ar_analysis_wait_idle(2000);
+
+        auto refs = ar_analysis_xrefs_to(cpu, addr, bank);
+        fprintf(out, "{\"ok\":true,\"addr\":\"0x%lX\",\"count\":%zu"
+                     ",\"refs\":[",
+                (unsigned long)addr, refs.size());
+        for (size_t i = 0; i < refs.size(); i++) {
+            auto &r = refs[i];
+            fprintf(out, "%s{\"from\":\"0x%lX\",\"bank\":%ld"
+                         ",\"kind\":\"%s\"}",
+                    i ? "," : "", (unsigned long)r.from, (long)r.from_bank,
+                    xref::kind_name(r.kind));
+        }
+        fprintf(out, "]}\n");
+        fflush(out);
+        return;
+    }
+
     /* --- search reset|filter|list|count --- */
     if (strcmp(cmd, "search") == 0) {
         if (nargs < 2) {
@@ -1257,6 +1460,75 @@ void ar_process_command(char *line, FILE *out) {
         return;
     }
 
+    /* --- bt [cpu] | bt on|off --- */
+    if (strcmp(cmd, "bt") == 0) {
+        if (!ar_has_debug()) { json_error_f(out, "no debug support"); return; }
+
+        if (nargs >= 2 && (strcmp(arg1, "on") == 0 || strcmp(arg1, "off") == 0)) {
+            bool enable = strcmp(arg1, "on") == 0;
+            if (!ar_callstack_enable(enable)) {
+                json_error_f(out, "failed to enable shadow stack");
+                return;
+            }
+            json_ok_f(out, "\"shadow\":%s", enable ? "true" : "false");
+            return;
+        }
+
+        rd_Cpu const *cpu = ar_debug_cpu();
+        if (nargs >= 2) {
+            rd_System const *sys = ar_debug_system();
+            cpu = nullptr;
+            for (unsigned i = 0; i < sys->v1.num_cpus; i++)
+                if (strcasecmp(sys->v1.cpus[i]->v1.id, arg1) == 0)
+                    cpu = sys->v1.cpus[i];
+            if (!cpu) { json_error_f(out, "unknown cpu: %s", arg1); return; }
+        }
+
+        bool shadow = false;
+        arch::StackTrace trace = ar_backtrace(cpu, 256, &shadow);
+        if (!shadow && trace.frames.empty()) {
+            json_error_f(out, "no stack trace for cpu %s (enable with 'bt on')",
+                         cpu->v1.id);
+            return;
+        }
+
+        const char *status = "ok";
+        switch (trace.status) {
+        case arch::StackTraceStatus::OK:         status = "ok"; break;
+        case arch::StackTraceStatus::MAX_DEPTH:  status = "max_depth"; break;
+        case arch::StackTraceStatus::SCAN_LIMIT: status = "scan_limit"; break;
+        case arch::StackTraceStatus::INVALID_SP: status = "invalid_sp"; break;
+        case arch::StackTraceStatus::INVALID_RA: status = "invalid_ra"; break;
+        case arch::StackTraceStatus::READ_ERROR: status = "read_error"; break;
+        }
+
+        rd_Memory const *mem = cpu->v1.memory_region;
+        fprintf(out, "{\"ok\":true,\"cpu\":\"%s\",\"source\":\"%s\",\"status\":\"%s\","
+                     "\"depth\":%zu,\"frames\":[",
+                cpu->v1.id, shadow ? "shadow" : "heuristic", status,
+                trace.frames.size());
+        for (size_t i = 0; i < trace.frames.size(); i++) {
+            const arch::StackFrame &f = trace.frames[i];
+            if (i > 0) fputc(',', out);
+            fprintf(out, "{\"pc\":\"0x%lX\",\"sp\":\"0x%lX\"",
+                    (unsigned long)f.pc, (unsigned long)f.sp);
+            if (f.func_addr != UINT64_MAX)
+                fprintf(out, ",\"func\":\"0x%lX\"", (unsigned long)f.func_addr);
+            char label[96];
+            if (mem && ar_sym_symbolize(mem->v1.id, f.pc, UINT64_MAX,
+                                        label, sizeof(label))) {
+                fprintf(out, ",\"label\":\"");
+                json_escape(out, label);
+                fputc('"', out);
+            }
+            if (f.interrupt) fprintf(out, ",\"interrupt\":true");
+            fputc('}', out);
+        }
+        fprintf(out, "]}\n");
+        fflush(out);
+        return;
+    }
+
     /* --- bp add|delete|enable|disable|list|clear --- */
     if (strcmp(cmd, "bp") == 0) {
         if (nargs < 2) {
@@ -1451,45 +1723,108 @@ void ar_process_command(char *line, FILE *out) {
     /* --- sym label|comment get|set|delete / sym list --- */
     if (strcmp(cmd, "sym") == 0) {
         if (nargs < 2) {
-            json_error_f(out, "usage: sym label|comment get|set|delete ... | sym list");
+            json_error_f(out, "usage: sym label|comment get|set|delete ... | sym list [start [count]]");
             return;
         }
 
         if (strcmp(arg1, "list") == 0) {
-            unsigned count = ar_sym_count();
-            ar_symbol *syms = nullptr;
-            if (count > 0) {
-                syms = new ar_symbol[count];
-                count = ar_sym_list(syms, count);
-            }
-            fprintf(out, "{\"ok\":true,\"symbols\":[");
-            for (unsigned i = 0; i < count; i++) {
-                if (i > 0) fputc(',', out);
-                fprintf(out, "{\"region\":\"%s\",\"addr\":%lu",
-                        syms[i].region_id, (unsigned long)syms[i].address);
-                if (syms[i].label[0]) {
-                    fprintf(out, ",\"label\":\"%s\"", syms[i].label);
-                }
-                if (syms[i].comment[0]) {
-                    /* Escape comment for JSON */
-                    fprintf(out, ",\"comment\":\"");
-                    for (const char *p = syms[i].comment; *p; p++) {
-                        switch (*p) {
-                        case '"':  fputs("\\\"", out); break;
-                        case '\\': fputs("\\\\", out); break;
-                        case '\n': fputs("\\n", out);  break;
-                        case '\r': fputs("\\r", out);  break;
-                        case '\t': fputs("\\t", out);  break;
-                        default:   fputc(*p, out);     break;
-                        }
+            /* sym list [start [count]] */
+            unsigned total = ar_sym_count();
+            unsigned start = nargs >= 3 ? (unsigned)strtoul(arg2, NULL, 0) : 0;
+            unsigned limit = total;
+            if (nargs >= 4) limit = (unsigned)strtoul(rest, NULL, 0);
+
+            fprintf(out, "{\"ok\":true,\"total\":%u,\"start\":%u"
+                         ",\"symbols\":[", total, start);
+            ar_symbol_ref page[256];
+            unsigned emitted = 0;
+            while (emitted < limit) {
+                unsigned want = limit - emitted < 256 ? limit - emitted : 256;
+                unsigned n = ar_sym_list(start + emitted, page, want);
+                if (n == 0) break;
+                for (unsigned i = 0; i < n; i++) {
+                    if (emitted + i > 0) fputc(',', out);
+                    fprintf(out, "{\"region\":\"%s\",\"addr\":%lu",
+                            page[i].region_id, (unsigned long)page[i].address);
+                    if (page[i].label) {
+                        fprintf(out, ",\"label\":\"");
+                        json_escape(out, page[i].label);
+                        fputc('"', out);
                     }
-                    fputc('"', out);
+                    if (page[i].comment) {
+                        fprintf(out, ",\"comment\":\"");
+                        json_escape(out, page[i].comment);
+                        fputc('"', out);
+                    }
+                    fputc('}', out);
                 }
-                fputc('}', out);
+                emitted += n;
             }
             fprintf(out, "]}\n");
             fflush(out);
-            delete[] syms;
+            return;
+        }
+
+        if (strcmp(arg1, "find") == 0) {
+            /* sym find <query> [limit] */
+            if (nargs < 3) {
+                json_error_f(out, "usage: sym find <query> [limit]");
+                return;
+            }
+            static const char *kinds[] = { "exact", "prefix", "substring", "fuzzy" };
+            unsigned limit = nargs >= 4 ? (unsigned)strtoul(rest, NULL, 0) : 20;
+            if (limit == 0 || limit > 256) limit = 256;
+            ar_symbol_match matches[256];
+            unsigned n = ar_sym_find(arg2, matches, limit);
+
+            fprintf(out, "{\"ok\":true,\"count\":%u,\"matches\":[", n);
+            for (unsigned i = 0; i < n; i++) {
+                fprintf(out, "%s{\"label\":\"", i ? "," : "");
+                json_escape(out, matches[i].label);
+                fprintf(out, "\",\"region\":\"%s\",\"addr\":\"0x%lX\",\"kind\":\"%s\"}",
+                        matches[i].region_id, (unsigned long)matches[i].address,
+                        kinds[matches[i].kind]);
+            }
+            fprintf(out, "]}\n");
+            fflush(out);
+            return;
+        }
+
+        if (strcmp(arg1, "import") == 0) {
+            /* sym import <path> [rgbds|map|elf] */
+            if (nargs < 3) {
+                json_error_f(out, "usage: sym import <path> [rgbds|map|elf]");
+                return;
+            }
+            const char *format = nargs >= 4 ? rest : NULL;
+            unsigned imported = 0, skipped = 0;
+            if (!ar_sym_import(arg2, format, &imported, &skipped)) {
+                json_error_f(out, "cannot import symbols from %s", arg2);
+                return;
+            }
+            json_ok_f(out, "\"imported\":%u,\"skipped\":%u", imported, skipped);
+            return;
+        }
+
+        if (strcmp(arg1, "batch") == 0) {
+            /* sym batch begin|commit: edits in between share one fsync.
+             * Open batches expire, see cmd_batch_expire(). */
+            if (nargs >= 3 && strcmp(arg2, "begin") == 0) {
+                ar_sym_batch_begin();
+                cmd_batch_depth++;
+                gettimeofday(&cmd_batch_last, NULL);
+                json_ok_f(out, NULL);
+            } else if (nargs >= 3 && strcmp(arg2, "commit") == 0) {
+                if (cmd_batch_depth == 0) {
+                    json_error_f(out, "no symbol batch open");
+                    return;
+                }
+                cmd_batch_depth--;
+                ar_sym_batch_commit();
+                json_ok_f(out, NULL);
+            } else {
+                json_error_f(out, "usage: sym batch begin|commit");
+            }
             return;
         }
 
@@ -1584,6 +1919,19 @@ void ar_process_command(char *line, FILE *out) {
         const char *resolved_region = rslv->region_id.c_str();
         uint64_t resolved_addr = rslv->addr;
 
+        if (strcmp(sub_cmd, "nearest") == 0 && is_label) {
+            uint64_t label_addr = 0;
+            const char *label = ar_sym_nearest_label(resolved_region,
+                                                     resolved_addr, &label_addr);
+            if (label)
+                json_ok_f(out, "\"label\":\"%s\",\"addr\":\"0x%lX\",\"offset\":%lu",
+                          label, (unsigned long)label_addr,
+                          (unsigned long)(resolved_addr - label_addr));
+            else
+                json_ok_f(out, "\"label\":null");
+            return;
+        }
+
         if (strcmp(sub_cmd, "get") == 0) {
             if (is_label) {
                 const char *label = ar_sym_get_label(resolved_region, resolved_addr);
@@ -1657,10 +2005,10 @@ void ar_process_command(char *line, FILE *out) {
         return;
     }
 
-    /* --- trace on|off|status|cpu|instructions|interrupts|registers|indent --- */
+    /* --- trace on|off|status|cpu|instructions|interrupts|registers|indent|symbols --- */
     if (strcmp(cmd, "trace") == 0) {
         if (nargs < 2) {
-            json_error_f(out, "usage: trace on|off|status|cpu|instructions|interrupts|registers|indent ...");
+            json_error_f(out, "usage: trace on|off|status|cpu|instructions|interrupts|registers|indent|symbols ...");
             return;
         }
 
@@ -1695,13 +2043,15 @@ void ar_process_command(char *line, FILE *out) {
         if (strcmp(arg1, "status") == 0) {
             json_ok_f(out, "\"tracing\":%s,\"lines\":%lu"
                           ",\"instructions\":%s,\"interrupts\":%s"
-                          ",\"registers\":%s,\"indent\":%s,\"file\":\"%s\"",
+                          ",\"registers\":%s,\"indent\":%s,\"symbols\":%s"
+                          ",\"file\":\"%s\"",
                       ar_trace_active() ? "true" : "false",
                       (unsigned long)ar_trace_total_lines(),
                       ar_trace_get_instructions() ? "true" : "false",
                       ar_trace_get_interrupts() ? "true" : "false",
                       ar_trace_get_registers() ? "true" : "false",
                       ar_trace_get_indent() ? "true" : "false",
+                      ar_trace_get_symbols() ? "true" : "false",
                       ar_trace_file_path());
             return;
         }
@@ -1777,6 +2127,19 @@ void ar_process_command(char *line, FILE *out) {
             return;
         }
 
+        if (strcmp(arg1, "symbols") == 0) {
+            if (nargs < 3) {
+                json_error_f(out, "usage: trace symbols on|off");
+                return;
+            }
+            if (strcmp(arg2, "on") == 0) ar_trace_set_symbols(true);
+            else if (strcmp(arg2, "off") == 0) ar_trace_set_symbols(false);
+            else { json_error_f(out, "usage: trace symbols on|off"); return; }
+            json_ok_f(out, "\"symbols\":%s",
+                      ar_trace_get_symbols() ? "true" : "false");
+            return;
+        }
+
         if (strcmp(arg1, "option") == 0) {
             /* trace option <index> on|off   OR   trace option list */
             if (nargs < 3) {
@@ -1821,6 +2184,81 @@ void ar_process_command(char *line, FILE *out) {
         return;
     }
 
+    /* --- gpucap [status] | gpucap budget <MiB> | gpucap save|load|stats <path> --- */
+    if (strcmp(cmd, "gpucap") == 0) {
+        if (nargs < 2 || strcmp(arg1, "status") == 0) {
+            json_ok_f(out, "\"active\":%s,\"streaming\":%s,\"events\":%lu"
+                          ",\"compressed\":%lu,\"pending\":%lu"
+                          ",\"memory\":%lu,\"budget\":%lu",
+                      sys::gpu_capture_active() ? "true" : "false",
+                      sys::gpu_capture_streaming() ? "true" : "false",
+                      (unsigned long)sys::gpu_capture_event_count(),
+                      (unsigned long)sys::gpu_capture_compressed_bytes(),
+                      (unsigned long)sys::gpu_capture_pending(),
+                      (unsigned long)sys::gpu_capture_memory(),
+                      (unsigned long)sys::gpu_capture_budget());
+            return;
+        }
+
+        if (strcmp(arg1, "budget") == 0) {
+            if (nargs < 3) {
+                json_ok_f(out, "\"budget\":%lu", (unsigned long)sys::gpu_capture_budget());
+                return;
+            }
+            unsigned long mib = strtoul(arg2, NULL, 0);
+            if (mib == 0) {
+                json_error_f(out, "usage: gpucap budget <MiB>");
+                return;
+            }
+            sys::gpu_capture_set_budget((size_t)mib << 20);
+            json_ok_f(out, "\"budget\":%lu", (unsigned long)sys::gpu_capture_budget());
+            return;
+        }
+
+        bool save = strcmp(arg1, "save") == 0;
+        bool stats = strcmp(arg1, "stats") == 0;
+        if (!save && !stats && strcmp(arg1, "load") != 0) {
+            json_error_f(out, "usage: gpucap [status] | gpucap budget <MiB> | gpucap save|load|stats <path>");
+            return;
+        }
+        char gpath[4096] = {0};
+        if (nargs >= 3)
+            sscanf(line, "%*s %*s %4095[^\n]", gpath);
+        size_t gl = strlen(gpath);
+        while (gl > 0 && (gpath[gl-1] == ' ' || gpath[gl-1] == '\t'))
+            gpath[--gl] = '\0';
+        if (!gpath[0]) {
+            json_error_f(out, "usage: gpucap %s <path>", arg1);
+            return;
+        }
+
+        if (stats) {
+            if (sys::gpu_capture_active()) {
+                json_error_f(out, "GPU capture in progress");
+                return;
+            }
+            auto frames = sys::gpu_stats_analyze_all(sys::gpu_capture_events(0));
+            if (sys::gpu_stats_write_json(gpath, frames))
+                json_ok_f(out, "\"path\":\"%s\",\"frames\":%lu", gpath,
+                          (unsigned long)frames.size());
+            else
+                json_error_f(out, "failed to write GPU stats: %s", gpath);
+        } else if (save) {
+            if (sys::gpu_capture_save(gpath))
+                json_ok_f(out, "\"path\":\"%s\",\"streaming\":%s", gpath,
+                          sys::gpu_capture_streaming() ? "true" : "false");
+            else
+                json_error_f(out, "failed to save GPU capture: %s", gpath);
+        } else {
+            if (sys::gpu_capture_load(gpath))
+                json_ok_f(out, "\"path\":\"%s\",\"events\":%lu", gpath,
+                          (unsigned long)sys::gpu_capture_event_count());
+            else
+                json_error_f(out, "failed to load GPU capture: %s", gpath);
+        }
+        return;
+    }
+
     /* --- reset --- */
     if (strcmp(cmd, "reset") == 0) {
         ar_reset();
@@ -0,0 +1,179 @@
+/*
+ * dirty.cpp: Pages of memory regions changed since a consumer last looked
+ *
+ * One Track per region, created by the first consumer that can use it and
+ * dropped by ar_dirty_clear().  Poll serials come from one counter shared
+ * by all tracks, so a consumer that outlives a clear never mistakes the
+ * serials of a new track for ones it has seen.
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
+
+#include "dirty.hpp"
+#include "backend.hpp"
+#include "memreader.hpp"
+#include "regions.hpp"
+
+/* Larger regions are not hashed: a poll would cost more than it saves */
+static constexpr uint64_t MAX_HASH_BYTES = 64ull << 20;
+
+/* Regions with more pages than this are not tracked */
+static constexpr uint64_t MAX_PAGES = 1ull << 20;
+
+struct Track {
+    bool     native;                /* the core reports dirty pages */
+    bool     hash;                  /* otherwise, compare page CRCs */
+    uint64_t pages;
+    uint64_t generation = 0;        /* of the last poll */
+    uint64_t epoch = 0;             /* 0: never polled */
+    std::vector<uint32_t> serial;   /* poll in which each page changed */
+    std::vector<uint32_t> group;    /* latest of each 64 pages' serials */
+    std::vector<uint64_t> bitmap;   /* core's report, native only */
+    std::vector<uint32_t> crc;      /* hash only */
+};
+
+static std::mutex                                   g_mutex;
+static std::unordered_map<rd_Memory const *, Track> g_tracks;
+static uint32_t                                     g_serial = 0;
+static uint64_t                                     g_epoch = 1;
+
+bool ar_dirty_native(rd_Memory const *mem) {
+    rd_DebuggerIf *dif = ar_get_debugger_if();
+    return mem && dif && dif->core_api_version >= 2 &&
+           mem->v2.get_dirty_pages;
+}
+
+void ar_dirty_invalidate(void) {
+    std::lock_guard lock(g_mutex);
+    g_epoch++;
+}
+
+void ar_dirty_clear(void) {
+    std::lock_guard lock(g_mutex);
+    g_tracks.clear();
+}
+
+/* ======================================================================== */
+/* Polling                                                                   */
+/* ======================================================================== */
+
+/* Track of mem usable by a consumer, created on first use; NULL if the
+ * region cannot be tracked that way */
+static Track *find_track(rd_Memory const *mem, bool hash) {
+    auto it = g_tracks.find(mem);
+    if (it == g_tracks.end()) {
+        uint64_t pages = (mem->v1.size + DirtyPages::PAGE_SIZE - 1) >> AR_DIRTY_PAGE_SHIFT;
+        if (pages == 0 || pages > MAX_PAGES) return nullptr;
+        bool native = ar_dirty_native(mem);
+        if (!native && !hash) return nullptr;
+        Track t;
+        t.native = native;
+        t.hash = hash;
+        t.pages = pages;
+        t.serial.assign(pages, 0);
+        t.group.assign((pages + 63) / 64, 0);
+        it = g_tracks.emplace(mem, std::move(t)).first;
+    }
+    Track &t = it->second;
+    if (!t.native && hash && !t.hash) {
+        t.hash = true;
+        t.epoch = 0;    /* no CRCs to compare against yet */
+    }
+    if (!t.native && !(hash && mem->v1.size <= MAX_HASH_BYTES)) return nullptr;
+    return &t;
+}
+
+static void poll(rd_Memory const *mem, Track &t) {
+    uint64_t generation = ar_regions_generation();
+    /* A running core writes between generations too */
+    if (t.generation == generation && t.epoch == g_epoch && !ar_running())
+        return;
+    bool all = t.epoch != g_epoch;
+    uint32_t serial = ++g_serial;
+
+    if (t.native) {
+        t.bitmap.assign((t.pages + 63) / 64, 0);
+        if (mem->v2.get_dirty_pages(mem, AR_DIRTY_PAGE_SHIFT, t.bitmap.data(), true)) {
+            for (uint64_t w = 0; w < t.bitmap.size() && !all; w++)
+                for (uint64_t bits = t.bitmap[w]; bits; bits &= bits - 1) {
+                    uint64_t p = w * 64 + (uint64_t)__builtin_ctzll(bits);
+                    if (p < t.pages) t.serial[p] = t.group[w] = serial;
+                }
+        } else {
+            /* Page size refused: hash from now on, if anyone asked to */
+            t.native = false;
+            all = true;
+        }
+    }
+    if (!t.native && t.hash && mem->v1.size <= MAX_HASH_BYTES) {
+        t.crc.resize(t.pages);
+        uint8_t buf[DirtyPages::PAGE_SIZE];
+        uint64_t base = mem->v1.base_address;
+        for (uint64_t p = 0; p < t.pages; p++) {
+            uint64_t off = p << AR_DIRTY_PAGE_SHIFT;
+            uint64_t n = mem->v1.size - off;
+            if (n > DirtyPages::PAGE_SIZE) n = DirtyPages::PAGE_SIZE;
+            ar_mem_read(mem, base + off, n, buf);
+            uint32_t crc = (uint32_t)crc32(crc32(0L, Z_NULL, 0), buf, (uInt)n);
+            if (all || crc != t.crc[p]) {
+                t.crc[p] = crc;
+                t.serial[p] = t.group[p >> 6] = serial;
+            }
+        }
+    }
+    if (all) {
+        t.serial.assign(t.pages, serial);
+        t.group.assign(t.group.size(), serial);
+    }
+
+    t.generation = generation;
+    t.epoch = g_epoch;
+}
+
+/* ======================================================================== */
+/* DirtyPages                                                                */
+/* ======================================================================== */
+
+void DirtyPages::set_memory(rd_Memory const *mem) {
+    if (mem == m_mem) return;
+    m_mem = mem;
+    m_base = mem ? mem->v1.base_address : 0;
+    m_bits.clear();
+    reset();
+}
+
+bool DirtyPages::update() {
+    m_all = true;
+    if (!m_mem) return false;
+
+    std::lock_guard lock(g_mutex);
+    Track *t = find_track(m_mem, m_hash);
+    if (!t) return false;
+    poll(m_mem, *t);
+    if (!t->native && !t->hash) return false;
+
+    m_bits.assign(t->group.size(), 0);
+    for (uint64_t w = 0; w < t->group.size(); w++) {
+        if (t->group[w] <= m_seen) continue;
+        uint64_t end = std::min(t->pages, (w + 1) * 64);
+        for (uint64_t p = w * 64; p < end; p++)
+            if (t->serial[p] > m_seen)
+                m_bits[w] |= 1ull << (p & 63);
+    }
+    m_seen = g_serial;
+    m_all = false;
+    return true;
+}
+
+uint64_t DirtyPages::count() const {
+    if (m_all)
+        return m_mem ? (m_mem->v1.size + PAGE_SIZE - 1) >> AR_DIRTY_PAGE_SHIFT : 0;
+    uint64_t n = 0;
+    for (uint64_t w : m_bits)
+        n += (uint64_t)__builtin_popcountll(w);
+    return n;
+}
@@ -0,0 +1,101 @@
+/*
+ * dirty.h: Pages of memory regions changed since a consumer last looked
+ *
+ * Cores with retrodebug API version 2 may report dirty pages through
+ * rd_Memory v2.get_dirty_pages.  Reading that record clears it, so the
+ * backend polls each region at most once per regions generation while
+ * the core is paused (on every update() while it runs) and keeps, per
+ * 4 KB page, the serial of the poll in which it last changed; each
+ * DirtyPages consumer remembers the last serial it has seen.
+ *
+ * For cores without get_dirty_pages a consumer may ask for hashing
+ * instead: each poll reads the whole region and compares the CRC32 of
+ * every page with the previous poll.  That only pays for consumers doing
+ * far more work per page than reading it (search filters); the others
+ * treat every page as changed.  A hashed page that changes and changes
+ * back between two polls is not reported.  Loading a state, resetting
+ * or reloading content marks every page changed.
+ */
+
+#ifndef AR_DIRTY_H
+#define AR_DIRTY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "retrodebug.h"
+
+#define AR_DIRTY_PAGE_SHIFT 12
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* True if the core reports the dirty pages of mem itself */
+bool ar_dirty_native(rd_Memory const *mem);
+
+/* Every page of every region counts as changed at the next poll (state
+ * load, reset, content reload) */
+void ar_dirty_invalidate(void);
+
+/* Forget every region (content load, core unload) */
+void ar_dirty_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+#include <vector>
+
+class DirtyPages {
+public:
+    static constexpr uint64_t PAGE_SIZE = 1ull << AR_DIRTY_PAGE_SHIFT;
+
+    /* hash: fall back to hashing pages when the core has no
+     * get_dirty_pages */
+    explicit DirtyPages(bool hash = false) : m_hash(hash) {}
+
+    /* Hash pages from the next update() on, or stop; a consumer that
+     * stops hashing sees every page as changed */
+    void set_hash(bool hash) { m_hash = hash; }
+
+    /* Switch regions; the next update() reports every page */
+    void set_memory(rd_Memory const *mem);
+    rd_Memory const *memory() const { return m_mem; }
+
+    /* Collect the pages changed since the previous update().  Returns
+     * false if the region is not tracked, in which case every page counts
+     * as changed.  Call it before reading the memory it covers. */
+    bool update();
+
+    /* Forget what has been seen; the next update() reports every page */
+    void reset() { m_seen = 0; m_all = true; }
+
+    /* Whether any page overlapping [addr, addr + size) changed, as of the
+     * last update() */
+    bool changed(uint64_t addr, uint64_t size = 1) const {
+        if (m_all || addr < m_base) return true;
+        uint64_t first = (addr - m_base) >> AR_DIRTY_PAGE_SHIFT;
+        uint64_t last = (addr - m_base + size - 1) >> AR_DIRTY_PAGE_SHIFT;
+        if (last >= (uint64_t)m_bits.size() * 64) return true;
+        for (uint64_t p = first; p <= last; p++)
+            if (m_bits[p >> 6] >> (p & 63) & 1) return true;
+        return false;
+    }
+
+    /* Pages reported by the last update() (all of them if untracked) */
+    uint64_t count() const;
+
+private:
+    rd_Memory const *m_mem = nullptr;
+    bool     m_hash;
+    bool     m_all = true;
+    uint64_t m_base = 0;
+    uint32_t m_seen = 0;            /* serial of the last poll seen */
+    std::vector<uint64_t> m_bits;   /* one bit per page, from m_base */
+};
+
+#endif
+
+#endif /* AR_DIRTY_H */
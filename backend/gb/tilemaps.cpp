@@ -1,10 +1,12 @@
 #include "gb/tilemaps.hpp"
 #include "retrodebug.h"
+#include "memreader.hpp"
 #include <cstring>
 
 namespace gb {
 
 static constexpr uint16_t MAP_BASE[2] = { 0x9800, 0x9C00 };
+static constexpr int MAP_BYTES = 32 * 32;
 
 TilemapData read_tilemap(rd_Memory const *mem, const char *system, int map_index) {
     TilemapData data = {};
@@ -20,11 +22,12 @@ TilemapData read_tilemap(rd_Memory const *mem, const char *system, int map_index
     uint16_t base = MAP_BASE[map_index];
 
     // Read tile indices from bank 0
+    uint8_t raw[MAP_BYTES];
+    ar_mem_read(mem, base, MAP_BYTES, raw);
     for (int row = 0; row < 32; row++) {
         for (int col = 0; col < 32; col++) {
-            uint16_t addr = base + row * 32 + col;
             TilemapEntry &e = data.entries[row][col];
-            e.tile_index = mem->v1.peek(mem, addr, false);
+            e.tile_index = raw[row * 32 + col];
             e.has_attrs = false;
         }
     }
@@ -32,12 +35,12 @@ TilemapData read_tilemap(rd_Memory const *mem, const char *system, int map_index
     // On GBC, read attributes from VRAM bank 1
     if (is_gbc && mem->v1.get_bank_address) {
         rd_MemoryMap mapping;
-        if (mem->v1.get_bank_address(mem, base, 1, &mapping) && mapping.source) {
+        if (mem->v1.get_bank_address(mem, base, 1, &mapping) && mapping.source &&
+            mapping.source->v1.peek) {
+            ar_mem_read(mapping.source, mapping.source_base_addr, MAP_BYTES, raw);
             for (int row = 0; row < 32; row++) {
                 for (int col = 0; col < 32; col++) {
-                    uint64_t offset = row * 32 + col;
-                    uint8_t attr = mapping.source->v1.peek(mapping.source,
-                                       mapping.source_base_addr + offset, false);
+                    uint8_t attr = raw[row * 32 + col];
                     TilemapEntry &e = data.entries[row][col];
                     e.palette = attr & 0x07;
                     e.vram_bank = (attr >> 3) & 1;
@@ -69,12 +72,12 @@ void read_gb_palette(rd_Memory const *mem, uint32_t out[4]) {
 
 bool read_gbc_palette(rd_Memory const *bgpal, uint32_t out[8][4]) {
     if (!bgpal || !bgpal->v1.peek) return false;
+    uint8_t raw[64];
+    ar_mem_read(bgpal, 0, sizeof(raw), raw);
     for (int pal = 0; pal < 8; pal++) {
         for (int col = 0; col < 4; col++) {
-            uint64_t addr = pal * 8 + col * 2;
-            uint8_t lo = bgpal->v1.peek(bgpal, addr, false);
-            uint8_t hi = bgpal->v1.peek(bgpal, addr + 1, false);
-            uint16_t rgb555 = lo | (hi << 8);
+            unsigned addr = pal * 8 + col * 2;
+            uint16_t rgb555 = raw[addr] | (raw[addr + 1] << 8);
             uint8_t r = (rgb555 & 0x1F) << 3;
             uint8_t g = ((rgb555 >> 5) & 0x1F) << 3;
             uint8_t b = ((rgb555 >> 10) & 0x1F) << 3;
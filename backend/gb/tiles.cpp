@@ -1,76 +1,130 @@
 #include "gb/tiles.hpp"
 #include "retrodebug.h"
+#include "memreader.hpp"
 #include <cstring>
 
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 namespace gb {
 
 static constexpr uint64_t VRAM_START = 0x8000;
 static constexpr uint64_t VRAM_TILE_END = 0x9800; // 0x8000-0x97FF = 6144 bytes = 384 tiles
 static constexpr int TILES_PER_BANK = 384;
 static constexpr int BYTES_PER_TILE = 16;
+static constexpr int BANK_BYTES = TILES_PER_BANK * BYTES_PER_TILE;
 
-static void decode_tile(const uint8_t *data, TileImage &tile) {
-    for (int row = 0; row < 8; row++) {
-        uint8_t lo = data[row * 2];
-        uint8_t hi = data[row * 2 + 1];
-        for (int bit = 7; bit >= 0; bit--) {
-            int pixel = ((hi >> bit) & 1) << 1 | ((lo >> bit) & 1);
-            tile.pixels[row * 8 + (7 - bit)] = (uint8_t)pixel;
+// Spread the 8 bits of a bitplane byte into 8 pixel bytes, leftmost (bit 7)
+// pixel first: byte n of the result holds bit 7-n of the input.
+#if defined(__BMI2__)
+static inline uint64_t spread_plane(uint8_t b) {
+    return __builtin_bswap64(_pdep_u64(b, 0x0101010101010101ULL));
+}
+#else
+struct PlaneLut {
+    uint64_t spread[256];
+    PlaneLut() {
+        for (int b = 0; b < 256; b++) {
+            uint8_t px[8];
+            for (int x = 0; x < 8; x++)
+                px[x] = (b >> (7 - x)) & 1;
+            memcpy(&spread[b], px, 8);
         }
     }
+};
+static const PlaneLut s_plane_lut;
+
+static inline uint64_t spread_plane(uint8_t b) {
+    return s_plane_lut.spread[b];
 }
+#endif
 
-static void read_bank(rd_Memory const *mem, int bank, std::vector<TileImage> &tiles) {
-    uint8_t raw[TILES_PER_BANK * BYTES_PER_TILE];
+void decode_tile(const uint8_t *data, TileImage &tile) {
+    for (int row = 0; row < 8; row++) {
+        uint64_t px = spread_plane(data[row * 2]) | (spread_plane(data[row * 2 + 1]) << 1);
+        memcpy(&tile.pixels[row * 8], &px, 8);
+    }
+}
 
+static bool read_bank(rd_Memory const *mem, int bank, uint8_t *raw) {
     if (bank == 0) {
-        // Bank 0: direct peek
-        for (uint64_t addr = VRAM_START; addr < VRAM_TILE_END; addr++)
-            raw[addr - VRAM_START] = mem->v1.peek(mem, addr, false);
-    } else {
-        // Bank 1 (GBC): use get_bank_address to resolve backing memory
-        if (!mem->v1.get_bank_address)
-            return;
+        // Bank 0: direct read
+        ar_mem_read(mem, VRAM_START, BANK_BYTES, raw);
+        return true;
+    }
 
-        rd_MemoryMap mapping;
-        if (!mem->v1.get_bank_address(mem, VRAM_START, bank, &mapping))
-            return;
+    // Bank 1 (GBC): use get_bank_address to resolve backing memory
+    if (!mem->v1.get_bank_address)
+        return false;
 
-        // Peek through the source region at the resolved offset
-        rd_Memory const *src = mapping.source;
-        if (!src)
-            return;
+    rd_MemoryMap mapping;
+    if (!mem->v1.get_bank_address(mem, VRAM_START, bank, &mapping))
+        return false;
 
-        for (uint64_t i = 0; i < VRAM_TILE_END - VRAM_START; i++)
-            raw[i] = src->v1.peek(src, mapping.source_base_addr + i, false);
-    }
+    // Read through the source region at the resolved offset
+    rd_Memory const *src = mapping.source;
+    if (!src || !src->v1.peek)
+        return false;
 
-    int base = (int)tiles.size();
-    tiles.resize(base + TILES_PER_BANK);
-    for (int i = 0; i < TILES_PER_BANK; i++)
-        decode_tile(&raw[i * BYTES_PER_TILE], tiles[base + i]);
+    ar_mem_read(src, mapping.source_base_addr, VRAM_TILE_END - VRAM_START, raw);
+    return true;
 }
 
-TileSet read_tiles(rd_Memory const *mem, const char *system) {
-    TileSet ts;
-    ts.banks = 1;
-
+uint32_t TileAtlas::update(rd_Memory const *mem, const char *system) {
     if (!mem || !mem->v1.peek)
-        return ts;
-
-    read_bank(mem, 0, ts.tiles);
+        return m_generation;
 
+    int banks = 1;
     // GBC has a second VRAM bank
-    if (system && strcmp(system, "gbc") == 0) {
-        if (mem->v1.get_bank_address) {
-            rd_MemoryMap mapping;
-            if (mem->v1.get_bank_address(mem, VRAM_START, 1, &mapping)) {
-                ts.banks = 2;
-                read_bank(mem, 1, ts.tiles);
-            }
-        }
+    if (system && strcmp(system, "gbc") == 0 && mem->v1.get_bank_address) {
+        rd_MemoryMap mapping;
+        if (mem->v1.get_bank_address(mem, VRAM_START, 1, &mapping))
+            banks = 2;
+    }
+
+    std::vector<uint8_t> buf((size_t)banks * BANK_BYTES);
+    read_bank(mem, 0, buf.data());
+    if (banks == 2 && !read_bank(mem, 1, buf.data() + BANK_BYTES))
+        memset(buf.data() + BANK_BYTES, 0, BANK_BYTES);
+
+    // Bank count changed (or first read): every tile is new
+    bool all = banks != m_set.banks;
+    if (all) {
+        m_set.banks = banks;
+        m_set.tiles.assign((size_t)banks * TILES_PER_BANK, TileImage{});
+        m_changed.assign((size_t)banks * TILES_PER_BANK, 0);
+        m_raw.assign(buf.size(), 0);
     }
 
+    uint32_t next = m_generation + 1;
+    bool any = false;
+    for (int i = 0; i < banks * TILES_PER_BANK; i++) {
+        const uint8_t *src = &buf[(size_t)i * BYTES_PER_TILE];
+        uint8_t *old = &m_raw[(size_t)i * BYTES_PER_TILE];
+        if (!all && memcmp(src, old, BYTES_PER_TILE) == 0)
+            continue;
+        memcpy(old, src, BYTES_PER_TILE);
+        decode_tile(src, m_set.tiles[i]);
+        m_changed[i] = next;
+        any = true;
+    }
+    if (any)
+        m_generation = next;
+    return m_generation;
+}
+
+TileAtlas &shared_tile_atlas() {
+    static TileAtlas atlas;
+    return atlas;
+}
+
+TileSet read_tiles(rd_Memory const *mem, const char *system) {
+    TileAtlas atlas;
+    atlas.update(mem, system);
+    TileSet ts = atlas.tiles();
+    if (ts.banks == 0)
+        ts.banks = 1;
     return ts;
 }
 
@@ -17,6 +17,36 @@ struct TileSet {
     int banks;                     // 1 for GB, 2 for GBC
 };
 
+// Decode one 16-byte 2bpp tile.
+void decode_tile(const uint8_t *data, TileImage &tile);
+
+// Decoded tiles of every VRAM bank, kept between reads.  update() reads the
+// tile data in bulk and re-decodes only tiles whose 16 bytes changed.  Each
+// tile records the generation in which it last changed, so several viewers
+// can share one atlas and each redraw just what changed since it last looked.
+class TileAtlas {
+public:
+    // Re-read VRAM.  mem = the CPU-addressable "ram" region,
+    // system = "gb" or "gbc".  Returns the current generation.
+    uint32_t update(rd_Memory const *mem, const char *system);
+
+    const TileSet &tiles() const { return m_set; }
+    uint32_t generation() const { return m_generation; }
+    // Generation in which tile idx last changed
+    uint32_t changed_at(int idx) const { return m_changed[idx]; }
+    // The tile's 16 bytes as last read
+    const uint8_t *raw(int idx) const { return &m_raw[idx * 16]; }
+
+private:
+    TileSet               m_set{{}, 0};
+    std::vector<uint8_t>  m_raw;
+    std::vector<uint32_t> m_changed;
+    uint32_t              m_generation = 0;
+};
+
+// Atlas shared by the tile and tilemap viewers (UI thread only).
+TileAtlas &shared_tile_atlas();
+
 // Read all tiles from VRAM via retrodebug peek.
 // mem = the CPU-addressable "ram" region, system = "gb" or "gbc"
 TileSet read_tiles(rd_Memory const *mem, const char *system);
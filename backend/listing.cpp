@@ -0,0 +1,550 @@
+/*
+ * listing.cpp: Whole-region annotated disassembly export
+ *
+ * Sections: the region is covered by the CPU's memory-map windows that
+ * source it (every bank of banked windows, mirrors dropped), plus raw
+ * sections for bytes no window maps.  Fixed-width ISAs have large windows
+ * split into SECTION_MAX chunks so they spread over the workers.
+ * Workers touch neither the core nor the symbol store: this thread reads
+ * every section's bytes, copies the symbols and turns the memory maps into
+ * spans (runs of addresses backed by consecutive addresses of one region)
+ * before they start, so a running core and symbol edits from other threads
+ * cannot race them.  Labels therefore follow the mapping at export time.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cctype>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "listing.hpp"
+#include "analysis.hpp"
+#include "arch.hpp"
+#include "backend.hpp"
+#include "memreader.hpp"
+#include "registers.hpp"
+#include "symbols.hpp"
+
+static constexpr uint64_t SECTION_MAX = 64 * 1024;
+static constexpr int64_t  MAX_BANKS = 512;
+static constexpr uint64_t OPERAND_MAX_OFFSET = 0xFF;
+static constexpr size_t   WRITE_BUFFER = 1 << 20;
+static constexpr unsigned DB_PER_LINE = 8;
+static constexpr int      MAX_HOPS = 16;
+
+struct Section {
+    uint64_t addr;          /* CPU address of the first byte (or region
+                               address for unmapped sections) */
+    uint64_t size;
+    uint64_t src;           /* offset in the exported region */
+    int64_t  bank;
+    bool     mapped;
+};
+
+struct SymCopy {
+    uint64_t    addr;
+    std::string text;
+};
+
+struct Syms {
+    std::vector<SymCopy> labels;    /* sorted by addr */
+    std::vector<SymCopy> comments;  /* sorted by addr */
+};
+
+/* Region IDs to their copied symbols */
+using SymTable = std::unordered_map<std::string, Syms>;
+
+struct Span {
+    uint64_t    addr;               /* first address covered */
+    uint64_t    size;
+    const Syms *syms;               /* of the backing region */
+    uint64_t    target;             /* backing address of addr */
+};
+
+struct Job {
+    rd_Cpu const    *cpu;
+    rd_Memory const *region;
+    bool             asm_compatible;
+    int              addr_width;
+    int              bank_width;
+    std::vector<Span> spans;        /* region offsets, sorted by addr */
+    std::vector<Span> space_spans;  /* CPU addresses, sorted by addr */
+};
+
+/* ======================================================================== */
+/* Sections                                                                  */
+/* ======================================================================== */
+
+static std::vector<rd_MemoryMap> fetch_map(rd_Memory const *mem) {
+    std::vector<rd_MemoryMap> maps;
+    if (mem && mem->v1.get_memory_map_count && mem->v1.get_memory_map) {
+        unsigned count = mem->v1.get_memory_map_count(mem);
+        if (count > 0) {
+            maps.resize(count);
+            mem->v1.get_memory_map(mem, maps.data());
+        }
+    }
+    return maps;
+}
+
+/* The CPU whose address space is, or maps, the region */
+static rd_Cpu const *cpu_for_region(rd_Memory const *region) {
+    rd_System const *sys = ar_debug_system();
+    if (!sys) return nullptr;
+    for (unsigned i = 0; i < sys->v1.num_cpus; i++)
+        if (sys->v1.cpus[i]->v1.memory_region == region)
+            return sys->v1.cpus[i];
+    for (unsigned i = 0; i < sys->v1.num_cpus; i++)
+        for (auto &m : fetch_map(sys->v1.cpus[i]->v1.memory_region))
+            if (m.source == region)
+                return sys->v1.cpus[i];
+    return ar_debug_cpu();
+}
+
+static std::vector<Section> build_sections(rd_Cpu const *cpu,
+                                           rd_Memory const *region) {
+    rd_Memory const *space = cpu->v1.memory_region;
+    std::vector<Section> cand;
+
+    if (space == region) {
+        cand.push_back({ 0, region->v1.size, 0, -1, true });
+    } else {
+        /* Every bank of each window onto the region */
+        auto maps = fetch_map(space);
+        int pc_idx = ar_reg_pc(cpu->v1.type);
+        uint64_t pc = pc_idx >= 0 ? cpu->v1.get_register(cpu, (unsigned)pc_idx)
+                                  : UINT64_MAX;
+        std::vector<bool> has_pc;
+        for (auto &m : maps) {
+            if (m.source != region || m.size == 0) continue;
+            bool banked = false;
+            if (space->v1.get_bank_address && m.bank >= 0) {
+                std::unordered_set<uint64_t> seen;
+                for (int64_t b = 0; b < MAX_BANKS; b++) {
+                    rd_MemoryMap bm;
+                    if (!space->v1.get_bank_address(space, m.base_addr, b, &bm) ||
+                        bm.source != region)
+                        break;
+                    if (bm.source_base_addr + bm.size > region->v1.size) break;
+                    if (!seen.insert(bm.source_base_addr).second) continue;
+                    cand.push_back({ bm.base_addr, bm.size, bm.source_base_addr,
+                                     b, true });
+                    has_pc.push_back(false);
+                    banked = true;
+                }
+            }
+            if (!banked) {
+                cand.push_back({ m.base_addr, m.size, m.source_base_addr,
+                                 m.bank, true });
+                has_pc.push_back(pc >= m.base_addr && pc - m.base_addr < m.size);
+            }
+        }
+
+        /* Mirrors: prefer the window the CPU is executing from */
+        std::vector<size_t> order(cand.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            if (cand[a].src != cand[b].src) return cand[a].src < cand[b].src;
+            return has_pc[a] > has_pc[b];
+        });
+        std::vector<Section> kept;
+        uint64_t covered = 0;
+        for (size_t i : order) {
+            const Section &s = cand[i];
+            if (s.src < covered) continue;
+            if (s.src > covered)
+                kept.push_back({ covered, s.src - covered, covered, -1, false });
+            kept.push_back(s);
+            covered = s.src + s.size;
+        }
+        if (covered < region->v1.size)
+            kept.push_back({ covered, region->v1.size - covered, covered, -1, false });
+        cand.swap(kept);
+    }
+
+    /* Split long sections where instruction boundaries are predictable */
+    const arch::Arch *a = arch::arch_for_cpu(cpu->v1.type);
+    bool fixed = a && a->alignment > 1 && a->alignment == a->max_insn_size;
+    std::vector<Section> out;
+    for (auto &s : cand) {
+        if (!fixed || s.size <= SECTION_MAX) {
+            out.push_back(s);
+            continue;
+        }
+        for (uint64_t off = 0; off < s.size; off += SECTION_MAX)
+            out.push_back({ s.addr + off, std::min(SECTION_MAX, s.size - off),
+                            s.src + off, s.bank, s.mapped });
+    }
+    return out;
+}
+
+/* ======================================================================== */
+/* Symbols                                                                   */
+/* ======================================================================== */
+
+static SymTable copy_symbols() {
+    SymTable table;
+    ar_symbol_ref page[256];
+    for (unsigned start = 0;;) {
+        unsigned n = ar_sym_list(start, page, 256);
+        if (n == 0) break;
+        for (unsigned i = 0; i < n; i++) {
+            Syms &s = table[page[i].region_id];
+            if (page[i].label) s.labels.push_back({ page[i].address, page[i].label });
+            if (page[i].comment) s.comments.push_back({ page[i].address, page[i].comment });
+        }
+        start += n;
+    }
+    return table;
+}
+
+/* Memory maps with a source, sorted by base address, fetched once each */
+using MapCache = std::unordered_map<rd_Memory const *, std::vector<rd_MemoryMap>>;
+
+static const std::vector<rd_MemoryMap> &sorted_map(MapCache &cache,
+                                                   rd_Memory const *mem) {
+    auto it = cache.find(mem);
+    if (it != cache.end()) return it->second;
+    auto maps = fetch_map(mem);
+    std::erase_if(maps, [](const rd_MemoryMap &m) {
+        return !m.source || m.size == 0;
+    });
+    std::stable_sort(maps.begin(), maps.end(),
+        [](const rd_MemoryMap &a, const rd_MemoryMap &b) {
+            return a.base_addr < b.base_addr;
+        });
+    return cache.emplace(mem, std::move(maps)).first->second;
+}
+
+/* Append the spans of [addr, addr + size) in mem, keyed from key, following
+ * the maps to the deepest backing region as ar_sym_resolve does (the
+ * lowest window wins where windows overlap).  Runs backed by regions
+ * without symbols, or by a chain of maps that loops, are left out. */
+static void resolve_spans(MapCache &cache, const SymTable &syms,
+                          rd_Memory const *mem, uint64_t addr, uint64_t size,
+                          uint64_t key, int hops, std::vector<Span> &out) {
+    const auto &maps = sorted_map(cache, mem);
+    while (size > 0) {
+        const rd_MemoryMap *hit = nullptr;
+        uint64_t len = size;
+        for (auto &m : maps) {
+            if (m.base_addr > addr) {
+                len = std::min(len, m.base_addr - addr);
+                break;
+            }
+            if (addr - m.base_addr < m.size) {
+                hit = &m;
+                len = std::min(len, m.size - (addr - m.base_addr));
+                break;
+            }
+        }
+        if (hit) {
+            if (hops < MAX_HOPS)
+                resolve_spans(cache, syms, hit->source,
+                              hit->source_base_addr + (addr - hit->base_addr),
+                              len, key, hops + 1, out);
+        } else {
+            auto it = syms.find(mem->v1.id);
+            if (it != syms.end())
+                out.push_back({ key, len, &it->second, addr });
+        }
+        addr += len;
+        key += len;
+        size -= len;
+    }
+}
+
+/* ======================================================================== */
+/* Rendering (workers)                                                       */
+/* ======================================================================== */
+
+static const Span *find_span(const std::vector<Span> &spans, uint64_t addr) {
+    auto it = std::upper_bound(spans.begin(), spans.end(), addr,
+        [](uint64_t a, const Span &s) { return a < s.addr; });
+    if (it == spans.begin()) return nullptr;
+    --it;
+    return addr - it->addr < it->size ? &*it : nullptr;
+}
+
+static const char *find_sym(const std::vector<Span> &spans, uint64_t addr,
+                            std::vector<SymCopy> Syms::*field) {
+    const Span *sp = find_span(spans, addr);
+    if (!sp) return nullptr;
+    const std::vector<SymCopy> &v = sp->syms->*field;
+    uint64_t target = sp->target + (addr - sp->addr);
+    auto it = std::lower_bound(v.begin(), v.end(), target,
+        [](const SymCopy &s, uint64_t a) { return s.addr < a; });
+    return (it != v.end() && it->addr == target) ? it->text.c_str() : nullptr;
+}
+
+static const char *label_at(const Job &job, uint64_t src) {
+    return find_sym(job.spans, src, &Syms::labels);
+}
+
+static const char *comment_at(const Job &job, uint64_t src) {
+    return find_sym(job.spans, src, &Syms::comments);
+}
+
+/* Nearest label at most OPERAND_MAX_OFFSET below addr, as ar_sym_symbolize */
+static void symbolize(const std::vector<Span> &spans, uint64_t addr,
+                      char *out, size_t out_size) {
+    const Span *sp = find_span(spans, addr);
+    if (!sp) return;
+    const std::vector<SymCopy> &v = sp->syms->labels;
+    uint64_t target = sp->target + (addr - sp->addr);
+    auto it = std::upper_bound(v.begin(), v.end(), target,
+        [](uint64_t a, const SymCopy &l) { return a < l.addr; });
+    if (it == v.begin() || target - (--it)->addr > OPERAND_MAX_OFFSET) return;
+    if (target == it->addr)
+        snprintf(out, out_size, "%s", it->text.c_str());
+    else
+        snprintf(out, out_size, "%s+0x%" PRIX64, it->text.c_str(),
+                 target - it->addr);
+}
+
+static void append_f(std::string &out, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void append_f(std::string &out, const char *fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) out.append(buf, std::min<size_t>((size_t)n, sizeof(buf) - 1));
+}
+
+/* '@'-marked operands: addresses inside the section resolve in the same
+ * bank, others through the mapping at export time */
+static void append_operands(std::string &out, const Job &job, const Section &s,
+                            const char *text) {
+    const char *p = text;
+    while (*p) {
+        if (*p != '@') { out += *p++; continue; }
+        const char *h = p + 1;
+        while (isxdigit((unsigned char)*h)) h++;
+        if (h == p + 1) { p++; continue; }
+        uint64_t addr = strtoull(p + 1, nullptr, 16);
+
+        char label[160];
+        label[0] = '\0';
+        if (s.mapped && addr >= s.addr && addr - s.addr < s.size)
+            symbolize(job.spans, s.src + (addr - s.addr), label, sizeof(label));
+        else if (s.mapped)
+            symbolize(job.space_spans, addr, label, sizeof(label));
+
+        if (label[0]) {
+            if (!out.empty() && out.back() == '$') out.pop_back();
+            out += label;
+        } else {
+            out.append(p + 1, (size_t)(h - p - 1));
+        }
+        p = h;
+    }
+}
+
+static void append_hex(std::string &out, uint64_t v, int digits) {
+    static const char hex[] = "0123456789ABCDEF";
+    char buf[16];
+    for (int i = digits - 1; i >= 0; i--, v >>= 4)
+        buf[i] = hex[v & 0xF];
+    out.append(buf, (size_t)digits);
+}
+
+/* Called once per line: formatted by hand, snprintf dominates otherwise */
+static void append_prefix(std::string &out, const Job &job,
+                          const std::string &bank_col, uint64_t addr,
+                          const uint8_t *bytes, unsigned len) {
+    if (job.asm_compatible) {
+        out += "    ";
+        return;
+    }
+    out += bank_col;
+    append_hex(out, addr, job.addr_width);
+    out += "  ";
+    unsigned shown = std::min(len, 4u);
+    for (unsigned i = 0; i < 4; i++) {
+        if (i < shown) append_hex(out, bytes[i], 2);
+        else out += "  ";
+        out += ' ';
+    }
+    out += ' ';
+}
+
+static void append_comment(std::string &out, const Job &job, uint64_t src) {
+    const char *c = comment_at(job, src);
+    if (!c) return;
+    const char *nl = strchr(c, '\n');
+    out += "  ; ";
+    out.append(c, nl ? (size_t)(nl - c) : strlen(c));
+}
+
+static bool is_db(const arch::Instruction &insn) {
+    return insn.length == 1 && insn.text.compare(0, 4, "DB $") == 0;
+}
+
+static std::string render(const Job &job, const Section &s,
+                          const std::vector<uint8_t> &bytes) {
+    rd_Memory const *r = job.region;
+
+    std::span<const uint8_t> data(bytes.data(), bytes.size());
+    auto insns = s.mapped
+        ? ar_analysis_disassemble_bank(job.cpu, data, s.addr, s.bank, true)
+        : arch::disassemble(data, s.addr, job.cpu->v1.type);
+
+    std::string bank_col;
+    if (job.bank_width > 0) {
+        if (s.bank >= 0) append_f(bank_col, "%*" PRId64 ":", job.bank_width, s.bank);
+        else bank_col.assign((size_t)job.bank_width + 1, ' ');
+    }
+
+    std::string out;
+    out.reserve(s.size * 24);
+    if (s.bank >= 0)
+        append_f(out, "\n; ==== %s $%" PRIX64 "-$%" PRIX64 ", bank %" PRId64
+                      " at $%" PRIX64 " ====\n",
+                 r->v1.id, s.src, s.src + s.size - 1, s.bank, s.addr);
+    else
+        append_f(out, "\n; ==== %s $%" PRIX64 "-$%" PRIX64 " ====\n",
+                 r->v1.id, s.src, s.src + s.size - 1);
+
+    for (size_t i = 0; i < insns.size(); i++) {
+        const auto &insn = insns[i];
+        uint64_t off = insn.address - s.addr;
+        if (off >= s.size) break;
+        uint64_t src = s.src + off;
+
+        if (const char *l = label_at(job, src))
+            append_f(out, "%s:\n", l);
+
+        /* Runs of data bytes up to the next label or comment */
+        if (is_db(insn)) {
+            unsigned n = 1;
+            while (n < DB_PER_LINE && i + n < insns.size() && is_db(insns[i + n]) &&
+                   insns[i + n].address == insn.address + n &&
+                   off + n < s.size &&
+                   !label_at(job, src + n) && !comment_at(job, src + n))
+                n++;
+            append_prefix(out, job, bank_col, insn.address, &bytes[off], n);
+            out += "DB ";
+            for (unsigned k = 0; k < n; k++) {
+                out += k ? ",$" : "$";
+                append_hex(out, bytes[off + k], 2);
+            }
+            append_comment(out, job, src);
+            out += '\n';
+            i += n - 1;
+            continue;
+        }
+
+        unsigned len = insn.length ? insn.length : 1;
+        if (off + len > s.size) len = (unsigned)(s.size - off);
+        append_prefix(out, job, bank_col, insn.address, &bytes[off], len);
+        append_operands(out, job, s, insn.text.c_str());
+        append_comment(out, job, src);
+        out += '\n';
+    }
+    return out;
+}
+
+/* ======================================================================== */
+/* Public API                                                                */
+/* ======================================================================== */
+
+bool ar_export_listing(const char *region_id, const char *path,
+                       bool asm_compatible, ar_listing_stats *stats) {
+    if (!ar_has_debug() || !region_id || !path) return false;
+    rd_Memory const *region = ar_find_memory_by_id(region_id);
+    if (!region || region->v1.size == 0) return false;
+    rd_Cpu const *cpu = cpu_for_region(region);
+    if (!cpu) return false;
+
+    Job job{ cpu, region, asm_compatible,
+             cpu->v1.memory_region->v1.size <= 0x10000 ? 4 : 8, 0, {}, {} };
+
+    auto sections = build_sections(cpu, region);
+    int64_t max_bank = -1;
+    for (auto &s : sections) max_bank = std::max(max_bank, s.bank);
+    if (max_bank >= 0) {
+        job.bank_width = 1;
+        for (int64_t v = max_bank; v >= 10; v /= 10) job.bank_width++;
+    }
+
+    /* Everything the workers read comes from this thread, up front */
+    SymTable syms = copy_symbols();
+    MapCache maps;
+    rd_Memory const *space = cpu->v1.memory_region;
+    resolve_spans(maps, syms, region, 0, region->v1.size, 0, 0, job.spans);
+    resolve_spans(maps, syms, space, 0, space->v1.size, 0, 0, job.space_spans);
+
+    std::vector<std::vector<uint8_t>> data(sections.size());
+    for (size_t i = 0; i < sections.size(); i++) {
+        data[i].resize(sections[i].size);
+        ar_mem_read(region, sections[i].src, sections[i].size, data[i].data());
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    std::vector<char> wbuf(WRITE_BUFFER);
+    setvbuf(f, wbuf.data(), _IOFBF, wbuf.size());
+
+    fprintf(f, "; %s listing of %s (%" PRIu64 " bytes)\n",
+            cpu->v1.id, region->v1.id, (uint64_t)region->v1.size);
+
+    /* Workers render sections in any order; this thread writes them in
+     * order as they complete, releasing each buffer once written */
+    std::vector<std::string> done_text(sections.size());
+    std::vector<char> done(sections.size(), 0);
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<size_t> next{0};
+
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    unsigned nthreads = (unsigned)std::min<size_t>(hw, sections.size());
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < nthreads; t++)
+        workers.emplace_back([&] {
+            for (size_t i; (i = next.fetch_add(1)) < sections.size(); ) {
+                std::string text = render(job, sections[i], data[i]);
+                std::vector<uint8_t>().swap(data[i]);
+                std::lock_guard lock(mutex);
+                done_text[i] = std::move(text);
+                done[i] = 1;
+                cv.notify_all();
+            }
+        });
+
+    uint64_t lines = 1;
+    for (size_t i = 0; i < sections.size(); i++) {
+        std::string text;
+        {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&] { return done[i] != 0; });
+            text.swap(done_text[i]);
+        }
+        fwrite(text.data(), 1, text.size(), f);
+        lines += (uint64_t)std::count(text.begin(), text.end(), '\n');
+    }
+    for (auto &w : workers) w.join();
+
+    bool ok = fflush(f) == 0 && !ferror(f);
+    fclose(f);
+
+    if (stats) {
+        stats->bytes = region->v1.size;
+        stats->lines = lines;
+        stats->sections = (unsigned)sections.size();
+        stats->threads = nthreads;
+    }
+    return ok;
+}
@@ -0,0 +1,40 @@
+/*
+ * listing.h: Whole-region annotated disassembly export
+ *
+ * Writes a listing of every byte of a memory region as seen by the CPU
+ * that maps it: one section per bank (or memory-map window), with labels,
+ * comments, and '@'-marked operands resolved within the same bank.  Where
+ * background analysis has reached a window, only known code is decoded and
+ * the rest is emitted as DB rows.  Sections are rendered on worker threads
+ * and written in address order.
+ */
+
+#ifndef AR_LISTING_H
+#define AR_LISTING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ar_listing_stats {
+    uint64_t bytes;         /* region bytes covered */
+    uint64_t lines;         /* lines written */
+    unsigned sections;      /* banks / windows */
+    unsigned threads;
+} ar_listing_stats;
+
+/* Export region_id to path.  With asm_compatible the address and byte
+ * columns are omitted, leaving label definitions, instructions, DB rows
+ * and ';' comments that an assembler for the CPU can read back.
+ * Returns false if the region is unknown or the file cannot be written. */
+bool ar_export_listing(const char *region_id, const char *path,
+                       bool asm_compatible, ar_listing_stats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AR_LISTING_H */
@@ -0,0 +1,129 @@
+/*
+ * memreader.cpp: Bulk and cached reads of emulated memory
+ *
+ * The page cache is fully associative with LRU replacement; with 16
+ * slots a linear scan is cheaper than any index.  The first page lookup
+ * in a new regions generation asks the dirty-page tracker which cached
+ * pages changed and retags the others.  Without peek_range a page fill
+ * would cost 4096 peeks, more than most callers save, so such regions are
+ * read uncached.  Pages only hold the part of their 4 KB that lies inside
+ * the region, so reads never reach past its end; bytes outside it are
+ * read uncached as before.
+ */
+
+#include <string.h>
+
+#include "memreader.hpp"
+
+static constexpr uint64_t READ_CHUNK = 64 * 1024;
+
+void ar_mem_read_span(rd_Memory const *mem, uint64_t addr, uint64_t size,
+                      uint8_t *out) {
+    auto peek = mem->v1.peek;
+    auto peek_range = mem->v1.peek_range;
+    while (size > 0) {
+        uint64_t n = size < READ_CHUNK ? size : READ_CHUNK;
+        if (!peek_range || !peek_range(mem, addr, n, out))
+            for (uint64_t i = 0; i < n; i++)
+                out[i] = peek(mem, addr + i, false);
+        addr += n;
+        out += n;
+        size -= n;
+    }
+}
+
+/* ======================================================================== */
+/* MemReader                                                                 */
+/* ======================================================================== */
+
+void MemReader::set_memory(rd_Memory const *mem) {
+    if (mem == m_mem) return;
+    m_mem = mem;
+    m_dirty.set_memory(mem);
+    clear();
+}
+
+void MemReader::clear() {
+    if (!m_pages) return;
+    for (unsigned i = 0; i < NUM_PAGES; i++)
+        m_pages[i].index = UINT64_MAX;
+}
+
+void MemReader::revalidate(uint64_t generation) {
+    uint64_t previous = m_generation;
+    m_generation = generation;
+    if (!m_dirty.update()) return;
+    for (unsigned i = 0; i < NUM_PAGES; i++) {
+        Page &p = m_pages[i];
+        if (p.index == UINT64_MAX || p.generation != previous) continue;
+        if (p.hi > p.lo && m_dirty.changed(p.lo, p.hi - p.lo)) {
+            p.index = UINT64_MAX;
+            p.stamp = 0;
+        } else
+            p.generation = generation;
+    }
+}
+
+const MemReader::Page *MemReader::page(uint64_t index) {
+    uint64_t generation = ar_regions_generation();
+    if (!m_pages) m_pages.reset(new Page[NUM_PAGES]);
+    if (generation != m_generation) revalidate(generation);
+
+    Page *p = &m_pages[m_last];
+    if (p->index != index || p->generation != generation) {
+        unsigned slot = 0;
+        for (unsigned i = 0; i < NUM_PAGES; i++) {
+            Page &c = m_pages[i];
+            if (c.index == index && c.generation == generation) {
+                slot = i;
+                break;
+            }
+            if (c.stamp < m_pages[slot].stamp) slot = i;
+        }
+        m_last = slot;
+        p = &m_pages[slot];
+
+        if (p->index != index || p->generation != generation) {
+            uint64_t start = index << PAGE_SHIFT;
+            uint64_t lo = start, hi = start + PAGE_SIZE;
+            if (m_mem->v1.size > 0) {
+                uint64_t base = m_mem->v1.base_address;
+                uint64_t end = base + m_mem->v1.size;
+                if (lo < base) lo = base;
+                if (hi > end) hi = end;
+                if (hi < lo) hi = lo;
+            }
+            p->index = index;
+            p->generation = generation;
+            p->lo = lo;
+            p->hi = hi;
+            if (hi > lo)
+                ar_mem_read(m_mem, lo, hi - lo, p->data + (lo - start));
+        }
+    }
+    p->stamp = ++m_clock;
+    return p;
+}
+
+void MemReader::read_cached(uint64_t addr, uint64_t size, uint8_t *out) {
+    if (size >= NUM_PAGES * PAGE_SIZE / 2) {
+        ar_mem_read(m_mem, addr, size, out);
+        return;
+    }
+    while (size > 0) {
+        uint64_t off = addr & (PAGE_SIZE - 1);
+        uint64_t n = PAGE_SIZE - off;
+        if (n > size) n = size;
+
+        const Page *p = page(addr >> PAGE_SHIFT);
+        if (addr >= p->lo && addr + n <= p->hi)
+            memcpy(out, p->data + off, (size_t)n);
+        else
+            ar_mem_read(m_mem, addr, n, out);
+
+        addr += n;
+        out += n;
+        size -= n;
+    }
+}
+
@@ -0,0 +1,151 @@
+/*
+ * memreader.h: Bulk and cached reads of emulated memory
+ *
+ * ar_mem_read() copies a span with peek_range, in chunks so that a
+ * stretch the core refuses costs per-byte peeks for that chunk only, and
+ * with peek when the core has no peek_range; short peeked reads are done
+ * inline.  The debugger interface
+ * exposes no host pointers to core memory, so this is the fast path.
+ *
+ * MemReader adds a small cache of 4 KB pages for callers that read the
+ * same memory piecemeal (search filters, hex viewer, disassembly bytes),
+ * for regions with peek_range.
+ * Cached pages are valid until ar_regions_invalidate(): the end of a
+ * frame, a debug pause, a poke, a state load or reset.  If the core
+ * reports dirty pages (dirty.h), only the pages it reports are dropped
+ * then; the rest stay cached across frames.  Code running on
+ * the core thread sees memory change within a frame and reads through
+ * ar_mem_read() instead.  A MemReader is not thread-safe; each consumer
+ * owns its own.
+ */
+
+#ifndef AR_MEMREADER_H
+#define AR_MEMREADER_H
+
+#include <stdint.h>
+
+#include "retrodebug.h"
+#include "dirty.hpp"
+#include "regions.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Reads of at most this many bytes from cores without peek_range are
+ * peeked inline (instruction fetch, disassembly bytes) */
+#define AR_MEM_READ_INLINE 16
+
+/* ar_mem_read() past the inline case */
+void ar_mem_read_span(rd_Memory const *mem, uint64_t addr, uint64_t size,
+                      uint8_t *out);
+
+/* Copy size bytes from addr to out, without side effects */
+static inline void ar_mem_read(rd_Memory const *mem, uint64_t addr,
+                               uint64_t size, uint8_t *out) {
+    if (size <= AR_MEM_READ_INLINE && !mem->v1.peek_range) {
+        uint8_t (*peek)(struct rd_Memory const *, uint64_t, bool) = mem->v1.peek;
+        for (uint64_t i = 0; i < size; i++)
+            out[i] = peek(mem, addr + i, false);
+        return;
+    }
+    ar_mem_read_span(mem, addr, size, out);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+#include <memory>
+#include <string.h>
+
+class MemReader {
+public:
+    static constexpr unsigned PAGE_SHIFT = 12;
+    static constexpr uint64_t PAGE_SIZE  = 1ull << PAGE_SHIFT;
+    static constexpr unsigned NUM_PAGES  = 16;
+
+    MemReader() = default;
+    explicit MemReader(rd_Memory const *mem) { set_memory(mem); }
+
+    /* Switch regions; drops the cache if mem differs */
+    void set_memory(rd_Memory const *mem);
+    rd_Memory const *memory() const { return m_mem; }
+
+    /* Copy size bytes from addr to out.  Spans of half the cache or more
+     * bypass it. */
+    void read(uint64_t addr, uint64_t size, uint8_t *out) {
+        if (!m_mem->v1.peek_range)
+            ar_mem_read(m_mem, addr, size, out);
+        else
+            read_cached(addr, size, out);
+    }
+
+    uint8_t read8(uint64_t addr) {
+        if (const Page *p = hit(addr, 1))
+            return p->data[addr & (PAGE_SIZE - 1)];
+        if (!m_mem->v1.peek_range)
+            return m_mem->v1.peek(m_mem, addr, false);
+        uint8_t b;
+        read_cached(addr, 1, &b);
+        return b;
+    }
+
+    /* Little-endian value of size (1..8) bytes at addr */
+    uint64_t read_le(uint64_t addr, unsigned size) {
+        uint8_t b[8];
+        if (size > 8) size = 8;
+        if (const Page *p = hit(addr, size))
+            memcpy(b, p->data + (addr & (PAGE_SIZE - 1)), size);
+        else if (!m_mem->v1.peek_range)
+            for (unsigned i = 0; i < size; i++)
+                b[i] = m_mem->v1.peek(m_mem, addr + i, false);
+        else
+            read_cached(addr, size, b);
+        uint64_t v = 0;
+        for (unsigned i = 0; i < size; i++)
+            v |= (uint64_t)b[i] << (i * 8);
+        return v;
+    }
+
+    /* Forget every cached page */
+    void clear();
+
+private:
+    struct Page {
+        uint64_t index = UINT64_MAX;   /* addr >> PAGE_SHIFT */
+        uint64_t generation = 0;
+        uint64_t stamp = 0;            /* last use */
+        uint64_t lo = 0, hi = 0;       /* in-region part [lo, hi) */
+        uint8_t  data[PAGE_SIZE];
+    };
+
+    /* The most recently used page, if it holds [addr, addr + size) */
+    const Page *hit(uint64_t addr, uint64_t size) const {
+        if (!m_pages) return nullptr;
+        const Page *p = &m_pages[m_last];
+        if (p->index != addr >> PAGE_SHIFT || addr < p->lo || addr + size > p->hi ||
+            p->generation != ar_regions_generation())
+            return nullptr;
+        return p;
+    }
+
+    const Page *page(uint64_t index);
+    void read_cached(uint64_t addr, uint64_t size, uint8_t *out);
+
+    /* Carry clean pages over to a new generation */
+    void revalidate(uint64_t generation);
+
+    rd_Memory const *m_mem = nullptr;
+    DirtyPages m_dirty;                /* without hashing */
+    uint64_t m_generation = 0;         /* of the last revalidate() */
+    std::unique_ptr<Page[]> m_pages;   /* allocated on first use */
+    uint64_t m_clock = 0;
+    unsigned m_last = 0;               /* most recently used slot, whose
+                                          stamp is the highest */
+};
+
+#endif
+
+#endif /* AR_MEMREADER_H */
@@ -0,0 +1,186 @@
+/*
+ * regions.cpp: Memory region registry and memory-map cache
+ *
+ * Registry: vector of regions indexed by handle, plus a hash from the
+ * core-owned ID string to the handle.  Map cache: per region, the map
+ * entries that have a source, sorted by base address and tagged with the
+ * generation they were read in.  A stale table is refilled in place on
+ * the next lookup, reusing its storage.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "regions.hpp"
+
+struct MapCache {
+    uint64_t generation = 0;        /* 0: never filled */
+    bool     disjoint = true;       /* entries do not overlap */
+    std::vector<rd_MemoryMap> maps; /* sourced entries, by base_addr */
+};
+
+struct Region {
+    rd_Memory const *mem;
+    MapCache         cache;
+};
+
+static std::mutex                                g_mutex;
+static std::vector<Region>                       g_regions;
+static std::unordered_map<std::string_view, int> g_by_id;
+static std::atomic<uint64_t>                     g_generation{1};
+
+/* ======================================================================== */
+/* Registry                                                                  */
+/* ======================================================================== */
+
+static int add_locked(rd_Memory const *mem) {
+    if (!mem || !mem->v1.id) return -1;
+    auto it = g_by_id.find(mem->v1.id);
+    if (it != g_by_id.end()) return it->second;
+    int handle = (int)g_regions.size();
+    g_regions.push_back({ mem, {} });
+    g_by_id.emplace(mem->v1.id, handle);
+    return handle;
+}
+
+void ar_regions_build(rd_System const *sys) {
+    std::lock_guard lock(g_mutex);
+    g_regions.clear();
+    g_by_id.clear();
+    g_generation++;
+    if (!sys) return;
+
+    for (unsigned i = 0; i < sys->v1.num_cpus; i++)
+        add_locked(sys->v1.cpus[i]->v1.memory_region);
+    for (unsigned i = 0; i < sys->v1.num_memory_regions; i++)
+        add_locked(sys->v1.memory_regions[i]);
+
+    /* Sources of memory maps, transitively */
+    std::vector<rd_MemoryMap> maps;
+    for (size_t i = 0; i < g_regions.size(); i++) {
+        rd_Memory const *mem = g_regions[i].mem;
+        if (!mem->v1.get_memory_map_count || !mem->v1.get_memory_map) continue;
+        unsigned count = mem->v1.get_memory_map_count(mem);
+        if (count == 0) continue;
+        maps.resize(count);
+        mem->v1.get_memory_map(mem, maps.data());
+        for (auto &m : maps)
+            add_locked(m.source);
+    }
+}
+
+void ar_regions_clear(void) {
+    std::lock_guard lock(g_mutex);
+    g_regions.clear();
+    g_by_id.clear();
+    g_generation++;
+}
+
+int ar_region_handle(const char *id) {
+    if (!id) return -1;
+    std::lock_guard lock(g_mutex);
+    auto it = g_by_id.find(id);
+    return it != g_by_id.end() ? it->second : -1;
+}
+
+rd_Memory const *ar_region_memory(int handle) {
+    std::lock_guard lock(g_mutex);
+    if (handle < 0 || (size_t)handle >= g_regions.size()) return NULL;
+    return g_regions[handle].mem;
+}
+
+int ar_region_add(rd_Memory const *mem) {
+    std::lock_guard lock(g_mutex);
+    return add_locked(mem);
+}
+
+/* ======================================================================== */
+/* Map cache                                                                 */
+/* ======================================================================== */
+
+void ar_regions_invalidate(void) {
+    g_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t ar_regions_generation(void) {
+    return g_generation.load(std::memory_order_relaxed);
+}
+
+static void refill(Region &r, uint64_t generation) {
+    MapCache &c = r.cache;
+    rd_Memory const *mem = r.mem;
+    c.generation = generation;
+    c.disjoint = true;
+    c.maps.clear();
+    if (!mem->v1.get_memory_map_count || !mem->v1.get_memory_map) return;
+
+    unsigned count = mem->v1.get_memory_map_count(mem);
+    if (count == 0) return;
+    c.maps.resize(count);
+    mem->v1.get_memory_map(mem, c.maps.data());
+    std::erase_if(c.maps, [](const rd_MemoryMap &m) {
+        return !m.source || m.size == 0;
+    });
+    std::sort(c.maps.begin(), c.maps.end(),
+        [](const rd_MemoryMap &a, const rd_MemoryMap &b) {
+            return a.base_addr < b.base_addr;
+        });
+    for (size_t i = 1; i < c.maps.size(); i++)
+        if (c.maps[i].base_addr - c.maps[i - 1].base_addr < c.maps[i - 1].size)
+            c.disjoint = false;
+}
+
+static const rd_MemoryMap *find_locked(int handle, uint64_t addr) {
+    Region &r = g_regions[handle];
+    uint64_t generation = g_generation.load(std::memory_order_relaxed);
+    if (r.cache.generation != generation) refill(r, generation);
+
+    auto &maps = r.cache.maps;
+    if (!r.cache.disjoint) {
+        for (auto &m : maps)
+            if (addr >= m.base_addr && addr - m.base_addr < m.size)
+                return &m;
+        return nullptr;
+    }
+    auto it = std::upper_bound(maps.begin(), maps.end(), addr,
+        [](uint64_t a, const rd_MemoryMap &m) { return a < m.base_addr; });
+    if (it == maps.begin()) return nullptr;
+    --it;
+    return addr - it->base_addr < it->size ? &*it : nullptr;
+}
+
+bool ar_region_map_find(int handle, uint64_t addr, rd_MemoryMap *out) {
+    std::lock_guard lock(g_mutex);
+    if (handle < 0 || (size_t)handle >= g_regions.size()) return false;
+    const rd_MemoryMap *m = find_locked(handle, addr);
+    if (!m) return false;
+    if (out) *out = *m;
+    return true;
+}
+
+bool ar_region_resolve(int handle, uint64_t addr,
+                       int *out_handle, uint64_t *out_addr) {
+    std::lock_guard lock(g_mutex);
+    if (handle < 0 || (size_t)handle >= g_regions.size()) return false;
+
+    /* A chain with more hops than there are regions revisits one */
+    size_t hops = 0;
+    for (;;) {
+        const rd_MemoryMap *m = find_locked(handle, addr);
+        if (!m) break;
+        if (++hops > g_regions.size()) return false;  /* cycle */
+        uint64_t next_addr = m->source_base_addr + (addr - m->base_addr);
+        int next = add_locked(m->source);
+        if (next < 0) break;
+        handle = next;
+        addr = next_addr;
+    }
+
+    if (out_handle) *out_handle = handle;
+    if (out_addr) *out_addr = addr;
+    return true;
+}
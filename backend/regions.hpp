@@ -0,0 +1,64 @@
+/*
+ * regions.h: Memory region registry and memory-map cache
+ *
+ * Every region reachable from the debugger system (CPU regions, system
+ * regions and memory-map sources) is registered once with a stable
+ * integer handle, looked up by ID through a hash table.  Each region's
+ * memory map is cached as an interval table sorted by base address and
+ * refilled lazily after ar_regions_invalidate(), which the backend calls
+ * at the end of every frame, whenever the core pauses at a debug event,
+ * after pokes that may switch banks, and after state loads and resets.  Address resolution is then a
+ * binary search per hop with no allocation.
+ */
+
+#ifndef AR_REGIONS_H
+#define AR_REGIONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "retrodebug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Register every region of sys (debug_init / content load) */
+void ar_regions_build(rd_System const *sys);
+
+/* Drop the registry (core unload / shutdown) */
+void ar_regions_clear(void);
+
+/* Handle of the region with the given ID, -1 if unknown.  Handles stay
+ * valid until the next ar_regions_build / ar_regions_clear. */
+int ar_region_handle(const char *id);
+
+/* Region registered under handle, NULL if out of range */
+rd_Memory const *ar_region_memory(int handle);
+
+/* Register a region found after the build (e.g. a bank source that was
+ * not mapped at the time).  Returns its handle. */
+int ar_region_add(rd_Memory const *mem);
+
+/* Mark every cached memory map stale (frame end, pause, poke, state
+ * load, reset) */
+void ar_regions_invalidate(void);
+
+/* Counter bumped by ar_regions_invalidate(), for other caches of memory
+ * contents to tag their entries with */
+uint64_t ar_regions_generation(void);
+
+/* Memory map entry with a source that covers addr in the given region.
+ * Returns false if the region has no map or addr is not backed. */
+bool ar_region_map_find(int handle, uint64_t addr, rd_MemoryMap *out);
+
+/* Follow memory maps from (handle, addr) to the deepest backing region.
+ * Returns false on a cycle or an unknown handle. */
+bool ar_region_resolve(int handle, uint64_t addr,
+                       int *out_handle, uint64_t *out_addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AR_REGIONS_H */
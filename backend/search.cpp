@@ -3,7 +3,9 @@
  *
  * Maintains a bitfield of candidate addresses within a memory region.
  * Successive filter operations narrow the set by comparing current values
- * against a target or against previously snapshotted values.
+ * against a target or against previously snapshotted values.  Slots on
+ * pages that did not change since the last snapshot still hold their
+ * snapshotted value and are not read again.
  */
 
 #include <stdlib.h>
@@ -11,12 +13,16 @@
 #include <stdint.h>
 
 #include "backend.hpp"
+#include "dirty.hpp"
+#include "memreader.hpp"
 
 /* ========================================================================
  * State
  * ======================================================================== */
 
 static rd_Memory const *s_mem;
+static MemReader s_reader;
+static DirtyPages s_dirty(true);   /* pages changed since the snapshot */
 static int       s_data_size;   /* 1, 2, or 4 */
 static int       s_alignment;   /* 1, 2, or 4 */
 static uint64_t  s_base_addr;
@@ -26,6 +32,10 @@ static uint8_t  *s_candidates;  /* bitfield, 1 bit per slot */
 static uint64_t *s_prev;        /* previous value per slot */
 static uint64_t  s_count;
 
+/* Filters hash unchanged pages while at least 1/HASH_MIN_FRACTION of the
+ * slots are candidates (cores without dirty-page reports) */
+static constexpr uint64_t HASH_MIN_FRACTION = 4;
+
 /* ========================================================================
  * Helpers
  * ======================================================================== */
@@ -37,10 +47,7 @@ static inline bool bit_test(const uint8_t *bf, uint64_t i) {
 }
 
 static uint64_t read_value(uint64_t addr, int size) {
-    uint64_t v = 0;
-    for (int i = 0; i < size; i++)
-        v |= (uint64_t)s_mem->v1.peek(s_mem, addr + (uint64_t)i, false) << (i * 8);
-    return v;
+    return s_reader.read_le(addr, (unsigned)size);
 }
 
 static inline uint64_t slot_to_addr(uint64_t slot) {
@@ -62,6 +69,8 @@ bool ar_search_reset(const char *region_id, int data_size, int alignment) {
     if (alignment < data_size) alignment = data_size;
 
     s_mem         = mem;
+    s_reader.set_memory(mem);
+    s_dirty.set_memory(mem);
     s_data_size   = data_size;
     s_alignment   = alignment;
     s_base_addr   = mem->v1.base_address;
@@ -87,6 +96,7 @@ bool ar_search_reset(const char *region_id, int data_size, int alignment) {
     s_prev = (uint64_t *)malloc((size_t)(s_num_slots * sizeof(uint64_t)));
     if (!s_prev) { ar_search_free(); return false; }
 
+    s_dirty.update();
     for (uint64_t i = 0; i < s_num_slots; i++)
         s_prev[i] = read_value(slot_to_addr(i), s_data_size);
 
@@ -99,6 +109,11 @@ uint64_t ar_search_filter(ar_search_op op, uint64_t value) {
 
     uint64_t bf_bytes = (s_num_slots + 7) / 8;
 
+    /* Hashing reads the whole region; once few candidates are left,
+     * reading them is cheaper */
+    s_dirty.set_hash(s_count >= s_num_slots / HASH_MIN_FRACTION);
+    s_dirty.update();
+
     for (uint64_t byte_i = 0; byte_i < bf_bytes; byte_i++) {
         uint8_t bits = s_candidates[byte_i];
         if (bits == 0) continue;
@@ -109,7 +124,9 @@ uint64_t ar_search_filter(ar_search_op op, uint64_t value) {
             uint64_t slot = byte_i * 8 + (uint64_t)bit;
             if (slot >= s_num_slots) break;
 
-            uint64_t cur = read_value(slot_to_addr(slot), s_data_size);
+            uint64_t addr = slot_to_addr(slot);
+            uint64_t cur = s_dirty.changed(addr, (uint64_t)s_data_size)
+                         ? read_value(addr, s_data_size) : s_prev[slot];
             uint64_t cmp = (value == AR_SEARCH_VS_PREV) ? s_prev[slot] : value;
             bool keep = false;
 
@@ -125,25 +142,12 @@ uint64_t ar_search_filter(ar_search_op op, uint64_t value) {
             if (!keep) {
                 bit_clear(s_candidates, slot);
                 s_count--;
+            } else {
+                s_prev[slot] = cur;     /* snapshot for the next filter */
             }
         }
     }
 
-    /* Update prev for surviving candidates */
-    for (uint64_t byte_i = 0; byte_i < bf_bytes; byte_i++) {
-        uint8_t bits = s_candidates[byte_i];
-        if (bits == 0) continue;
-
-        for (int bit = 0; bit < 8; bit++) {
-            if (!(bits & (1u << bit))) continue;
-
-            uint64_t slot = byte_i * 8 + (uint64_t)bit;
-            if (slot >= s_num_slots) break;
-
-            s_prev[slot] = read_value(slot_to_addr(slot), s_data_size);
-        }
-    }
-
     return s_count;
 }
 
@@ -188,6 +192,8 @@ void ar_search_free(void) {
     free(s_prev);
     s_prev = nullptr;
     s_mem = nullptr;
+    s_reader.set_memory(nullptr);
+    s_dirty.set_memory(nullptr);
     s_data_size = 0;
     s_alignment = 0;
     s_base_addr = 0;
@@ -1,30 +1,73 @@
 /*
  * symbols.cpp: Label and comment annotation storage
  *
- * Storage: std::map<(region_id, addr), SymEntry>
- * Persistence: JSON array in <rombase>.sym.json
- * Resolution: walks memory maps to deepest backing region
+ * Storage: per interned region ID, a flat vector of entries sorted by
+ *          address (O(log n) exact and floor lookups)
+ * Persistence: JSON snapshot in <rombase>.sym.json plus an append-only
+ *              journal of edits in <rombase>.sym.journal, compacted into
+ *              the snapshot every COMPACT_EDITS edits and after replay
+ * Resolution: walks cached memory maps (regions.hpp) to deepest backing region
+ * Name index: labels sorted by lowercase name plus a trigram index, rebuilt
+ *             lazily on the first ar_sym_find after an edit
+ * Symbolization: label+offset strings cached per (space, bank, address),
+ *                dropped whenever a label changes
+ * Threads: edits come from the main thread (UI and command server) and
+ *          take g_sym_mutex exclusively; symbolization runs on the core
+ *          thread (trace) and listing workers and takes it shared
  */
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <optional>
-#include <set>
 #include <string>
+#include <string_view>
 #include <regex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include <cctype>
 #include <cstdio>
 #include <cstring>
 #include <cinttypes>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "symbols.hpp"
 #include "backend.hpp"
+#include "regions.hpp"
 
+/* One record per annotated address */
 struct SymEntry {
+    uint64_t    addr;
     std::string label;
     std::string comment;
 };
 
-using SymKey = std::pair<std::string, uint64_t>;
-static std::map<SymKey, SymEntry> g_syms;
+/* Symbols of one interned region: records sorted by address, plus the
+ * addresses that carry a label for nearest-label (floor) queries. */
+struct RegionSyms {
+    std::string           id;
+    std::vector<SymEntry> entries;
+    std::vector<uint64_t> labels;
+};
+
+struct IdHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+static std::vector<RegionSyms>                                    g_regions;
+static std::vector<unsigned>                                      g_order; /* by id */
+static std::unordered_map<std::string, unsigned, IdHash, std::equal_to<>> g_region_ids;
+static size_t                                                     g_count = 0;
+static bool                                                       g_names_dirty = true;
+static std::atomic<uint64_t>                                      g_label_generation{1};
+static std::shared_mutex                                          g_sym_mutex;
 
 /* ======================================================================== */
 /* Label validation                                                          */
@@ -54,51 +97,18 @@ std::optional<ar_resolved_addr> ar_sym_resolve(const char *region_id,
 {
     if (!region_id) return std::nullopt;
 
-    std::set<std::string> visited;
-    std::string cur_region = region_id;
-    uint64_t cur_addr = addr;
-
-    for (;;) {
-        if (visited.count(cur_region))
-            return std::nullopt; /* cycle */
-        visited.insert(cur_region);
+    /* ar_find_memory_by_id registers regions mapped after the build */
+    int handle = ar_region_handle(region_id);
+    if (handle < 0 && ar_find_memory_by_id(region_id))
+        handle = ar_region_handle(region_id);
+    if (handle < 0) return std::nullopt;
 
-        rd_Memory const *mem = ar_find_memory_by_id(cur_region.c_str());
-        if (!mem) {
-            /* First iteration: region doesn't exist at all */
-            if (visited.size() == 1) return std::nullopt;
-            break;
-        }
-
-        if (!mem->v1.get_memory_map_count || !mem->v1.get_memory_map)
-            break;
-
-        unsigned count = mem->v1.get_memory_map_count(mem);
-        if (count == 0) break;
-
-        auto *maps = new rd_MemoryMap[count];
-        mem->v1.get_memory_map(mem, maps);
-
-        bool found = false;
-        for (unsigned i = 0; i < count; i++) {
-            if (maps[i].source &&
-                cur_addr >= maps[i].base_addr &&
-                cur_addr < maps[i].base_addr + maps[i].size)
-            {
-                uint64_t new_addr = maps[i].source_base_addr +
-                                    (cur_addr - maps[i].base_addr);
-                cur_region = maps[i].source->v1.id;
-                cur_addr = new_addr;
-                found = true;
-                break;
-            }
-        }
-        delete[] maps;
-
-        if (!found) break;
-    }
+    int res_handle;
+    uint64_t res_addr;
+    if (!ar_region_resolve(handle, addr, &res_handle, &res_addr))
+        return std::nullopt; /* cycle */
 
-    return ar_resolved_addr{ cur_region, cur_addr };
+    return ar_resolved_addr{ ar_region_memory(res_handle)->v1.id, res_addr };
 }
 
 std::optional<ar_resolved_addr> ar_sym_resolve_bank(const char *region_id,
@@ -125,14 +135,267 @@ std::optional<ar_resolved_addr> ar_sym_resolve_bank(const char *region_id,
 }
 
 /* ======================================================================== */
-/* Auto-save helper                                                          */
+/* Storage                                                                   */
+/* ======================================================================== */
+
+static RegionSyms *find_region(const char *region_id) {
+    if (!region_id) return nullptr;
+    auto it = g_region_ids.find(std::string_view(region_id));
+    return it != g_region_ids.end() ? &g_regions[it->second] : nullptr;
+}
+
+static RegionSyms &intern_region(const char *region_id) {
+    if (RegionSyms *r = find_region(region_id)) return *r;
+    unsigned idx = (unsigned)g_regions.size();
+    g_regions.push_back({ region_id, {}, {} });
+    g_names_dirty = true;
+    g_region_ids.emplace(region_id, idx);
+    auto pos = std::lower_bound(g_order.begin(), g_order.end(), idx,
+        [](unsigned a, unsigned b) { return g_regions[a].id < g_regions[b].id; });
+    g_order.insert(pos, idx);
+    return g_regions[idx];
+}
+
+static std::vector<SymEntry>::iterator lower_entry(RegionSyms &r, uint64_t addr) {
+    return std::lower_bound(r.entries.begin(), r.entries.end(), addr,
+        [](const SymEntry &e, uint64_t a) { return e.addr < a; });
+}
+
+static SymEntry *find_entry(const char *region_id, uint64_t addr) {
+    RegionSyms *r = find_region(region_id);
+    if (!r) return nullptr;
+    auto it = lower_entry(*r, addr);
+    return (it != r->entries.end() && it->addr == addr) ? &*it : nullptr;
+}
+
+static SymEntry &get_entry(RegionSyms &r, uint64_t addr) {
+    auto it = lower_entry(r, addr);
+    if (it == r.entries.end() || it->addr != addr) {
+        it = r.entries.insert(it, SymEntry{ addr, {}, {} });
+        g_count++;
+        g_names_dirty = true;
+    }
+    return *it;
+}
+
+static void set_label_flag(RegionSyms &r, uint64_t addr, bool on) {
+    auto it = std::lower_bound(r.labels.begin(), r.labels.end(), addr);
+    bool present = it != r.labels.end() && *it == addr;
+    if (on && !present) r.labels.insert(it, addr);
+    else if (!on && present) r.labels.erase(it);
+}
+
+/* Drop the entry at addr once it has neither label nor comment */
+static void prune_entry(RegionSyms &r, uint64_t addr) {
+    auto it = lower_entry(r, addr);
+    if (it != r.entries.end() && it->addr == addr &&
+        it->label.empty() && it->comment.empty()) {
+        r.entries.erase(it);
+        g_count--;
+        g_names_dirty = true;
+    }
+}
+
+static void put_label(const char *region_id, uint64_t addr, const char *label) {
+    RegionSyms &r = intern_region(region_id);
+    get_entry(r, addr).label = label;
+    set_label_flag(r, addr, true);
+    g_names_dirty = true;
+    g_label_generation++;
+}
+
+static bool drop_label(const char *region_id, uint64_t addr) {
+    RegionSyms *r = find_region(region_id);
+    SymEntry *e = find_entry(region_id, addr);
+    if (!r || !e) return false;
+    e->label.clear();
+    set_label_flag(*r, addr, false);
+    g_names_dirty = true;
+    g_label_generation++;
+    prune_entry(*r, addr);
+    return true;
+}
+
+static void put_comment(const char *region_id, uint64_t addr, const char *comment) {
+    get_entry(intern_region(region_id), addr).comment = comment;
+}
+
+static bool drop_comment(const char *region_id, uint64_t addr) {
+    RegionSyms *r = find_region(region_id);
+    SymEntry *e = find_entry(region_id, addr);
+    if (!r || !e) return false;
+    e->comment.clear();
+    prune_entry(*r, addr);
+    return true;
+}
+
+/* ======================================================================== */
+/* Journal                                                                   */
 /* ======================================================================== */
 
-static void auto_save(void) {
+/* One edit per line:
+ *   L <region> <hex addr> <label>      l <region> <hex addr>
+ *   C <region> <hex addr> <comment>    c <region> <hex addr>
+ * Comments escape '\\', '\n' and '\r'.  Every edit sets or clears a value,
+ * so replaying a journal over a snapshot that already contains some of
+ * its edits is harmless.
+ *
+ * Edits build their lines under g_sym_mutex but write them after releasing
+ * it, so a symbolize call on the core thread never waits on the disk; the
+ * file and compaction are serialized by g_journal_mutex instead. */
+
+static constexpr unsigned COMPACT_EDITS = 4096;
+
+static std::mutex  g_journal_mutex;
+static FILE       *g_journal = nullptr;
+static std::string g_journal_path;
+static unsigned    g_journal_edits = 0;
+static int         g_batch_depth = 0;
+static std::string g_batch_buf;
+static unsigned    g_batch_edits = 0;
+
+static std::string rom_file(const char *suffix) {
     const char *base = ar_rompath_base();
-    if (!base || !base[0]) return;
-    std::string path = std::string(base) + ".sym.json";
-    ar_sym_save(path.c_str());
+    if (!base || !base[0]) return {};
+    return std::string(base) + suffix;
+}
+
+static void journal_close(void) {
+    if (g_journal) fclose(g_journal);
+    g_journal = nullptr;
+    g_journal_path.clear();
+}
+
+static bool journal_open(void) {
+    std::string path = rom_file(".sym.journal");
+    if (path.empty()) return false;
+    if (g_journal && path == g_journal_path) return true;
+    journal_close();
+    g_journal = fopen(path.c_str(), "a");
+    if (!g_journal) {
+        fprintf(stderr, "[arret] Failed to open %s\n", path.c_str());
+        return false;
+    }
+    g_journal_path = path;
+    return true;
+}
+
+/* Write the table to the snapshot, then empty the journal.  Called with
+ * g_journal_mutex held; symbolize calls may read alongside. */
+static void compact(void) {
+    std::string snap = rom_file(".sym.json");
+    if (snap.empty()) return;
+    {
+        std::shared_lock lock(g_sym_mutex);
+        if (!ar_sym_save(snap.c_str())) return;
+    }
+    journal_close();
+    std::string path = rom_file(".sym.journal");
+    FILE *f = fopen(path.c_str(), "w");
+    if (f) fclose(f);
+    g_journal_edits = 0;
+}
+
+static void journal_commit(const std::string &data, unsigned edits) {
+    std::lock_guard lock(g_journal_mutex);
+    if (data.empty() || !journal_open()) return;
+    bool ok = fwrite(data.data(), 1, data.size(), g_journal) == data.size();
+    ok = fflush(g_journal) == 0 && ok;
+    ok = fsync(fileno(g_journal)) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "[arret] Failed to write %s\n", g_journal_path.c_str());
+    g_journal_edits += edits;
+    if (g_journal_edits >= COMPACT_EDITS) compact();
+}
+
+static void journal_line(std::string &out, char op, const char *region_id,
+                         uint64_t addr, const char *text) {
+    char head[96];
+    snprintf(head, sizeof(head), "%c %s %" PRIx64, op, region_id, addr);
+    out += head;
+    if (text) {
+        out += ' ';
+        for (const char *p = text; *p; p++) {
+            switch (*p) {
+            case '\\': out += "\\\\"; break;
+            case '\n':  out += "\\n";  break;
+            case '\r':  out += "\\r";  break;
+            default:    out += *p;     break;
+            }
+        }
+    }
+    out += '\n';
+}
+
+/* Append lines holding edits to the open batch, or else to the journal.
+ * Called after releasing g_sym_mutex. */
+static void journal_lines(const std::string &lines, unsigned edits) {
+    if (g_batch_depth > 0) {
+        g_batch_buf += lines;
+        g_batch_edits += edits;
+        return;
+    }
+    journal_commit(lines, edits);
+}
+
+/* Apply the complete lines of a journal.  Returns the number applied. */
+static unsigned journal_replay(const std::string &path) {
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) return 0;
+
+    unsigned applied = 0;
+    char *line = nullptr;
+    size_t cap = 0;
+    ssize_t len;
+    std::string text;
+    while ((len = getline(&line, &cap, f)) > 0) {
+        if (line[len - 1] != '\n') break;     /* torn final write */
+        line[len - 1] = '\0';
+        if (len < 4 || line[1] != ' ') continue;
+
+        char *region = line + 2;
+        char *sp = strchr(region, ' ');
+        if (!sp) continue;
+        *sp = '\0';
+        char *end;
+        uint64_t addr = strtoull(sp + 1, &end, 16);
+        const char *arg = (*end == ' ') ? end + 1 : "";
+
+        text.clear();
+        for (const char *p = arg; *p; p++) {
+            if (*p == '\\' && p[1]) {
+                p++;
+                text += (*p == 'n') ? '\n' : (*p == 'r') ? '\r' : *p;
+            } else {
+                text += *p;
+            }
+        }
+
+        switch (line[0]) {
+        case 'L': if (valid_label(text.c_str())) put_label(region, addr, text.c_str()); break;
+        case 'l': drop_label(region, addr); break;
+        case 'C': put_comment(region, addr, text.c_str()); break;
+        case 'c': drop_comment(region, addr); break;
+        default:  continue;
+        }
+        applied++;
+    }
+    free(line);
+    fclose(f);
+    return applied;
+}
+
+void ar_sym_batch_begin(void) {
+    g_batch_depth++;
+}
+
+void ar_sym_batch_commit(void) {
+    if (g_batch_depth == 0 || --g_batch_depth > 0) return;
+    std::string data;
+    data.swap(g_batch_buf);
+    unsigned edits = g_batch_edits;
+    g_batch_edits = 0;
+    journal_commit(data, edits);
 }
 
 /* ======================================================================== */
@@ -140,27 +403,43 @@ static void auto_save(void) {
 /* ======================================================================== */
 
 bool ar_sym_set_label(const char *region_id, uint64_t addr, const char *label) {
-    if (!valid_label(label)) return false;
-    SymKey key{region_id, addr};
-    g_syms[key].label = label;
-    auto_save();
+    if (!region_id || !valid_label(label)) return false;
+    std::string line;
+    {
+        std::unique_lock lock(g_sym_mutex);
+        put_label(region_id, addr, label);
+        journal_line(line, 'L', region_id, addr, label);
+    }
+    journal_lines(line, 1);
     return true;
 }
 
 bool ar_sym_delete_label(const char *region_id, uint64_t addr) {
-    auto it = g_syms.find({region_id, addr});
-    if (it == g_syms.end()) return false;
-    it->second.label.clear();
-    if (it->second.comment.empty())
-        g_syms.erase(it);
-    auto_save();
+    std::string line;
+    {
+        std::unique_lock lock(g_sym_mutex);
+        if (!drop_label(region_id, addr)) return false;
+        journal_line(line, 'l', region_id, addr, nullptr);
+    }
+    journal_lines(line, 1);
     return true;
 }
 
 const char *ar_sym_get_label(const char *region_id, uint64_t addr) {
-    auto it = g_syms.find({region_id, addr});
-    if (it == g_syms.end() || it->second.label.empty()) return nullptr;
-    return it->second.label.c_str();
+    SymEntry *e = find_entry(region_id, addr);
+    if (!e || e->label.empty()) return nullptr;
+    return e->label.c_str();
+}
+
+const char *ar_sym_nearest_label(const char *region_id, uint64_t addr,
+                                 uint64_t *label_addr) {
+    RegionSyms *r = find_region(region_id);
+    if (!r) return nullptr;
+    auto it = std::upper_bound(r->labels.begin(), r->labels.end(), addr);
+    if (it == r->labels.begin()) return nullptr;
+    --it;
+    if (label_addr) *label_addr = *it;
+    return ar_sym_get_label(region_id, *it);
 }
 
 /* ======================================================================== */
@@ -168,58 +447,534 @@ const char *ar_sym_get_label(const char *region_id, uint64_t addr) {
 /* ======================================================================== */
 
 bool ar_sym_set_comment(const char *region_id, uint64_t addr, const char *comment) {
-    if (!comment) return false;
-    SymKey key{region_id, addr};
-    g_syms[key].comment = comment;
-    auto_save();
+    if (!region_id || !comment) return false;
+    std::string line;
+    {
+        std::unique_lock lock(g_sym_mutex);
+        put_comment(region_id, addr, comment);
+        journal_line(line, 'C', region_id, addr, comment);
+    }
+    journal_lines(line, 1);
     return true;
 }
 
 bool ar_sym_delete_comment(const char *region_id, uint64_t addr) {
-    auto it = g_syms.find({region_id, addr});
-    if (it == g_syms.end()) return false;
-    it->second.comment.clear();
-    if (it->second.label.empty())
-        g_syms.erase(it);
-    auto_save();
+    std::string line;
+    {
+        std::unique_lock lock(g_sym_mutex);
+        if (!drop_comment(region_id, addr)) return false;
+        journal_line(line, 'c', region_id, addr, nullptr);
+    }
+    journal_lines(line, 1);
     return true;
 }
 
 const char *ar_sym_get_comment(const char *region_id, uint64_t addr) {
-    auto it = g_syms.find({region_id, addr});
-    if (it == g_syms.end() || it->second.comment.empty()) return nullptr;
-    return it->second.comment.c_str();
+    SymEntry *e = find_entry(region_id, addr);
+    if (!e || e->comment.empty()) return nullptr;
+    return e->comment.c_str();
+}
+
+/* ======================================================================== */
+/* Bulk edits                                                                */
+/* ======================================================================== */
+
+unsigned ar_sym_set_bulk(const ar_symbol_ref *defs, unsigned count) {
+    /* Valid definitions by (region, address); the stable sort keeps a
+     * later duplicate after an earlier one so it wins below */
+    std::vector<unsigned> order;
+    order.reserve(count);
+    for (unsigned i = 0; i < count; i++) {
+        const ar_symbol_ref &d = defs[i];
+        if (!d.region_id || (!d.label && !d.comment)) continue;
+        if (d.label && !valid_label(d.label)) continue;
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+        int c = strcmp(defs[a].region_id, defs[b].region_id);
+        return c != 0 ? c < 0 : defs[a].address < defs[b].address;
+    });
+
+    std::unique_lock lock(g_sym_mutex);
+    std::string lines;
+    std::vector<SymEntry> merged;
+    for (size_t i = 0; i < order.size(); ) {
+        /* One region at a time: merge its sorted definitions with its
+         * sorted entries in a single pass */
+        const char *region_id = defs[order[i]].region_id;
+        size_t end = i;
+        while (end < order.size() &&
+               strcmp(defs[order[end]].region_id, region_id) == 0)
+            end++;
+
+        RegionSyms &r = intern_region(region_id);
+        merged.clear();
+        merged.reserve(r.entries.size() + (end - i));
+        auto old = r.entries.begin();
+        for (; i < end; i++) {
+            const ar_symbol_ref &d = defs[order[i]];
+            while (old != r.entries.end() && old->addr < d.address)
+                merged.push_back(std::move(*old++));
+            if (old != r.entries.end() && old->addr == d.address)
+                merged.push_back(std::move(*old++));
+            else if (merged.empty() || merged.back().addr != d.address)
+                merged.push_back(SymEntry{ d.address, {}, {} });
+            SymEntry &e = merged.back();
+            if (d.label) {
+                e.label = d.label;
+                journal_line(lines, 'L', region_id, d.address, d.label);
+            }
+            if (d.comment) {
+                e.comment = d.comment;
+                journal_line(lines, 'C', region_id, d.address, d.comment);
+            }
+        }
+        for (; old != r.entries.end(); ++old)
+            merged.push_back(std::move(*old));
+
+        g_count += merged.size() - r.entries.size();
+        r.entries.swap(merged);
+        r.labels.clear();
+        for (auto &e : r.entries)
+            if (!e.label.empty()) r.labels.push_back(e.addr);
+    }
+
+    if (!order.empty()) {
+        g_names_dirty = true;
+        g_label_generation++;
+        lock.unlock();
+        journal_lines(lines, (unsigned)order.size());
+    }
+    return (unsigned)order.size();
+}
+
+/* ======================================================================== */
+/* Name index                                                                */
+/* ======================================================================== */
+
+/* Every label, ordered by lowercase name.  Lowercase names live in one
+ * NUL-separated pool; mask has a bit per character class present, so a
+ * fuzzy query can skip names lacking one of its characters. */
+struct NameRef {
+    uint32_t    off, len;       /* lowercase name in g_name_pool */
+    uint64_t    mask;
+    const char *region_id;
+    const char *label;
+    uint64_t    addr;
+};
+
+static std::vector<NameRef>                                    g_names;
+static std::string                                             g_name_pool;
+static std::vector<uint32_t>                                   g_tri_start; /* TRIGRAMS + 1 */
+static std::vector<uint32_t>                                   g_tri_names;
+static std::vector<uint32_t>                                   g_seen;
+static uint32_t                                                g_seen_stamp = 0;
+
+static char lower_char(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+/* Lowercase labels use 37 characters: a-z, 0-9 and '_' */
+static constexpr uint32_t NAME_CHARS = 37;
+static constexpr uint32_t TRIGRAMS = NAME_CHARS * NAME_CHARS * NAME_CHARS;
+
+static uint32_t char_code(char c) {
+    if (c >= 'a' && c <= 'z') return (uint32_t)(c - 'a');
+    if (c >= '0' && c <= '9') return 26 + (uint32_t)(c - '0');
+    if (c == '_') return 36;
+    return NAME_CHARS;
+}
+
+static uint64_t char_bit(char c) {
+    return 1ull << char_code(c);
+}
+
+/* TRIGRAMS if p holds a character no label can contain */
+static uint32_t trigram(const char *p) {
+    uint32_t a = char_code(p[0]), b = char_code(p[1]), c = char_code(p[2]);
+    if (a == NAME_CHARS || b == NAME_CHARS || c == NAME_CHARS) return TRIGRAMS;
+    return (a * NAME_CHARS + b) * NAME_CHARS + c;
+}
+
+static std::string_view name_of(const NameRef &n) {
+    return std::string_view(g_name_pool.data() + n.off, n.len);
+}
+
+static void rebuild_names(void) {
+    g_names_dirty = false;
+    g_names.clear();
+    g_name_pool.clear();
+    g_tri_names.clear();
+
+    /* Lowercase into the pool in storage order, then sort by name */
+    std::vector<NameRef> refs;
+    std::string pool;
+    for (auto &r : g_regions)
+        for (auto &e : r.entries) {
+            if (e.label.empty()) continue;
+            NameRef n{ (uint32_t)pool.size(), (uint32_t)e.label.size(), 0,
+                       r.id.c_str(), e.label.c_str(), e.addr };
+            for (char c : e.label) {
+                c = lower_char(c);
+                n.mask |= char_bit(c);
+                pool += c;
+            }
+            pool += '\0';
+            refs.push_back(n);
+        }
+    std::sort(refs.begin(), refs.end(), [&](const NameRef &a, const NameRef &b) {
+        return std::string_view(pool.data() + a.off, a.len) <
+               std::string_view(pool.data() + b.off, b.len);
+    });
+
+    /* Repack the pool in name order so prefix runs are contiguous in memory */
+    g_names.reserve(refs.size());
+    g_name_pool.reserve(pool.size());
+    for (NameRef n : refs) {
+        g_name_pool.append(pool.data() + n.off, n.len + 1);
+        n.off = (uint32_t)(g_name_pool.size() - n.len - 1);
+        g_names.push_back(n);
+    }
+
+    /* Trigram -> names by counting sort; last[] drops repeats in a name */
+    std::vector<uint32_t> last(TRIGRAMS, UINT32_MAX);
+    g_tri_start.assign(TRIGRAMS + 1, 0);
+    for (uint32_t i = 0; i < g_names.size(); i++) {
+        const char *p = g_name_pool.data() + g_names[i].off;
+        for (uint32_t k = 0; k + 3 <= g_names[i].len; k++) {
+            uint32_t t = trigram(p + k);
+            if (t == TRIGRAMS || last[t] == i) continue;
+            last[t] = i;
+            g_tri_start[t + 1]++;
+        }
+    }
+    for (uint32_t t = 0; t < TRIGRAMS; t++)
+        g_tri_start[t + 1] += g_tri_start[t];
+    g_tri_names.resize(g_tri_start[TRIGRAMS]);
+    std::vector<uint32_t> fill(g_tri_start.begin(), g_tri_start.end() - 1);
+    std::fill(last.begin(), last.end(), UINT32_MAX);
+    for (uint32_t i = 0; i < g_names.size(); i++) {
+        const char *p = g_name_pool.data() + g_names[i].off;
+        for (uint32_t k = 0; k + 3 <= g_names[i].len; k++) {
+            uint32_t t = trigram(p + k);
+            if (t == TRIGRAMS || last[t] == i) continue;
+            last[t] = i;
+            g_tri_names[fill[t]++] = i;
+        }
+    }
+    g_seen.assign(g_names.size(), 0);
+    g_seen_stamp = 0;
+}
+
+unsigned ar_sym_find(const char *query, ar_symbol_match *out, unsigned max) {
+    if (!query || !query[0] || max == 0) return 0;
+    if (g_names_dirty) rebuild_names();
+    if (g_names.empty()) return 0;
+
+    std::string q(query);
+    uint64_t qmask = 0;
+    for (char &c : q) {
+        c = lower_char(c);
+        qmask |= char_bit(c);
+    }
+    if (++g_seen_stamp == 0) {
+        std::fill(g_seen.begin(), g_seen.end(), 0);
+        g_seen_stamp = 1;
+    }
+
+    /* (kind, rank within kind, name index); rank is the match position for
+     * substrings and the number of skipped characters for fuzzy matches */
+    struct Hit { unsigned kind, rank; uint32_t idx; };
+    std::vector<Hit> hits;
+    auto add = [&](unsigned kind, unsigned rank, uint32_t idx) {
+        if (g_seen[idx] == g_seen_stamp) return;
+        g_seen[idx] = g_seen_stamp;
+        hits.push_back({ kind, rank, idx });
+    };
+
+    /* Prefix: a contiguous run of the sorted names */
+    auto it = std::lower_bound(g_names.begin(), g_names.end(), std::string_view(q),
+        [](const NameRef &n, std::string_view v) { return name_of(n) < v; });
+    for (; it != g_names.end() && name_of(*it).starts_with(q); ++it)
+        add(it->len == q.size() ? AR_SYM_MATCH_EXACT : AR_SYM_MATCH_PREFIX,
+            0, (uint32_t)(it - g_names.begin()));
+
+    /* Substring: verify the shortest posting list of the query's trigrams */
+    if (hits.size() < max) {
+        auto check = [&](uint32_t idx) {
+            size_t pos = name_of(g_names[idx]).find(q);
+            if (pos != std::string_view::npos)
+                add(AR_SYM_MATCH_SUBSTRING, (unsigned)pos, idx);
+        };
+        if (q.size() >= 3) {
+            uint32_t best = TRIGRAMS;
+            for (size_t k = 0; k + 3 <= q.size(); k++) {
+                uint32_t t = trigram(q.data() + k);
+                if (t == TRIGRAMS) { best = TRIGRAMS; break; }
+                if (best == TRIGRAMS ||
+                    g_tri_start[t + 1] - g_tri_start[t] <
+                    g_tri_start[best + 1] - g_tri_start[best])
+                    best = t;
+            }
+            if (best != TRIGRAMS)
+                for (uint32_t i = g_tri_start[best]; i < g_tri_start[best + 1]; i++)
+                    check(g_tri_names[i]);
+        } else {
+            for (uint32_t idx = 0; idx < g_names.size(); idx++) check(idx);
+        }
+    }
+
+    /* Fuzzy: query characters in order, anywhere in the name */
+    if (hits.size() < max) {
+        for (uint32_t idx = 0; idx < g_names.size(); idx++) {
+            const NameRef &n = g_names[idx];
+            if ((n.mask & qmask) != qmask || n.len < q.size()) continue;
+            const char *p = g_name_pool.data() + n.off;
+            size_t qi = 0, first = 0, last = 0;
+            for (size_t k = 0; k < n.len && qi < q.size(); k++)
+                if (p[k] == q[qi]) {
+                    if (qi == 0) first = k;
+                    last = k;
+                    qi++;
+                }
+            if (qi == q.size())
+                add(AR_SYM_MATCH_FUZZY, (unsigned)(last - first + 1 - q.size()), idx);
+        }
+    }
+
+    auto better = [](const Hit &a, const Hit &b) {
+        if (a.kind != b.kind) return a.kind < b.kind;
+        if (a.rank != b.rank) return a.rank < b.rank;
+        if (g_names[a.idx].len != g_names[b.idx].len)
+            return g_names[a.idx].len < g_names[b.idx].len;
+        return a.idx < b.idx;
+    };
+    size_t n = hits.size() < max ? hits.size() : max;
+    std::partial_sort(hits.begin(), hits.begin() + n, hits.end(), better);
+
+    for (size_t i = 0; i < n; i++) {
+        const NameRef &r = g_names[hits[i].idx];
+        out[i] = { r.region_id, r.addr, r.label, (ar_sym_match_kind)hits[i].kind };
+    }
+    return (unsigned)n;
+}
+
+/* ======================================================================== */
+/* Symbolization                                                             */
+/* ======================================================================== */
+
+/* Operands get label+offset only this close to a label; further away the
+ * label most likely names something unrelated */
+static constexpr uint64_t OPERAND_MAX_OFFSET = 0xFF;
+static constexpr size_t   SYMBOLIZE_CACHE_MAX = 1 << 16;    /* per shard */
+static constexpr size_t   SYMBOLIZE_SHARDS = 16;
+
+struct SymbolizeKey {
+    int      handle;
+    int64_t  bank;
+    uint64_t addr;
+    uint64_t max_offset;
+    bool operator==(const SymbolizeKey &) const = default;
+};
+
+struct SymbolizeKeyHash {
+    size_t operator()(const SymbolizeKey &k) const {
+        uint64_t h = k.addr * 0x9E3779B97F4A7C15ull;
+        h ^= ((uint64_t)k.handle << 32) ^ (uint64_t)k.bank ^ (k.max_offset << 48);
+        return (size_t)(h ^ (h >> 29));
+    }
+};
+
+/* Split by key hash so the trace hook and listing workers rarely meet on
+ * one mutex.  Empty string: no label in range (cached too). */
+struct SymbolizeShard {
+    std::mutex                                                      mutex;
+    std::unordered_map<SymbolizeKey, std::string, SymbolizeKeyHash> cache;
+    uint64_t                                                        generation = 0;
+};
+
+static SymbolizeShard g_symbolize[SYMBOLIZE_SHARDS];
+
+static std::string symbolize_uncached(int handle, uint64_t addr, int64_t bank,
+                                      uint64_t max_offset) {
+    /* First hop through the given bank when the region can say where it
+     * points, so the result matches the key even if the cached maps are a
+     * frame behind */
+    rd_Memory const *space = ar_region_memory(handle);
+    rd_MemoryMap m;
+    if (bank >= 0 && space && space->v1.get_bank_address &&
+        space->v1.get_bank_address(space, addr, bank, &m) && m.source) {
+        int src = ar_region_add(m.source);
+        if (src >= 0) {
+            addr = m.source_base_addr + (addr - m.base_addr);
+            handle = src;
+        }
+    }
+
+    int rh;
+    uint64_t ra;
+    if (!ar_region_resolve(handle, addr, &rh, &ra)) return {};
+    rd_Memory const *mem = ar_region_memory(rh);
+
+    std::shared_lock lock(g_sym_mutex);
+    RegionSyms *r = mem ? find_region(mem->v1.id) : nullptr;
+    if (!r) return {};
+
+    auto it = std::upper_bound(r->labels.begin(), r->labels.end(), ra);
+    if (it == r->labels.begin()) return {};
+    uint64_t label_addr = *--it;
+    if (ra - label_addr > max_offset) return {};
+    SymEntry *e = find_entry(mem->v1.id, label_addr);
+    if (!e) return {};
+
+    std::string text = e->label;
+    if (ra != label_addr) {
+        char off[24];
+        snprintf(off, sizeof(off), "+0x%" PRIX64, ra - label_addr);
+        text += off;
+    }
+    return text;
+}
+
+size_t ar_sym_symbolize_bank(const char *region_id, uint64_t addr, int64_t bank,
+                             uint64_t max_offset, char *out, size_t out_size) {
+    int handle = ar_region_handle(region_id);
+    if (handle < 0 || out_size == 0) return 0;
+
+    /* The bank mapped at addr is part of the key: the same CPU address
+     * names different code once the bank switches */
+    SymbolizeKey key{ handle, bank < 0 ? -1 : bank, addr, max_offset };
+
+    SymbolizeShard &shard = g_symbolize[SymbolizeKeyHash{}(key) % SYMBOLIZE_SHARDS];
+    auto copy_out = [&](const std::string &text) {
+        size_t n = std::min(text.size(), out_size - 1);
+        memcpy(out, text.data(), n);
+        out[n] = '\0';
+        return text.empty() ? 0 : n;
+    };
+
+    uint64_t generation;
+    {
+        std::lock_guard lock(shard.mutex);
+        generation = g_label_generation.load();
+        if (generation != shard.generation) {
+            shard.cache.clear();
+            shard.generation = generation;
+        }
+        auto it = shard.cache.find(key);
+        if (it != shard.cache.end()) return copy_out(it->second);
+    }
+
+    /* Resolve a miss outside the shard lock; a result that raced a label
+     * change is kept under the old generation and dropped on next use */
+    std::string text = symbolize_uncached(handle, addr, key.bank, max_offset);
+    {
+        std::lock_guard lock(shard.mutex);
+        if (shard.generation == generation) {
+            if (shard.cache.size() >= SYMBOLIZE_CACHE_MAX) shard.cache.clear();
+            shard.cache.emplace(key, text);
+        }
+    }
+    return copy_out(text);
+}
+
+size_t ar_sym_symbolize(const char *region_id, uint64_t addr, uint64_t max_offset,
+                        char *out, size_t out_size) {
+    rd_MemoryMap m;
+    int64_t bank = ar_region_map_find(ar_region_handle(region_id), addr, &m)
+                   ? m.bank : -1;
+    return ar_sym_symbolize_bank(region_id, addr, bank, max_offset, out, out_size);
+}
+
+size_t ar_sym_symbolize_text(const char *text, const char *region_id,
+                             ar_sym_bank_fn bank_of, void *user,
+                             char *out, size_t out_size) {
+    if (out_size == 0) return 0;
+    size_t j = 0;
+    auto put = [&](const char *s, size_t n) {
+        if (n > out_size - 1 - j) n = out_size - 1 - j;
+        memcpy(out + j, s, n);
+        j += n;
+    };
+
+    const char *p = text;
+    while (*p) {
+        if (*p != '@') {
+            const char *q = p;
+            while (*q && *q != '@') q++;
+            put(p, (size_t)(q - p));
+            p = q;
+            continue;
+        }
+        const char *h = p + 1;
+        while (isxdigit((unsigned char)*h)) h++;
+        if (h == p + 1) { p++; continue; }
+
+        char label[128];
+        uint64_t addr = strtoull(p + 1, nullptr, 16);
+        size_t n = 0;
+        if (region_id && bank_of)
+            n = ar_sym_symbolize_bank(region_id, addr, bank_of(user, addr),
+                                      OPERAND_MAX_OFFSET, label, sizeof(label));
+        else if (region_id)
+            n = ar_sym_symbolize(region_id, addr, OPERAND_MAX_OFFSET, label, sizeof(label));
+        if (n > 0) {
+            if (j > 0 && out[j - 1] == '$') j--;    /* "$@0150" -> "label" */
+            put(label, n);
+        } else {
+            put(p + 1, (size_t)(h - p - 1));
+        }
+        p = h;
+    }
+    out[j] = '\0';
+    return j;
 }
 
 /* ======================================================================== */
 /* List / count / clear                                                      */
 /* ======================================================================== */
 
-unsigned ar_sym_list(ar_symbol *out, unsigned max) {
-    unsigned i = 0;
-    for (auto &[key, entry] : g_syms) {
-        if (i >= max) break;
-        ar_symbol &s = out[i++];
-        memset(&s, 0, sizeof(s));
-        strncpy(s.region_id, key.first.c_str(), sizeof(s.region_id) - 1);
-        s.address = key.second;
-        strncpy(s.label, entry.label.c_str(), sizeof(s.label) - 1);
-        strncpy(s.comment, entry.comment.c_str(), sizeof(s.comment) - 1);
+unsigned ar_sym_list(unsigned start, ar_symbol_ref *out, unsigned max) {
+    unsigned n = 0;
+    size_t skip = start;
+    for (unsigned idx : g_order) {
+        auto &r = g_regions[idx];
+        if (skip >= r.entries.size()) {
+            skip -= r.entries.size();
+            continue;
+        }
+        for (size_t i = skip; i < r.entries.size() && n < max; i++) {
+            auto &e = r.entries[i];
+            out[n++] = { r.id.c_str(), e.addr,
+                         e.label.empty() ? nullptr : e.label.c_str(),
+                         e.comment.empty() ? nullptr : e.comment.c_str() };
+        }
+        skip = 0;
+        if (n >= max) break;
     }
-    return i;
+    return n;
 }
 
 unsigned ar_sym_count(void) {
-    return (unsigned)g_syms.size();
+    return (unsigned)g_count;
+}
+
+static void clear_table(void) {
+    g_regions.clear();
+    g_order.clear();
+    g_region_ids.clear();
+    g_count = 0;
+    g_names_dirty = true;
+    g_label_generation++;
 }
 
 void ar_sym_clear(void) {
-    g_syms.clear();
+    std::unique_lock lock(g_sym_mutex);
+    clear_table();
 }
 
 bool ar_sym_has_annotation(const char *region_id, uint64_t addr) {
-    auto it = g_syms.find({region_id, addr});
-    return it != g_syms.end();
+    return find_entry(region_id, addr) != nullptr;
 }
 
 /* ======================================================================== */
@@ -248,116 +1003,114 @@ static void json_write_string(FILE *f, const std::string &s) {
 }
 
 bool ar_sym_save(const char *path) {
-    FILE *f = fopen(path, "w");
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
     if (!f) return false;
 
     fputs("[\n", f);
     bool first = true;
-    for (auto &[key, entry] : g_syms) {
-        if (!first) fputs(",\n", f);
-        first = false;
-        fputs("  {\"region\":", f);
-        json_write_string(f, key.first);
-        fprintf(f, ",\"addr\":%" PRIu64, key.second);
-        if (!entry.label.empty()) {
-            fputs(",\"label\":", f);
-            json_write_string(f, entry.label);
-        }
-        if (!entry.comment.empty()) {
-            fputs(",\"comment\":", f);
-            json_write_string(f, entry.comment);
+    for (unsigned idx : g_order) {
+        auto &r = g_regions[idx];
+        for (auto &entry : r.entries) {
+            if (!first) fputs(",\n", f);
+            first = false;
+            fputs("  {\"region\":", f);
+            json_write_string(f, r.id);
+            fprintf(f, ",\"addr\":%" PRIu64, entry.addr);
+            if (!entry.label.empty()) {
+                fputs(",\"label\":", f);
+                json_write_string(f, entry.label);
+            }
+            if (!entry.comment.empty()) {
+                fputs(",\"comment\":", f);
+                json_write_string(f, entry.comment);
+            }
+            fputc('}', f);
         }
-        fputc('}', f);
     }
     fputs("\n]\n", f);
-    fclose(f);
+    bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        remove(tmp.c_str());
+        fprintf(stderr, "[arret] Failed to write %s\n", path);
+        return false;
+    }
     fprintf(stderr, "[arret] Saved %u symbols to %s\n",
-            (unsigned)g_syms.size(), path);
+            (unsigned)g_count, path);
     return true;
 }
 
-/* Simple JSON parser: read entire file, scan for objects with known keys */
-
-static std::string json_unescape(const std::string &s) {
-    std::string out;
-    out.reserve(s.size());
-    for (size_t i = 0; i < s.size(); i++) {
-        if (s[i] == '\\' && i + 1 < s.size()) {
-            switch (s[i + 1]) {
-            case '"':  out += '"';  i++; break;
-            case '\\': out += '\\'; i++; break;
-            case 'n':  out += '\n'; i++; break;
-            case 'r':  out += '\r'; i++; break;
-            case 't':  out += '\t'; i++; break;
-            case 'u':
-                /* Skip \uXXXX — just drop it for simplicity */
-                i += 5;
-                break;
-            default: out += s[i]; break;
-            }
-        } else {
-            out += s[i];
-        }
-    }
-    return out;
-}
-
-/* Extract a JSON string value starting at pos (pos points to opening '"').
-   Returns the unescaped string and advances pos past the closing '"'. */
-static std::string parse_json_string(const std::string &data, size_t &pos) {
-    if (pos >= data.size() || data[pos] != '"') return {};
-    pos++; /* skip opening quote */
-    std::string raw;
-    while (pos < data.size()) {
-        if (data[pos] == '\\' && pos + 1 < data.size()) {
-            raw += data[pos];
-            raw += data[pos + 1];
-            pos += 2;
-        } else if (data[pos] == '"') {
-            pos++; /* skip closing quote */
-            return json_unescape(raw);
-        } else {
-            raw += data[pos++];
-        }
+/* Snapshot loader: mmap the file and scan it for objects with known keys.
+   Strings without escapes are copied straight out of the mapping. */
+
+static void append_utf8(std::string &out, unsigned cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
     }
-    return json_unescape(raw);
 }
 
-/* Parse a JSON number at pos, advance past it */
-static uint64_t parse_json_number(const std::string &data, size_t &pos) {
-    uint64_t val = 0;
-    while (pos < data.size() && data[pos] >= '0' && data[pos] <= '9') {
-        val = val * 10 + (data[pos] - '0');
-        pos++;
+/* Parse a JSON string at p (pointing to the opening '"') into out and
+   advance p past the closing '"'. */
+static void parse_json_string(const char *&p, const char *end, std::string &out) {
+    out.clear();
+    if (p >= end || *p != '"') return;
+    p++;
+    const char *run = p;
+    while (p < end && *p != '"' && *p != '\\') p++;
+    out.assign(run, p);
+    while (p < end && *p != '"') {
+        if (*p != '\\' || p + 1 >= end) { out += *p++; continue; }
+        char c = p[1];
+        p += 2;
+        switch (c) {
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u':
+            if (end - p >= 4) {
+                char hex[5] = { p[0], p[1], p[2], p[3], 0 };
+                append_utf8(out, (unsigned)strtoul(hex, nullptr, 16));
+                p += 4;
+            }
+            break;
+        default: out += c; break;
+        }
     }
-    return val;
+    if (p < end) p++; /* closing quote */
 }
 
 bool ar_sym_load(const char *path) {
-    FILE *f = fopen(path, "r");
-    if (!f) return false;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) { close(fd); return false; }
+    size_t fsize = (size_t)st.st_size;
+    void *map = mmap(nullptr, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
 
-    /* Read entire file */
-    fseek(f, 0, SEEK_END);
-    long fsize = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    if (fsize <= 0) { fclose(f); return false; }
-    std::string data((size_t)fsize, '\0');
-    size_t nread = fread(&data[0], 1, (size_t)fsize, f);
-    (void)nread;
-    fclose(f);
+    std::unique_lock lock(g_sym_mutex);
+    clear_table();
 
-    g_syms.clear();
+    const char *p = (const char *)map;
+    const char *end = p + fsize;
+    std::string key, region, val;
 
     /* Scan for objects */
-    size_t pos = 0;
-    while (pos < data.size()) {
+    while (p < end) {
         /* Find next '{' */
-        pos = data.find('{', pos);
-        if (pos == std::string::npos) break;
-        pos++; /* skip '{' */
+        p = (const char *)memchr(p, '{', (size_t)(end - p));
+        if (!p) break;
+        p++; /* skip '{' */
 
-        std::string region;
         uint64_t addr = 0;
         std::string label;
         std::string comment;
@@ -365,64 +1118,101 @@ bool ar_sym_load(const char *path) {
         bool has_addr = false;
 
         /* Parse key-value pairs until '}' */
-        while (pos < data.size() && data[pos] != '}') {
+        while (p < end && *p != '}') {
             /* Skip whitespace and commas */
-            while (pos < data.size() &&
-                   (data[pos] == ' ' || data[pos] == '\t' ||
-                    data[pos] == '\n' || data[pos] == '\r' ||
-                    data[pos] == ','))
-                pos++;
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' ||
+                               *p == '\r' || *p == ','))
+                p++;
 
-            if (pos >= data.size() || data[pos] == '}') break;
+            if (p >= end || *p == '}') break;
 
             /* Parse key */
-            std::string key = parse_json_string(data, pos);
+            parse_json_string(p, end, key);
             if (key.empty()) break;
 
             /* Skip ':' and whitespace */
-            while (pos < data.size() &&
-                   (data[pos] == ':' || data[pos] == ' ' || data[pos] == '\t'))
-                pos++;
+            while (p < end && (*p == ':' || *p == ' ' || *p == '\t'))
+                p++;
 
-            if (pos >= data.size()) break;
+            if (p >= end) break;
 
             /* Parse value */
-            if (data[pos] == '"') {
-                std::string val = parse_json_string(data, pos);
-                if (key == "region")  { region = val; has_region = true; }
-                else if (key == "label")   label = val;
-                else if (key == "comment") comment = val;
-            } else if (data[pos] >= '0' && data[pos] <= '9') {
-                uint64_t val = parse_json_number(data, pos);
-                if (key == "addr") { addr = val; has_addr = true; }
+            if (*p == '"') {
+                parse_json_string(p, end, val);
+                if (key == "region")  { region.swap(val); has_region = true; }
+                else if (key == "label")   label.swap(val);
+                else if (key == "comment") comment.swap(val);
+            } else if (*p >= '0' && *p <= '9') {
+                uint64_t n = 0;
+                while (p < end && *p >= '0' && *p <= '9')
+                    n = n * 10 + (uint64_t)(*p++ - '0');
+                if (key == "addr") { addr = n; has_addr = true; }
             } else {
                 /* Skip unknown value */
-                pos++;
+                p++;
             }
         }
 
-        if (pos < data.size() && data[pos] == '}')
-            pos++;
+        if (p < end && *p == '}')
+            p++;
 
         if (has_region && has_addr && (!label.empty() || !comment.empty())) {
-            SymEntry entry;
-            entry.label = label;
-            entry.comment = comment;
-            g_syms[{region, addr}] = entry;
+            /* Appended unsorted; sorted once below */
+            RegionSyms &r = intern_region(region.c_str());
+            r.entries.push_back({ addr, std::move(label), std::move(comment) });
         }
     }
+    munmap(map, fsize);
+
+    /* Sort each region; a later duplicate of an address wins */
+    g_count = 0;
+    for (auto &r : g_regions) {
+        std::stable_sort(r.entries.begin(), r.entries.end(),
+            [](const SymEntry &a, const SymEntry &b) { return a.addr < b.addr; });
+        std::vector<SymEntry> merged;
+        merged.reserve(r.entries.size());
+        for (auto &e : r.entries) {
+            if (!merged.empty() && merged.back().addr == e.addr)
+                merged.back() = std::move(e);
+            else
+                merged.push_back(std::move(e));
+        }
+        r.entries.swap(merged);
+        r.labels.clear();
+        for (auto &e : r.entries)
+            if (!e.label.empty()) r.labels.push_back(e.addr);
+        g_count += r.entries.size();
+    }
 
     fprintf(stderr, "[arret] Loaded %u symbols from %s\n",
-            (unsigned)g_syms.size(), path);
+            (unsigned)g_count, path);
     return true;
 }
 
 void ar_sym_auto_load(void) {
-    const char *base = ar_rompath_base();
-    if (!base || !base[0]) return;
-    std::string path = std::string(base) + ".sym.json";
-    FILE *f = fopen(path.c_str(), "r");
-    if (!f) return;
-    fclose(f);
-    ar_sym_load(path.c_str());
+    {
+        std::lock_guard lock(g_journal_mutex);
+        journal_close();
+        g_journal_edits = 0;
+    }
+    g_batch_depth = 0;
+    g_batch_buf.clear();
+    g_batch_edits = 0;
+
+    std::string snap = rom_file(".sym.json");
+    if (snap.empty()) return;
+    if (access(snap.c_str(), R_OK) == 0)
+        ar_sym_load(snap.c_str());
+
+    /* Fold edits made since the last compaction into a fresh snapshot */
+    unsigned replayed;
+    {
+        std::unique_lock lock(g_sym_mutex);
+        replayed = journal_replay(rom_file(".sym.journal"));
+    }
+    if (replayed > 0) {
+        fprintf(stderr, "[arret] Replayed %u symbol edits\n", replayed);
+        std::lock_guard lock(g_journal_mutex);
+        compact();
+    }
 }
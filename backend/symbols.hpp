@@ -3,12 +3,14 @@
  *
  * Symbols attach labels and comments to (region_id, address) pairs.
  * Addresses are resolved through memory maps to the deepest backing
- * region before storage.  Persisted as <rombase>.sym.json.
+ * region before storage.  Persisted as <rombase>.sym.json plus an
+ * append-only journal of edits, <rombase>.sym.journal.
  */
 
 #ifndef AR_SYMBOLS_H
 #define AR_SYMBOLS_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -26,21 +28,101 @@ bool        ar_sym_set_comment(const char *region_id, uint64_t addr, const char
 bool        ar_sym_delete_comment(const char *region_id, uint64_t addr);
 const char *ar_sym_get_comment(const char *region_id, uint64_t addr);
 
-typedef struct ar_symbol {
-    char     region_id[64];
-    uint64_t address;
-    char     label[128];
-    char     comment[1024];
-} ar_symbol;
-
-unsigned ar_sym_list(ar_symbol *out, unsigned max);
+/* Nearest label at or before addr in region_id (no map resolution), for
+ * "label+offset" display.  Stores the label's address in *label_addr.
+ * Returns NULL if the region has no label at or below addr. */
+const char *ar_sym_nearest_label(const char *region_id, uint64_t addr,
+                                 uint64_t *label_addr);
+
+/* Symbol as seen by ar_sym_list.  Pointers refer to the symbol table and
+ * stay valid until the next modification; label/comment are NULL if unset. */
+typedef struct ar_symbol_ref {
+    const char *region_id;
+    uint64_t    address;
+    const char *label;
+    const char *comment;
+} ar_symbol_ref;
+
+/* Set the label and/or comment (whichever is not NULL) of many addresses
+ * at once: each region's entries are merged with the sorted definitions
+ * in one pass and the edits are journaled as one batch.  A later
+ * definition of the same address wins.  Definitions with an invalid label
+ * are skipped.  Returns the number applied. */
+unsigned ar_sym_set_bulk(const ar_symbol_ref *defs, unsigned count);
+
+/* Fill up to max symbols, ordered by (region_id, address), starting at
+ * index start.  Returns the number written; page until it returns 0. */
+unsigned ar_sym_list(unsigned start, ar_symbol_ref *out, unsigned max);
 unsigned ar_sym_count(void);
 
+typedef enum {
+    AR_SYM_MATCH_EXACT,
+    AR_SYM_MATCH_PREFIX,
+    AR_SYM_MATCH_SUBSTRING,
+    AR_SYM_MATCH_FUZZY      /* query characters in order, with gaps */
+} ar_sym_match_kind;
+
+typedef struct {
+    const char       *region_id;
+    uint64_t          address;
+    const char       *label;
+    ar_sym_match_kind kind;
+} ar_symbol_match;
+
+/* Labels matching query case-insensitively, best first: exact, prefix,
+ * substring, then fuzzy; shorter and tighter matches rank higher within a
+ * kind.  Returns the number written (at most max).  Pointers stay valid
+ * until the next symbol edit. */
+unsigned ar_sym_find(const char *query, ar_symbol_match *out, unsigned max);
+
+/* Write "label" or "label+0xOFF" for addr in the address space of
+ * region_id, using the nearest label at most max_offset below the resolved
+ * address.  Returns the length written, 0 if there is none.  Results are
+ * cached per (region, mapped bank, address) until a label changes, so this
+ * is cheap enough to call for every traced instruction.  Unlike the rest
+ * of this API, the symbolize functions may be called from any thread. */
+size_t ar_sym_symbolize(const char *region_id, uint64_t addr, uint64_t max_offset,
+                        char *out, size_t out_size);
+
+/* As ar_sym_symbolize, with the bank the caller sees mapped at addr
+ * (negative: none).  ar_sym_symbolize takes it from the cached memory
+ * maps, which a running core only refreshes once per frame. */
+size_t ar_sym_symbolize_bank(const char *region_id, uint64_t addr, int64_t bank,
+                             uint64_t max_offset, char *out, size_t out_size);
+
+/* Bank mapped at addr, negative if none */
+typedef int64_t (*ar_sym_bank_fn)(void *user, uint64_t addr);
+
+/* Copy disassembly text, replacing each '@'-marked operand ("$@0150") with
+ * its symbol (label+offset close to a label) or else the plain number
+ * ("$0150").  bank_of, if not NULL, gives the bank of each operand address.
+ * Returns the length written. */
+size_t ar_sym_symbolize_text(const char *text, const char *region_id,
+                             ar_sym_bank_fn bank_of, void *user,
+                             char *out, size_t out_size);
+
+/* Write / read a JSON snapshot.  ar_sym_load replaces the table. */
 bool ar_sym_save(const char *path);
 bool ar_sym_load(const char *path);
+
+/* Load <rombase>.sym.json, replay <rombase>.sym.journal on top and compact.
+ * Afterwards every edit is appended to the journal with one fsync. */
 void ar_sym_auto_load(void);
 void ar_sym_clear(void);
 
+/* Group edits: journal lines are buffered until the outermost commit,
+ * which appends them with a single fsync. */
+void ar_sym_batch_begin(void);
+void ar_sym_batch_commit(void);
+
+/* Import labels from an assembler/linker symbol file into the primary CPU's
+ * address space, as one batch.  format: "rgbds" (also no$gmb "sym"),
+ * "map" (GNU ld) or "elf" (.symtab); NULL or "" detects it from the file.
+ * Names are sanitized to label syntax.  Returns false if the file cannot
+ * be read or the format is unknown. */
+bool ar_sym_import(const char *path, const char *format,
+                   unsigned *imported, unsigned *skipped);
+
 /* True if address has label or comment. */
 bool ar_sym_has_annotation(const char *region_id, uint64_t addr);
 
@@ -0,0 +1,279 @@
+/*
+ * symimport.cpp: Bulk symbol import from assembler / linker output
+ *
+ * Formats:
+ *   rgbds  RGBDS and no$gmb .sym: "BB:AAAA name" per line, ';' comments
+ *   map    GNU ld .map: "0xADDR  name" lines (and "name = ." assignments)
+ *   elf    ELF32/ELF64 little-endian .symtab (PSX homebrew executables)
+ *
+ * Text formats are read a line at a time; ELF symbols are read from the
+ * symbol table in chunks.  Addresses are in the primary CPU's address
+ * space and resolved through memory maps (banked ones through
+ * ar_sym_resolve_bank).  Labels are collected and set with one
+ * ar_sym_set_bulk call, which merges them into the table in one pass and
+ * journals them as one batch.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include "symbols.hpp"
+#include "backend.hpp"
+
+/* ======================================================================== */
+/* Helpers                                                                   */
+/* ======================================================================== */
+
+struct Importer {
+    struct Def {
+        std::string region;
+        uint64_t    addr;
+        std::string label;
+    };
+
+    const char      *region;
+    unsigned         imported = 0;
+    unsigned         skipped = 0;
+    std::string      label;
+    std::vector<Def> defs;
+
+    /* Labels must match [a-zA-Z_][a-zA-Z0-9_]*: map anything else
+       (local-label dots, '$', '@', ...) to '_' */
+    void add(const char *name, size_t len, uint64_t addr, int64_t bank) {
+        label.assign(name, len);
+        for (char &c : label)
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '_'))
+                c = '_';
+        if (label.empty()) { skipped++; return; }
+        if (label[0] >= '0' && label[0] <= '9') label.insert(0, 1, '_');
+
+        std::optional<ar_resolved_addr> rslv;
+        if (bank >= 0) rslv = ar_sym_resolve_bank(region, addr, bank);
+        if (!rslv) rslv = ar_sym_resolve(region, addr);
+        if (!rslv) { skipped++; return; }
+        defs.push_back({ std::move(rslv->region_id), rslv->addr, label });
+    }
+
+    /* Set every collected label */
+    void commit() {
+        std::vector<ar_symbol_ref> refs;
+        refs.reserve(defs.size());
+        for (auto &d : defs)
+            refs.push_back({ d.region.c_str(), d.addr, d.label.c_str(), nullptr });
+        imported = ar_sym_set_bulk(refs.data(), (unsigned)refs.size());
+        skipped += (unsigned)refs.size() - imported;
+        defs.clear();
+    }
+};
+
+static bool is_ident_char(char c) {
+    return c && c != ' ' && c != '\t' && c != '\r' && c != '\n' && c != ';';
+}
+
+static const char *skip_space(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+/* ======================================================================== */
+/* RGBDS / no$gmb .sym                                                       */
+/* ======================================================================== */
+
+static void import_rgbds(FILE *f, Importer &imp) {
+    char *line = nullptr;
+    size_t cap = 0;
+    while (getline(&line, &cap, f) > 0) {
+        const char *p = skip_space(line);
+        if (*p == ';' || *p == '\0' || *p == '\n' || *p == '\r') continue;
+
+        char *end;
+        uint64_t bank = strtoull(p, &end, 16);
+        if (end == p || *end != ':') { imp.skipped++; continue; }
+        p = end + 1;
+        uint64_t addr = strtoull(p, &end, 16);
+        if (end == p) { imp.skipped++; continue; }
+
+        p = skip_space(end);
+        const char *name = p;
+        while (is_ident_char(*p)) p++;
+        if (p == name) { imp.skipped++; continue; }
+        imp.add(name, (size_t)(p - name), addr, (int64_t)bank);
+    }
+    free(line);
+}
+
+/* ======================================================================== */
+/* GNU ld .map                                                               */
+/* ======================================================================== */
+
+/* Symbol lines are "<ws>0xADDR<ws>name" or "<ws>0xADDR<ws>name = expr";
+   section and input-file lines carry a size and object name instead. */
+static void import_map(FILE *f, Importer &imp) {
+    char *line = nullptr;
+    size_t cap = 0;
+    while (getline(&line, &cap, f) > 0) {
+        const char *p = skip_space(line);
+        if (p == line || p[0] != '0' || (p[1] != 'x' && p[1] != 'X'))
+            continue;   /* symbol lines are indented */
+
+        char *end;
+        uint64_t addr = strtoull(p, &end, 16);
+        p = skip_space(end);
+        const char *name = p;
+        while (is_ident_char(*p)) p++;
+        size_t len = (size_t)(p - name);
+        if (len == 0 || name[0] == '0' || strncmp(name, "PROVIDE", 7) == 0)
+            continue;
+
+        p = skip_space(p);
+        if (*p != '\0' && *p != '\n' && *p != '\r' && *p != '=')
+            continue;   /* "0xADDR 0xSIZE file.o" and similar */
+        imp.add(name, len, addr, -1);
+    }
+    free(line);
+}
+
+/* ======================================================================== */
+/* ELF .symtab                                                               */
+/* ======================================================================== */
+
+static uint64_t rd_le(const uint8_t *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+static bool read_at(FILE *f, uint64_t off, void *buf, size_t size) {
+    return fseek(f, (long)off, SEEK_SET) == 0 && fread(buf, 1, size, f) == size;
+}
+
+static bool import_elf(FILE *f, Importer &imp) {
+    uint8_t eh[64];
+    if (!read_at(f, 0, eh, 52) || memcmp(eh, "\x7f" "ELF", 4) != 0) return false;
+    bool is64 = eh[4] == 2;
+    if (eh[5] != 1) {
+        fprintf(stderr, "[arret] Only little-endian ELF files are supported\n");
+        return false;
+    }
+    if (is64 && !read_at(f, 0, eh, 64)) return false;
+
+    uint64_t shoff    = is64 ? rd_le(eh + 0x28, 8) : rd_le(eh + 0x20, 4);
+    unsigned shentsz  = (unsigned)rd_le(eh + (is64 ? 0x3A : 0x2E), 2);
+    unsigned shnum    = (unsigned)rd_le(eh + (is64 ? 0x3C : 0x30), 2);
+    if (shoff == 0 || shnum == 0 || shentsz < (is64 ? 64u : 40u)) return false;
+
+    std::vector<uint8_t> sh((size_t)shentsz * shnum);
+    if (!read_at(f, shoff, sh.data(), sh.size())) return false;
+
+    struct Section { uint32_t type, link; uint64_t offset, size, entsize; };
+    auto section = [&](unsigned idx) {
+        const uint8_t *s = sh.data() + (size_t)idx * shentsz;
+        Section sec;
+        sec.type = (uint32_t)rd_le(s + 0x04, 4);
+        if (is64) {
+            sec.offset  = rd_le(s + 0x18, 8);
+            sec.size    = rd_le(s + 0x20, 8);
+            sec.link    = (uint32_t)rd_le(s + 0x28, 4);
+            sec.entsize = rd_le(s + 0x38, 8);
+        } else {
+            sec.offset  = rd_le(s + 0x10, 4);
+            sec.size    = rd_le(s + 0x14, 4);
+            sec.link    = (uint32_t)rd_le(s + 0x18, 4);
+            sec.entsize = rd_le(s + 0x24, 4);
+        }
+        return sec;
+    };
+
+    for (unsigned i = 0; i < shnum; i++) {
+        Section symtab = section(i);
+        if (symtab.type != 2) continue;     /* SHT_SYMTAB */
+        if (symtab.link >= shnum || symtab.entsize < (is64 ? 24u : 16u)) continue;
+
+        /* String table: read whole, symbols are streamed */
+        Section strsec = section(symtab.link);
+        uint64_t str_size = strsec.size;
+        std::vector<char> strtab(str_size + 1, '\0');
+        if (!read_at(f, strsec.offset, strtab.data(), str_size)) continue;
+
+        const uint64_t off = symtab.offset, entsize = symtab.entsize;
+        const uint64_t count = symtab.size / entsize;
+        const size_t CHUNK = 1024;
+        std::vector<uint8_t> buf(CHUNK * entsize);
+        for (uint64_t first = 0; first < count; first += CHUNK) {
+            size_t n = (size_t)std::min<uint64_t>(CHUNK, count - first);
+            if (!read_at(f, off + first * entsize, buf.data(), n * entsize))
+                break;
+            for (size_t k = 0; k < n; k++) {
+                const uint8_t *e = buf.data() + k * entsize;
+                uint32_t name  = (uint32_t)rd_le(e, 4);
+                uint8_t  info  = is64 ? e[4] : e[12];
+                uint16_t shndx = (uint16_t)rd_le(e + (is64 ? 6 : 14), 2);
+                uint64_t value = is64 ? rd_le(e + 8, 8) : rd_le(e + 4, 4);
+                unsigned stype = info & 0xF;
+
+                /* NOTYPE/OBJECT/FUNC symbols defined in a section */
+                if (stype > 2 || shndx == 0 || shndx >= 0xFF00) continue;
+                if (name == 0 || name >= str_size) continue;
+                const char *s = strtab.data() + name;
+                if (s[0] == '\0' || s[0] == '$') continue;  /* mapping symbols */
+                imp.add(s, strlen(s), value, -1);
+            }
+        }
+    }
+    return true;
+}
+
+/* ======================================================================== */
+/* Public API                                                                */
+/* ======================================================================== */
+
+static const char *detect_format(FILE *f, const char *path) {
+    unsigned char magic[4] = {0};
+    size_t n = fread(magic, 1, 4, f);
+    rewind(f);
+    if (n == 4 && memcmp(magic, "\x7f" "ELF", 4) == 0) return "elf";
+    const char *dot = strrchr(path, '.');
+    if (dot && strcasecmp(dot, ".map") == 0) return "map";
+    return "rgbds";
+}
+
+bool ar_sym_import(const char *path, const char *format,
+                   unsigned *imported, unsigned *skipped) {
+    if (!ar_has_debug() || !ar_debug_cpu()) return false;
+    rd_Memory const *mem = ar_debug_cpu()->v1.memory_region;
+    if (!mem) return false;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    if (!format || !format[0]) format = detect_format(f, path);
+
+    Importer imp;
+    imp.region = mem->v1.id;
+    bool ok = true;
+
+    if (strcasecmp(format, "rgbds") == 0 || strcasecmp(format, "sym") == 0 ||
+        strcasecmp(format, "nocash") == 0)
+        import_rgbds(f, imp);
+    else if (strcasecmp(format, "map") == 0)
+        import_map(f, imp);
+    else if (strcasecmp(format, "elf") == 0)
+        ok = import_elf(f, imp);
+    else
+        ok = false;
+    imp.commit();
+    fclose(f);
+
+    if (imported) *imported = imp.imported;
+    if (skipped) *skipped = imp.skipped;
+    if (ok)
+        fprintf(stderr, "[arret] Imported %u symbols from %s (%s)\n",
+                imp.imported, path, format);
+    return ok;
+}
@@ -47,6 +47,14 @@ struct Sys {
      * Must return false (trace never halts). */
     bool (*trace_option_on_event)(rd_SubscriptionID sub_id,
                                   rd_Event const *event);
+
+    /* Code analysis roots, in the main CPU's address space.
+     * entry_points are code addresses (reset, interrupt handlers);
+     * entry_vectors are addresses of 16-bit little-endian code pointers. */
+    const uint64_t *entry_points;
+    unsigned num_entry_points;
+    const uint64_t *entry_vectors;
+    unsigned num_entry_vectors;
 };
 
 const Sys *sys_for_desc(const char *description);
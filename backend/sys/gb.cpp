@@ -14,7 +14,18 @@ static const char *const gb_int_names[] = {
     "Joypad",
 };
 
-extern const Sys sys_gb  = { "gb",  gb_int_names, 5 };
-extern const Sys sys_gbc = { "gbc", gb_int_names, 5 };
+/* Cartridge entry, RST vectors, interrupt vectors */
+static const uint64_t gb_entry_points[] = {
+    0x0100,
+    0x0000, 0x0008, 0x0010, 0x0018, 0x0020, 0x0028, 0x0030, 0x0038,
+    0x0040, 0x0048, 0x0050, 0x0058, 0x0060,
+};
+
+extern const Sys sys_gb  = { "gb",  gb_int_names, 5,
+                             nullptr, 0, nullptr, nullptr, nullptr, nullptr,
+                             gb_entry_points, 14, nullptr, 0 };
+extern const Sys sys_gbc = { "gbc", gb_int_names, 5,
+                             nullptr, 0, nullptr, nullptr, nullptr, nullptr,
+                             gb_entry_points, 14, nullptr, 0 };
 
 } // namespace sys
@@ -11,6 +11,11 @@ static const char *const nes_int_names[] = {
     "IRQ",
 };
 
-extern const Sys sys_nes = { "nes", nes_int_names, 2 };
+/* NMI, RESET, IRQ/BRK */
+static const uint64_t nes_entry_vectors[] = { 0xFFFA, 0xFFFC, 0xFFFE };
+
+extern const Sys sys_nes = { "nes", nes_int_names, 2,
+                             nullptr, 0, nullptr, nullptr, nullptr, nullptr,
+                             nullptr, 0, nes_entry_vectors, 3 };
 
 } // namespace sys
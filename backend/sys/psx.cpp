@@ -948,6 +948,9 @@ static bool psx_trace_on_event_dispatch(rd_SubscriptionID sub_id,
  * System descriptor
  * ======================================================================== */
 
+/* BIOS reset, general exception handler */
+static const uint64_t psx_entry_points[] = { 0xBFC00000, 0x80000080 };
+
 extern const Sys sys_psx = {
     "psx",
     psx_int_names, 11,
@@ -956,6 +959,8 @@ extern const Sys sys_psx = {
     psx_trace_option_stop,
     psx_trace_is_sub,
     psx_trace_on_event_dispatch,
+    psx_entry_points, 2,
+    nullptr, 0,
 };
 
 } // namespace sys
@@ -2,15 +2,71 @@
  * psx_gpu_capture.cpp: PSX GPU event capture
  *
  * Core-thread capture of GPU commands with rectangular VRAM diffs.
+ *
+ * Each VRAM-modifying command reads, XORs and compresses only the
+ * rectangle it can touch.  Commands of unknown extent read all of VRAM
+ * and diff the bounding box of what changed.  Every frame boundary does
+ * the same, recording anything the command rectangles missed (DMA
+ * writes, underestimated extents), so reconstruction is exact at frame
+ * granularity.
+ *
+ * Drawing commands whose words say everything they draw (fills, copies,
+ * polygons, rectangles, lines) are replayed on the shadow VRAM by the
+ * software rasterizer, and only the residual between its prediction and
+ * what the core really drew is stored, usually nothing.  The prediction
+ * is kept only when it leaves less to store than the plain diff, so a
+ * core the rasterizer disagrees with costs no more than before.
+ *
+ * A keyframe is taken once the diffs since the last one add up to
+ * KEYFRAME_COST bytes, which bounds the work of reconstructing any event.
+ * Reconstructed states are kept in a small LRU cache; since XOR diffs are
+ * their own inverse, a seek starts from whichever of the nearest keyframe
+ * or a cached state (before or after the target) is cheapest.
+ *
+ * A capture can be written to a file (see "Capture file" below).  Saved
+ * during capture, events are streamed to it in chunks as their diffs
+ * become final and the in-memory diffs are dropped, so RAM use stays
+ * bounded; the finished file is then memory-mapped.  Loaded captures are
+ * memory-mapped too, and replay without a running core.
+ *
+ * The core thread only copies the raw diff bytes into a pooled buffer and
+ * queues them; a small pool of workers compresses them into
+ * GpuCapEvent::diff.  Results land at their event's index, and a
+ * watermark tracks the prefix of events whose diffs are final, so readers
+ * wait only for the events they need.  When the queue holds too many raw
+ * bytes the core thread waits for the workers.
+ *
+ * Events live in fixed-size chunks that never move, and compressed diffs
+ * are bump-allocated from large arena pages, so a long capture makes no
+ * per-event heap allocations.  Capture memory is held to a budget: past
+ * it, a streamed capture spills its ready diffs early, and otherwise the
+ * diffs before the second keyframe are dropped (their events are kept,
+ * marked dropped) and replay starts from that keyframe.
  */
 
 #include "psx_gpu_capture.hpp"
+#include "psx_gpu_raster.hpp"
 #include "backend.hpp"
+#include "memreader.hpp"
 #include "retrodebug_psx.h"
 
 #include <cstring>
 #include <climits>
+#include <cerrno>
+#include <cstdio>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <zlib.h>
 
 namespace sys {
@@ -22,34 +78,75 @@ namespace sys {
 static constexpr int VRAM_W     = 1024;   // halfwords per row
 static constexpr int VRAM_H     = 512;
 static constexpr int VRAM_BYTES = VRAM_W * VRAM_H * 2;  // 1 048 576
-static constexpr int KEYFRAME_INTERVAL = 128;
+static constexpr size_t KEYFRAME_COST = 8u << 20;   // diff bytes between keyframes
+static constexpr size_t DIFF_COST = 4096;           // fixed cost per diff (inflate setup)
+static constexpr size_t RECON_CACHE_SIZE = 8;       // reconstructed VRAM states kept
+static constexpr size_t CHECKPOINT_COST = 1u << 20; // walks longer than this cache their midpoint
+static constexpr int DIFF_LEVEL = Z_BEST_SPEED;
+static constexpr size_t MAX_QUEUED_BYTES = 64u << 20;  // raw diff bytes awaiting compression
+static constexpr size_t MAX_POOLED_BUFFERS = 16;
+static constexpr unsigned MAX_WORKERS = 4;
+static constexpr size_t ARENA_PAGE = 4u << 20;         // compressed diff arena page
+static constexpr size_t DEFAULT_BUDGET = 1024u << 20;  // capture memory budget
 
 /* ======================================================================== */
 /* Compression helpers (zlib, compatible with Qt's qCompress/qUncompress)   */
 /* ======================================================================== */
 
-static std::vector<uint8_t> zcompress(const uint8_t *data, size_t len) {
+/* Deflate state kept per thread: compress2() allocates and initialises
+ * a fresh one per call, which dominates for small rectangle diffs. */
+struct Deflater {
+    z_stream zs{};
+    int level = INT_MIN;
+    ~Deflater() { if (level != INT_MIN) deflateEnd(&zs); }
+};
+
+/* Compress into out, which is reused (its capacity kept) from call to
+ * call.  Returns the compressed length, 0 on failure. */
+static size_t zcompress(const uint8_t *data, size_t len, std::vector<uint8_t> &out,
+                        int level = Z_DEFAULT_COMPRESSION) {
+    thread_local Deflater d;
+    if (d.level != level) {
+        if (d.level != INT_MIN) deflateEnd(&d.zs);
+        d.zs = z_stream{};
+        d.level = INT_MIN;
+        if (deflateInit(&d.zs, level) != Z_OK) return 0;
+        d.level = level;
+    } else if (deflateReset(&d.zs) != Z_OK) {
+        return 0;
+    }
+
     /* qCompress format: 4-byte big-endian uncompressed size + zlib stream */
-    uLongf bound = compressBound((uLong)len);
-    std::vector<uint8_t> out(4 + bound);
+    uLong bound = deflateBound(&d.zs, (uLong)len);
+    if (out.size() < 4 + bound) out.resize(4 + bound);
     out[0] = (uint8_t)((len >> 24) & 0xFF);
     out[1] = (uint8_t)((len >> 16) & 0xFF);
     out[2] = (uint8_t)((len >>  8) & 0xFF);
     out[3] = (uint8_t)((len >>  0) & 0xFF);
-    uLongf dest_len = bound;
-    int rc = compress2(out.data() + 4, &dest_len, data, (uLong)len, Z_DEFAULT_COMPRESSION);
-    if (rc != Z_OK) return {};
-    out.resize(4 + dest_len);
-    return out;
+    d.zs.next_in = const_cast<Bytef *>(data);
+    d.zs.avail_in = (uInt)len;
+    d.zs.next_out = out.data() + 4;
+    d.zs.avail_out = (uInt)bound;
+    if (deflate(&d.zs, Z_FINISH) != Z_STREAM_END) return 0;
+    return 4 + d.zs.total_out;
 }
 
-static bool zuncompress(const std::vector<uint8_t> &src, uint8_t *out, size_t out_len) {
-    if (src.size() < 4) return false;
+static bool zuncompress(const uint8_t *src, size_t len, uint8_t *out, size_t out_len) {
+    if (len < 4) return false;
     uLongf dest_len = (uLongf)out_len;
-    int rc = uncompress(out, &dest_len, src.data() + 4, (uLong)(src.size() - 4));
+    int rc = uncompress(out, &dest_len, src + 4, (uLong)(len - 4));
     return rc == Z_OK && dest_len == (uLongf)out_len;
 }
 
+/* Unpack a stored diff: compressed, or raw where compressing it failed */
+static bool unpackDiff(bool raw, const uint8_t *src, size_t len, uint8_t *out,
+                       size_t out_len) {
+    if (!raw) return zuncompress(src, len, out, out_len);
+    if (len != out_len) return false;
+    memcpy(out, src, len);
+    return true;
+}
+
 /* ======================================================================== */
 /* VRAM bounding rectangle                                                   */
 /* ======================================================================== */
@@ -60,15 +157,16 @@ static inline int sign11(uint32_t v) {
     return (int)(v << 21) >> 21;
 }
 
-/* Compute the VRAM rectangle (halfword coords) affected by a GP0 command.
+/* Compute the VRAM rectangle (halfword coords) affected by a GP0 command,
+ * given the drawing state st in effect for it.
  * Returns false if bounds can't be determined (caller diffs full VRAM). */
 static bool gpuCmdVramRect(const uint32_t *words, unsigned count,
-                           int off_x, int off_y,
-                           int ax1, int ay1, int ax2, int ay2,
-                           VramRect &r)
+                           const GpuRasterState &st, VramRect &r)
 {
     if (count == 0) return false;
     uint8_t op = (uint8_t)(words[0] >> 24);
+    int off_x = st.off_x, off_y = st.off_y;
+    int ax1 = st.area_x1, ay1 = st.area_y1, ax2 = st.area_x2, ay2 = st.area_y2;
 
     int x0, y0, x1, y1;
 
@@ -187,61 +285,189 @@ static bool gpuCmdVramRect(const uint32_t *words, unsigned count,
 /* Rectangular VRAM read/extract/patch helpers                               */
 /* ======================================================================== */
 
-#if 0   /* Disabled along with partial rect diff */
+/* Read rect r from VRAM into out, packed row after row */
 static void readVramRect(rd_Memory const *mem, const VramRect &r, uint8_t *out) {
     unsigned row_bytes = (unsigned)r.w * 2;
     for (int row = 0; row < r.h; row++) {
         uint64_t addr = ((uint64_t)(r.y + row) * VRAM_W + r.x) * 2;
-        if (mem->v1.peek_range)
-            mem->v1.peek_range(mem, addr, row_bytes, out);
-        else
-            for (unsigned b = 0; b < row_bytes; b++)
-                out[b] = mem->v1.peek(mem, addr + b, false);
+        ar_mem_read(mem, addr, row_bytes, out);
         out += row_bytes;
     }
 }
 
+/* XOR the packed rect cur against the same rect of the shadow VRAM prev,
+ * and copy cur into prev.  xor_out may alias cur.  Returns true if any
+ * byte differed. */
+static bool xorRect(const uint8_t *cur, const VramRect &r,
+                    uint8_t *prev, uint8_t *xor_out) {
+    unsigned row_bytes = (unsigned)r.w * 2;
+    uint8_t any = 0;
+    for (int row = 0; row < r.h; row++) {
+        uint8_t *p = prev + ((unsigned)(r.y + row) * VRAM_W + (unsigned)r.x) * 2;
+        for (unsigned b = 0; b < row_bytes; b++) {
+            uint8_t c = cur[b];
+            uint8_t x = c ^ p[b];
+            p[b] = c;
+            xor_out[b] = x;
+            any |= x;
+        }
+        cur += row_bytes;
+        xor_out += row_bytes;
+    }
+    return any != 0;
+}
+
+/* Copy rect r out of a full VRAM image, packed row after row.
+ * out may be the image itself. */
 static void extractRect(const uint8_t *vram, const VramRect &r, uint8_t *out) {
     unsigned row_bytes = (unsigned)r.w * 2;
     for (int row = 0; row < r.h; row++) {
-        unsigned off = ((unsigned)(r.y + row) * VRAM_W + (unsigned)r.x) * 2;
-        memcpy(out, vram + off, row_bytes);
+        memmove(out, vram + ((unsigned)(r.y + row) * VRAM_W + (unsigned)r.x) * 2, row_bytes);
         out += row_bytes;
     }
 }
 
+/* Bounding rectangle of the halfwords that differ between two full VRAM
+ * images.  Returns false if they are identical. */
+static bool changedBounds(const uint8_t *a, const uint8_t *b, VramRect &r) {
+    const unsigned row_bytes = VRAM_W * 2;
+    int x0 = VRAM_W, x1 = -1, y0 = -1, y1 = -1;
+    for (int y = 0; y < VRAM_H; y++) {
+        const uint8_t *pa = a + (size_t)y * row_bytes, *pb = b + (size_t)y * row_bytes;
+        if (memcmp(pa, pb, row_bytes) == 0) continue;
+        int lo = 0, hi = (int)row_bytes - 1;
+        while (pa[lo] == pb[lo]) lo++;
+        while (pa[hi] == pb[hi]) hi--;
+        x0 = std::min(x0, lo / 2);
+        x1 = std::max(x1, hi / 2);
+        if (y0 < 0) y0 = y;
+        y1 = y;
+    }
+    if (y0 < 0) return false;
+    r.x = x0; r.y = y0;
+    r.w = x1 - x0 + 1;
+    r.h = y1 - y0 + 1;
+    return true;
+}
+
+/* Copy a packed rect back into a full VRAM image */
 static void patchRect(uint8_t *vram, const VramRect &r, const uint8_t *src) {
     unsigned row_bytes = (unsigned)r.w * 2;
     for (int row = 0; row < r.h; row++) {
-        unsigned off = ((unsigned)(r.y + row) * VRAM_W + (unsigned)r.x) * 2;
-        memcpy(vram + off, src, row_bytes);
+        memcpy(vram + ((unsigned)(r.y + row) * VRAM_W + (unsigned)r.x) * 2, src, row_bytes);
         src += row_bytes;
     }
 }
 
-static void xorRect(const uint8_t *vram, const VramRect &r,
-                     const uint8_t *prev, uint8_t *xor_out) {
+/* Apply a packed XOR rect to a full VRAM image */
+static void applyXorRect(uint8_t *vram, const VramRect &r, const uint8_t *src) {
     unsigned row_bytes = (unsigned)r.w * 2;
     for (int row = 0; row < r.h; row++) {
-        unsigned off = ((unsigned)(r.y + row) * VRAM_W + (unsigned)r.x) * 2;
+        uint8_t *p = vram + ((unsigned)(r.y + row) * VRAM_W + (unsigned)r.x) * 2;
         for (unsigned b = 0; b < row_bytes; b++)
-            xor_out[row * row_bytes + b] = vram[off + b] ^ prev[off + b];
+            p[b] ^= src[b];
+        src += row_bytes;
     }
 }
-#endif  /* partial rect diff helpers */
+
+/* ======================================================================== */
+/* Diff arena                                                                */
+/* ======================================================================== */
+
+/* Bump allocator for compressed diffs, in ARENA_PAGE pages; a diff larger
+ * than that gets a page of its own.  A page is freed once every diff in it
+ * was released (spilled to the capture file or dropped).  Diffs are
+ * allocated roughly in capture order, so old pages empty out together. */
+class DiffArena {
+public:
+    uint8_t *alloc(size_t len) {
+        Page *p = m_cur;
+        if (!p || p->size - p->used < len) {
+            p = newPage(std::max(len, ARENA_PAGE));
+            if (len < ARENA_PAGE) {
+                Page *old = m_cur;
+                m_cur = p;
+                if (old && old->live == 0) freePage(old);
+            }
+        }
+        uint8_t *out = p->data.get() + p->used;
+        p->used += len;
+        p->live += len;
+        m_live += len;
+        return out;
+    }
+
+    void release(const uint8_t *ptr, size_t len) {
+        auto it = std::prev(m_pages.upper_bound(ptr));
+        Page *p = &it->second;
+        p->live -= len;
+        m_live -= len;
+        if (p->live == 0 && p != m_cur) freePage(p);
+    }
+
+    void clear() {
+        m_pages.clear();
+        m_cur = nullptr;
+        m_bytes = m_live = 0;
+    }
+
+    size_t bytes() const { return m_bytes; }   // pages held
+    size_t live() const { return m_live; }     // diffs not yet released
+
+private:
+    struct Page {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size = 0, used = 0, live = 0;
+    };
+
+    Page *newPage(size_t size) {
+        auto data = std::make_unique<uint8_t[]>(size);
+        const uint8_t *key = data.get();
+        Page &p = m_pages[key];
+        p.data = std::move(data);
+        p.size = size;
+        m_bytes += size;
+        return &p;
+    }
+
+    void freePage(Page *p) {
+        m_bytes -= p->size;
+        m_pages.erase(p->data.get());
+    }
+
+    std::map<const uint8_t *, Page> m_pages;   // by start address
+    Page *m_cur = nullptr;                     // page being filled
+    size_t m_bytes = 0, m_live = 0;
+};
 
 /* ======================================================================== */
 /* Capture state                                                             */
 /* ======================================================================== */
 
+/* g_mutex serialises the core thread's capture state with start/stop and
+ * UI readers.  g_resMutex guards g_events storage (push_back, diff), the
+ * diff arena and the ready flags, so workers can publish results while
+ * the core thread holds g_mutex.  Lock order: g_mutex, then g_resMutex or
+ * g_jobMutex. */
 static std::mutex              g_mutex;
-static std::vector<GpuCapEvent> g_events;
+static std::mutex              g_resMutex;
+static std::condition_variable g_readyCv;
+static GpuCapEventList         g_events;
+static DiffArena               g_arena;
+static std::vector<uint8_t>   g_ready;      // per event: diff is final
+static size_t                  g_readyUpTo = 0;  // events [0, n) are final
+static std::vector<uint32_t>  g_keyframes;  // keyframe event indices, ascending
 static std::vector<uint8_t>   g_prevVram;   // 1MB shadow buffer
+static std::vector<uint8_t>   g_curVram;    // 1MB scratch: VRAM as read now
+static std::vector<uint8_t>   g_saveVram;   // 1MB scratch: shadow rect before a replay
 static rd_Memory const        *g_vramMem = nullptr;
 static rd_SubscriptionID      g_sub = -1;
-static bool                    g_active = false;
+static std::atomic<bool>       g_active{false};
 static unsigned                g_frameCounter = 0;
-static size_t                  g_compressedBytes = 0;
+static size_t                  g_costSinceKey = 0;  // diff cost since the last keyframe
+static std::atomic<size_t>     g_compressedBytes{0};
+static std::atomic<unsigned>   g_generation{0};
+static std::atomic<size_t>     g_budget{DEFAULT_BUDGET};
 
 /* Deferred diff for CPU>VRAM: at post-hook time the transfer hasn't
  * completed yet (InCmd=INCMD_FBWRITE), so we record the event but defer
@@ -250,53 +476,746 @@ static bool                    g_deferred = false;
 static size_t                  g_deferredIdx = 0;
 
 /* GPU drawing state (core thread only, no lock needed) */
-static int g_drawOffX = 0, g_drawOffY = 0;
-static int g_drawAreaX1 = 0, g_drawAreaY1 = 0;
-static int g_drawAreaX2 = VRAM_W - 1, g_drawAreaY2 = VRAM_H - 1;
+static GpuRasterState g_gpu = gpu_raster_reset_state();
+
+/* ======================================================================== */
+/* Compression workers                                                       */
+/* ======================================================================== */
+
+struct DiffJob {
+    unsigned idx = 0;
+    std::vector<uint8_t> raw;   // pooled; may be larger than len
+    size_t len = 0;
+};
+
+static std::mutex              g_jobMutex;
+static std::condition_variable g_jobCv;     // workers: job queued or shutdown
+static std::condition_variable g_spaceCv;   // core thread: queue drained
+static std::deque<DiffJob>     g_jobs;
+static size_t                  g_queuedBytes = 0;
+static std::vector<std::vector<uint8_t>> g_freeBuffers;
+static std::vector<GpuCapWorkerStats>    g_workerStats;
+
+/* Workers outlive a capture and are joined at exit, after draining */
+struct WorkerPool {
+    std::vector<std::thread> threads;
+    bool stop = false;   // guarded by g_jobMutex
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(g_jobMutex);
+            stop = true;
+        }
+        g_jobCv.notify_all();
+        for (auto &t : threads) t.join();
+    }
+};
+static WorkerPool g_pool;
+
+/* Advance the ready watermark.  Must be called with g_resMutex held. */
+static void advanceReady() {
+    while (g_readyUpTo < g_ready.size() && g_ready[g_readyUpTo])
+        g_readyUpTo++;
+}
+
+static std::vector<uint8_t> takeBuffer(size_t len) {
+    std::vector<uint8_t> buf;
+    {
+        std::lock_guard lock(g_jobMutex);
+        if (!g_freeBuffers.empty()) {
+            buf = std::move(g_freeBuffers.back());
+            g_freeBuffers.pop_back();
+        }
+    }
+    if (buf.size() < len) buf.resize(len);
+    return buf;
+}
+
+static void returnBuffer(std::vector<uint8_t> &&buf) {
+    std::lock_guard lock(g_jobMutex);
+    if (g_freeBuffers.size() < MAX_POOLED_BUFFERS)
+        g_freeBuffers.push_back(std::move(buf));
+}
+
+/* Called from the core thread; blocks while too much raw data is queued.
+ * The event at job.idx must already be in g_events. */
+static void queueJob(DiffJob &&job) {
+    {
+        std::unique_lock lock(g_jobMutex);
+        g_spaceCv.wait(lock, [] { return g_queuedBytes < MAX_QUEUED_BYTES; });
+        g_queuedBytes += job.len;
+        g_jobs.push_back(std::move(job));
+    }
+    g_jobCv.notify_one();
+}
+
+static void spillReady(bool all);
+
+static void workerMain(unsigned id) {
+    for (;;) {
+        DiffJob job;
+        {
+            std::unique_lock lock(g_jobMutex);
+            g_jobCv.wait(lock, [] { return g_pool.stop || !g_jobs.empty(); });
+            if (g_jobs.empty()) return;
+            job = std::move(g_jobs.front());
+            g_jobs.pop_front();
+        }
+
+        thread_local std::vector<uint8_t> z;
+        auto t0 = std::chrono::steady_clock::now();
+        size_t zlen = zcompress(job.raw.data(), job.len, z, DIFF_LEVEL);
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+
+        /* Keep the diff raw rather than lose it: replay needs every one */
+        bool raw = zlen == 0;
+        if (raw) {
+            fprintf(stderr, "[arret] GPU capture: compressing event %u failed, stored raw\n",
+                    job.idx);
+            z.assign(job.raw.begin(), job.raw.begin() + (ptrdiff_t)job.len);
+            zlen = job.len;
+        }
+
+        {
+            std::lock_guard lock(g_jobMutex);
+            g_queuedBytes -= job.len;
+            GpuCapWorkerStats &st = g_workerStats[id];
+            st.jobs++;
+            st.raw_bytes += job.len;
+            st.compressed_bytes += zlen;
+            st.busy_ns += (uint64_t)ns;
+            if (g_freeBuffers.size() < MAX_POOLED_BUFFERS)
+                g_freeBuffers.push_back(std::move(job.raw));
+        }
+        g_spaceCv.notify_one();
+        g_compressedBytes += zlen;
+
+        {
+            std::lock_guard lock(g_resMutex);
+            GpuCapEvent &ev = g_events[job.idx];
+            if (zlen) {
+                uint8_t *dst = g_arena.alloc(zlen);
+                memcpy(dst, z.data(), zlen);
+                ev.diff = dst;
+                ev.diff_size = (uint32_t)zlen;
+                ev.raw_diff = raw;
+            }
+            g_ready[job.idx] = 1;
+            advanceReady();
+        }
+        g_readyCv.notify_all();
+        spillReady(false);
+    }
+}
+
+/* Spawn the pool on first use, and reset its statistics */
+static void startWorkers() {
+    std::lock_guard lock(g_jobMutex);
+    if (g_pool.threads.empty()) {
+        /* Leave cores for emulation and the UI */
+        unsigned hc = std::thread::hardware_concurrency();
+        unsigned n = std::clamp(hc > 2 ? hc - 2 : 1u, 1u, MAX_WORKERS);
+        g_workerStats.assign(n, GpuCapWorkerStats{});
+        for (unsigned i = 0; i < n; i++)
+            g_pool.threads.emplace_back(workerMain, i);
+    } else {
+        std::fill(g_workerStats.begin(), g_workerStats.end(), GpuCapWorkerStats{});
+    }
+}
+
+/* Wait until the diffs of events [0, count) are final.  During capture a
+ * CPU>VRAM event still waiting for its transfer is not waited for: only
+ * the core thread can complete it. */
+static void waitReady(size_t count) {
+    if (g_deferred && count > g_deferredIdx)
+        count = g_deferredIdx;
+    std::unique_lock lock(g_resMutex);
+    count = std::min(count, g_ready.size());
+    g_readyCv.wait(lock, [count] { return g_readyUpTo >= count; });
+}
+
+/* ======================================================================== */
+/* Capture file                                                              */
+/* ======================================================================== */
+
+/* Layout, in host byte order (little-endian on every supported host):
+ *   FileHeader
+ *   chunks:  ChunkHeader, FileEvent[count], then the diffs they reference
+ *   index:   IndexHeader, uint64_t chunk_offsets[], uint32_t keyframes[]
+ * The header's index_offset is written last.  A file without it (capture
+ * interrupted) is still readable by walking the chunks. */
+
+static constexpr char     CAPFILE_MAGIC[8] = { 'A', 'R', 'G', 'P', 'U', 'C', 'A', 'P' };
+static constexpr uint32_t CAPFILE_VERSION  = 3;            // 2 lacks FE_RAW, still read
+static constexpr uint32_t CHUNK_MAGIC      = 0x4B4E4843;   // "CHNK"
+static constexpr uint32_t INDEX_MAGIC      = 0x58444E49;   // "INDX"
+static constexpr size_t   CHUNK_EVENTS     = 256;          // events per chunk
+
+struct FileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;    // sizeof(FileEvent)
+    uint64_t event_count;    // 0 until finished
+    uint64_t index_offset;   // 0 until finished
+};
+
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t count;          // FileEvent records that follow
+    uint64_t first_event;
+    uint64_t diff_bytes;     // diff data after the records
+};
+
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t num_chunks;
+    uint64_t num_keyframes;
+};
+
+enum : uint8_t { FE_KEYFRAME = 1, FE_HAS_DIFF = 2, FE_REPLAYED = 4, FE_RAW = 8 };
+
+struct FileEvent {
+    uint8_t  type, port, source, flags;
+    uint32_t word_count;
+    uint32_t words[16];
+    uint32_t pc;
+    uint32_t frame_number;
+    uint16_t diff_x, diff_y, diff_w, diff_h;
+    uint64_t diff_offset;    // absolute file offset
+    uint32_t diff_size;      // 0: no diff
+    uint32_t reserved;
+    GpuRasterState state;    // drawing state for replay
+    uint32_t reserved2;
+};
+static_assert(sizeof(FileEvent) == 128, "capture file record layout");
+
+struct CapWriter {
+    int fd = -1;
+    uint64_t pos = 0;        // end of file
+    uint64_t events = 0;     // events written
+    std::vector<uint64_t> chunks;
+    std::vector<uint32_t> keyframes;
+};
+
+/* The file being streamed to during capture.  g_fileMutex also serialises
+ * reads of diffs that were already moved to it. */
+static std::mutex        g_fileMutex;
+static CapWriter         g_writer;
+static std::string       g_streamPath;
+static std::atomic<bool> g_streaming{false};
+
+/* Mapped file backing the current capture's spilled or loaded diffs */
+static const uint8_t *g_map = nullptr;
+static size_t         g_mapSize = 0;
+
+static bool writeAll(int fd, const void *data, size_t len) {
+    auto *p = static_cast<const uint8_t *>(data);
+    while (len > 0) {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool writerOpen(CapWriter &w, const char *path) {
+    w = CapWriter{};
+    w.fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w.fd < 0) return false;
+    FileHeader h{};
+    memcpy(h.magic, CAPFILE_MAGIC, sizeof(h.magic));
+    h.version = CAPFILE_VERSION;
+    h.record_size = sizeof(FileEvent);
+    if (!writeAll(w.fd, &h, sizeof(h))) {
+        ::close(w.fd);
+        w.fd = -1;
+        return false;
+    }
+    w.pos = sizeof(h);
+    return true;
+}
+
+static FileEvent toRecord(const GpuCapEvent &ev) {
+    FileEvent r{};
+    r.type = ev.type;
+    r.port = ev.port;
+    r.source = ev.source;
+    if (!ev.dropped)
+        r.flags = (ev.is_keyframe ? FE_KEYFRAME : 0) | (ev.has_diff ? FE_HAS_DIFF : 0) |
+                  (ev.replayed ? FE_REPLAYED : 0) | (ev.raw_diff ? FE_RAW : 0);
+    r.word_count = ev.word_count;
+    memcpy(r.words, ev.words, sizeof(r.words));
+    r.pc = ev.pc;
+    r.frame_number = ev.frame_number;
+    r.diff_x = ev.diff_x; r.diff_y = ev.diff_y;
+    r.diff_w = ev.diff_w; r.diff_h = ev.diff_h;
+    r.state = ev.state;
+    return r;
+}
+
+static GpuCapEvent fromRecord(const FileEvent &r) {
+    GpuCapEvent ev{};
+    ev.type = r.type == GpuCapEvent::FRAME_BOUNDARY ? GpuCapEvent::FRAME_BOUNDARY
+                                                     : GpuCapEvent::GPU_COMMAND;
+    ev.port = r.port;
+    ev.source = r.source;
+    ev.is_keyframe = r.flags & FE_KEYFRAME;
+    ev.has_diff = (r.flags & FE_HAS_DIFF) && r.diff_size > 0;
+    ev.replayed = (r.flags & FE_REPLAYED) && ev.type == GpuCapEvent::GPU_COMMAND;
+    ev.raw_diff = r.flags & FE_RAW;
+    ev.word_count = std::min<uint32_t>(r.word_count, 16);
+    memcpy(ev.words, r.words, sizeof(ev.words));
+    ev.pc = r.pc;
+    ev.frame_number = r.frame_number;
+    ev.diff_x = r.diff_x; ev.diff_y = r.diff_y;
+    ev.diff_w = r.diff_w; ev.diff_h = r.diff_h;
+    ev.state = r.state;
+    ev.file_offset = r.diff_offset;
+    ev.file_size = r.diff_size;
+    return ev;
+}
+
+/* Append one chunk.  diffs[i] is recs[i]'s compressed diff (empty span for
+ * none); the records' diff_offset and diff_size are filled in. */
+static bool writerChunk(CapWriter &w, std::vector<FileEvent> &recs,
+                        const std::vector<std::pair<const uint8_t *, size_t>> &diffs) {
+    ChunkHeader ch{ CHUNK_MAGIC, (uint32_t)recs.size(), w.events, 0 };
+    uint64_t off = w.pos + sizeof(ch) + recs.size() * sizeof(FileEvent);
+    for (size_t i = 0; i < recs.size(); i++) {
+        recs[i].diff_offset = diffs[i].second ? off + ch.diff_bytes : 0;
+        recs[i].diff_size = (uint32_t)diffs[i].second;
+        ch.diff_bytes += diffs[i].second;
+    }
+    if (!writeAll(w.fd, &ch, sizeof(ch)) ||
+        !writeAll(w.fd, recs.data(), recs.size() * sizeof(FileEvent)))
+        return false;
+    for (const auto &d : diffs)
+        if (d.second && !writeAll(w.fd, d.first, d.second))
+            return false;
+
+    for (size_t i = 0; i < recs.size(); i++)
+        if (recs[i].flags & FE_KEYFRAME)
+            w.keyframes.push_back((uint32_t)(w.events + i));
+    w.chunks.push_back(w.pos);
+    w.pos = off + ch.diff_bytes;
+    w.events += recs.size();
+    return true;
+}
+
+/* Write the index and the final header, and close the file */
+static bool writerFinish(CapWriter &w) {
+    IndexHeader ih{ INDEX_MAGIC, (uint32_t)w.chunks.size(), w.keyframes.size() };
+    bool ok = writeAll(w.fd, &ih, sizeof(ih)) &&
+              writeAll(w.fd, w.chunks.data(), w.chunks.size() * sizeof(uint64_t)) &&
+              writeAll(w.fd, w.keyframes.data(), w.keyframes.size() * sizeof(uint32_t));
+
+    FileHeader h{};
+    memcpy(h.magic, CAPFILE_MAGIC, sizeof(h.magic));
+    h.version = CAPFILE_VERSION;
+    h.record_size = sizeof(FileEvent);
+    h.event_count = w.events;
+    h.index_offset = w.pos;
+    ok = ok && pwrite(w.fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+    ok = ::close(w.fd) == 0 && ok;
+    w.fd = -1;
+    return ok;
+}
+
+static void unmapFile() {
+    if (g_map) munmap(const_cast<uint8_t *>(g_map), g_mapSize);
+    g_map = nullptr;
+    g_mapSize = 0;
+}
+
+static bool mapFile(const char *path, const uint8_t *&map, size_t &size) {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(FileHeader))
+        p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    map = static_cast<const uint8_t *>(p);
+    size = (size_t)st.st_size;
+    return true;
+}
+
+/* Parse a mapped capture file.  Headers may be unaligned, hence memcpy. */
+static bool parseFile(const uint8_t *map, size_t size,
+                      GpuCapEventList &events, std::vector<uint32_t> &keyframes) {
+    FileHeader h;
+    memcpy(&h, map, sizeof(h));
+    if (memcmp(h.magic, CAPFILE_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version < 2 || h.version > CAPFILE_VERSION || h.record_size != sizeof(FileEvent))
+        return false;
+
+    /* Chunk offsets from the index, or by walking the chunks */
+    std::vector<uint64_t> chunks;
+    bool indexed = false;
+    IndexHeader ih{};
+    if (h.index_offset && h.index_offset <= size - sizeof(ih)) {
+        memcpy(&ih, map + h.index_offset, sizeof(ih));
+        uint64_t need = sizeof(ih) + (uint64_t)ih.num_chunks * sizeof(uint64_t) +
+                        ih.num_keyframes * sizeof(uint32_t);
+        if (ih.magic == INDEX_MAGIC && need <= size - h.index_offset) {
+            chunks.resize(ih.num_chunks);
+            memcpy(chunks.data(), map + h.index_offset + sizeof(ih),
+                   chunks.size() * sizeof(uint64_t));
+            indexed = true;
+        }
+    }
+    if (!indexed) {
+        uint64_t off = sizeof(h);
+        while (off + sizeof(ChunkHeader) <= size) {
+            ChunkHeader ch;
+            memcpy(&ch, map + off, sizeof(ch));
+            uint64_t end = off + sizeof(ch) + (uint64_t)ch.count * sizeof(FileEvent) + ch.diff_bytes;
+            if (ch.magic != CHUNK_MAGIC || end > size) break;
+            chunks.push_back(off);
+            off = end;
+        }
+    }
+
+    events.clear();
+    keyframes.clear();
+    for (uint64_t off : chunks) {
+        if (off > size - sizeof(ChunkHeader)) return false;
+        ChunkHeader ch;
+        memcpy(&ch, map + off, sizeof(ch));
+        if (ch.magic != CHUNK_MAGIC || ch.first_event != events.size() ||
+            (uint64_t)ch.count * sizeof(FileEvent) > size - off - sizeof(ch))
+            return false;
+        const uint8_t *rec = map + off + sizeof(ch);
+        for (uint32_t i = 0; i < ch.count; i++, rec += sizeof(FileEvent)) {
+            FileEvent r;
+            memcpy(&r, rec, sizeof(r));
+            if (r.diff_size && (r.diff_offset > size || r.diff_size > size - r.diff_offset))
+                return false;
+            if (r.flags & FE_KEYFRAME)
+                keyframes.push_back((uint32_t)events.size());
+            events.push_back(fromRecord(r));
+        }
+    }
+    return true;
+}
+
+/* Write events whose diffs are final to the streaming file and drop the
+ * in-memory copies.  Unless all is set, waits for a full chunk, and skips
+ * the work if another thread is already writing. */
+static void spillReady(bool all) {
+    if (!g_streaming) return;
+    std::unique_lock flock(g_fileMutex, std::defer_lock);
+    if (all) flock.lock();
+    else if (!flock.try_lock()) return;
+
+    while (g_writer.fd >= 0) {
+        size_t first = g_writer.events, end;
+        std::vector<FileEvent> recs;
+        std::vector<std::pair<const uint8_t *, size_t>> diffs;
+        {
+            /* Final diffs stay put in the arena until released below */
+            std::lock_guard lock(g_resMutex);
+            end = std::min(g_readyUpTo, first + CHUNK_EVENTS);
+            if (end == first || (!all && end - first < CHUNK_EVENTS)) return;
+            for (size_t i = first; i < end; i++) {
+                const GpuCapEvent &ev = g_events[i];
+                recs.push_back(toRecord(ev));
+                diffs.emplace_back(ev.diff, ev.diff ? ev.diff_size : 0);
+            }
+        }
+
+        bool ok = writerChunk(g_writer, recs, diffs);
+
+        if (ok) {
+            std::lock_guard lock(g_resMutex);
+            for (size_t i = first; i < end; i++) {
+                GpuCapEvent &ev = g_events[i];
+                ev.file_offset = recs[i - first].diff_offset;
+                ev.file_size = recs[i - first].diff_size;
+                if (ev.diff) g_arena.release(ev.diff, ev.diff_size);
+                ev.diff = nullptr;
+            }
+        }
+        if (!ok) {
+            /* Keep capturing in memory */
+            fprintf(stderr, "[arret] GPU capture: write to %s failed: %s\n",
+                    g_streamPath.c_str(), strerror(errno));
+            ::close(g_writer.fd);
+            g_writer.fd = -1;
+            g_streaming = false;
+        }
+    }
+}
+
+/* Compressed diff of ev: in memory, in the mapped capture file, or read
+ * back from the file being streamed into scratch. */
+static bool diffData(const GpuCapEvent &ev, const uint8_t *&data, size_t &len,
+                     std::vector<uint8_t> &scratch) {
+    if (ev.diff) {
+        data = ev.diff;
+        len = ev.diff_size;
+        return true;
+    }
+    if (!ev.file_size) return false;
+    if (g_map) {
+        if (ev.file_offset > g_mapSize || ev.file_size > g_mapSize - ev.file_offset)
+            return false;
+        data = g_map + ev.file_offset;
+        len = ev.file_size;
+        return true;
+    }
+    std::lock_guard lock(g_fileMutex);
+    if (g_writer.fd < 0) return false;
+    scratch.resize(ev.file_size);
+    if (pread(g_writer.fd, scratch.data(), ev.file_size, (off_t)ev.file_offset) !=
+        (ssize_t)ev.file_size)
+        return false;
+    data = scratch.data();
+    len = ev.file_size;
+    return true;
+}
+
+/* Flush the rest of a streamed capture and switch to reading it mapped.
+ * Must be called with g_mutex held, after the last event. */
+static void finishStream() {
+    if (!g_streaming) return;
+    waitReady(SIZE_MAX);
+    spillReady(true);
+
+    std::lock_guard flock(g_fileMutex);
+    g_streaming = false;
+    if (g_writer.fd < 0) return;
+    if (!writerFinish(g_writer))
+        fprintf(stderr, "[arret] GPU capture: finishing %s failed: %s\n",
+                g_streamPath.c_str(), strerror(errno));
+    if (!mapFile(g_streamPath.c_str(), g_map, g_mapSize))
+        fprintf(stderr, "[arret] GPU capture: cannot map %s\n", g_streamPath.c_str());
+}
 
 /* ======================================================================== */
 /* Full VRAM read helper                                                     */
 /* ======================================================================== */
 
 static void readFullVram(rd_Memory const *mem, uint8_t *buf) {
-    if (mem->v1.peek_range && mem->v1.peek_range(mem, 0, VRAM_BYTES, buf))
-        return;
-    for (int i = 0; i < VRAM_BYTES; i++)
-        buf[i] = mem->v1.peek(mem, i, false);
+    ar_mem_read(mem, 0, VRAM_BYTES, buf);
 }
 
 /* ======================================================================== */
 /* Deferred diff completion                                                  */
 /* ======================================================================== */
 
+static GpuRasterClip rectClip(const VramRect &r) {
+    return { r.x, r.y, r.x + r.w - 1, r.y + r.h - 1 };
+}
+
+/* Replay ev's command on the shadow VRAM within r, as the prediction its
+ * diff is taken against; cur is r as the core really drew it.  The
+ * prediction is undone (returns false) unless fewer bytes differ from it
+ * than from the shadow as it was.  Must be called with g_mutex held. */
+static bool replayRect(const GpuCapEvent &ev, const VramRect &r, const uint8_t *cur) {
+    if (ev.type != GpuCapEvent::GPU_COMMAND || ev.port != 0 ||
+        !gpu_raster_can_exec(ev.words, ev.word_count))
+        return false;
+    uint8_t *save = g_saveVram.data();
+    extractRect(g_prevVram.data(), r, save);
+    gpu_raster_exec(ev.state, g_prevVram.data(), ev.words, ev.word_count, rectClip(r));
+
+    unsigned row_bytes = (unsigned)r.w * 2;
+    size_t plain = 0, residual = 0;
+    for (int row = 0; row < r.h; row++) {
+        const uint8_t *p = g_prevVram.data() + ((unsigned)(r.y + row) * VRAM_W + (unsigned)r.x) * 2;
+        const uint8_t *c = cur + (size_t)row * row_bytes, *o = save + (size_t)row * row_bytes;
+        for (unsigned b = 0; b < row_bytes; b++) {
+            plain += c[b] != o[b];
+            residual += c[b] != p[b];
+        }
+    }
+    if (residual < plain) return true;
+    patchRect(g_prevVram.data(), r, save);
+    return false;
+}
+
+/* Record the VRAM change since the previous diff into ev.  Keyframes
+ * hold all of VRAM; otherwise rect (when known) bounds the XOR diff,
+ * taken against the replayed command where that predicts it better.  The
+ * raw bytes go into job for the compression workers; returns false (and
+ * leaves ev.diff empty) if nothing is left to store.  Must be called with
+ * g_mutex held. */
+static bool storeDiff(GpuCapEvent &ev, bool keyframe, const VramRect *rect, DiffJob &job) {
+#ifdef GPU_CAPTURE_ALL_KEYFRAMES
+    keyframe = true;
+#endif
+    if (keyframe) {
+        readFullVram(g_vramMem, g_curVram.data());
+        g_costSinceKey = 0;
+        ev.is_keyframe = true;
+        g_prevVram.swap(g_curVram);
+        ev.has_diff = true;
+        job.raw = takeBuffer(VRAM_BYTES);
+        job.len = VRAM_BYTES;
+        memcpy(job.raw.data(), g_prevVram.data(), VRAM_BYTES);
+        return true;
+    }
+
+    ev.is_keyframe = false;
+    ev.replayed = false;
+    VramRect r;
+    if (rect) {
+        r = *rect;
+        readVramRect(g_vramMem, r, g_curVram.data());
+        ev.replayed = replayRect(ev, r, g_curVram.data());
+        if (ev.replayed)
+            g_costSinceKey += (size_t)r.w * r.h * 2;
+    } else {
+        /* Unknown extent: diff the bounding box of what actually changed */
+        ev.diff_x = ev.diff_y = ev.diff_w = ev.diff_h = 0;
+        readFullVram(g_vramMem, g_curVram.data());
+        if (!changedBounds(g_curVram.data(), g_prevVram.data(), r))
+            return false;
+        ev.diff_x = (uint16_t)r.x;
+        ev.diff_y = (uint16_t)r.y;
+        ev.diff_w = (uint16_t)r.w;
+        ev.diff_h = (uint16_t)r.h;
+        extractRect(g_curVram.data(), r, g_curVram.data());
+    }
+
+    job.len = (size_t)r.w * r.h * 2;
+    job.raw = takeBuffer(job.len);
+    if (!xorRect(g_curVram.data(), r, g_prevVram.data(), job.raw.data())) {
+        returnBuffer(std::move(job.raw));
+        return false;
+    }
+    g_costSinceKey += job.len + DIFF_COST;
+    ev.has_diff = true;
+    return true;
+}
+
+static bool keyframeDue() {
+    return g_costSinceKey >= KEYFRAME_COST;
+}
+
+/* Memory held by events and diffs.  Must be called with g_resMutex held. */
+static size_t captureMemory() {
+    return g_events.memory() + g_arena.bytes();
+}
+
+/* Drop the diffs of the oldest stretch, up to the second keyframe, so
+ * replay starts there.  Without a second keyframe, asks for one instead.
+ * Returns false if nothing could be dropped yet.  Must be called with
+ * g_mutex and g_resMutex held. */
+static bool dropOldest() {
+    if (g_keyframes.size() < 2) {
+        g_costSinceKey = KEYFRAME_COST;
+        return false;
+    }
+    unsigned end = g_keyframes[1];
+    if (end >= g_readyUpTo) return false;   // diffs before it still compressing
+
+    for (unsigned i = g_keyframes[0]; i < end; i++) {
+        GpuCapEvent &ev = g_events[i];
+        if (ev.diff) g_arena.release(ev.diff, ev.diff_size);
+        ev.diff = nullptr;
+        ev.dropped = true;
+    }
+    g_keyframes.erase(g_keyframes.begin());
+    return true;
+}
+
+/* Drop the oldest frames until within budget.  Event records themselves
+ * are never dropped, so once the diffs are down to a page there is
+ * nothing left to gain.  Must be called with g_mutex and g_resMutex held. */
+static void trimToBudget() {
+    size_t dropped = 0;
+    while (captureMemory() > g_budget && g_arena.live() >= ARENA_PAGE && dropOldest())
+        dropped++;
+    if (dropped)
+        fprintf(stderr, "[arret] GPU capture: over budget, replay now starts at event %u\n",
+                g_keyframes.front());
+}
+
+/* Stay within the memory budget: write out what can be written when
+ * streaming, else drop the oldest frames.  Must be called with g_mutex
+ * held. */
+static void enforceBudget() {
+    {
+        std::lock_guard lock(g_resMutex);
+        if (captureMemory() <= g_budget || g_arena.live() < ARENA_PAGE) return;
+        if (!g_streaming) {
+            trimToBudget();
+            return;
+        }
+    }
+    spillReady(true);
+}
+
+/* Append an event, then queue its diff job if it has one.  A deferred
+ * event is pushed pending with no job.  Must be called with g_mutex held. */
+static void pushEvent(GpuCapEvent &&ev, DiffJob *job, bool deferred = false) {
+    unsigned idx;
+    {
+        std::lock_guard lock(g_resMutex);
+        idx = (unsigned)g_events.size();
+        if (ev.is_keyframe)
+            g_keyframes.push_back(idx);
+        g_events.push_back(std::move(ev));
+        g_ready.push_back(job || deferred ? 0 : 1);
+        advanceReady();
+    }
+    if (job) {
+        job->idx = idx;
+        queueJob(std::move(*job));
+    }
+    enforceBudget();
+}
+
+static bool eventRect(const GpuCapEvent &ev, VramRect &r) {
+    if (ev.diff_w == 0 || ev.diff_h == 0) return false;
+    r.x = ev.diff_x; r.y = ev.diff_y; r.w = ev.diff_w; r.h = ev.diff_h;
+    return true;
+}
+
 /* Complete the deferred VRAM diff for a previous CPU>VRAM event.
  * Must be called with g_mutex held and g_deferred == true. */
 static void completeDeferredDiff() {
     if (!g_deferred || !g_vramMem) return;
     g_deferred = false;
 
-    GpuCapEvent &ev = g_events[g_deferredIdx];
-
-    std::vector<uint8_t> cur(VRAM_BYTES);
-    readFullVram(g_vramMem, cur.data());
+    unsigned idx = (unsigned)g_deferredIdx;
+    GpuCapEvent ev;
+    {
+        std::lock_guard lock(g_resMutex);
+        ev = g_events[idx];
+    }
+    VramRect rect;
+    bool have_rect = eventRect(ev, rect);
+    DiffJob job;
+    bool changed = storeDiff(ev, keyframeDue(), have_rect ? &rect : nullptr, job);
 
-#ifdef GPU_CAPTURE_ALL_KEYFRAMES
-    ev.is_keyframe = true;
-    ev.diff = zcompress(cur.data(), VRAM_BYTES);
-#else
-    if (g_deferredIdx % KEYFRAME_INTERVAL == 0) {
-        ev.is_keyframe = true;
-        ev.diff = zcompress(cur.data(), VRAM_BYTES);
+    {
+        std::lock_guard lock(g_resMutex);
+        GpuCapEvent &dst = g_events[idx];
+        dst.is_keyframe = ev.is_keyframe;
+        dst.has_diff = ev.has_diff;
+        dst.replayed = ev.replayed;
+        if (ev.is_keyframe)
+            g_keyframes.push_back(idx);
+        dst.diff_x = ev.diff_x; dst.diff_y = ev.diff_y;
+        dst.diff_w = ev.diff_w; dst.diff_h = ev.diff_h;
+        if (!changed) {
+            g_ready[idx] = 1;
+            advanceReady();
+        }
+    }
+    if (changed) {
+        job.idx = idx;
+        queueJob(std::move(job));
     } else {
-        std::vector<uint8_t> xd(VRAM_BYTES);
-        for (int i = 0; i < VRAM_BYTES; i++)
-            xd[i] = cur[i] ^ g_prevVram[i];
-        ev.is_keyframe = false;
-        ev.diff = zcompress(xd.data(), VRAM_BYTES);
+        g_readyCv.notify_all();
     }
-#endif
-    g_prevVram = std::move(cur);
-    g_compressedBytes += ev.diff.size();
 }
 
 /* ======================================================================== */
@@ -314,23 +1233,10 @@ static bool onCaptureEvent(rd_SubscriptionID, rd_Event const *event) {
     uint32_t pc     = post->pc;
     unsigned source = post->source;
 
-    /* Track GPU drawing state from config commands */
-    if (port == 0 && count > 0) {
-        uint8_t cfg = (uint8_t)(words[0] >> 24);
-        if (cfg == 0xE3) {
-            g_drawAreaX1 = words[0] & 0x3FF;
-            g_drawAreaY1 = (words[0] >> 10) & 0x1FF;
-        } else if (cfg == 0xE4) {
-            g_drawAreaX2 = words[0] & 0x3FF;
-            g_drawAreaY2 = (words[0] >> 10) & 0x1FF;
-        } else if (cfg == 0xE5) {
-            g_drawOffX = sign11(words[0] & 0x7FF);
-            g_drawOffY = sign11((words[0] >> 11) & 0x7FF);
-        }
-    }
-
-    /* Build event record */
+    /* Build event record, with the drawing state the command runs in */
     GpuCapEvent ev{};
+    ev.state = g_gpu;
+    gpu_raster_update_state(g_gpu, port, words, count);
     ev.type = GpuCapEvent::GPU_COMMAND;
     ev.port = (uint8_t)port;
     ev.source = (uint8_t)source;
@@ -361,14 +1267,9 @@ static bool onCaptureEvent(rd_SubscriptionID, rd_Event const *event) {
     unsigned eventIdx = (unsigned)g_events.size();
 
     if (modifies_vram && g_vramMem) {
-        /* Compute bounding box for UI overlay */
+        /* Bounding box: limits the diff and drives the UI overlay */
         VramRect rect;
-        bool have_rect = gpuCmdVramRect(
-            ev.words, ev.word_count,
-            g_drawOffX, g_drawOffY,
-            g_drawAreaX1, g_drawAreaY1,
-            g_drawAreaX2, g_drawAreaY2,
-            rect);
+        bool have_rect = gpuCmdVramRect(ev.words, ev.word_count, ev.state, rect);
 
         if (have_rect) {
             ev.diff_x = (uint16_t)rect.x;
@@ -380,37 +1281,20 @@ static bool onCaptureEvent(rd_SubscriptionID, rd_Event const *event) {
         if (is_cpu_to_vram) {
             /* CPU>VRAM: defer diff — VRAM hasn't been updated yet at
              * post-hook time (only InCmd=INCMD_FBWRITE is set). */
-            g_events.push_back(std::move(ev));
+            pushEvent(std::move(ev), nullptr, true);
             g_deferred = true;
             g_deferredIdx = eventIdx;
             return false;
         }
 
-        {
-            std::vector<uint8_t> cur(VRAM_BYTES);
-            readFullVram(g_vramMem, cur.data());
-
-#ifdef GPU_CAPTURE_ALL_KEYFRAMES
-            ev.is_keyframe = true;
-            ev.diff = zcompress(cur.data(), VRAM_BYTES);
-#else
-            if (eventIdx % KEYFRAME_INTERVAL == 0) {
-                ev.is_keyframe = true;
-                ev.diff = zcompress(cur.data(), VRAM_BYTES);
-            } else {
-                std::vector<uint8_t> xd(VRAM_BYTES);
-                for (int i = 0; i < VRAM_BYTES; i++)
-                    xd[i] = cur[i] ^ g_prevVram[i];
-                ev.is_keyframe = false;
-                ev.diff = zcompress(xd.data(), VRAM_BYTES);
-            }
-#endif
-            g_prevVram = std::move(cur);
+        DiffJob job;
+        if (storeDiff(ev, keyframeDue(), have_rect ? &rect : nullptr, job)) {
+            pushEvent(std::move(ev), &job);
+            return false;
         }
-        g_compressedBytes += ev.diff.size();
     }
 
-    g_events.push_back(std::move(ev));
+    pushEvent(std::move(ev), nullptr);
     return false;
 }
 
@@ -418,6 +1302,100 @@ static bool isCaptureSubFilter(rd_SubscriptionID sub_id) {
     return g_active && sub_id == g_sub;
 }
 
+/* ======================================================================== */
+/* Reconstruction                                                            */
+/* ======================================================================== */
+
+/* Reconstructed VRAM at event idx (an event with a diff) */
+struct CachedVram {
+    unsigned idx = 0;
+    uint64_t stamp = 0;          // last use
+    std::vector<uint8_t> vram;   // empty: slot unused
+};
+
+static std::mutex  g_cacheMutex;
+static CachedVram  g_cache[RECON_CACHE_SIZE];
+static uint64_t    g_cacheClock = 0;
+
+/* Relative cost of stepping over an event: replay plus diff */
+static size_t diffCost(const GpuCapEvent &ev) {
+    VramRect r;
+    size_t bytes = ev.is_keyframe || !eventRect(ev, r) ? VRAM_BYTES : (size_t)r.w * r.h * 2;
+    return (ev.replayed ? bytes : 0) + (ev.has_diff ? DIFF_COST + bytes : 0);
+}
+
+/* XOR a non-keyframe diff into vram.  XOR is its own inverse, so this
+ * steps forward or backward over the event alike. */
+static void applyDiff(const GpuCapEvent &ev, uint8_t *vram) {
+    static thread_local std::vector<uint8_t> xd, scratch;
+    const uint8_t *z;
+    size_t zlen;
+    if (!ev.has_diff || ev.is_keyframe || !diffData(ev, z, zlen, scratch)) return;
+    xd.resize(VRAM_BYTES);
+    VramRect r;
+    if (eventRect(ev, r)) {
+        if (unpackDiff(ev.raw_diff, z, zlen, xd.data(), (size_t)r.w * r.h * 2))
+            applyXorRect(vram, r, xd.data());
+    } else if (unpackDiff(ev.raw_diff, z, zlen, xd.data(), VRAM_BYTES)) {
+        for (int j = 0; j < VRAM_BYTES; j++)
+            vram[j] ^= xd[j];
+    }
+}
+
+/* Step vram forward over event ev: replay its command, then apply the
+ * diff.  Only diffs can be stepped back over. */
+static void stepEvent(const GpuCapEvent &ev, uint8_t *vram) {
+    VramRect r;
+    if (ev.replayed && eventRect(ev, r))
+        gpu_raster_exec(ev.state, vram, ev.words, ev.word_count, rectClip(r));
+    applyDiff(ev, vram);
+}
+
+static inline bool changesVram(const GpuCapEvent &ev) {
+    return ev.has_diff || ev.replayed;
+}
+
+/* Remember vram as the state at event idx, replacing the least recently
+ * used slot.  Must be called with g_cacheMutex held. */
+static CachedVram *cacheStore(unsigned idx, const uint8_t *vram) {
+    CachedVram *slot = &g_cache[0];
+    for (auto &c : g_cache) {
+        if (c.vram.empty()) { slot = &c; break; }
+        if (c.stamp < slot->stamp) slot = &c;
+    }
+    slot->vram.resize(VRAM_BYTES);
+    memcpy(slot->vram.data(), vram, VRAM_BYTES);
+    slot->idx = idx;
+    slot->stamp = ++g_cacheClock;
+    return slot;
+}
+
+/* Step vram forward over events (from, to], cost being their total
+ * diffCost().  Replays can't be stepped back over, so a long walk caches
+ * the state halfway: seeking backwards then halves the distance each time
+ * instead of starting over from the keyframe. */
+static void stepForward(unsigned from, unsigned to, size_t cost, uint8_t *vram) {
+    size_t done = 0;
+    bool mid = cost < CHECKPOINT_COST;
+    for (unsigned i = from + 1; i <= to; i++) {
+        stepEvent(g_events[i], vram);
+        done += diffCost(g_events[i]);
+        if (!mid && done >= cost / 2 && i < to) {
+            cacheStore(i, vram);
+            mid = true;
+        }
+    }
+}
+
+static void clearCache() {
+    std::lock_guard lock(g_cacheMutex);
+    for (auto &c : g_cache) {
+        c.vram.clear();
+        c.vram.shrink_to_fit();
+        c.stamp = 0;
+    }
+}
+
 /* ======================================================================== */
 /* Public API                                                                */
 /* ======================================================================== */
@@ -455,27 +1433,40 @@ bool gpu_capture_start(rd_DebuggerIf *dif) {
         return false;
     }
 
+    startWorkers();
+    clearCache();
+
     /* Reset state */
     {
         std::lock_guard lock(g_mutex);
-        g_events.clear();
+        {
+            /* Let the previous capture's jobs land before dropping it */
+            std::unique_lock res(g_resMutex);
+            g_readyCv.wait(res, [] { return g_readyUpTo >= g_ready.size(); });
+            g_events.clear();
+            g_arena.clear();
+            g_ready.clear();
+            g_readyUpTo = 0;
+            g_keyframes.clear();
+        }
+        unmapFile();
+        g_generation++;
         g_compressedBytes = 0;
         g_frameCounter = 1;
-        g_drawOffX = 0; g_drawOffY = 0;
-        g_drawAreaX1 = 0; g_drawAreaY1 = 0;
-        g_drawAreaX2 = VRAM_W - 1; g_drawAreaY2 = VRAM_H - 1;
+        g_costSinceKey = 0;
+        g_gpu = gpu_raster_reset_state();
         g_deferred = false;
 
-        /* Initial keyframe */
         g_prevVram.resize(VRAM_BYTES);
-        readFullVram(g_vramMem, g_prevVram.data());
+        g_curVram.resize(VRAM_BYTES);
+        g_saveVram.resize(VRAM_BYTES);
 
+        /* Initial keyframe */
         GpuCapEvent ev{};
         ev.type = GpuCapEvent::GPU_COMMAND;
-        ev.is_keyframe = true;
-        ev.diff = zcompress(g_prevVram.data(), VRAM_BYTES);
-        g_compressedBytes += ev.diff.size();
-        g_events.push_back(std::move(ev));
+        DiffJob job;
+        storeDiff(ev, true, nullptr, job);
+        pushEvent(std::move(ev), &job);
     }
 
     g_active = true;
@@ -492,10 +1483,35 @@ void gpu_capture_stop(rd_DebuggerIf *dif) {
     ar_clear_aux_event_handler();
     ar_clear_post_frame_hook();
 
-    /* Free shadow buffer */
-    g_prevVram.clear();
-    g_prevVram.shrink_to_fit();
+    std::lock_guard lock(g_mutex);
+    /* A CPU>VRAM transfer still pending has finished by now */
+    if (g_deferred)
+        completeDeferredDiff();
+
+    /* Diffs still being compressed could take the capture over budget
+     * after the last event; if so, wait for them and trim now */
+    if (!g_streaming) {
+        size_t queued;
+        {
+            std::lock_guard jobs(g_jobMutex);
+            queued = g_queuedBytes;
+        }
+        std::unique_lock res(g_resMutex);
+        if (captureMemory() + queued > g_budget) {
+            g_readyCv.wait(res, [] { return g_readyUpTo >= g_ready.size(); });
+            trimToBudget();
+        }
+    }
+    finishStream();
+
+    /* Free shadow and scratch buffers; queued jobs own their own */
+    for (auto *v : { &g_prevVram, &g_curVram, &g_saveVram }) {
+        v->clear();
+        v->shrink_to_fit();
+    }
     g_vramMem = nullptr;
+    std::lock_guard jobs(g_jobMutex);
+    g_freeBuffers.clear();
 }
 
 void gpu_capture_frame_boundary() {
@@ -509,14 +1525,21 @@ void gpu_capture_frame_boundary() {
     GpuCapEvent ev{};
     ev.type = GpuCapEvent::FRAME_BOUNDARY;
     ev.frame_number = g_frameCounter++;
-    g_events.push_back(std::move(ev));
+    /* Catch VRAM writes that fell outside the command rectangles */
+    DiffJob job;
+    bool changed = g_vramMem && storeDiff(ev, keyframeDue(), nullptr, job);
+    pushEvent(std::move(ev), changed ? &job : nullptr);
 }
 
 bool gpu_capture_active() {
     return g_active;
 }
 
-const std::vector<GpuCapEvent> &gpu_capture_events() {
+const GpuCapEventList &gpu_capture_events(size_t need) {
+    /* The core thread appends to g_events while capturing */
+    static const GpuCapEventList none;
+    if (g_active) return none;
+    waitReady(need);
     return g_events;
 }
 
@@ -524,53 +1547,217 @@ size_t gpu_capture_compressed_bytes() {
     return g_compressedBytes;
 }
 
+size_t gpu_capture_event_count() {
+    std::lock_guard lock(g_resMutex);
+    return g_events.size();
+}
+
+unsigned gpu_capture_generation() {
+    return g_generation;
+}
+
+bool gpu_capture_streaming() {
+    return g_streaming;
+}
+
+bool gpu_capture_save(const char *path) {
+    std::unique_lock lock(g_mutex);
+    if (g_active) {
+        {
+            std::lock_guard flock(g_fileMutex);
+            if (g_streaming || !writerOpen(g_writer, path)) return false;
+            g_streamPath = path;
+            g_streaming = true;
+        }
+        lock.unlock();
+        /* Everything final so far; the workers write the rest */
+        spillReady(true);
+        return g_streaming;
+    }
+    if (g_events.empty()) return false;
+    waitReady(SIZE_MAX);
+
+    /* Write under a temporary name: path may be the mapped file itself */
+    std::string tmp = std::string(path) + ".tmp";
+    CapWriter w;
+    if (!writerOpen(w, tmp.c_str())) return false;
+    bool ok = true;
+    std::vector<std::vector<uint8_t>> scratch(CHUNK_EVENTS);
+    for (size_t first = 0; ok && first < g_events.size(); first += CHUNK_EVENTS) {
+        size_t end = std::min(g_events.size(), first + CHUNK_EVENTS);
+        std::vector<FileEvent> recs;
+        std::vector<std::pair<const uint8_t *, size_t>> diffs;
+        for (size_t i = first; i < end; i++) {
+            const GpuCapEvent &ev = g_events[i];
+            const uint8_t *z = nullptr;
+            size_t zlen = 0;
+            if (ev.has_diff && !ev.dropped && !diffData(ev, z, zlen, scratch[i - first]))
+                ok = false;
+            recs.push_back(toRecord(ev));
+            diffs.emplace_back(z, zlen);
+        }
+        ok = ok && writerChunk(w, recs, diffs);
+    }
+    if (ok) {
+        ok = writerFinish(w) && rename(tmp.c_str(), path) == 0;
+    } else {
+        ::close(w.fd);
+    }
+    if (!ok) unlink(tmp.c_str());
+    return ok;
+}
+
+bool gpu_capture_load(const char *path) {
+    std::lock_guard lock(g_mutex);
+    if (g_active) return false;
+
+    const uint8_t *map;
+    size_t size;
+    if (!mapFile(path, map, size)) return false;
+    GpuCapEventList events;
+    std::vector<uint32_t> keyframes;
+    if (!parseFile(map, size, events, keyframes) || events.empty()) {
+        munmap(const_cast<uint8_t *>(map), size);
+        return false;
+    }
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < events.size(); i++)
+        bytes += events[i].file_size;
+    {
+        std::unique_lock res(g_resMutex);
+        g_readyCv.wait(res, [] { return g_readyUpTo >= g_ready.size(); });
+        g_events.swap(events);
+        g_arena.clear();
+        g_keyframes.swap(keyframes);
+        g_ready.assign(g_events.size(), 1);
+        g_readyUpTo = g_events.size();
+    }
+    clearCache();
+    unmapFile();
+    g_map = map;
+    g_mapSize = size;
+    g_compressedBytes = bytes;
+    g_generation++;
+    return true;
+}
+
+void gpu_capture_set_budget(size_t bytes) {
+    g_budget = bytes;
+}
+
+size_t gpu_capture_budget() {
+    return g_budget;
+}
+
+size_t gpu_capture_memory() {
+    std::lock_guard lock(g_resMutex);
+    return captureMemory();
+}
+
+size_t gpu_capture_pending() {
+    std::lock_guard lock(g_resMutex);
+    size_t n = 0;
+    for (size_t i = g_readyUpTo; i < g_ready.size(); i++)
+        n += !g_ready[i];
+    return n;
+}
+
+std::vector<GpuCapWorkerStats> gpu_capture_worker_stats() {
+    std::lock_guard lock(g_jobMutex);
+    return g_workerStats;
+}
+
 std::mutex &gpu_capture_mutex() {
     return g_mutex;
 }
 
 bool gpu_capture_reconstruct(unsigned idx, uint8_t *out) {
-    if (idx >= g_events.size()) return false;
+    /* While capturing, the core thread appends events and keyframes and
+     * the budget or a stream drops diffs and frees their arena pages.
+     * Otherwise holding g_mutex keeps a capture from starting and a load
+     * from swapping the events out; the workers only still write diffs
+     * past the ready watermark, which is never read below it. */
+    if (g_active) return false;
+    std::lock_guard lock(g_mutex);
+    if (g_active || g_streaming) return false;
 
-    /* Walk back to nearest event with VRAM data */
-    unsigned target = idx;
-    while (target > 0 && (g_events[target].type == GpuCapEvent::FRAME_BOUNDARY ||
-                           g_events[target].diff.empty()))
-        target--;
-    if (g_events[target].diff.empty()) return false;
+    unsigned kf, limit, target = idx;
+    {
+        std::unique_lock res(g_resMutex);
+        if (idx >= g_events.size()) return false;
+        g_readyCv.wait(res, [idx] { return g_readyUpTo > idx; });
+
+        /* Walk back to nearest event that changed VRAM */
+        while (target > 0 && !changesVram(g_events[target]))
+            target--;
+        if (!changesVram(g_events[target])) return false;
+
+        /* Nearest keyframe <= target, and the first one after it */
+        auto next_kf = std::upper_bound(g_keyframes.begin(), g_keyframes.end(), target);
+        if (next_kf == g_keyframes.begin()) return false;
+        kf = *(next_kf - 1);
+        limit = next_kf == g_keyframes.end() ? UINT_MAX : *next_kf;
+        if (!g_events[kf].has_diff) return false;
+    }
 
-#ifdef GPU_CAPTURE_ALL_KEYFRAMES
-    /* Every VRAM-modifying event is a keyframe — just decompress it */
-    return zuncompress(g_events[target].diff, out, VRAM_BYTES);
-#else
-    /* Find nearest keyframe <= target */
-    unsigned kf = target;
-    while (kf > 0 && !g_events[kf].is_keyframe) {
-        kf--;
-        if (g_events[kf].type == GpuCapEvent::FRAME_BOUNDARY || g_events[kf].diff.empty()) {
-            if (kf == 0) break;
+    std::lock_guard cache(g_cacheMutex);
+
+    /* Cheapest starting point: the keyframe, or a cached state in
+     * [kf, target) stepped forward, or one after target with no keyframe
+     * or replayed event in between stepped backward */
+    CachedVram *from = nullptr;
+    size_t best = diffCost(g_events[kf]);
+    for (unsigned i = kf + 1; i <= target; i++)
+        best += diffCost(g_events[i]);
+    for (auto &c : g_cache) {
+        if (c.vram.empty()) continue;
+        size_t cost = 0;
+        if (c.idx == target) {
+            from = &c;
+            break;
+        } else if (c.idx >= kf && c.idx < target) {
+            for (unsigned i = c.idx + 1; i <= target; i++)
+                cost += diffCost(g_events[i]);
+        } else if (c.idx > target && c.idx < limit && c.idx < g_events.size()) {
+            unsigned i = target + 1;
+            for (; i <= c.idx && !g_events[i].replayed; i++)
+                cost += diffCost(g_events[i]);
+            if (i <= c.idx) continue;
+        } else {
             continue;
         }
+        if (cost < best) {
+            best = cost;
+            from = &c;
+        }
     }
-    if (!g_events[kf].is_keyframe || g_events[kf].diff.empty()) return false;
-
-    /* Decompress keyframe */
-    if (!zuncompress(g_events[kf].diff, out, VRAM_BYTES)) return false;
 
-    /* Apply subsequent diffs */
-    for (unsigned i = kf + 1; i <= target; i++) {
-        const GpuCapEvent &ev = g_events[i];
-        if (ev.type == GpuCapEvent::FRAME_BOUNDARY || ev.diff.empty() || ev.is_keyframe)
-            continue;
-
-        /* Full VRAM diff */
-        std::vector<uint8_t> xd(VRAM_BYTES);
-        if (!zuncompress(ev.diff, xd.data(), VRAM_BYTES)) continue;
-        for (int j = 0; j < VRAM_BYTES; j++)
-            out[j] ^= xd[j];
+    bool hit = from && from->idx == target;
+    if (from) {
+        memcpy(out, from->vram.data(), VRAM_BYTES);
+        if (from->idx < target) {
+            stepForward(from->idx, target, best, out);
+        } else {
+            for (unsigned i = from->idx; i > target; i--)
+                applyDiff(g_events[i], out);
+        }
+    } else {
+        std::vector<uint8_t> scratch;
+        const uint8_t *z;
+        size_t zlen;
+        if (!diffData(g_events[kf], z, zlen, scratch) ||
+            !unpackDiff(g_events[kf].raw_diff, z, zlen, out, VRAM_BYTES))
+            return false;
+        stepForward(kf, target, best, out);
     }
 
+    /* Remember the result */
+    if (hit)
+        from->stamp = ++g_cacheClock;
+    else
+        cacheStore(target, out);
     return true;
-#endif
 }
 
 } // namespace sys
@@ -3,6 +3,9 @@
  *
  * Runs on the core thread.  Records GPU commands, computes VRAM diffs
  * (rectangular, bounding-box–sized), and inserts frame boundaries.
+ * Diffs are compressed by a pool of worker threads into a paged arena.
+ * Captures can be streamed to a file while recording and loaded back
+ * (memory-mapped), and are kept within a memory budget.
  * The Qt VramViewer reads the finished capture for display.
  */
 
@@ -10,7 +13,10 @@
 #define PSX_GPU_CAPTURE_HPP
 
 #include "retrodebug.h"
+#include "psx_gpu_raster.hpp"
 #include <cstdint>
+#include <cstddef>
+#include <memory>
 #include <vector>
 #include <mutex>
 
@@ -23,19 +29,85 @@ struct GpuCapEvent {
     uint8_t  port;           // 0=GP0, 1=GP1
     uint8_t  source;         // 0=CPU, 2=DMA ch2
     bool     is_keyframe;
+    bool     has_diff;       // diff stored; may still be compressing
+    bool     replayed;       // command is replayed before the diff is applied
+    bool     dropped;        // diff discarded to stay within the memory budget
+    bool     raw_diff;       // diff stored uncompressed (compression failed)
     unsigned word_count;
     uint32_t words[16];
     uint32_t pc;             // R3000A PC
     unsigned frame_number;   // for FRAME_BOUNDARY
+    GpuRasterState state;    // drawing state the command ran in
 
-    /* Compressed VRAM diff (qCompress'd).
+    /* Compressed VRAM diff (qCompress'd, or raw if raw_diff), diff_size
+     * bytes in the capture's arena.  Null if VRAM did not change, a
+     * replayed command predicted the change exactly, or the diff is only
+     * in the file.
      * Keyframe: full 1MB VRAM.
-     * Partial:  diff_w * diff_h * 2 bytes of packed XOR data. */
-    std::vector<uint8_t> diff;
-
-    /* Bounding rectangle in VRAM halfword coords.
-     * diff_w == 0 && diff_h == 0 means full VRAM (keyframe or fallback). */
+     * Partial:  diff_w * diff_h * 2 bytes of packed XOR data, against the
+     *           VRAM as the replayed command left it if replayed.  For
+     *           unknown-extent commands and frame boundaries (which catch
+     *           writes outside the command rectangles) the rectangle is
+     *           the bounding box of the bytes that changed. */
+    const uint8_t *diff;
+    uint32_t diff_size;
+
+    /* Bounding rectangle in VRAM halfword coords, also set on keyframes
+     * for the UI overlay.  diff_w == 0 && diff_h == 0 means unknown. */
     uint16_t diff_x, diff_y, diff_w, diff_h;
+
+    /* Where the diff lives in the capture file once it was streamed there
+     * (diff is then null) or loaded from it.  file_size == 0: not in a file. */
+    uint64_t file_offset;
+    uint32_t file_size;
+
+    /* Compressed diff size, wherever it is stored */
+    size_t diff_bytes() const { return diff ? diff_size : file_size; }
+};
+
+/* Append-only event storage in fixed-size chunks.  Events never move:
+ * growing allocates a chunk instead of copying every event, and
+ * references stay valid until clear(). */
+class GpuCapEventList {
+public:
+    static constexpr size_t CHUNK = 4096;   // events per chunk
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    GpuCapEvent &operator[](size_t i) { return m_chunks[i / CHUNK][i % CHUNK]; }
+    const GpuCapEvent &operator[](size_t i) const { return m_chunks[i / CHUNK][i % CHUNK]; }
+
+    void push_back(GpuCapEvent &&ev) {
+        if (m_size == m_chunks.size() * CHUNK)
+            m_chunks.emplace_back(new GpuCapEvent[CHUNK]);
+        (*this)[m_size++] = std::move(ev);
+    }
+
+    void clear() {
+        m_chunks.clear();
+        m_size = 0;
+    }
+
+    void swap(GpuCapEventList &o) {
+        m_chunks.swap(o.m_chunks);
+        std::swap(m_size, o.m_size);
+    }
+
+    /* Bytes held, for the memory budget */
+    size_t memory() const { return m_chunks.size() * CHUNK * sizeof(GpuCapEvent); }
+
+private:
+    std::vector<std::unique_ptr<GpuCapEvent[]>> m_chunks;
+    size_t m_size = 0;
+};
+
+/* Per-worker compression statistics since the last gpu_capture_start(). */
+struct GpuCapWorkerStats {
+    uint64_t jobs;              // diffs compressed
+    uint64_t raw_bytes;         // uncompressed input
+    uint64_t compressed_bytes;  // output
+    uint64_t busy_ns;           // time spent compressing
 };
 
 /* Start capturing GPU Post events.
@@ -52,19 +124,60 @@ void gpu_capture_frame_boundary();
 /* Returns true if a capture is in progress. */
 bool gpu_capture_active();
 
-/* Access captured events.  Only valid after capture stops.
+/* Access captured events.  Empty while a capture is in progress.
+ * Waits until the diffs of the first need events are final; the diffs of
+ * later events may still be written by the workers and must not be read.
  * The returned reference is stable until the next gpu_capture_start(). */
-const std::vector<GpuCapEvent> &gpu_capture_events();
+const GpuCapEventList &gpu_capture_events(size_t need = SIZE_MAX);
 
 /* Total compressed bytes stored during capture. */
 size_t gpu_capture_compressed_bytes();
 
+/* Number of events captured or loaded so far.  Thread-safe. */
+size_t gpu_capture_event_count();
+
+/* Incremented whenever the capture is replaced (start or load). */
+unsigned gpu_capture_generation();
+
+/* Write the capture to a file.  While capturing this starts streaming:
+ * events go to the file as their diffs are compressed and are dropped from
+ * memory, and gpu_capture_stop() finishes the file and maps it.  Otherwise
+ * the whole capture is written.  Returns false on I/O error, if there is
+ * nothing to save, or if a capture is already being streamed. */
+bool gpu_capture_save(const char *path);
+
+/* Replace the current capture with one loaded (memory-mapped) from a file.
+ * Works without a running core.  Fails while capturing. */
+bool gpu_capture_load(const char *path);
+
+/* Returns true while a capture is being streamed to a file. */
+bool gpu_capture_streaming();
+
+/* Memory the capture may hold (events and compressed diffs).  Beyond it,
+ * a capture being streamed writes out what it can early; otherwise the
+ * oldest frames' diffs are dropped, up to a keyframe, so the most recent
+ * part stays replayable.  Thread-safe. */
+void gpu_capture_set_budget(size_t bytes);
+size_t gpu_capture_budget();
+
+/* Memory currently held by the capture. */
+size_t gpu_capture_memory();
+
+/* Number of diffs still waiting to be compressed. */
+size_t gpu_capture_pending();
+
+/* Snapshot of the compression workers' statistics, one entry per worker. */
+std::vector<GpuCapWorkerStats> gpu_capture_worker_stats();
+
 /* Lock/unlock for reading capture data from the UI thread. */
 std::mutex &gpu_capture_mutex();
 
 /* Reconstruct full 1MB VRAM state at event index idx.
+ * Waits for the diffs of events up to idx.  Recent results are cached, so
+ * seeking near a previously shown event is cheap in either direction.
  * Writes into out (must be >= 1048576 bytes).
- * Returns true on success. */
+ * Returns true on success; false while capturing and for events dropped
+ * over the budget. */
 bool gpu_capture_reconstruct(unsigned idx, uint8_t *out);
 
 } // namespace sys
@@ -0,0 +1,526 @@
+/*
+ * psx_gpu_raster.cpp: software PSX GPU (GP0) rasterizer
+ *
+ * Straightforward per-pixel implementation: polygons use edge functions
+ * with a top-left fill rule and 16.16 fixed-point attribute gradients,
+ * lines a fixed-point DDA.  Fidelity matters only in that every pixel
+ * it gets wrong costs the capture a residual diff.
+ */
+
+#include "psx_gpu_raster.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+namespace sys {
+
+static constexpr int VRAM_W = 1024;   // halfwords per row
+static constexpr int VRAM_H = 512;
+
+/* ======================================================================== */
+/* State                                                                     */
+/* ======================================================================== */
+
+static inline int sign11(uint32_t v) {
+    return (int)(v << 21) >> 21;
+}
+
+GpuRasterState gpu_raster_reset_state() {
+    GpuRasterState st{};
+    st.area_x2 = VRAM_W - 1;
+    st.area_y2 = VRAM_H - 1;
+    return st;
+}
+
+void gpu_raster_update_state(GpuRasterState &st, unsigned port,
+                             const uint32_t *words, unsigned count) {
+    if (count == 0) return;
+    uint8_t op = (uint8_t)(words[0] >> 24);
+
+    if (port == 1) {
+        if (op == 0x00)
+            st = gpu_raster_reset_state();
+        return;
+    }
+
+    switch (op) {
+    case 0xE1: st.texpage = (uint16_t)(words[0] & 0x3FFF); break;
+    case 0xE2: st.texwin = words[0] & 0xFFFFF; break;
+    case 0xE3:
+        st.area_x1 = (uint16_t)(words[0] & 0x3FF);
+        st.area_y1 = (uint16_t)((words[0] >> 10) & 0x1FF);
+        break;
+    case 0xE4:
+        st.area_x2 = (uint16_t)(words[0] & 0x3FF);
+        st.area_y2 = (uint16_t)((words[0] >> 10) & 0x1FF);
+        break;
+    case 0xE5:
+        st.off_x = (int16_t)sign11(words[0] & 0x7FF);
+        st.off_y = (int16_t)sign11((words[0] >> 11) & 0x7FF);
+        break;
+    case 0xE6: st.mask = (uint8_t)(words[0] & 3); break;
+    default:
+        /* Textured polygons load the page from their second texcoord */
+        if (op >= 0x20 && op <= 0x3F && (op & 0x04)) {
+            unsigned stride = 2 + ((op & 0x10) ? 1 : 0);
+            unsigned uv1 = 1 + stride + 1;
+            if (uv1 < count)
+                st.texpage = (uint16_t)((st.texpage & ~0x9FF) | ((words[uv1] >> 16) & 0x9FF));
+        }
+        break;
+    }
+}
+
+/* ======================================================================== */
+/* Pixel helpers                                                             */
+/* ======================================================================== */
+
+struct Vram {
+    uint8_t *p;
+
+    uint16_t get(int x, int y) const {
+        size_t o = ((size_t)(y & (VRAM_H - 1)) * VRAM_W + (size_t)(x & (VRAM_W - 1))) * 2;
+        return (uint16_t)(p[o] | (p[o + 1] << 8));
+    }
+    void set(int x, int y, uint16_t v) {
+        size_t o = ((size_t)(y & (VRAM_H - 1)) * VRAM_W + (size_t)(x & (VRAM_W - 1))) * 2;
+        p[o] = (uint8_t)v;
+        p[o + 1] = (uint8_t)(v >> 8);
+    }
+};
+
+static const int8_t DITHER[4][4] = {
+    { -4,  0, -3,  1 },
+    {  2, -2,  3, -1 },
+    { -3,  1, -4,  0 },
+    {  3, -1,  2, -2 },
+};
+
+static inline int clamp8(int c) { return c < 0 ? 0 : c > 255 ? 255 : c; }
+
+/* 8-bit channels (may exceed 255 after modulation) to BGR555 */
+static inline uint16_t pack15(int r, int g, int b, int x, int y, bool dither) {
+    if (dither) {
+        int d = DITHER[y & 3][x & 3];
+        r += d; g += d; b += d;
+    }
+    return (uint16_t)((clamp8(r) >> 3) | ((clamp8(g) >> 3) << 5) | ((clamp8(b) >> 3) << 10));
+}
+
+static uint16_t blend(uint16_t back, uint16_t front, unsigned mode) {
+    uint16_t out = 0;
+    for (int sh = 0; sh < 15; sh += 5) {
+        int b = (back >> sh) & 31, f = (front >> sh) & 31, c;
+        switch (mode) {
+        case 0:  c = (b + f) >> 1;             break;
+        case 1:  c = std::min(31, b + f);      break;
+        case 2:  c = std::max(0, b - f);       break;
+        default: c = std::min(31, b + f / 4);  break;
+        }
+        out |= (uint16_t)(c << sh);
+    }
+    return out;
+}
+
+/* Coverage mode: count pixels instead of drawing them */
+struct Cover {
+    uint16_t *counts;   // per-pixel write counts, may be null
+    uint64_t pixels = 0;
+
+    void add(int x, int y) {
+        pixels++;
+        if (counts) {
+            uint16_t &c = counts[(size_t)(y & (VRAM_H - 1)) * VRAM_W + (size_t)(x & (VRAM_W - 1))];
+            if (c != 0xFFFF) c++;
+        }
+    }
+};
+
+/* Everything needed to colour and store a primitive's pixels */
+struct Prim {
+    Vram vram;
+    Cover *cover = nullptr;
+    GpuRasterClip clip;
+    bool textured = false, raw = false, semi = false, dither = false;
+    bool set_mask = false, check_mask = false;
+    unsigned semi_mode = 0;
+
+    /* Texture page, CLUT and window */
+    int tex_x = 0, tex_y = 0, clut_x = 0, clut_y = 0;
+    unsigned depth = 0;
+    unsigned win_mask_u = 0, win_mask_v = 0, win_off_u = 0, win_off_v = 0;
+
+    void setTexpage(unsigned tp) {
+        tex_x = (int)(tp & 0xF) * 64;
+        tex_y = (int)((tp >> 4) & 1) * 256;
+        semi_mode = (tp >> 5) & 3;
+        depth = (tp >> 7) & 3;
+    }
+
+    uint16_t texel(unsigned u, unsigned v) const {
+        u = ((u & 0xFF) & ~win_mask_u) | (win_off_u & win_mask_u);
+        v = ((v & 0xFF) & ~win_mask_v) | (win_off_v & win_mask_v);
+        switch (depth) {
+        case 0: {
+            uint16_t hw = vram.get(tex_x + (int)(u >> 2), tex_y + (int)v);
+            return vram.get(clut_x + ((hw >> ((u & 3) * 4)) & 0xF), clut_y);
+        }
+        case 1: {
+            uint16_t hw = vram.get(tex_x + (int)(u >> 1), tex_y + (int)v);
+            return vram.get(clut_x + ((hw >> ((u & 1) * 8)) & 0xFF), clut_y);
+        }
+        default:
+            return vram.get(tex_x + (int)u, tex_y + (int)v);
+        }
+    }
+
+    /* r, g, b are 8-bit vertex colours */
+    void pixel(int x, int y, int r, int g, int b, unsigned u, unsigned v) {
+        if (x < clip.x0 || x > clip.x1 || y < clip.y0 || y > clip.y1) return;
+        if (cover) {
+            cover->add(x, y);
+            return;
+        }
+
+        uint16_t color;
+        bool translucent = semi;
+        if (textured) {
+            uint16_t t = texel(u, v);
+            if (t == 0) return;
+            translucent = semi && (t & 0x8000);
+            if (raw) {
+                color = t;
+            } else {
+                /* Modulate: texel * colour / 128, 0x80 being neutral */
+                int tr = (t & 31) << 3, tg = ((t >> 5) & 31) << 3, tb = ((t >> 10) & 31) << 3;
+                color = (uint16_t)(pack15((tr * r) >> 7, (tg * g) >> 7, (tb * b) >> 7,
+                                          x, y, dither) | (t & 0x8000));
+            }
+        } else {
+            color = pack15(r, g, b, x, y, dither);
+        }
+
+        uint16_t dst = vram.get(x, y);
+        if (check_mask && (dst & 0x8000)) return;
+        if (translucent)
+            color = (uint16_t)(blend(dst, color, semi_mode) | (color & 0x8000));
+        if (set_mask) color |= 0x8000;
+        vram.set(x, y, color);
+    }
+};
+
+/* Draw-area clip intersected with the caller's clip */
+static GpuRasterClip drawClip(const GpuRasterState &st, const GpuRasterClip &clip) {
+    return { std::max(clip.x0, (int)st.area_x1), std::max(clip.y0, (int)st.area_y1),
+             std::min(clip.x1, (int)st.area_x2), std::min(clip.y1, (int)st.area_y2) };
+}
+
+static Prim makePrim(const GpuRasterState &st, uint8_t *vram, Cover *cover,
+                     const GpuRasterClip &clip, uint8_t op) {
+    Prim p;
+    p.vram = Vram{ vram };
+    p.cover = cover;
+    p.clip = drawClip(st, clip);
+    p.semi = op & 0x02;
+    p.set_mask = st.mask & 1;
+    p.check_mask = st.mask & 2;
+    p.setTexpage(st.texpage);
+    p.win_mask_u = (st.texwin & 0x1F) * 8;
+    p.win_mask_v = ((st.texwin >> 5) & 0x1F) * 8;
+    p.win_off_u = ((st.texwin >> 10) & 0x1F) * 8;
+    p.win_off_v = ((st.texwin >> 15) & 0x1F) * 8;
+    return p;
+}
+
+static inline void setClut(Prim &p, uint32_t uv_word) {
+    p.clut_x = (int)((uv_word >> 16) & 0x3F) * 16;
+    p.clut_y = (int)((uv_word >> 22) & 0x1FF);
+}
+
+/* ======================================================================== */
+/* Primitives                                                                */
+/* ======================================================================== */
+
+struct Vtx { int x, y, r, g, b, u, v; };
+
+static inline bool topLeft(const Vtx &a, const Vtx &b) {
+    int dy = b.y - a.y, dx = b.x - a.x;
+    return dy < 0 || (dy == 0 && dx > 0);
+}
+
+static inline int edge(const Vtx &a, const Vtx &b, int x, int y) {
+    return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+static void drawTriangle(Prim &p, Vtx v0, Vtx v1, Vtx v2) {
+    /* The GPU skips polygons with too large an extent */
+    for (auto [a, b] : { std::pair(&v0, &v1), std::pair(&v1, &v2), std::pair(&v2, &v0) })
+        if (abs(a->x - b->x) >= 1024 || abs(a->y - b->y) >= 512) return;
+
+    int area = edge(v0, v1, v2.x, v2.y);
+    if (area == 0) return;
+    if (area < 0) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    int x0 = std::max(p.clip.x0, std::min({ v0.x, v1.x, v2.x }));
+    int x1 = std::min(p.clip.x1, std::max({ v0.x, v1.x, v2.x }));
+    int y0 = std::max(p.clip.y0, std::min({ v0.y, v1.y, v2.y }));
+    int y1 = std::min(p.clip.y1, std::max({ v0.y, v1.y, v2.y }));
+    if (x0 > x1 || y0 > y1) return;
+
+    /* 16.16 gradients of an attribute over x and y */
+    int ex1 = v1.x - v0.x, ey1 = v1.y - v0.y, ex2 = v2.x - v0.x, ey2 = v2.y - v0.y;
+    auto grad = [&](int a0, int a1, int a2, int64_t &dx, int64_t &dy) {
+        int64_t da1 = a1 - a0, da2 = a2 - a0;
+        dx = ((da1 * ey2 - da2 * ey1) * 65536) / area;
+        dy = ((da2 * ex1 - da1 * ex2) * 65536) / area;
+    };
+    int64_t drx, dry, dgx, dgy, dbx, dby, dux, duy, dvx, dvy;
+    grad(v0.r, v1.r, v2.r, drx, dry);
+    grad(v0.g, v1.g, v2.g, dgx, dgy);
+    grad(v0.b, v1.b, v2.b, dbx, dby);
+    grad(v0.u, v1.u, v2.u, dux, duy);
+    grad(v0.v, v1.v, v2.v, dvx, dvy);
+
+    bool tl0 = topLeft(v1, v2), tl1 = topLeft(v2, v0), tl2 = topLeft(v0, v1);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            int w0 = edge(v1, v2, x, y), w1 = edge(v2, v0, x, y), w2 = edge(v0, v1, x, y);
+            if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+            if ((w0 == 0 && !tl0) || (w1 == 0 && !tl1) || (w2 == 0 && !tl2)) continue;
+
+            int64_t fx = x - v0.x, fy = y - v0.y;
+            auto at = [&](int a0, int64_t dx, int64_t dy) {
+                return (int)((((int64_t)a0 << 16) + dx * fx + dy * fy + 0x8000) >> 16);
+            };
+            p.pixel(x, y, at(v0.r, drx, dry), at(v0.g, dgx, dgy), at(v0.b, dbx, dby),
+                    (unsigned)at(v0.u, dux, duy), (unsigned)at(v0.v, dvx, dvy));
+        }
+    }
+}
+
+static void drawLine(Prim &p, const Vtx &a, const Vtx &b) {
+    int dx = b.x - a.x, dy = b.y - a.y;
+    if (abs(dx) >= 1024 || abs(dy) >= 512) return;
+
+    int n = std::max(abs(dx), abs(dy));
+    if (n == 0) {
+        p.pixel(a.x, a.y, a.r, a.g, a.b, 0, 0);
+        return;
+    }
+    auto step = [n](int d) { return ((int64_t)d * 65536) / n; };
+    int64_t sx = step(dx), sy = step(dy);
+    int64_t sr = step(b.r - a.r), sg = step(b.g - a.g), sb = step(b.b - a.b);
+    int64_t x = ((int64_t)a.x << 16) + 0x8000, y = ((int64_t)a.y << 16) + 0x8000;
+    int64_t r = ((int64_t)a.r << 16) + 0x8000, g = ((int64_t)a.g << 16) + 0x8000;
+    int64_t bl = ((int64_t)a.b << 16) + 0x8000;
+    for (int i = 0; i <= n; i++) {
+        p.pixel((int)(x >> 16), (int)(y >> 16), (int)(r >> 16), (int)(g >> 16), (int)(bl >> 16), 0, 0);
+        x += sx; y += sy; r += sr; g += sg; bl += sb;
+    }
+}
+
+static inline void unpackColor(uint32_t c, Vtx &v) {
+    v.r = (int)(c & 0xFF);
+    v.g = (int)((c >> 8) & 0xFF);
+    v.b = (int)((c >> 16) & 0xFF);
+}
+
+static inline void unpackXY(const GpuRasterState &st, uint32_t w, Vtx &v) {
+    v.x = sign11(w & 0x7FF) + st.off_x;
+    v.y = sign11((w >> 16) & 0x7FF) + st.off_y;
+}
+
+/* ======================================================================== */
+/* Commands                                                                  */
+/* ======================================================================== */
+
+/* Words needed to replay, or 0 if the command can't be replayed */
+static unsigned wordsNeeded(const uint32_t *words, unsigned count) {
+    if (count == 0) return 0;
+    uint8_t op = (uint8_t)(words[0] >> 24);
+    if (op == 0x02) return 3;
+    if (op >= 0x20 && op <= 0x3F) {
+        /* One triangle per call: the first three vertices */
+        unsigned stride = 1 + ((op & 0x10) ? 1 : 0) + ((op & 0x04) ? 1 : 0);
+        return 1 + 2 * stride + 1 + ((op & 0x04) ? 1 : 0);
+    }
+    if (op >= 0x40 && op <= 0x5F)
+        return (op & 0x08) ? 0 : (op & 0x10) ? 4 : 3;
+    if (op >= 0x60 && op <= 0x7F) {
+        unsigned n = 2 + ((op & 0x04) ? 1 : 0);
+        return ((op >> 3) & 3) == 0 ? n + 1 : n;
+    }
+    if (op >= 0x80 && op <= 0x9F) return 4;
+    return 0;
+}
+
+bool gpu_raster_can_exec(const uint32_t *words, unsigned count) {
+    unsigned need = wordsNeeded(words, count);
+    return need != 0 && need <= count;
+}
+
+static void execFill(uint8_t *vram, Cover *cover, const uint32_t *w, const GpuRasterClip &clip) {
+    Vram v{ vram };
+    Vtx c;
+    unpackColor(w[0], c);
+    uint16_t color = (uint16_t)((c.r >> 3) | ((c.g >> 3) << 5) | ((c.b >> 3) << 10));
+    int x0 = (int)(w[1] & 0x3F0), y0 = (int)((w[1] >> 16) & 0x3FF);
+    int width = (int)(((w[2] & 0x3FF) + 0xF) & ~0xF), height = (int)((w[2] >> 16) & 0x1FF);
+    for (int y = 0; y < height; y++) {
+        int py = (y0 + y) & (VRAM_H - 1);
+        if (py < clip.y0 || py > clip.y1) continue;
+        for (int x = 0; x < width; x++) {
+            int px = (x0 + x) & (VRAM_W - 1);
+            if (px < clip.x0 || px > clip.x1) continue;
+            if (cover) cover->add(px, py);
+            else v.set(px, py, color);
+        }
+    }
+}
+
+static void execCopy(const GpuRasterState &st, uint8_t *vram, Cover *cover, const uint32_t *w,
+                     const GpuRasterClip &clip) {
+    Vram v{ vram };
+    int sx = (int)(w[1] & 0x3FF), sy = (int)((w[1] >> 16) & 0x1FF);
+    int dx = (int)(w[2] & 0x3FF), dy = (int)((w[2] >> 16) & 0x1FF);
+    int width  = (int)((((w[3] & 0x3FF) - 1) & 0x3FF) + 1);
+    int height = (int)(((((w[3] >> 16) & 0x1FF) - 1) & 0x1FF) + 1);
+    uint16_t set = (st.mask & 1) ? 0x8000 : 0;
+    bool check = st.mask & 2;
+
+    /* Row at a time through a buffer, so overlapping copies read the source first */
+    uint16_t row[VRAM_W];
+    for (int y = 0; y < height; y++) {
+        int py = (dy + y) & (VRAM_H - 1);
+        if (py < clip.y0 || py > clip.y1) continue;
+        for (int x = 0; x < width && !cover; x++)
+            row[x] = v.get(sx + x, sy + y);
+        for (int x = 0; x < width; x++) {
+            int px = (dx + x) & (VRAM_W - 1);
+            if (px < clip.x0 || px > clip.x1) continue;
+            if (cover) {
+                cover->add(px, py);
+                continue;
+            }
+            if (check && (v.get(px, py) & 0x8000)) continue;
+            v.set(px, py, row[x] | set);
+        }
+    }
+}
+
+static void execPolygon(const GpuRasterState &st, uint8_t *vram, Cover *cover, const uint32_t *w,
+                        const GpuRasterClip &clip) {
+    uint8_t op = (uint8_t)(w[0] >> 24);
+    bool shade = op & 0x10, tex = op & 0x04;
+    Prim p = makePrim(st, vram, cover, clip, op);
+    p.textured = tex;
+    p.raw = op & 0x01;
+
+    Vtx v[3];
+    unsigned pos = 1;
+    for (int i = 0; i < 3; i++) {
+        unpackColor(i > 0 && shade ? w[pos++] : w[0], v[i]);
+        unpackXY(st, w[pos++], v[i]);
+        v[i].u = v[i].v = 0;
+        if (tex) {
+            v[i].u = (int)(w[pos] & 0xFF);
+            v[i].v = (int)((w[pos] >> 8) & 0xFF);
+            if (i == 0) setClut(p, w[pos]);
+            if (i == 1) p.setTexpage((st.texpage & ~0x9FF) | ((w[pos] >> 16) & 0x9FF));
+            pos++;
+        }
+    }
+    p.dither = (st.texpage & 0x200) && (shade || (tex && !p.raw));
+    drawTriangle(p, v[0], v[1], v[2]);
+}
+
+static void execLine(const GpuRasterState &st, uint8_t *vram, Cover *cover, const uint32_t *w,
+                     const GpuRasterClip &clip) {
+    uint8_t op = (uint8_t)(w[0] >> 24);
+    bool shade = op & 0x10;
+    Prim p = makePrim(st, vram, cover, clip, op);
+    p.dither = (st.texpage & 0x200) && shade;
+
+    Vtx a{}, b{};
+    unpackColor(w[0], a);
+    unpackXY(st, w[1], a);
+    unpackColor(shade ? w[2] : w[0], b);
+    unpackXY(st, w[shade ? 3 : 2], b);
+    drawLine(p, a, b);
+}
+
+static void execRect(const GpuRasterState &st, uint8_t *vram, Cover *cover, const uint32_t *w,
+                     const GpuRasterClip &clip) {
+    uint8_t op = (uint8_t)(w[0] >> 24);
+    bool tex = op & 0x04;
+    Prim p = makePrim(st, vram, cover, clip, op);
+    p.textured = tex;
+    p.raw = op & 0x01;
+
+    Vtx c{};
+    unpackColor(w[0], c);
+    unpackXY(st, w[1], c);
+    unsigned u0 = 0, v0 = 0;
+    if (tex) {
+        u0 = w[2] & 0xFF;
+        v0 = (w[2] >> 8) & 0xFF;
+        setClut(p, w[2]);
+    }
+
+    int width, height;
+    switch ((op >> 3) & 3) {
+    case 1:  width = height = 1;  break;
+    case 2:  width = height = 8;  break;
+    case 3:  width = height = 16; break;
+    default: {
+        uint32_t sz = w[tex ? 3 : 2];
+        width = (int)(sz & 0x3FF);
+        height = (int)((sz >> 16) & 0x1FF);
+        break;
+    }
+    }
+
+    bool flip_x = st.texpage & 0x1000, flip_y = st.texpage & 0x2000;
+    int x0 = std::max(c.x, p.clip.x0), x1 = std::min(c.x + width - 1, p.clip.x1);
+    int y0 = std::max(c.y, p.clip.y0), y1 = std::min(c.y + height - 1, p.clip.y1);
+    for (int y = y0; y <= y1; y++) {
+        unsigned v = flip_y ? v0 - (unsigned)(y - c.y) : v0 + (unsigned)(y - c.y);
+        for (int x = x0; x <= x1; x++) {
+            unsigned u = flip_x ? u0 - (unsigned)(x - c.x) : u0 + (unsigned)(x - c.x);
+            p.pixel(x, y, c.r, c.g, c.b, u, v);
+        }
+    }
+}
+
+/* Draw, or count coverage if cover is set (vram is then unused) */
+static bool run(const GpuRasterState &st, uint8_t *vram, Cover *cover,
+                const uint32_t *words, unsigned count, const GpuRasterClip &clip) {
+    if (!gpu_raster_can_exec(words, count)) return false;
+    uint8_t op = (uint8_t)(words[0] >> 24);
+    if (op == 0x02)                     execFill(vram, cover, words, clip);
+    else if (op >= 0x20 && op <= 0x3F)  execPolygon(st, vram, cover, words, clip);
+    else if (op >= 0x40 && op <= 0x5F)  execLine(st, vram, cover, words, clip);
+    else if (op >= 0x60 && op <= 0x7F)  execRect(st, vram, cover, words, clip);
+    else                                execCopy(st, vram, cover, words, clip);
+    return true;
+}
+
+bool gpu_raster_exec(const GpuRasterState &st, uint8_t *vram,
+                     const uint32_t *words, unsigned count,
+                     const GpuRasterClip &clip) {
+    return run(st, vram, nullptr, words, count, clip);
+}
+
+uint64_t gpu_raster_coverage(const GpuRasterState &st,
+                             const uint32_t *words, unsigned count,
+                             uint16_t *counts) {
+    Cover cover{ counts };
+    run(st, nullptr, &cover, words, count, { 0, 0, VRAM_W - 1, VRAM_H - 1 });
+    return cover.pixels;
+}
+
+} // namespace sys
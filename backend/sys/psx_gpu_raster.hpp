@@ -0,0 +1,64 @@
+/*
+ * psx_gpu_raster.hpp: software PSX GPU (GP0) rasterizer
+ *
+ * Replays GP0 drawing commands against a 1MB VRAM image: fills, VRAM
+ * copies, flat/Gouraud and textured polygons, rectangles and lines, with
+ * the draw area, drawing offset, texture page/window, semi-transparency,
+ * dithering and mask bit settings.  Used by the GPU capture to predict
+ * what a command draws, so that only the difference from the real GPU
+ * has to be stored, and by the capture statistics to measure coverage.  Output is close to, but not bit-exact with, a given
+ * core; callers must not rely on exactness.
+ */
+
+#ifndef PSX_GPU_RASTER_HPP
+#define PSX_GPU_RASTER_HPP
+
+#include <stdint.h>
+
+namespace sys {
+
+/* Drawing state set by GP0(E1h..E6h), enough to replay a command */
+struct GpuRasterState {
+    int16_t  off_x, off_y;                          // E5: drawing offset
+    uint16_t area_x1, area_y1, area_x2, area_y2;    // E3/E4: draw area (inclusive)
+    uint16_t texpage;                               // E1 bits 0-13
+    uint8_t  mask;                                  // E6: 1 = set mask, 2 = check mask
+    uint8_t  pad;
+    uint32_t texwin;                                // E2 bits 0-19
+};
+static_assert(sizeof(GpuRasterState) == 20, "GpuRasterState is stored in capture files");
+
+/* Power-on state: full draw area, everything else zero */
+GpuRasterState gpu_raster_reset_state();
+
+/* Apply a command's effect on the drawing state: E1h-E6h, the texture
+ * page carried by textured polygons, and GP1(00h) reset. */
+void gpu_raster_update_state(GpuRasterState &st, unsigned port,
+                             const uint32_t *words, unsigned count);
+
+/* Pixel rectangle (halfword coords, inclusive) writes are limited to */
+struct GpuRasterClip { int x0, y0, x1, y1; };
+
+/* Execute a GP0 drawing command on vram (1024x512 little-endian
+ * halfwords) using the state in effect before it.  Writes outside clip
+ * are dropped.  Returns false, leaving vram untouched, for commands that
+ * can't be replayed from their words (CPU-to-VRAM data, polylines,
+ * truncated commands). */
+bool gpu_raster_exec(const GpuRasterState &st, uint8_t *vram,
+                     const uint32_t *words, unsigned count,
+                     const GpuRasterClip &clip);
+
+/* Returns true if gpu_raster_exec() can replay this command. */
+bool gpu_raster_can_exec(const uint32_t *words, unsigned count);
+
+/* Number of pixels the command would write, ignoring texture transparency
+ * and the mask bit.  If counts (1024x512) is non-null, each of them is
+ * incremented there, saturating.  0 for commands gpu_raster_exec() can't
+ * replay. */
+uint64_t gpu_raster_coverage(const GpuRasterState &st,
+                             const uint32_t *words, unsigned count,
+                             uint16_t *counts);
+
+} // namespace sys
+
+#endif // PSX_GPU_RASTER_HPP
@@ -0,0 +1,163 @@
+/*
+ * psx_gpu_stats.cpp: PSX GPU workload statistics from a capture
+ */
+
+#include "psx_gpu_stats.hpp"
+#include "psx_gpu_raster.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+namespace sys {
+
+static constexpr int VRAM_W = 1024;
+static constexpr int VRAM_H = 512;
+
+const char *const gpu_prim_kind_names[GPU_PRIM_KINDS] = {
+    "triangle", "rect", "line", "fill", "copy", "upload", "download",
+};
+
+/* Primitive kind of a GP0 command, or -1 for state and misc commands */
+static int primKind(uint8_t op) {
+    if (op == 0x02)                 return GPU_PRIM_FILL;
+    if (op >= 0x20 && op <= 0x3F)   return GPU_PRIM_TRIANGLE;
+    if (op >= 0x40 && op <= 0x5F)   return GPU_PRIM_LINE;
+    if (op >= 0x60 && op <= 0x7F)   return GPU_PRIM_RECT;
+    if (op >= 0x80 && op <= 0x9F)   return GPU_PRIM_COPY;
+    if (op >= 0xA0 && op <= 0xBF)   return GPU_PRIM_UPLOAD;
+    if (op >= 0xC0 && op <= 0xDF)   return GPU_PRIM_DOWNLOAD;
+    return -1;
+}
+
+std::vector<std::pair<size_t, size_t>> gpu_stats_frames(const GpuCapEventList &events) {
+    std::vector<std::pair<size_t, size_t>> frames;
+    size_t first = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        if (events[i].type == GpuCapEvent::FRAME_BOUNDARY) {
+            frames.emplace_back(first, i + 1);
+            first = i + 1;
+        }
+    }
+    if (first < events.size())
+        frames.emplace_back(first, events.size());
+    return frames;
+}
+
+GpuFrameStats gpu_stats_analyze(const GpuCapEventList &events,
+                                size_t first, size_t end, bool overdraw) {
+    GpuFrameStats fs{};
+    end = std::min(end, events.size());
+    fs.first_event = first;
+    fs.end_event = end;
+    if (end > first && events[end - 1].type == GpuCapEvent::FRAME_BOUNDARY)
+        fs.frame_number = events[end - 1].frame_number;
+    if (overdraw)
+        fs.overdraw.assign((size_t)VRAM_W * VRAM_H, 0);
+
+    std::unordered_map<uint32_t, GpuPcStats> pcs;
+    for (size_t i = first; i < end; i++) {
+        const GpuCapEvent &ev = events[i];
+        if (ev.type != GpuCapEvent::GPU_COMMAND || ev.port != 0 || ev.word_count == 0)
+            continue;
+
+        if (ev.source == 0) fs.cpu_words += ev.word_count;
+        else                fs.dma_words += ev.word_count;
+
+        uint8_t op = (uint8_t)(ev.words[0] >> 24);
+        int kind = primKind(op);
+        if (kind < 0) continue;
+        fs.prims[kind]++;
+
+        uint64_t pixels = 0;
+        if (kind == GPU_PRIM_UPLOAD) {
+            if (ev.word_count >= 3) {
+                uint32_t w = ((ev.words[2] & 0x3FF) - 1) & 0x3FF;
+                uint32_t h = (((ev.words[2] >> 16) & 0x1FF) - 1) & 0x1FF;
+                pixels = (uint64_t)(w + 1) * (h + 1);
+            }
+        } else if (kind != GPU_PRIM_DOWNLOAD) {
+            pixels = gpu_raster_coverage(ev.state, ev.words, ev.word_count,
+                                         overdraw ? fs.overdraw.data() : nullptr);
+        }
+
+        switch (kind) {
+        case GPU_PRIM_TRIANGLE:
+        case GPU_PRIM_RECT:
+            if (op & 0x04) fs.textured_pixels += pixels;
+            else           fs.untextured_pixels += pixels;
+            break;
+        case GPU_PRIM_LINE:
+            fs.untextured_pixels += pixels;
+            break;
+        default:
+            fs.transfer_pixels += pixels;
+            break;
+        }
+
+        GpuPcStats &pc = pcs[ev.pc];
+        pc.pc = ev.pc;
+        pc.prims++;
+        pc.pixels += pixels;
+    }
+
+    fs.pcs.reserve(pcs.size());
+    for (const auto &[addr, pc] : pcs)
+        fs.pcs.push_back(pc);
+    std::sort(fs.pcs.begin(), fs.pcs.end(), [](const GpuPcStats &a, const GpuPcStats &b) {
+        if (a.pixels != b.pixels) return a.pixels > b.pixels;
+        if (a.prims != b.prims) return a.prims > b.prims;
+        return a.pc < b.pc;
+    });
+    if (fs.pcs.size() > GPU_STATS_TOP_PCS)
+        fs.pcs.resize(GPU_STATS_TOP_PCS);
+
+    for (uint16_t c : fs.overdraw)
+        fs.max_overdraw = std::max<unsigned>(fs.max_overdraw, c);
+    return fs;
+}
+
+std::vector<GpuFrameStats> gpu_stats_analyze_all(const GpuCapEventList &events) {
+    std::vector<GpuFrameStats> out;
+    for (const auto &[first, end] : gpu_stats_frames(events))
+        out.push_back(gpu_stats_analyze(events, first, end, false));
+    return out;
+}
+
+bool gpu_stats_write_json(const char *path, const std::vector<GpuFrameStats> &frames) {
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (!f) return false;
+
+    fputs("[\n", f);
+    for (size_t i = 0; i < frames.size(); i++) {
+        const GpuFrameStats &fs = frames[i];
+        fprintf(f, "  {\"frame\":%u,\"first_event\":%zu,\"end_event\":%zu,\"prims\":{",
+                fs.frame_number, fs.first_event, fs.end_event);
+        for (int k = 0; k < GPU_PRIM_KINDS; k++)
+            fprintf(f, "%s\"%s\":%u", k ? "," : "", gpu_prim_kind_names[k], fs.prims[k]);
+        fprintf(f, "},\"textured_pixels\":%" PRIu64 ",\"untextured_pixels\":%" PRIu64
+                   ",\"transfer_pixels\":%" PRIu64 ",\"cpu_words\":%" PRIu64
+                   ",\"dma_words\":%" PRIu64 ",\"pcs\":[",
+                fs.textured_pixels, fs.untextured_pixels, fs.transfer_pixels,
+                fs.cpu_words, fs.dma_words);
+        for (size_t j = 0; j < fs.pcs.size(); j++)
+            fprintf(f, "%s{\"pc\":\"%08X\",\"prims\":%u,\"pixels\":%" PRIu64 "}",
+                    j ? "," : "", fs.pcs[j].pc, fs.pcs[j].prims, fs.pcs[j].pixels);
+        fprintf(f, "]}%s\n", i + 1 < frames.size() ? "," : "");
+    }
+    fputs("]\n", f);
+
+    bool ok = fflush(f) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        remove(tmp.c_str());
+        fprintf(stderr, "[arret] Failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+} // namespace sys
@@ -0,0 +1,82 @@
+/*
+ * psx_gpu_stats.hpp: PSX GPU workload statistics from a capture
+ *
+ * Splits captured events into frames at the frame boundaries and counts,
+ * per frame, primitives by type, the pixels they cover (rasterized with
+ * the drawing state recorded at capture time), command words by source,
+ * and the PCs that issued the most pixels.  Optionally accumulates an
+ * overdraw heatmap.  Used by the VramViewer and exported as JSON.
+ */
+
+#ifndef PSX_GPU_STATS_HPP
+#define PSX_GPU_STATS_HPP
+
+#include "psx_gpu_capture.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace sys {
+
+enum GpuPrimKind {
+    GPU_PRIM_TRIANGLE,    // polygons arrive one triangle per event
+    GPU_PRIM_RECT,
+    GPU_PRIM_LINE,        // single lines and polylines
+    GPU_PRIM_FILL,
+    GPU_PRIM_COPY,        // VRAM-to-VRAM
+    GPU_PRIM_UPLOAD,      // CPU-to-VRAM
+    GPU_PRIM_DOWNLOAD,    // VRAM-to-CPU
+    GPU_PRIM_KINDS
+};
+
+/* Short names for display and JSON, indexed by GpuPrimKind */
+extern const char *const gpu_prim_kind_names[GPU_PRIM_KINDS];
+
+/* Work issued from one PC within a frame */
+struct GpuPcStats {
+    uint32_t pc;
+    unsigned prims;
+    uint64_t pixels;
+};
+
+struct GpuFrameStats {
+    unsigned frame_number;      // of the closing boundary; 0: capture ended first
+    size_t   first_event;       // events [first_event, end_event)
+    size_t   end_event;
+
+    unsigned prims[GPU_PRIM_KINDS];
+    uint64_t textured_pixels;   // polygons and rectangles with a texture
+    uint64_t untextured_pixels; // other polygons, rectangles and lines
+    uint64_t transfer_pixels;   // fills, copies and uploads
+    uint64_t cpu_words;         // GP0 command words written by the CPU
+    uint64_t dma_words;         // ... and by DMA (headers only for transfers)
+
+    /* Ranked by pixels drawn, then primitives; at most GPU_STATS_TOP_PCS */
+    std::vector<GpuPcStats> pcs;
+
+    /* 1024x512 pixel write counts, if requested; max_overdraw is the largest */
+    std::vector<uint16_t> overdraw;
+    unsigned max_overdraw;
+};
+
+static constexpr size_t GPU_STATS_TOP_PCS = 32;
+
+/* Event ranges [first, end) of the frames in events, each ending with its
+ * frame boundary (the last one may not). */
+std::vector<std::pair<size_t, size_t>> gpu_stats_frames(const GpuCapEventList &events);
+
+/* Statistics of the events [first, end).  Reads only the command words
+ * and drawing state, not the diffs. */
+GpuFrameStats gpu_stats_analyze(const GpuCapEventList &events,
+                                size_t first, size_t end, bool overdraw);
+
+/* Statistics of every frame, without heatmaps */
+std::vector<GpuFrameStats> gpu_stats_analyze_all(const GpuCapEventList &events);
+
+/* Write frames as a JSON array.  Returns false on I/O error. */
+bool gpu_stats_write_json(const char *path, const std::vector<GpuFrameStats> &frames);
+
+} // namespace sys
+
+#endif // PSX_GPU_STATS_HPP
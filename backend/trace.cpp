@@ -20,9 +20,12 @@
 
 #include "trace.hpp"
 #include "backend.hpp"
+#include "memreader.hpp"
 #include "arch.hpp"
 #include "sys.hpp"
 #include "registers.hpp"
+#include "regions.hpp"
+#include "symbols.hpp"
 
 /* ========================================================================
  * Ring buffer
@@ -60,6 +63,7 @@ static bool g_instructions = true;
 static bool g_interrupts = true;
 static bool g_registers = false;
 static bool g_indent = false;
+static bool g_symbols = false;
 static FILE *g_file = nullptr;
 static char g_file_path[4096] = {0};
 
@@ -98,12 +102,31 @@ struct MMapEntry {
 
 struct CpuMMap {
     std::vector<MMapEntry> entries;
+    std::vector<rd_MemoryMap> scratch;
     int bankWidth;   /* 0 = no banking */
     int addrWidth;   /* hex digits for address */
+    uint64_t generation = 0;    /* regions generation of entries */
 };
 
 static std::unordered_map<rd_Cpu const *, CpuMMap> g_cpu_mmaps;
 
+/* Re-read the banks mapped right now; the core may switch them at any
+ * instruction.  Returns the highest bank, -1 if none. */
+static int64_t read_mmap(CpuMMap &cm, rd_Memory const *mem) {
+    cm.entries.clear();
+    if (!mem->v1.get_memory_map_count || !mem->v1.get_memory_map) return -1;
+    unsigned mc = mem->v1.get_memory_map_count(mem);
+    if (mc == 0) return -1;
+    cm.scratch.resize(mc);
+    mem->v1.get_memory_map(mem, cm.scratch.data());
+    int64_t maxBank = -1;
+    for (auto &m : cm.scratch) {
+        cm.entries.push_back({m.base_addr, m.size, m.bank});
+        if (m.bank > maxBank) maxBank = m.bank;
+    }
+    return maxBank;
+}
+
 static void build_mmap(rd_Cpu const *cpu) {
     CpuMMap cm;
     cm.bankWidth = 0;
@@ -118,28 +141,13 @@ static void build_mmap(rd_Cpu const *cpu) {
     uint64_t maxAddr = mem->v1.base_address + mem->v1.size;
     if (maxAddr > 0x10000) cm.addrWidth = 8;
 
-    if (mem->v1.get_memory_map_count && mem->v1.get_memory_map) {
-        unsigned mc = mem->v1.get_memory_map_count(mem);
-        if (mc > 0) {
-            auto *maps = (rd_MemoryMap *)malloc(mc * sizeof(rd_MemoryMap));
-            if (maps) {
-                mem->v1.get_memory_map(mem, maps);
-                int64_t maxBank = -1;
-                for (unsigned i = 0; i < mc; i++) {
-                    cm.entries.push_back({maps[i].base_addr, maps[i].size,
-                                          maps[i].bank});
-                    if (maps[i].bank > maxBank) maxBank = maps[i].bank;
-                }
-                if (maxBank >= 0) {
-                    cm.bankWidth = 1;
-                    for (int64_t v = maxBank; v >= 10; v /= 10) cm.bankWidth++;
-                }
-                free(maps);
-            }
-        }
+    int64_t maxBank = read_mmap(cm, mem);
+    if (maxBank >= 0) {
+        cm.bankWidth = 1;
+        for (int64_t v = maxBank; v >= 10; v /= 10) cm.bankWidth++;
     }
 
-    g_cpu_mmaps[cpu] = cm;
+    g_cpu_mmaps[cpu] = std::move(cm);
 }
 
 static int64_t bank_for_addr(const CpuMMap &cm, uint64_t addr) {
@@ -149,6 +157,11 @@ static int64_t bank_for_addr(const CpuMMap &cm, uint64_t addr) {
     return -1;
 }
 
+/* ar_sym_bank_fn over a CpuMMap */
+static int64_t mmap_bank(void *user, uint64_t addr) {
+    return bank_for_addr(*(const CpuMMap *)user, addr);
+}
+
 /* ========================================================================
  * Sys trace option log sink
  * ======================================================================== */
@@ -301,7 +314,10 @@ static void populate_cpus(void) {
  * Trace line formatting
  * ======================================================================== */
 
-/* Strip '@' address markers from disassembly text (no symbol interpolation) */
+/* PCs are shown relative to the enclosing label up to this distance */
+#define TRACE_PC_MAX_OFFSET 0x1000
+
+/* Strip '@' address markers from disassembly text (symbols off) */
 static void strip_at_markers(const char *src, char *dst, size_t dst_size) {
     size_t j = 0;
     for (size_t i = 0; src[i] && j < dst_size - 1; i++) {
@@ -446,6 +462,9 @@ bool ar_trace_get_registers(void) { return g_registers; }
 void ar_trace_set_indent(bool enable) { g_indent = enable; }
 bool ar_trace_get_indent(void) { return g_indent; }
 
+void ar_trace_set_symbols(bool enable) { g_symbols = enable; }
+bool ar_trace_get_symbols(void) { return g_symbols; }
+
 const char *ar_trace_file_path(void) { return g_file_path; }
 
 unsigned ar_trace_read_new(char *out, unsigned max_lines) {
@@ -545,16 +564,24 @@ bool ar_trace_on_event(rd_SubscriptionID sub_id, rd_Event const *event) {
     rd_Memory const *mem = cpu->v1.memory_region;
     if (!mem) return false;
 
-    /* Memory map for bank display */
+    /* Memory map for bank display and symbols: as mapped at this
+     * instruction when symbolizing, else once per regions generation
+     * (frame, pause, poke) */
     auto mm = g_cpu_mmaps.find(cpu);
+    if (mm != g_cpu_mmaps.end() && mm->second.bankWidth > 0) {
+        uint64_t generation = ar_regions_generation();
+        if (g_symbols || mm->second.generation != generation) {
+            read_mmap(mm->second, mem);
+            mm->second.generation = generation;
+        }
+    }
 
     /* Read bytes at PC for disassembly */
     const arch::Arch *arch = arch::arch_for_cpu(cpu->v1.type);
     unsigned maxInsn = arch ? arch->max_insn_size : 4;
     if (maxInsn > 16) maxInsn = 16;
     uint8_t buf[16];
-    for (unsigned i = 0; i < maxInsn; i++)
-        buf[i] = mem->v1.peek(mem, pc + i, false);
+    ar_mem_read(mem, pc, maxInsn, buf);
 
     /* Disassemble one instruction */
     auto insns = arch::disassemble(
@@ -573,8 +600,9 @@ bool ar_trace_on_event(rd_SubscriptionID sub_id, rd_Event const *event) {
     }
 
     /* Bank prefix */
+    int64_t bank = -1;
     if (mm != g_cpu_mmaps.end() && mm->second.bankWidth > 0) {
-        int64_t bank = bank_for_addr(mm->second, pc);
+        bank = bank_for_addr(mm->second, pc);
         if (bank >= 0)
             pos += snprintf(line + pos, TRACE_LINE_SIZE - pos,
                             "%*ld:", mm->second.bankWidth, (long)bank);
@@ -587,13 +615,28 @@ bool ar_trace_on_event(rd_SubscriptionID sub_id, rd_Event const *event) {
     int aw = 4;
     if (mm != g_cpu_mmaps.end()) aw = mm->second.addrWidth;
     pos += snprintf(line + pos, TRACE_LINE_SIZE - pos,
-                    "%0*lX: ", aw, (unsigned long)pc);
+                    "%0*lX", aw, (unsigned long)pc);
+
+    /* Enclosing label (cached per address and bank) */
+    char label[96];
+    if (g_symbols &&
+        ar_sym_symbolize_bank(mem->v1.id, pc, bank, TRACE_PC_MAX_OFFSET,
+                              label, sizeof(label)))
+        pos += snprintf(line + pos, TRACE_LINE_SIZE - pos, " <%s>", label);
+    pos += snprintf(line + pos, TRACE_LINE_SIZE - pos, ": ");
 
-    /* Instruction text (strip @ markers, no symbol interpolation) */
+    /* Instruction text: operands symbolized, or @ markers stripped */
     if (!insns.empty()) {
-        char stripped[128];
-        strip_at_markers(insns[0].text.c_str(), stripped, sizeof(stripped));
-        pos += snprintf(line + pos, TRACE_LINE_SIZE - pos, "%s", stripped);
+        char text[128];
+        if (g_symbols) {
+            CpuMMap *banks = (mm != g_cpu_mmaps.end() && mm->second.bankWidth > 0)
+                             ? &mm->second : nullptr;
+            ar_sym_symbolize_text(insns[0].text.c_str(), mem->v1.id,
+                                  banks ? mmap_bank : nullptr, banks,
+                                  text, sizeof(text));
+        } else
+            strip_at_markers(insns[0].text.c_str(), text, sizeof(text));
+        pos += snprintf(line + pos, TRACE_LINE_SIZE - pos, "%s", text);
     } else {
         pos += snprintf(line + pos, TRACE_LINE_SIZE - pos, "???");
     }
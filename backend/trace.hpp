@@ -3,8 +3,8 @@
  *
  * Records every instruction executed on selected CPUs into a ring buffer
  * (for the Qt UI) and optionally to a file.  Lines include disassembly,
- * optional bank prefix, optional register state, and optional SP-based
- * indentation.
+ * optional bank prefix, optional register state, optional SP-based
+ * indentation, and optional label+offset symbolization.
  *
  * The trace module manages its own retrodebug execution subscriptions
  * (broad, all addresses) for each enabled CPU.
@@ -58,6 +58,11 @@ bool ar_trace_get_registers(void);
 void ar_trace_set_indent(bool enable);
 bool ar_trace_get_indent(void);
 
+/* Enable/disable symbolization: PCs get a " <label+0xOFF>" suffix and
+ * '@'-marked operands become labels (default: off). */
+void ar_trace_set_symbols(bool enable);
+bool ar_trace_get_symbols(void);
+
 /* System-specific trace options (driven by sys::TraceOption).
  * Options are identified by index (0-based).
  * Settings persist across trace sessions. */
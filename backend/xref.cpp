@@ -0,0 +1,147 @@
+/*
+ * xref.cpp: Cross-reference extraction and index helpers
+ */
+
+#include "xref.hpp"
+#include "retrodebug.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace xref {
+
+static bool ref_less(const ar_xref &a, const ar_xref &b) {
+    if (a.to != b.to) return a.to < b.to;
+    if (a.from_bank != b.from_bank) return a.from_bank < b.from_bank;
+    return a.from < b.from;
+}
+
+static bool is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') ||
+           (c >= 'a' && c <= 'f');
+}
+
+/* R3000A: complete pointers from LUI upper halves */
+static void extract_r3000a(std::span<const uint8_t> raw, HiTracker &hi,
+                           std::vector<Ref> &out)
+{
+    if (raw.size() < 4) return;
+    uint32_t w = (uint32_t)raw[0] | ((uint32_t)raw[1] << 8) |
+                 ((uint32_t)raw[2] << 16) | ((uint32_t)raw[3] << 24);
+    unsigned op = w >> 26;
+    unsigned rs = (w >> 21) & 31;
+    unsigned rt = (w >> 16) & 31;
+    uint16_t imm = w & 0xFFFF;
+    bool known = rs != 0 && ((hi.valid >> rs) & 1);
+
+    switch (op) {
+    case 0x0F: /* LUI */
+        if (rt) {
+            hi.hi[rt] = (uint32_t)imm << 16;
+            hi.valid |= 1u << rt;
+        }
+        return;
+    case 0x09: /* ADDIU */
+        if (known)
+            out.push_back({ (uint32_t)(hi.hi[rs] + (int16_t)imm), AR_XREF_IMM });
+        break;
+    case 0x0D: /* ORI */
+        if (known)
+            out.push_back({ hi.hi[rs] | imm, AR_XREF_IMM });
+        break;
+    case 0x20: case 0x21: case 0x22: case 0x23:   /* LB LH LWL LW */
+    case 0x24: case 0x25: case 0x26:              /* LBU LHU LWR */
+    case 0x28: case 0x29: case 0x2A: case 0x2B:   /* SB SH SWL SW */
+    case 0x2E:                                    /* SWR */
+    case 0x32: case 0x3A:                         /* LWC2 SWC2 */
+        if (known)
+            out.push_back({ (uint32_t)(hi.hi[rs] + (int16_t)imm), AR_XREF_DATA });
+        break;
+    }
+
+    /* Anything that writes a GPR drops its tracked upper half */
+    if (op == 0x00)
+        hi.valid &= ~(1u << ((w >> 11) & 31));
+    else if (op == 0x03)
+        hi.valid &= ~(1u << 31);
+    else if ((op >= 0x08 && op <= 0x0E) || (op >= 0x20 && op <= 0x26))
+        hi.valid &= ~(1u << rt);
+}
+
+void extract(const arch::Instruction &insn, unsigned cpu_type,
+             std::span<const uint8_t> raw, HiTracker &hi,
+             std::vector<Ref> &out)
+{
+    if (insn.is_error) return;
+
+    if (insn.has_target)
+        out.push_back({ insn.target,
+                        insn.is_call    ? AR_XREF_CALL
+                      : insn.breaks_flow ? AR_XREF_JUMP
+                      : AR_XREF_BRANCH });
+
+    /* '@' marks address operands; a bare '$' with 4+ hex digits is an
+     * immediate that may be a pointer (e.g. "LD HL,$C0A2").  Not on the
+     * R3000A, whose 16-bit immediates are masks and constants (ANDI, ORI,
+     * LI); its pointers come from the LUI pairs tracked below. */
+    bool imm = cpu_type != RD_CPU_R3000A;
+    const char *p = insn.text.c_str();
+    while (*p) {
+        bool marked = (*p == '@');
+        if (marked || (imm && *p == '$' && p[1] != '@')) {
+            const char *h = p + 1;
+            while (is_hex(*h)) h++;
+            size_t digits = (size_t)(h - (p + 1));
+            if (digits > 0 && (marked || digits >= 4)) {
+                uint64_t v = strtoull(p + 1, nullptr, 16);
+                if (!(insn.has_target && v == insn.target))
+                    out.push_back({ v, marked ? AR_XREF_DATA : AR_XREF_IMM });
+            }
+            p = h;
+            continue;
+        }
+        p++;
+    }
+
+    if (cpu_type == RD_CPU_R3000A)
+        extract_r3000a(raw, hi, out);
+}
+
+const char *kind_name(ar_xref_kind kind) {
+    switch (kind) {
+    case AR_XREF_CALL:   return "call";
+    case AR_XREF_JUMP:   return "jump";
+    case AR_XREF_BRANCH: return "branch";
+    case AR_XREF_DATA:   return "data";
+    case AR_XREF_IMM:    return "imm";
+    }
+    return "?";
+}
+
+void sort(std::vector<ar_xref> &refs) {
+    std::sort(refs.begin(), refs.end(), ref_less);
+}
+
+std::vector<ar_xref> merge(std::span<const std::vector<ar_xref> *const> parts) {
+    size_t total = 0;
+    for (auto *p : parts) total += p->size();
+
+    std::vector<ar_xref> out;
+    out.reserve(total);
+    for (auto *p : parts) {
+        size_t mid = out.size();
+        out.insert(out.end(), p->begin(), p->end());
+        std::inplace_merge(out.begin(), out.begin() + mid, out.end(), ref_less);
+    }
+    return out;
+}
+
+std::span<const ar_xref> find(const std::vector<ar_xref> &index, uint64_t addr) {
+    auto lo = std::lower_bound(index.begin(), index.end(), addr,
+        [](const ar_xref &r, uint64_t a) { return r.to < a; });
+    auto hi = std::upper_bound(lo, index.end(), addr,
+        [](uint64_t a, const ar_xref &r) { return a < r.to; });
+    return { lo, hi };
+}
+
+} // namespace xref
@@ -0,0 +1,71 @@
+/*
+ * xref.h: Cross-reference extraction and index helpers
+ *
+ * Extracts the addresses an instruction refers to -- branch/call targets,
+ * '@'-marked memory operands, 16-bit immediates, and R3000A LUI pairs
+ * completed by ADDIU/ORI or a load/store -- and keeps references in flat
+ * arrays sorted by target for binary-search queries.  The index itself
+ * is owned by the analysis worker (analysis.cpp), which rebuilds only the
+ * segments whose code changed.
+ */
+
+#ifndef AR_XREF_H
+#define AR_XREF_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "arch.hpp"
+
+enum ar_xref_kind : uint8_t {
+    AR_XREF_CALL,       /* subroutine call target */
+    AR_XREF_JUMP,       /* unconditional jump target */
+    AR_XREF_BRANCH,     /* conditional branch target */
+    AR_XREF_DATA,       /* memory operand */
+    AR_XREF_IMM,        /* immediate that looks like an address */
+};
+
+struct ar_xref {
+    uint64_t     to;
+    uint64_t     from;          /* address of the referencing instruction */
+    int64_t      from_bank;
+    int64_t      to_bank;       /* -1 for unbanked or unknown */
+    ar_xref_kind kind;
+};
+
+namespace xref {
+
+struct Ref {
+    uint64_t     to;
+    ar_xref_kind kind;
+};
+
+/* Upper halves loaded by LUI, per GPR, within the current basic block */
+struct HiTracker {
+    uint32_t hi[32];
+    uint32_t valid = 0;
+    void reset() { valid = 0; }
+};
+
+/* Append the references made by insn.  raw holds the instruction's bytes
+ * (used for the R3000A LUI tracking).  Immediates are reported as
+ * AR_XREF_IMM; the caller decides whether they land in mapped memory. */
+void extract(const arch::Instruction &insn, unsigned cpu_type,
+             std::span<const uint8_t> raw, HiTracker &hi,
+             std::vector<Ref> &out);
+
+const char *kind_name(ar_xref_kind kind);
+
+/* Sort by (to, from) */
+void sort(std::vector<ar_xref> &refs);
+
+/* Merge individually sorted parts into one sorted array */
+std::vector<ar_xref> merge(std::span<const std::vector<ar_xref> *const> parts);
+
+/* All references to addr in a sorted array */
+std::span<const ar_xref> find(const std::vector<ar_xref> &index, uint64_t addr);
+
+} // namespace xref
+
+#endif /* AR_XREF_H */
@@ -12,7 +12,7 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#define RD_API_VERSION 1
+#define RD_API_VERSION 2
 
 /* Watchpoint operations */
 #define RD_MEMORY_READ (1 << 0)
@@ -133,6 +133,23 @@ struct rd_Memory {
         bool (*get_bank_address)(struct rd_Memory const* self, uint64_t address, int64_t bank, rd_MemoryMap* out);
     }
     v1;
+
+    /* Only present if the core's core_api_version is 2 or higher */
+    struct {
+        /* Optional. Reports which pages of (1 << page_shift) bytes, counted
+         * from base_address, may read differently than when the core last
+         * cleared its record: written by the CPU, DMA, poke or poke_range,
+         * or remapped by a bank switch. Pages that change without being
+         * written (timers, I/O registers) are always dirty. Page n is bit
+         * (n & 63) of bitmap[n >> 6]; the caller allocates one bit per page
+         * rounded up to whole words, and the core writes all of them. If
+         * clear is true, the record is cleared once the bitmap is filled.
+         * Loading a state or resetting may leave every page dirty.
+         * Returns false, leaving bitmap untouched, if page_shift is not
+         * supported. Cores should support at least page_shift 12. */
+        bool (*get_dirty_pages)(struct rd_Memory const* self, unsigned page_shift, uint64_t* bitmap, bool clear);
+    }
+    v2;
 };
 
 typedef struct rd_Cpu {
@@ -3,7 +3,11 @@
 #include "backend.hpp"
 #include "registers.hpp"
 #include "symbols.hpp"
+#include "analysis.hpp"
 #include "arch.hpp"
+#include "callstack.hpp"
+#include "memreader.hpp"
+#include "SymbolCompleter.h"
 
 #include <QPainter>
 #include <QFont>
@@ -29,6 +33,7 @@
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QToolTip>
+#include <QSignalBlocker>
 
 #include <algorithm>
 #include <cmath>
@@ -496,10 +501,12 @@ protected:
 
             QString bytes;
             if (m_mem) {
-                for (uint8_t b = 0; b < insn.length; b++) {
-                    uint8_t val = m_mem->v1.peek(m_mem, insn.address + b, false);
-                    bytes += QString("%1").arg(val, 2, 16, QChar('0')).toUpper();
-                }
+                uint8_t raw[16];
+                uint8_t len = insn.length < sizeof(raw) ? insn.length : sizeof(raw);
+                m_reader.set_memory(m_mem);
+                m_reader.read(insn.address, len, raw);
+                for (uint8_t b = 0; b < len; b++)
+                    bytes += QString("%1").arg(raw[b], 2, 16, QChar('0')).toUpper();
             }
             while (bytes.length() < byteColChars)
                 bytes += ' ';
@@ -690,6 +697,31 @@ protected:
         auto *editLabel = menu.addAction("Edit label...");
         auto *editComment = menu.addAction("Edit comment...");
 
+        /* References to this address from analysed code, as last
+         * published; Debugger::refresh() queues changed pages on pause */
+        std::vector<std::pair<QAction *, uint64_t>> refActions;
+        if (m_cpu && m_valid) {
+            int64_t bank = (idx < (int)m_banks.size()) ? m_banks[idx] : -1;
+            auto refs = ar_analysis_xrefs_to(m_cpu, clickAddr, bank);
+            auto *refsMenu = menu.addMenu(
+                QString("References to %1 (%2)").arg(addrLabel).arg(refs.size()));
+            refsMenu->setEnabled(!refs.empty());
+            constexpr size_t maxRefs = 64;
+            for (size_t i = 0; i < refs.size() && i < maxRefs; i++) {
+                QString text = QString("%1  %2")
+                    .arg(refs[i].from, m_addrWidth, 16, QChar('0')).toUpper()
+                    .arg(xref::kind_name(refs[i].kind));
+                if (refs[i].from_bank >= 0)
+                    text = QString("%1:").arg(refs[i].from_bank, 2, 16, QChar('0'))
+                               .toUpper() + text;
+                refActions.push_back({ refsMenu->addAction(text), refs[i].from });
+            }
+            if (refs.size() > maxRefs)
+                refsMenu->addAction(QString("... %1 more (see xref command)")
+                                        .arg(refs.size() - maxRefs))
+                    ->setEnabled(false);
+        }
+
         /* Separator before breakpoint actions */
         menu.addSeparator();
 
@@ -743,6 +775,13 @@ protected:
         auto *chosen = menu.exec(event->globalPos());
         if (!chosen) return;
 
+        for (auto &[action, from] : refActions) {
+            if (chosen == action) {
+                goToAddress(from);
+                return;
+            }
+        }
+
         if (chosen == editLabel && m_mem) {
             auto rslv = ar_sym_resolve(m_mem->v1.id, clickAddr);
             if (!rslv) {
@@ -909,7 +948,7 @@ private:
         int margin = lineH;
         std::vector<JumpArrow> arrows;
         for (int i = 0; i < (int)m_insns.size(); i++) {
-            if (!m_insns[i].has_target) continue;
+            if (!m_insns[i].has_target || m_insns[i].is_call) continue;
             auto it = addrIdx.find(m_insns[i].target);
             if (it == addrIdx.end()) continue;
             int src = delayedFlowIdx(i);
@@ -955,7 +994,7 @@ private:
         int margin = lineH;
         std::vector<int> stubs;
         for (int i = 0; i < (int)m_insns.size(); i++) {
-            if (!m_insns[i].has_target) continue;
+            if (!m_insns[i].has_target || m_insns[i].is_call) continue;
             int src = delayedFlowIdx(i);
             int sy = rowYs[src];
             if (sy < -margin || sy > viewHeight + margin) continue;
@@ -1037,10 +1076,10 @@ private:
 
         uint64_t fetch_size = end - start;
         std::vector<uint8_t> buf(fetch_size);
-        for (uint64_t i = 0; i < fetch_size; i++)
-            buf[i] = m_mem->v1.peek(m_mem, start + i, false);
+        m_reader.set_memory(m_mem);
+        m_reader.read(start, fetch_size, buf.data());
 
-        m_insns = arch::disassemble(buf, start, m_cpuType);
+        m_insns = ar_analysis_disassemble(m_cpu, buf, start);
 
         /* Fetch memory map and compute bank for each instruction */
         m_banks.clear();
@@ -1172,6 +1211,7 @@ private:
     unsigned m_branchDelaySlots = 0;
     rd_Cpu const *m_cpu = nullptr;
     rd_Memory const *m_mem = nullptr;
+    MemReader m_reader;     /* listing and instruction bytes, per frame */
     QScrollBar *m_scrollBar;
     std::vector<LabelRegion> m_labelRegions;
 };
@@ -1378,8 +1418,19 @@ public:
         auto *layout = new QVBoxLayout(this);
         layout->setContentsMargins(4, 4, 4, 4);
 
-        auto *label = new QLabel("Stack Trace", this);
-        layout->addWidget(label);
+        auto *header = new QHBoxLayout;
+        header->addWidget(new QLabel("Stack Trace", this));
+        header->addStretch();
+        m_shadowCheck = new QCheckBox("Shadow", this);
+        m_shadowCheck->setToolTip("Track calls and returns as they execute "
+                                  "instead of unwinding memory");
+        m_shadowCheck->setChecked(ar_callstack_enabled());
+        connect(m_shadowCheck, &QCheckBox::toggled, this, [this](bool on) {
+            ar_callstack_enable(on);
+            refresh();
+        });
+        header->addWidget(m_shadowCheck);
+        layout->addLayout(header);
 
         m_list = new QListWidget(this);
         QFont mono("Monospace", 10);
@@ -1402,7 +1453,7 @@ public:
             return;
         }
         auto *a = arch::arch_for_cpu(cpu->v1.type);
-        if (!a || !a->stack_trace_fn) {
+        if (!a || (!a->stack_trace_fn && !a->flow_fn)) {
             hide();
             return;
         }
@@ -1414,16 +1465,39 @@ public:
         m_list->clear();
         if (!m_cpu || !isVisible()) return;
 
-        auto trace = arch::stack_trace(m_cpu);
+        bool shadow = false;
+        auto trace = ar_backtrace(m_cpu, 64, &shadow);
+        {
+            QSignalBlocker block(m_shadowCheck);
+            m_shadowCheck->setChecked(ar_callstack_enabled());
+        }
 
+        rd_Memory const *mem = m_cpu->v1.memory_region;
         for (auto &frame : trace.frames) {
-            auto *item = new QListWidgetItem(
-                QString("0x%1").arg(frame.pc, m_hexDigits, 16, QChar('0')).toUpper(),
-                m_list);
+            QString text = QString("0x%1").arg(frame.pc, m_hexDigits, 16, QChar('0')).toUpper();
+            auto rslv = mem ? ar_sym_resolve(mem->v1.id, frame.pc)
+                            : std::optional<ar_resolved_addr>();
+            if (rslv) {
+                uint64_t labelAddr = 0;
+                const char *label = ar_sym_nearest_label(rslv->region_id.c_str(),
+                                                         rslv->addr, &labelAddr);
+                if (label && rslv->addr == labelAddr)
+                    text += QString("  %1").arg(label);
+                else if (label)
+                    text += QString("  %1+0x%2").arg(label)
+                                .arg(QString::number(rslv->addr - labelAddr, 16).toUpper());
+            }
+            if (frame.interrupt)
+                text += "  (interrupted)";
+            auto *item = new QListWidgetItem(text, m_list);
             item->setData(Qt::UserRole, QVariant::fromValue<quint64>(frame.pc));
         }
 
-        if (trace.status != arch::StackTraceStatus::OK) {
+        if (!shadow && trace.frames.empty()) {
+            auto *item = new QListWidgetItem("enable Shadow to trace calls", m_list);
+            item->setForeground(Qt::gray);
+            item->setData(Qt::UserRole, QVariant::fromValue<quint64>(UINT64_MAX));
+        } else if (trace.status != arch::StackTraceStatus::OK) {
             const char *msg = nullptr;
             switch (trace.status) {
             case arch::StackTraceStatus::MAX_DEPTH:  msg = "max depth reached"; break;
@@ -1442,6 +1516,7 @@ public:
 private:
     std::function<void(uint64_t)> m_navigateCb;
     QListWidget *m_list = nullptr;
+    QCheckBox *m_shadowCheck = nullptr;
     rd_Cpu const *m_cpu = nullptr;
     int m_hexDigits = 4;
 };
@@ -1574,13 +1649,19 @@ void Debugger::onCpuChanged(int index) {
 void Debugger::goToAddress() {
     if (!m_lastPaused) return;
 
-    bool ok;
-    QString text = QInputDialog::getText(this, "Go to Address",
-        "Address (hex):", QLineEdit::Normal, "", &ok);
-    if (!ok || text.isEmpty()) return;
-
-    uint64_t addr = text.toULongLong(&ok, 16);
-    if (!ok) return;
+    QInputDialog dlg(this);
+    dlg.setWindowTitle("Go to Address");
+    dlg.setLabelText("Address (hex, $ or 0x prefix) or label:");
+    dlg.setInputMode(QInputDialog::TextInput);   /* creates the line edit */
+    if (auto *edit = dlg.findChild<QLineEdit *>())
+        new SymbolCompleter(edit);
+    if (dlg.exec() != QDialog::Accepted) return;
+    QString text = dlg.textValue().trimmed();
+    if (text.isEmpty()) return;
+
+    uint64_t addr;
+    if (!parseAddress(text, m_cpu ? m_cpu->v1.memory_region : nullptr, &addr))
+        return;
 
     m_disasm->goToAddress(addr);
 }
@@ -1590,6 +1671,9 @@ void Debugger::setThreadBlocked(bool blocked) {
 }
 
 void Debugger::refresh(bool paused) {
+    /* Have the analysis worker re-decode code changed while running, so
+     * cross-references are current by the time a menu asks for them */
+    if (paused && !m_lastPaused && isVisible()) ar_analysis_refresh();
     m_lastPaused = paused;
     if (m_goToAction) m_goToAction->setEnabled(paused);
     if (!isVisible()) return;
@@ -10,6 +10,7 @@
 #include "gb/TileViewer.h"
 #include "gb/TilemapViewer.h"
 #include "psx/VramViewer.h"
+#include "RefreshScheduler.h"
 
 #include <QMenuBar>
 #include <QMenu>
@@ -28,6 +29,7 @@
 #include "backend.hpp"
 #include "breakpoint.hpp"
 #include "symbols.hpp"
+#include "analysis.hpp"
 
 /* Position a newly-created floating widget so it doesn't overlap existing
    visible floating widgets, staying on the same monitor as the main window. */
@@ -94,6 +96,7 @@ MainWindow::MainWindow(QWidget *parent)
     , m_tilemapViewer(nullptr)
     , m_vramViewer(nullptr)
     , m_timer(new QTimer(this))
+    , m_refresh(new RefreshScheduler(this, m_video))
 {
     setWindowTitle("Arrêt");
     setCentralWidget(m_video);
@@ -144,9 +147,11 @@ void MainWindow::tick() {
             m_stepping = false;
             m_paused = true;
             m_pauseAction->setText("Resume");
+            m_refresh->markDirty(RefreshScheduler::Frame | RefreshScheduler::Memory);
         }
         if (ar_bp_hit() >= 0) {
             ar_bp_ack_hit();
+            m_refresh->markDirty(RefreshScheduler::Frame | RefreshScheduler::Memory);
             m_paused = true;
             m_bpPaused = true;
             m_pauseAction->setText("Resume");
@@ -163,6 +168,7 @@ void MainWindow::tick() {
     if (state == 3 /* DONE */) {
         ar_core_ack_done();
         state = 0;
+        m_refresh->markDirty(RefreshScheduler::Frame | RefreshScheduler::Memory);
         if (m_stepping && ar_debug_step_complete()) {
             ar_debug_step_end();
             m_stepping = false;
@@ -197,21 +203,26 @@ void MainWindow::tick() {
         }
     }
 
-    /* UI refresh always */
+    /* Tell the scheduler what changed; tool windows refresh only when
+       something they show did */
+    if (state == 2 && m_lastCoreState != 2)
+        m_refresh->markDirty(RefreshScheduler::Frame | RefreshScheduler::Memory);
+    m_lastCoreState = state;
+
+    bool uiPaused = (state == 0 && m_paused) || state == 2;
+    if (uiPaused != m_lastUiPaused) {
+        m_refresh->markDirty(RefreshScheduler::Paused | RefreshScheduler::Memory);
+        m_lastUiPaused = uiPaused;
+    }
+    if (ar_bp_generation() != m_bpGeneration) {
+        m_bpGeneration = ar_bp_generation();
+        m_refresh->markDirty(RefreshScheduler::Breakpoints);
+    }
+
     m_video->update();
-    if (m_memViewer) m_memViewer->refresh();
-    if (m_memSearch) m_memSearch->refresh();
-    if (m_debugger) {
-        bool paused = (state == 0 && m_paused) || state == 2 || state == 3;
-        m_debugger->refresh(paused);
-    }
-    if (m_breakpoints) m_breakpoints->refresh();
-    if (m_traceLog) m_traceLog->refresh();
-    if (m_inputTool) m_inputTool->refresh();
-    if (m_tileViewer) m_tileViewer->refresh();
-    if (m_tilemapViewer) m_tilemapViewer->refresh();
-    if (m_vramViewer) m_vramViewer->refresh();
-    ar_check_socket_commands();
+    m_refresh->run();
+    if (ar_check_socket_commands() > 0)
+        m_refresh->markDirty(RefreshScheduler::Commands);
 
     if (!ar_running())
         close();
@@ -254,8 +265,10 @@ void MainWindow::loadContent() {
     ar_bp_set_auto(true);
     ar_bp_auto_load();
     ar_sym_auto_load();
+    ar_analysis_auto_start();
 
     updateMenuState();
+    m_refresh->markDirty(RefreshScheduler::All);
 
     /* Restart with correct timing */
     m_timer->stop();
@@ -329,6 +342,7 @@ void MainWindow::reloadRom() {
     if (!ar_content_loaded()) return;
     m_audio->stop();
     ar_reload_rom();
+    m_refresh->markDirty(RefreshScheduler::All);
     m_video->update();
     if (!ar_is_mute())
         m_audio->start();
@@ -344,6 +358,13 @@ void MainWindow::openMemoryViewerAt(rd_Memory const *mem, uint64_t addr) {
         m_memViewer = new MemoryViewer(this);
         m_memViewer->setFloating(true);
         m_memViewer->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_memViewer, "Memory Viewer",
+                       RefreshScheduler::Memory | RefreshScheduler::Commands, 60,
+                       [this, w = m_memViewer] {
+                           w->refresh();
+                           if (w->isFading())
+                               m_refresh->markDirty(w);
+                       });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_memViewer, {m_memSearch, m_debugger, m_breakpoints, m_traceLog, m_inputTool});
@@ -361,6 +382,9 @@ void MainWindow::openMemorySearch() {
         m_memSearch = new MemorySearch(this);
         m_memSearch->setFloating(true);
         m_memSearch->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_memSearch, "Memory Search",
+                       RefreshScheduler::Memory | RefreshScheduler::Commands, 10,
+                       [w = m_memSearch] { w->refresh(); });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_memSearch, {m_memViewer, m_debugger, m_breakpoints, m_traceLog, m_inputTool});
@@ -376,6 +400,10 @@ void MainWindow::openDebugger() {
         m_debugger = new Debugger(this);
         m_debugger->setFloating(true);
         m_debugger->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_debugger, "Debugger",
+                       RefreshScheduler::Memory | RefreshScheduler::Paused |
+                       RefreshScheduler::Breakpoints | RefreshScheduler::Commands, 30,
+                       [this, w = m_debugger] { w->refresh(m_lastUiPaused); });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_debugger, {m_memViewer, m_memSearch, m_breakpoints, m_traceLog, m_inputTool});
@@ -391,6 +419,9 @@ void MainWindow::openBreakpoints() {
         m_breakpoints = new Breakpoints(this);
         m_breakpoints->setFloating(true);
         m_breakpoints->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_breakpoints, "Breakpoints",
+                       RefreshScheduler::Breakpoints | RefreshScheduler::Commands, 10,
+                       [w = m_breakpoints] { w->refresh(); });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_breakpoints, {m_memViewer, m_memSearch, m_debugger, m_traceLog, m_inputTool});
@@ -406,6 +437,9 @@ void MainWindow::openTraceLog() {
         m_traceLog = new TraceLog(this);
         m_traceLog->setFloating(true);
         m_traceLog->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_traceLog, "Trace Log",
+                       RefreshScheduler::Frame | RefreshScheduler::Commands, 30,
+                       [w = m_traceLog] { w->refresh(); });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_traceLog, {m_memViewer, m_memSearch, m_debugger, m_breakpoints, m_inputTool});
@@ -421,6 +455,9 @@ void MainWindow::openInputTool() {
         m_inputTool = new InputTool(this);
         m_inputTool->setFloating(true);
         m_inputTool->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_inputTool, "Input",
+                       RefreshScheduler::Commands, 10,
+                       [w = m_inputTool] { w->refresh(); });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_inputTool, {m_memViewer, m_memSearch, m_debugger, m_breakpoints, m_traceLog});
@@ -436,6 +473,9 @@ void MainWindow::openTileViewer() {
         m_tileViewer = new TileViewer(this);
         m_tileViewer->setFloating(true);
         m_tileViewer->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_tileViewer, "Tile Viewer",
+                       RefreshScheduler::Frame | RefreshScheduler::Memory | RefreshScheduler::Commands, 30,
+                       [w = m_tileViewer] { w->refresh(); });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_tileViewer, {m_memViewer, m_memSearch, m_debugger, m_breakpoints, m_traceLog, m_inputTool});
@@ -451,6 +491,9 @@ void MainWindow::openTilemapViewer() {
         m_tilemapViewer = new TilemapViewer(this);
         m_tilemapViewer->setFloating(true);
         m_tilemapViewer->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_tilemapViewer, "Tilemap Viewer",
+                       RefreshScheduler::Frame | RefreshScheduler::Memory | RefreshScheduler::Commands, 30,
+                       [w = m_tilemapViewer] { w->refresh(); });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_tilemapViewer, {m_memViewer, m_memSearch, m_debugger, m_breakpoints, m_traceLog, m_inputTool, m_tileViewer});
@@ -466,6 +509,9 @@ void MainWindow::openVramViewer() {
         m_vramViewer = new VramViewer(this);
         m_vramViewer->setFloating(true);
         m_vramViewer->setAllowedAreas(Qt::NoDockWidgetArea);
+        m_refresh->add(m_vramViewer, "VRAM Viewer",
+                       RefreshScheduler::Frame | RefreshScheduler::Memory | RefreshScheduler::Commands, 30,
+                       [w = m_vramViewer] { w->refresh(); });
     }
     if (firstOpen)
         placeFloatingWidget(this, m_vramViewer, {m_memViewer, m_memSearch, m_debugger, m_breakpoints, m_traceLog, m_inputTool, m_tileViewer, m_tilemapViewer});
@@ -475,6 +521,10 @@ void MainWindow::openVramViewer() {
     }
 }
 
+void MainWindow::toggleRefreshStats(bool on) {
+    m_refresh->setOverlayVisible(on);
+}
+
 void MainWindow::openContentInfo() {
     if (!ar_has_debug() || !ar_content_loaded()) {
         QMessageBox::information(this, "Content Info", "No content loaded.");
@@ -620,6 +670,7 @@ void MainWindow::buildMenus() {
                 return;
             }
             ar_load_state(slot);
+            m_refresh->markDirty(RefreshScheduler::All);
         });
     }
 
@@ -666,6 +717,11 @@ void MainWindow::buildMenus() {
     toolsMenu->addAction("Content Info", this, &MainWindow::openContentInfo,
                          QKeySequence("Ctrl+Shift+I"));
 
+    toolsMenu->addSeparator();
+    auto *statsAction = toolsMenu->addAction("Refresh Stats");
+    statsAction->setCheckable(true);
+    connect(statsAction, &QAction::toggled, this, &MainWindow::toggleRefreshStats);
+
     updateMenuState();
 }
 
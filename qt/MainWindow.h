@@ -15,6 +15,7 @@ class InputTool;
 class TileViewer;
 class TilemapViewer;
 class VramViewer;
+class RefreshScheduler;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -52,6 +53,7 @@ private slots:
     void openTileViewer();
     void openTilemapViewer();
     void openVramViewer();
+    void toggleRefreshStats(bool on);
 
 private:
     void buildMenus();
@@ -70,6 +72,10 @@ private:
     TilemapViewer *m_tilemapViewer;
     VramViewer   *m_vramViewer;
     QTimer       *m_timer;
+    RefreshScheduler *m_refresh;
+    unsigned      m_bpGeneration = 0;
+    int           m_lastCoreState = 0;
+    bool          m_lastUiPaused = false;
     bool          m_paused = false;
     bool          m_stepping = false;
     bool          m_bpPaused = false;      /* paused at a breakpoint */
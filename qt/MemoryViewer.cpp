@@ -26,7 +26,9 @@
 #include <vector>
 
 #include "backend.hpp"
+#include "regions.hpp"
 #include "symbols.hpp"
+#include "SymbolCompleter.h"
 
 /* ======================================================================== */
 /* GoToDialog                                                                */
@@ -39,7 +41,8 @@ GoToDialog::GoToDialog(QWidget *parent)
     auto *layout = new QVBoxLayout(this);
 
     m_input = new QLineEdit;
-    m_input->setPlaceholderText("0000");
+    m_input->setPlaceholderText("0000 or label");
+    new SymbolCompleter(m_input);
     layout->addWidget(m_input);
 
     auto *btn = new QPushButton("Jump To");
@@ -49,10 +52,72 @@ GoToDialog::GoToDialog(QWidget *parent)
     connect(m_input, &QLineEdit::returnPressed, this, &QDialog::accept);
 }
 
-uint64_t GoToDialog::address() const {
-    bool ok;
-    uint64_t addr = m_input->text().toULongLong(&ok, 16);
-    return ok ? addr : 0;
+bool GoToDialog::address(rd_Memory const *space, rd_Memory const **mem,
+                         uint64_t *addr) const {
+    if (!parseAddress(m_input->text(), space, addr, mem)) return false;
+    if (*mem == space) *mem = nullptr;
+    return true;
+}
+
+/* ======================================================================== */
+/* HexViewState                                                              */
+/* ======================================================================== */
+
+bool HexViewState::takeSnapshot(int rows) {
+    if (!mem || size == 0) {
+        bool had = snapFirst >= 0;
+        snapFirst = -1;
+        snap.clear();
+        heat.clear();
+        return had;
+    }
+
+    int64_t first = (int64_t)scrollRow * bytesPerRow();
+    int64_t count = (int64_t)rows * bytesPerRow();
+    if (first > (int64_t)size) first = (int64_t)size;
+    if (count > (int64_t)size - first) count = (int64_t)size - first;
+
+    scratch.resize((size_t)count);
+    reader.set_memory(mem);
+    reader.read(baseAddr + (uint64_t)first, (uint64_t)count, scratch.data());
+
+    /* Window moved or new region: no change highlighting */
+    if (mem != snapMem || first != snapFirst || scratch.size() != snap.size()) {
+        snapMem = mem;
+        snapFirst = first;
+        snap.swap(scratch);
+        heat.assign(snap.size(), 0);
+        return true;
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < snap.size(); i++) {
+        if (scratch[i] != snap[i]) {
+            heat[i] = fadeTicks();
+            changed = true;
+        } else if (heat[i] > 0) {
+            heat[i]--;
+            changed = true;
+        }
+    }
+    if (changed) snap.swap(scratch);
+    return changed;
+}
+
+void HexViewState::ensureSnapshot(int rows) {
+    int64_t first = (int64_t)scrollRow * bytesPerRow();
+    int64_t count = (int64_t)rows * bytesPerRow();
+    if (count > (int64_t)size - first) count = (int64_t)size - first;
+    if (mem != snapMem || first != snapFirst || count > (int64_t)snap.size())
+        takeSnapshot(rows);
+}
+
+uint8_t HexViewState::byteAt(int64_t idx) const {
+    int64_t i = idx - snapFirst;
+    if (snapFirst >= 0 && i >= 0 && i < (int64_t)snap.size())
+        return snap[i];
+    reader.set_memory(mem);
+    return reader.read8(baseAddr + (uint64_t)idx);
 }
 
 /* ======================================================================== */
@@ -172,6 +237,7 @@ void HexArea::paintEvent(QPaintEvent *) {
 
     int64_t sMin = m_state->selMin();
     int64_t sMax = m_state->selMax();
+    m_state->ensureSnapshot(vis);
 
     /* Build watchpoint map: address → {exists, anyEnabled}
      * Only if current region is a CPU's memory_region */
@@ -221,7 +287,7 @@ void HexArea::paintEvent(QPaintEvent *) {
             if (idx >= (int64_t)m_state->size) break;
 
             uint64_t addr = m_state->baseAddr + (uint64_t)idx;
-            uint8_t val = m_state->mem->v1.peek(m_state->mem, addr, false);
+            uint8_t val = m_state->byteAt(idx);
 
             int hx = 2 + col * cw * 3;
             bool selected = (sMin >= 0 && idx >= sMin && idx <= sMax);
@@ -242,6 +308,10 @@ void HexArea::paintEvent(QPaintEvent *) {
                 } else if (ar_sym_has_annotation(m_state->mem->v1.id, addr)) {
                     p.fillRect(hx, y, cw * 2, rh, QColor(200, 230, 200));
                 }
+                /* Recently changed: fades out over fadeTicks() refreshes */
+                if (uint8_t heat = m_state->heatAt(idx))
+                    p.fillRect(hx, y, cw * 2, rh,
+                               QColor(255, 90, 60, 40 + 160 * heat / HexViewState::fadeTicks()));
                 p.setPen(Qt::black);
             }
 
@@ -407,6 +477,7 @@ void HexArea::keyPressEvent(QKeyEvent *event) {
         uint8_t val = (uint8_t)((m_state->editNibble << 4) | digit);
         uint64_t addr = m_state->baseAddr + (uint64_t)cur;
         m_state->mem->v1.poke(m_state->mem, addr, val);
+        ar_regions_invalidate();
         m_state->editNibble = -1;
 
         /* Advance cursor */
@@ -569,6 +640,7 @@ void AsciiColumn::paintEvent(QPaintEvent *) {
 
     int64_t sMin = m_state->selMin();
     int64_t sMax = m_state->selMax();
+    m_state->ensureSnapshot(vis);
 
     for (int i = 0; i < vis; i++) {
         int row = m_state->scrollRow + i;
@@ -580,8 +652,7 @@ void AsciiColumn::paintEvent(QPaintEvent *) {
             int64_t idx = (int64_t)row * 16 + col;
             if (idx >= (int64_t)m_state->size) break;
 
-            uint64_t addr = m_state->baseAddr + (uint64_t)idx;
-            uint8_t val = m_state->mem->v1.peek(m_state->mem, addr, false);
+            uint8_t val = m_state->byteAt(idx);
 
             int ax = 2 + col * cw;
             bool selected = (sMin >= 0 && idx >= sMin && idx <= sMax);
@@ -590,6 +661,9 @@ void AsciiColumn::paintEvent(QPaintEvent *) {
                 p.fillRect(ax, y, cw, rh, QColor(60, 120, 200));
                 p.setPen(Qt::white);
             } else {
+                if (uint8_t heat = m_state->heatAt(idx))
+                    p.fillRect(ax, y, cw, rh,
+                               QColor(255, 90, 60, 40 + 160 * heat / HexViewState::fadeTicks()));
                 p.setPen(val >= 0x20 && val < 0x7F ? Qt::black : Qt::lightGray);
             }
 
@@ -689,6 +763,15 @@ MemoryViewer::MemoryViewer(QWidget *parent)
 }
 
 void MemoryViewer::refresh() {
+    /* One read of the visible rows per tick; repaint only if a byte
+       changed or is still fading, the window moved, or watchpoints were
+       added/removed */
+    if (!isVisible()) return;
+    unsigned bpCount = ar_bp_count();
+    bool changed = m_state.takeSnapshot(m_hexArea->visibleRows() + 1);
+    if (!changed && bpCount == m_bpCount) return;
+    m_bpCount = bpCount;
+
     m_addrCol->update();
     m_hexArea->update();
     m_asciiCol->update();
@@ -800,8 +883,11 @@ void MemoryViewer::goTo(rd_Memory const *mem, uint64_t addr) {
 
 void MemoryViewer::onGoTo() {
     GoToDialog dlg(this);
-    if (dlg.exec() == QDialog::Accepted)
-        goTo(nullptr, dlg.address());
+    if (dlg.exec() != QDialog::Accepted) return;
+    rd_Memory const *mem;
+    uint64_t addr;
+    if (dlg.address(m_state.mem, &mem, &addr))
+        goTo(mem, addr);
 }
 
 void MemoryViewer::onCopy() {
@@ -809,12 +895,13 @@ void MemoryViewer::onCopy() {
     int64_t sMax = m_state.selMax();
     if (sMin < 0 || !m_state.mem) return;
 
+    std::vector<uint8_t> bytes((size_t)(sMax - sMin + 1));
+    ar_mem_read(m_state.mem, m_state.baseAddr + (uint64_t)sMin, bytes.size(), bytes.data());
+
     QString result;
-    for (int64_t i = sMin; i <= sMax; i++) {
-        if (i > sMin) result += ' ';
-        uint64_t addr = m_state.baseAddr + (uint64_t)i;
-        uint8_t val = m_state.mem->v1.peek(m_state.mem, addr, false);
-        result += QString("%1").arg(val, 2, 16, QChar('0')).toUpper();
+    for (size_t i = 0; i < bytes.size(); i++) {
+        if (i > 0) result += ' ';
+        result += QString("%1").arg(bytes[i], 2, 16, QChar('0')).toUpper();
     }
 
     QApplication::clipboard()->setText(result);
@@ -842,6 +929,7 @@ void MemoryViewer::onPaste() {
             m_state.mem->v1.poke(m_state.mem, m_state.baseAddr + (uint64_t)pos, val);
         pos++;
     }
+    ar_regions_invalidate();
 
     refresh();
 }
@@ -892,8 +980,7 @@ void MemoryViewer::onDump() {
 
     while (remaining > 0) {
         int n = (remaining > CHUNK) ? CHUNK : (int)remaining;
-        for (int i = 0; i < n; i++)
-            buf[i] = m_state.mem->v1.peek(m_state.mem, addr + i, false);
+        ar_mem_read(m_state.mem, addr, (uint64_t)n, buf);
         file.write(reinterpret_cast<const char *>(buf), n);
         addr += n;
         remaining -= n;
@@ -6,6 +6,9 @@
 #include <QDialog>
 #include <QScrollBar>
 #include <stdint.h>
+#include <vector>
+
+#include "memreader.hpp"
 
 QT_BEGIN_NAMESPACE
 class QComboBox;
@@ -45,6 +48,40 @@ struct HexViewState {
     bool hasRange() const {
         return selAnchor >= 0 && selCursor >= 0 && selAnchor != selCursor;
     }
+
+    /* Snapshot of the visible rows, read once per refresh and shared by
+     * the hex and ASCII columns.  heat[i] counts down from fadeTicks()
+     * after snap[i] changed. */
+    static constexpr int fadeTicks() { return 30; }
+
+    rd_Memory const *snapMem = nullptr;
+    int64_t snapFirst = -1;             /* byte index of snap[0] */
+    std::vector<uint8_t> snap;
+    std::vector<uint8_t> heat;
+    std::vector<uint8_t> scratch;
+
+    /* Pages read this frame, shared by snapshots and single-byte reads */
+    mutable MemReader reader;
+
+    /* Re-read the rows from scrollRow.  Returns false if nothing visible
+     * changed: same window, same bytes, nothing fading. */
+    bool takeSnapshot(int rows);
+
+    /* Snapshot covering rows from scrollRow, taken now if the window moved
+     * since the last refresh (scroll, resize, region change). */
+    void ensureSnapshot(int rows);
+
+    uint8_t byteAt(int64_t idx) const;
+    uint8_t heatAt(int64_t idx) const {
+        int64_t i = idx - snapFirst;
+        return (snapFirst >= 0 && i >= 0 && i < (int64_t)heat.size()) ? heat[i] : 0;
+    }
+
+    bool fading() const {
+        for (uint8_t h : heat)
+            if (h) return true;
+        return false;
+    }
 };
 
 /* ======================================================================== */
@@ -55,7 +92,11 @@ class GoToDialog : public QDialog {
     Q_OBJECT
 public:
     explicit GoToDialog(QWidget *parent = nullptr);
-    uint64_t address() const;
+
+    /* Hex address, or a label as seen from space; *mem is the region to
+     * show (NULL: stay in the current one).  False if neither parses. */
+    bool address(rd_Memory const *space, rd_Memory const **mem,
+                 uint64_t *addr) const;
 
 private:
     QLineEdit *m_input;
@@ -144,6 +185,9 @@ public:
 
     void refresh();
 
+    /* Change highlights still fading: needs refreshes with no new changes */
+    bool isFading() const { return m_state.fading(); }
+
     /* Navigate to an address. If mem is non-null, switch to that region first.
        If mem is null, use the currently-selected region. */
     void goTo(rd_Memory const *mem, uint64_t addr);
@@ -165,6 +209,7 @@ private:
     HexArea       *m_hexArea;
     AsciiColumn   *m_asciiCol;
     QScrollBar    *m_scrollBar;
+    unsigned       m_bpCount = 0;
 };
 
 #endif // MEMORYVIEWER_H
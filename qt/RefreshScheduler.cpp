@@ -0,0 +1,155 @@
+#include "RefreshScheduler.h"
+
+#include <QApplication>
+#include <QEvent>
+#include <QFont>
+#include <QLabel>
+#include <QWidget>
+#include <algorithm>
+
+static constexpr qint64 OVERLAY_INTERVAL_NS = 500 * 1000 * 1000;
+
+/* ======================================================================== */
+/* RefreshScheduler                                                          */
+/* ======================================================================== */
+
+RefreshScheduler::RefreshScheduler(QWidget *mainWindow, QWidget *overlayParent)
+    : QObject(mainWindow), m_main(mainWindow), m_overlayParent(overlayParent)
+{
+    m_clock.start();
+    qApp->installEventFilter(this);
+}
+
+void RefreshScheduler::add(QWidget *w, const QString &name, unsigned deps,
+                           int maxHz, std::function<void()> refresh) {
+    Client c;
+    c.widget = w;
+    c.name = name;
+    c.deps = deps;
+    c.minIntervalNs = maxHz > 0 ? 1000000000LL / maxHz : 0;
+    c.refresh = std::move(refresh);
+    m_clients.push_back(std::move(c));
+
+    connect(w, &QObject::destroyed, this, [this](QObject *obj) {
+        m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                            [obj](const Client &c) { return c.widget == obj; }),
+                        m_clients.end());
+    });
+}
+
+void RefreshScheduler::markDirty(unsigned deps) {
+    for (auto &c : m_clients)
+        c.dirty |= deps & c.deps;
+}
+
+void RefreshScheduler::markDirty(QWidget *w) {
+    for (auto &c : m_clients)
+        if (c.widget == w) c.dirty |= c.deps;
+}
+
+bool RefreshScheduler::eventFilter(QObject *obj, QEvent *event) {
+    if ((event->type() == QEvent::KeyRelease ||
+         event->type() == QEvent::MouseButtonRelease) && obj->isWidgetType()) {
+        QWidget *top = static_cast<QWidget *>(obj)->window();
+        for (auto &c : m_clients) {
+            if (c.widget->window() == top) {
+                markDirty(Memory);
+                break;
+            }
+        }
+    }
+    return QObject::eventFilter(obj, event);
+}
+
+bool RefreshScheduler::isShown(const QWidget *w) const {
+    return w->isVisible() && !w->window()->isMinimized() && !m_main->isMinimized();
+}
+
+void RefreshScheduler::run() {
+    qint64 now = m_clock.nsecsElapsed();
+
+    /* Index loop: a refresh may open another tool window */
+    for (size_t i = 0; i < m_clients.size(); i++) {
+        Client &c = m_clients[i];
+        if (!c.dirty) continue;
+        if (!isShown(c.widget)) {
+            c.skippedHidden++;
+            continue;
+        }
+        if (c.lastRunNs >= 0 && now - c.lastRunNs < c.minIntervalNs)
+            continue;
+
+        /* Cleared first so the refresh can ask for another pass */
+        c.dirty = 0;
+        c.lastRunNs = now;
+
+        QElapsedTimer t;
+        t.start();
+        auto refresh = c.refresh;
+        refresh();
+        qint64 ns = t.nsecsElapsed();
+
+        Client &after = m_clients[i];
+        after.avgNs = after.avgNs > 0 ? after.avgNs * 0.9 + ns * 0.1 : (double)ns;
+        after.maxNs = std::max(after.maxNs, ns);
+        after.runs++;
+    }
+
+    if (m_overlay && now - m_overlayLastNs >= OVERLAY_INTERVAL_NS)
+        updateOverlay();
+}
+
+/* ======================================================================== */
+/* Cost overlay                                                              */
+/* ======================================================================== */
+
+void RefreshScheduler::setOverlayVisible(bool on) {
+    if (on == overlayVisible()) return;
+    if (!on) {
+        delete m_overlay;
+        m_overlay = nullptr;
+        return;
+    }
+
+    m_overlay = new QLabel(m_overlayParent);
+    QFont mono("Monospace", 9);
+    mono.setStyleHint(QFont::Monospace);
+    m_overlay->setFont(mono);
+    m_overlay->setStyleSheet("QLabel { background: rgba(0, 0, 0, 160); color: white; padding: 4px; }");
+    m_overlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    m_overlay->move(4, 4);
+    m_overlayLastNs = m_clock.nsecsElapsed();
+    updateOverlay();
+    m_overlay->show();
+}
+
+bool RefreshScheduler::overlayVisible() const {
+    return m_overlay != nullptr;
+}
+
+void RefreshScheduler::updateOverlay() {
+    qint64 now = m_clock.nsecsElapsed();
+    double secs = (now - m_overlayLastNs) / 1e9;
+    if (secs <= 0) secs = 1;
+    m_overlayLastNs = now;
+
+    QString text = QString("%1 %2 %3 %4")
+                       .arg("refresh", -16).arg("avg ms", 7)
+                       .arg("max ms", 7).arg("Hz", 4);
+    for (auto &c : m_clients) {
+        QString line = QString("%1 %2 %3 %4")
+                           .arg(c.name.left(16), -16)
+                           .arg(c.avgNs / 1e6, 7, 'f', 2)
+                           .arg(c.maxNs / 1e6, 7, 'f', 2)
+                           .arg(c.runs / secs, 4, 'f', 0);
+        if (!isShown(c.widget))
+            line += c.skippedHidden ? "  hidden, dirty" : "  hidden";
+        text += "\n" + line;
+        c.maxNs = 0;
+        c.runs = 0;
+        c.skippedHidden = 0;
+    }
+    m_overlay->setText(text);
+    m_overlay->adjustSize();
+    m_overlay->raise();
+}
@@ -0,0 +1,88 @@
+#ifndef REFRESHSCHEDULER_H
+#define REFRESHSCHEDULER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+#include <functional>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+class QEvent;
+class QLabel;
+class QWidget;
+QT_END_NAMESPACE
+
+/* ======================================================================== */
+/* RefreshScheduler                                                          */
+/* ======================================================================== */
+
+/* Decides which tool windows refresh on a UI tick.  Each client declares
+ * what its view depends on and a maximum refresh rate; MainWindow reports
+ * what happened since the last tick.  A client runs only when one of its
+ * dependencies changed, it is visible (not closed or minimized), and its
+ * rate allows it.  Changes seen while hidden or rate-limited are kept
+ * until the client can run. */
+class RefreshScheduler : public QObject {
+    Q_OBJECT
+public:
+    enum Dependency : unsigned {
+        Frame       = 1 << 0,   // core ran (frame finished or blocked mid-frame)
+        Memory      = 1 << 1,   // memory / registers may differ (run, step, state load, reset)
+        Breakpoints = 1 << 2,   // breakpoint list changed
+        Paused      = 1 << 3,   // pause / run state changed
+        Commands    = 1 << 4,   // a socket command ran (may change anything)
+        All         = 0x1F,
+    };
+
+    /* overlayParent hosts the cost overlay (the video widget) */
+    RefreshScheduler(QWidget *mainWindow, QWidget *overlayParent);
+
+    /* Register w; refresh is called on the UI thread.  The client is
+       dropped when w is destroyed.  New clients start dirty. */
+    void add(QWidget *w, const QString &name, unsigned deps, int maxHz,
+             std::function<void()> refresh);
+
+    void markDirty(unsigned deps);
+    void markDirty(QWidget *w);
+
+    /* Run due clients.  Called once per tick. */
+    void run();
+
+    /* Per-client refresh cost overlay, top-left over overlayParent. */
+    void setOverlayVisible(bool on);
+    bool overlayVisible() const;
+
+protected:
+    /* Input in a tool window may poke memory or registers */
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private:
+    struct Client {
+        QWidget *widget;
+        QString name;
+        unsigned deps;
+        qint64 minIntervalNs;
+        std::function<void()> refresh;
+        unsigned dirty = All;
+        qint64 lastRunNs = -1;
+
+        /* Cost statistics (overlay) */
+        double avgNs = 0;           // exponential moving average
+        qint64 maxNs = 0;           // since last overlay update
+        unsigned runs = 0;          // since last overlay update
+        unsigned skippedHidden = 0;
+    };
+
+    bool isShown(const QWidget *w) const;
+    void updateOverlay();
+
+    QWidget *m_main;
+    QWidget *m_overlayParent;
+    std::vector<Client> m_clients;
+    QElapsedTimer m_clock;
+    QLabel *m_overlay = nullptr;
+    qint64 m_overlayLastNs = 0;
+};
+
+#endif // REFRESHSCHEDULER_H
@@ -0,0 +1,117 @@
+#include "SymbolCompleter.h"
+
+#include <QAbstractItemView>
+#include <QLineEdit>
+#include <QStringListModel>
+#include <cstring>
+#include <vector>
+
+#include "backend.hpp"
+#include "symbols.hpp"
+
+static constexpr unsigned MAX_MATCHES = 32;
+
+/* ======================================================================== */
+/* SymbolCompleter                                                           */
+/* ======================================================================== */
+
+SymbolCompleter::SymbolCompleter(QLineEdit *edit)
+    : QCompleter(edit), m_edit(edit), m_model(new QStringListModel(this))
+{
+    setModel(m_model);
+    setWidget(edit);
+    setCaseSensitivity(Qt::CaseInsensitive);
+    setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    setMaxVisibleItems(12);
+
+    connect(edit, &QLineEdit::textEdited, this, &SymbolCompleter::updateMatches);
+    connect(this, qOverload<const QString &>(&QCompleter::activated), edit,
+        [edit](const QString &label) { edit->setText(label); });
+}
+
+void SymbolCompleter::updateMatches(const QString &text) {
+    QByteArray query = text.trimmed().toUtf8();
+    QStringList labels;
+    if (!query.isEmpty()) {
+        ar_symbol_match matches[MAX_MATCHES];
+        unsigned n = ar_sym_find(query.constData(), matches, MAX_MATCHES);
+        for (unsigned i = 0; i < n; i++)
+            labels << QString::fromUtf8(matches[i].label);
+    }
+    m_model->setStringList(labels);
+
+    /* A lone exact match needs no popup */
+    if (labels.isEmpty() ||
+        (labels.size() == 1 && labels[0].compare(text.trimmed(), Qt::CaseInsensitive) == 0)) {
+        popup()->hide();
+        return;
+    }
+    complete();
+}
+
+/* ======================================================================== */
+/* Label lookup                                                              */
+/* ======================================================================== */
+
+bool symbolAddress(const QString &text, rd_Memory const *space,
+                   uint64_t *addr, rd_Memory const **mem) {
+    QByteArray name = text.trimmed().toUtf8();
+    if (name.isEmpty()) return false;
+
+    ar_symbol_match m;
+    if (ar_sym_find(name.constData(), &m, 1) != 1 || m.kind != AR_SYM_MATCH_EXACT)
+        return false;
+
+    if (space && space->v1.id && strcmp(space->v1.id, m.region_id) == 0) {
+        *addr = m.address;
+        if (mem) *mem = space;
+        return true;
+    }
+
+    /* Find the map entry of space that currently reaches the label */
+    if (space && space->v1.get_memory_map_count && space->v1.get_memory_map) {
+        unsigned count = space->v1.get_memory_map_count(space);
+        std::vector<rd_MemoryMap> maps(count);
+        if (count) space->v1.get_memory_map(space, maps.data());
+        for (auto &e : maps) {
+            if (!e.source || e.size == 0) continue;
+            auto base = ar_sym_resolve(space->v1.id, e.base_addr);
+            if (!base || base->region_id != m.region_id) continue;
+            if (m.address < base->addr || m.address - base->addr >= e.size) continue;
+            uint64_t cand = e.base_addr + (m.address - base->addr);
+            auto back = ar_sym_resolve(space->v1.id, cand);
+            if (back && back->region_id == m.region_id && back->addr == m.address) {
+                *addr = cand;
+                if (mem) *mem = space;
+                return true;
+            }
+        }
+    }
+
+    if (!mem) return false;
+    *mem = ar_find_memory_by_id(m.region_id);
+    *addr = m.address;
+    return *mem != nullptr;
+}
+
+bool parseAddress(const QString &text, rd_Memory const *space,
+                  uint64_t *addr, rd_Memory const **mem) {
+    QString t = text.trimmed();
+    QString digits = t;
+    bool prefixed = true;
+    if (t.startsWith('$'))
+        digits = t.mid(1);
+    else if (t.startsWith("0x", Qt::CaseInsensitive))
+        digits = t.mid(2);
+    else
+        prefixed = false;
+
+    if (!prefixed && symbolAddress(t, space, addr, mem)) return true;
+
+    bool ok;
+    uint64_t value = digits.toULongLong(&ok, 16);
+    if (!ok) return false;
+    *addr = value;
+    if (mem) *mem = space;
+    return true;
+}
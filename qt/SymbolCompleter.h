@@ -0,0 +1,46 @@
+#ifndef SYMBOLCOMPLETER_H
+#define SYMBOLCOMPLETER_H
+
+#include <QCompleter>
+#include <stdint.h>
+
+QT_BEGIN_NAMESPACE
+class QLineEdit;
+class QStringListModel;
+QT_END_NAMESPACE
+
+struct rd_Memory;
+
+/* ======================================================================== */
+/* SymbolCompleter                                                           */
+/* ======================================================================== */
+
+/* Label popup for an address field, ranked by ar_sym_find (prefix,
+ * substring and fuzzy matches, so Qt's own prefix filter is bypassed). */
+class SymbolCompleter : public QCompleter {
+    Q_OBJECT
+public:
+    explicit SymbolCompleter(QLineEdit *edit);
+
+private:
+    void updateMatches(const QString &text);
+
+    QLineEdit        *m_edit;
+    QStringListModel *m_model;
+};
+
+/* Address of the label named text as seen from space: the label's own
+ * address if it lives in space, else the address space maps it to now.
+ * If space cannot see it, *mem (when given) is set to the label's region
+ * and addr is in that region; otherwise *mem is set to space. */
+bool symbolAddress(const QString &text, rd_Memory const *space,
+                   uint64_t *addr, rd_Memory const **mem = nullptr);
+
+/* Address typed into an address field.  "$1234" and "0x1234" are always
+ * numbers; otherwise an exact label comes first, so labels that are also
+ * valid hex ("fade", "beef") stay reachable, then bare hex.  A number sets
+ * *mem (when given) to space; labels resolve as in symbolAddress(). */
+bool parseAddress(const QString &text, rd_Memory const *space,
+                  uint64_t *addr, rd_Memory const **mem = nullptr);
+
+#endif // SYMBOLCOMPLETER_H
@@ -78,6 +78,13 @@ TraceLog::TraceLog(QWidget *parent)
     });
     rvbox->addWidget(m_indentCheck);
 
+    m_symbolsCheck = new QCheckBox("Symbols");
+    m_symbolsCheck->setChecked(ar_trace_get_symbols());
+    connect(m_symbolsCheck, &QCheckBox::toggled, this, [](bool on) {
+        ar_trace_set_symbols(on);
+    });
+    rvbox->addWidget(m_symbolsCheck);
+
     rvbox->addSpacing(8);
 
     /* System-specific trace options (populated lazily) */
@@ -141,6 +148,7 @@ void TraceLog::toggleTrace() {
         ar_trace_set_interrupts(m_intCheck->isChecked());
         ar_trace_set_registers(m_regCheck->isChecked());
         ar_trace_set_indent(m_indentCheck->isChecked());
+        ar_trace_set_symbols(m_symbolsCheck->isChecked());
 
         /* Apply CPU settings */
         for (auto &cc : m_cpuChecks)
@@ -244,6 +252,8 @@ void TraceLog::refresh() {
         m_regCheck->setChecked(ar_trace_get_registers());
     if (m_indentCheck->isChecked() != ar_trace_get_indent())
         m_indentCheck->setChecked(ar_trace_get_indent());
+    if (m_symbolsCheck->isChecked() != ar_trace_get_symbols())
+        m_symbolsCheck->setChecked(ar_trace_get_symbols());
 
     /* Sync sys option checkboxes */
     for (auto &so : m_sysOptChecks) {
@@ -36,6 +36,7 @@ private:
     QCheckBox      *m_intCheck;
     QCheckBox      *m_regCheck;
     QCheckBox      *m_indentCheck;
+    QCheckBox      *m_symbolsCheck;
     QPushButton    *m_startBtn;
     QLabel         *m_lineCount;
     QLabel         *m_cpuLabel;
@@ -13,22 +13,29 @@ VideoWidget::VideoWidget(QWidget *parent)
 }
 
 void VideoWidget::paintEvent(QPaintEvent *) {
-    const uint32_t *buf = ar_frame_buf();
-    unsigned w = ar_frame_width();
-    unsigned h = ar_frame_height();
+    ar_frame frame;
+    ar_frame_acquire(&frame);
 
-    if (!buf || w == 0 || h == 0) return;
+    /* Convert each new frame once; repaints without a new frame (expose,
+       resize, tool windows) reuse the pixmap.  The acquired slot stays
+       stable until release, so the QImage can wrap it without a copy.
+       XRGB8888 maps to QImage::Format_RGB32 (0xffRRGGBB). */
+    if (frame.seq != m_frameSeq || m_frame.isNull()) {
+        if (frame.width && frame.height) {
+            QImage img(reinterpret_cast<const uchar *>(frame.pixels),
+                       frame.width, frame.height, frame.width * 4,
+                       QImage::Format_RGB32);
+            m_frame = QPixmap::fromImage(img);
+        }
+        m_frameSeq = frame.seq;
+    }
+    ar_frame_release();
 
-    /* XRGB8888 maps to QImage::Format_RGB32 (0xffRRGGBB).
-       Deep-copy so the painter has a stable snapshot — the core thread
-       may be writing into frame_buf concurrently. */
-    QImage img(reinterpret_cast<const uchar *>(buf),
-               w, h, w * 4, QImage::Format_RGB32);
-    QImage snap = img.copy();
+    if (m_frame.isNull()) return;
 
     QPainter p(this);
     p.setRenderHint(QPainter::SmoothPixmapTransform, false);
-    p.drawImage(rect(), snap);
+    p.drawPixmap(rect(), m_frame);
 }
 
 void VideoWidget::keyPressEvent(QKeyEvent *event) {
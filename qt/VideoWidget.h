@@ -1,6 +1,7 @@
 #ifndef VIDEOWIDGET_H
 #define VIDEOWIDGET_H
 
+#include <QPixmap>
 #include <QWidget>
 
 class VideoWidget : public QWidget {
@@ -15,6 +16,9 @@ protected:
 
 private:
     void handleKey(int key, bool pressed);
+
+    QPixmap  m_frame;           // last frame shown, converted once
+    uint64_t m_frameSeq = 0;
 };
 
 #endif // VIDEOWIDGET_H
@@ -20,23 +20,36 @@ TileGridWidget::TileGridWidget(QWidget *parent)
     setMouseTracking(false);
 }
 
-void TileGridWidget::setTileSet(const gb::TileSet &ts) {
-    m_tileSet = ts;
-    rebuildImage();
-    setFixedSize(sizeHint());
-    update();
+void TileGridWidget::setAtlas(const gb::TileAtlas &atlas) {
+    m_atlas = &atlas;
+    int banks = atlas.tiles().banks;
+
+    if (m_image.isNull() || banks != m_banks) {
+        m_banks = banks;
+        rebuildImage();
+        setFixedSize(sizeHint());
+        update();
+    } else if (atlas.generation() != m_seenGeneration) {
+        for (int i = 0; i < tileCount(); i++) {
+            if (atlas.changed_at(i) > m_seenGeneration) {
+                drawTile(i);
+                update(tileRect(i));
+            }
+        }
+    }
+    m_seenGeneration = atlas.generation();
 }
 
 QSize TileGridWidget::sizeHint() const {
     int w = COLS * tileSize();
-    int sections = BLOCKS_PER_BANK * m_tileSet.banks;
+    int sections = BLOCKS_PER_BANK * m_banks;
     int h = sections * sectionHeight();
     if (h == 0) h = 100;
     return QSize(w, h);
 }
 
 int TileGridWidget::tileAtPos(const QPoint &pos) const {
-    int sections = BLOCKS_PER_BANK * m_tileSet.banks;
+    int sections = BLOCKS_PER_BANK * m_banks;
     if (sections == 0) return -1;
 
     int ts = tileSize();
@@ -57,12 +70,21 @@ int TileGridWidget::tileAtPos(const QPoint &pos) const {
 
     int tileInBlock = row * COLS + col;
     int tileIndex = section * TILES_PER_BLOCK + tileInBlock;
-    if (tileIndex < 0 || tileIndex >= (int)m_tileSet.tiles.size())
+    if (tileIndex < 0 || tileIndex >= tileCount())
         return -1;
 
     return tileIndex;
 }
 
+QRect TileGridWidget::tileRect(int index) const {
+    int ts = tileSize();
+    int section = index / TILES_PER_BLOCK;
+    int inBlock = index % TILES_PER_BLOCK;
+    int x = (inBlock % COLS) * ts;
+    int y = section * sectionHeight() + SECTION_LABEL_H + SECTION_GAP + (inBlock / COLS) * ts;
+    return QRect(x, y, ts, ts);
+}
+
 void TileGridWidget::mousePressEvent(QMouseEvent *event) {
     if (event->button() != Qt::LeftButton) return;
     int idx = tileAtPos(event->pos());
@@ -74,8 +96,8 @@ void TileGridWidget::mousePressEvent(QMouseEvent *event) {
 }
 
 void TileGridWidget::rebuildImage() {
-    int sections = BLOCKS_PER_BANK * m_tileSet.banks;
-    if (sections == 0 || m_tileSet.tiles.empty()) {
+    int sections = BLOCKS_PER_BANK * m_banks;
+    if (sections == 0 || !m_atlas || m_atlas->tiles().tiles.empty()) {
         m_image = QImage();
         return;
     }
@@ -87,22 +109,24 @@ void TileGridWidget::rebuildImage() {
     m_image = QImage(w, h, QImage::Format_ARGB32);
     m_image.fill(0xFF808080);
 
-    for (int section = 0; section < sections; section++) {
-        int baseIdx = section * TILES_PER_BLOCK;
-        for (int t = 0; t < TILES_PER_BLOCK && baseIdx + t < (int)m_tileSet.tiles.size(); t++) {
-            const auto &tile = m_tileSet.tiles[baseIdx + t];
-            int col = t % COLS;
-            int row = t / COLS;
-            int px0 = col * TILE_PX;
-            int py0 = (section * rowsPerBlock() + row) * TILE_PX;
-
-            for (int py = 0; py < TILE_PX; py++) {
-                auto *scanline = reinterpret_cast<uint32_t *>(m_image.scanLine(py0 + py));
-                for (int px = 0; px < TILE_PX; px++) {
-                    scanline[px0 + px] = GB_PALETTE[tile.pixels[py * 8 + px] & 3];
-                }
-            }
-        }
+    for (int i = 0; i < tileCount(); i++)
+        drawTile(i);
+}
+
+void TileGridWidget::drawTile(int index) {
+    const auto &tiles = m_atlas->tiles().tiles;
+    if (index >= (int)tiles.size()) return;
+
+    const auto &tile = tiles[index];
+    int section = index / TILES_PER_BLOCK;
+    int t = index % TILES_PER_BLOCK;
+    int px0 = (t % COLS) * TILE_PX;
+    int py0 = (section * rowsPerBlock() + t / COLS) * TILE_PX;
+
+    for (int py = 0; py < TILE_PX; py++) {
+        auto *scanline = reinterpret_cast<uint32_t *>(m_image.scanLine(py0 + py));
+        for (int px = 0; px < TILE_PX; px++)
+            scanline[px0 + px] = GB_PALETTE[tile.pixels[py * 8 + px] & 3];
     }
 }
 
@@ -115,7 +139,7 @@ void TileGridWidget::paintEvent(QPaintEvent *) {
         return;
     }
 
-    int sections = BLOCKS_PER_BANK * m_tileSet.banks;
+    int sections = BLOCKS_PER_BANK * m_banks;
     int ts = tileSize();
 
     static const char *blockLabels[] = {
@@ -136,7 +160,7 @@ void TileGridWidget::paintEvent(QPaintEvent *) {
 
         // Section label
         QString label;
-        if (m_tileSet.banks > 1)
+        if (m_banks > 1)
             label = QString("Bank %1 - %2").arg(bank).arg(blockLabels[block]);
         else
             label = QString(blockLabels[block]);
@@ -154,18 +178,10 @@ void TileGridWidget::paintEvent(QPaintEvent *) {
     }
 
     // Selection highlight
-    if (m_selected >= 0 && m_selected < (int)m_tileSet.tiles.size()) {
-        int section = m_selected / TILES_PER_BLOCK;
-        int inBlock = m_selected % TILES_PER_BLOCK;
-        int col = inBlock % COLS;
-        int row = inBlock / COLS;
-
-        int x = col * ts;
-        int y = section * sectionHeight() + SECTION_LABEL_H + SECTION_GAP + row * ts;
-
+    if (m_selected >= 0 && m_selected < tileCount()) {
         p.setPen(QPen(Qt::red, 2));
         p.setBrush(Qt::NoBrush);
-        p.drawRect(x, y, ts, ts);
+        p.drawRect(tileRect(m_selected));
     }
 }
 
@@ -256,8 +272,9 @@ void TileViewer::readTiles() {
     rd_Memory const *mem = ar_debug_mem();
     if (!mem) return;
 
-    gb::TileSet ts = gb::read_tiles(mem, sys->v1.description);
-    m_grid->setTileSet(ts);
+    gb::TileAtlas &atlas = gb::shared_tile_atlas();
+    atlas.update(mem, sys->v1.description);
+    m_grid->setAtlas(atlas);
     updateSidebar();
 }
 
@@ -269,8 +286,8 @@ void TileViewer::updateSidebar() {
     int sel = m_grid->selectedTile();
     if (sel < 0) return;
 
-    const gb::TileSet &ts = m_grid->tileSet();
-    if (sel >= (int)ts.tiles.size()) return;
+    const gb::TileAtlas *atlas = m_grid->atlas();
+    if (!atlas || sel >= (int)atlas->tiles().tiles.size()) return;
 
     int tilesPerBank = 384;
     int bank = sel / tilesPerBank;
@@ -286,35 +303,18 @@ void TileViewer::updateSidebar() {
     m_infoBank->setText(QString("Bank: %1").arg(bank));
     m_infoBlock->setText(QString("Block: %1").arg(block));
 
-    // Read raw tile bytes for hex display
+    // Raw tile bytes for hex display, as last read into the atlas
     QString hexStr;
-    rd_Memory const *mem = ar_debug_mem();
-    if (mem && mem->v1.peek) {
-        if (bank == 0) {
-            for (int i = 0; i < 16; i++) {
-                if (i > 0 && i % 8 == 0) hexStr += "\n";
-                else if (i > 0) hexStr += " ";
-                uint8_t b = mem->v1.peek(mem, addr + i, false);
-                hexStr += QString("%1").arg(b, 2, 16, QChar('0')).toUpper();
-            }
-        } else if (mem->v1.get_bank_address) {
-            rd_MemoryMap mapping;
-            if (mem->v1.get_bank_address(mem, addr, bank, &mapping) && mapping.source) {
-                uint64_t offset = addr - 0x8000;
-                for (int i = 0; i < 16; i++) {
-                    if (i > 0 && i % 8 == 0) hexStr += "\n";
-                    else if (i > 0) hexStr += " ";
-                    uint8_t b = mapping.source->v1.peek(mapping.source,
-                                    mapping.source_base_addr + offset + i, false);
-                    hexStr += QString("%1").arg(b, 2, 16, QChar('0')).toUpper();
-                }
-            }
-        }
+    const uint8_t *raw = atlas->raw(sel);
+    for (int i = 0; i < 16; i++) {
+        if (i > 0 && i % 8 == 0) hexStr += "\n";
+        else if (i > 0) hexStr += " ";
+        hexStr += QString("%1").arg(raw[i], 2, 16, QChar('0')).toUpper();
     }
-    m_infoHex->setText(hexStr.isEmpty() ? "-" : hexStr);
+    m_infoHex->setText(hexStr);
 
     // Zoomed preview: render the selected tile at 8x
-    const auto &tile = ts.tiles[sel];
+    const auto &tile = atlas->tiles().tiles[sel];
     QImage preview(8, 8, QImage::Format_ARGB32);
     for (int y = 0; y < 8; y++) {
         auto *scanline = reinterpret_cast<uint32_t *>(preview.scanLine(y));
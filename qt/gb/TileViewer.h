@@ -31,8 +31,9 @@ class TileGridWidget : public QWidget {
 public:
     explicit TileGridWidget(QWidget *parent = nullptr);
 
-    void setTileSet(const gb::TileSet &ts);
-    const gb::TileSet &tileSet() const { return m_tileSet; }
+    // Redraw the tiles that changed in atlas since the last call
+    void setAtlas(const gb::TileAtlas &atlas);
+    const gb::TileAtlas *atlas() const { return m_atlas; }
     int selectedTile() const { return m_selected; }
 
     QSize sizeHint() const override;
@@ -58,13 +59,18 @@ private:
     int blockPixelHeight() const { return rowsPerBlock() * tileSize(); }
     int sectionHeight() const { return SECTION_LABEL_H + SECTION_GAP + blockPixelHeight(); }
 
+    int tileCount() const { return m_banks * BLOCKS_PER_BANK * TILES_PER_BLOCK; }
     int tileAtPos(const QPoint &pos) const;
+    QRect tileRect(int index) const; // widget coordinates
 
-    gb::TileSet m_tileSet;
+    const gb::TileAtlas *m_atlas = nullptr;
+    int m_banks = 0;
+    uint32_t m_seenGeneration = 0;
     QImage m_image;
     int m_selected = -1;
 
     void rebuildImage();
+    void drawTile(int index);
 };
 
 /* ======================================================================== */
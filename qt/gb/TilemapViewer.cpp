@@ -76,6 +76,7 @@ void TilemapGridWidget::paintEvent(QPaintEvent *) {
 /* ======================================================================== */
 
 static constexpr int TILES_PER_BANK = 384;
+static constexpr uint32_t CELL_EMPTY = 0xFFFFFFFF;
 
 // Resolve a tilemap entry to a TileSet index
 static int resolve_tile_index(uint8_t tile_index, uint8_t lcdc,
@@ -108,6 +109,7 @@ TilemapViewer::TilemapViewer(QWidget *parent)
     memset(&m_mapData, 0, sizeof(m_mapData));
     memset(m_gbPal, 0, sizeof(m_gbPal));
     memset(m_gbcPal, 0, sizeof(m_gbcPal));
+    memset(m_drawnColors, 0, sizeof(m_drawnColors));
 
     auto *main = new QWidget;
     auto *hbox = new QHBoxLayout(main);
@@ -234,7 +236,7 @@ void TilemapViewer::readData() {
 
     int mapIdx = m_map1Radio->isChecked() ? 1 : 0;
     m_mapData = gb::read_tilemap(mem, sys->v1.description, mapIdx);
-    m_tileSet = gb::read_tiles(mem, sys->v1.description);
+    gb::shared_tile_atlas().update(mem, sys->v1.description);
 
     // Read palettes
     gb::read_gb_palette(mem, m_gbPal);
@@ -252,52 +254,80 @@ void TilemapViewer::readData() {
 }
 
 void TilemapViewer::rebuildImage() {
-    if (m_tileSet.tiles.empty()) {
+    const gb::TileAtlas &atlas = gb::shared_tile_atlas();
+    const auto &tiles = atlas.tiles().tiles;
+    if (tiles.empty()) {
+        m_image = QImage();
         m_grid->setImage(QImage());
         return;
     }
 
     bool usePal = m_paletteCheck->isChecked();
-    QImage img(256, 256, QImage::Format_ARGB32);
-    img.fill(0xFF808080);
+    bool gbcColors = usePal && m_mapData.is_gbc && m_gbcPalValid;
+
+    uint32_t colors[9][4];
+    for (int pal = 0; pal < 8; pal++)
+        for (int c = 0; c < 4; c++)
+            colors[pal][c] = gbcColors ? m_gbcPal[pal][c] : 0;
+    for (int c = 0; c < 4; c++)
+        colors[8][c] = usePal ? m_gbPal[c] : GB_PALETTE[c];
+
+    bool full = m_image.isNull() || memcmp(colors, m_drawnColors, sizeof(colors)) != 0;
+    if (m_image.isNull())
+        m_image = QImage(256, 256, QImage::Format_ARGB32);
+    memcpy(m_drawnColors, colors, sizeof(colors));
+
+    uint8_t lcdc = effectiveLcdc();
+    bool changed = false;
 
     for (int row = 0; row < 32; row++) {
         for (int col = 0; col < 32; col++) {
             const gb::TilemapEntry &e = m_mapData.entries[row][col];
 
-            uint8_t lcdc = effectiveLcdc();
             int tileIdx = resolve_tile_index(e.tile_index, lcdc,
                                              e.has_attrs ? e.vram_bank : 0,
                                              m_mapData.is_gbc);
-            if (tileIdx < 0 || tileIdx >= (int)m_tileSet.tiles.size())
+            bool valid = tileIdx >= 0 && tileIdx < (int)tiles.size();
+            uint32_t key = CELL_EMPTY;
+            if (valid)
+                key = (uint32_t)tileIdx | (e.palette << 10) | (e.h_flip << 13) |
+                      (e.v_flip << 14) | (e.has_attrs << 15);
+
+            if (!full && key == m_cellKey[row][col] &&
+                (!valid || atlas.changed_at(tileIdx) <= m_seenGeneration))
                 continue;
+            m_cellKey[row][col] = key;
+            changed = true;
 
-            const gb::TileImage &tile = m_tileSet.tiles[tileIdx];
             int px0 = col * 8;
             int py0 = row * 8;
 
+            if (!valid) {
+                for (int py = 0; py < 8; py++) {
+                    auto *scanline = reinterpret_cast<uint32_t *>(m_image.scanLine(py0 + py));
+                    for (int px = 0; px < 8; px++)
+                        scanline[px0 + px] = 0xFF808080;
+                }
+                continue;
+            }
+
+            const gb::TileImage &tile = tiles[tileIdx];
+            const uint32_t *pal = (gbcColors && e.has_attrs) ? colors[e.palette] : colors[8];
+
             for (int py = 0; py < 8; py++) {
                 int srcY = (e.has_attrs && e.v_flip) ? (7 - py) : py;
-                auto *scanline = reinterpret_cast<uint32_t *>(img.scanLine(py0 + py));
+                auto *scanline = reinterpret_cast<uint32_t *>(m_image.scanLine(py0 + py));
                 for (int px = 0; px < 8; px++) {
                     int srcX = (e.has_attrs && e.h_flip) ? (7 - px) : px;
-                    uint8_t cidx = tile.pixels[srcY * 8 + srcX] & 3;
-
-                    uint32_t color;
-                    if (usePal && m_mapData.is_gbc && m_gbcPalValid && e.has_attrs) {
-                        color = m_gbcPal[e.palette][cidx];
-                    } else if (usePal) {
-                        color = m_gbPal[cidx];
-                    } else {
-                        color = GB_PALETTE[cidx];
-                    }
-                    scanline[px0 + px] = color;
+                    scanline[px0 + px] = pal[tile.pixels[srcY * 8 + srcX] & 3];
                 }
             }
         }
     }
 
-    m_grid->setImage(img);
+    m_seenGeneration = atlas.generation();
+    if (changed)
+        m_grid->setImage(m_image);
 }
 
 void TilemapViewer::onTileClicked(int, int) {
@@ -367,8 +397,9 @@ void TilemapViewer::updateSidebar() {
     int tileIdx = resolve_tile_index(e.tile_index, lcdc,
                                      e.has_attrs ? e.vram_bank : 0,
                                      m_mapData.is_gbc);
-    if (tileIdx >= 0 && tileIdx < (int)m_tileSet.tiles.size()) {
-        const gb::TileImage &tile = m_tileSet.tiles[tileIdx];
+    const auto &tiles = gb::shared_tile_atlas().tiles().tiles;
+    if (tileIdx >= 0 && tileIdx < (int)tiles.size()) {
+        const gb::TileImage &tile = tiles[tileIdx];
         bool usePal = m_paletteCheck->isChecked();
         QImage preview(8, 8, QImage::Format_ARGB32);
         for (int py = 0; py < 8; py++) {
@@ -91,11 +91,17 @@ private:
 
     // Cached data
     gb::TilemapData m_mapData;
-    gb::TileSet     m_tileSet;
     uint32_t        m_gbPal[4];
     uint32_t        m_gbcPal[8][4];
     bool            m_gbcPalValid = false;
     bool            m_firstLoad = true;
+
+    // Composited map, kept between ticks; a cell is redrawn when its
+    // entry, its tile's pixels or the colors in use change
+    QImage          m_image;
+    uint32_t        m_cellKey[32][32];
+    uint32_t        m_drawnColors[9][4];    // 0-7 GBC palettes, 8 = DMG
+    uint32_t        m_seenGeneration = 0;
 };
 
 #endif // GB_TILEMAPVIEWER_H
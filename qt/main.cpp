@@ -14,6 +14,7 @@
 
 #include "backend.hpp"
 #include "symbols.hpp"
+#include "analysis.hpp"
 #include "assets.hpp"
 
 /* Frontend callbacks for Qt */
@@ -196,6 +197,7 @@ int main(int argc, char **argv) {
                 ar_bp_auto_load();
                 ar_sym_auto_load();
             }
+            ar_analysis_auto_start();
         }
     }
 
@@ -0,0 +1,300 @@
+#include "VramDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static constexpr int TILE_BYTES_W = VramDecoder::TILE * 2;   // bytes per tile row
+static constexpr int ROW_BYTES    = VramDecoder::VRAM_HW_W * 2;
+static constexpr size_t MAX_FREE_BUFFERS = 2;
+
+/* ======================================================================== */
+/* Conversion kernels                                                        */
+/* ======================================================================== */
+
+/* 15-bit BGR555 halfwords to 0xFFRRGGBB */
+static void convert15(const uint8_t *src, uint32_t *dst, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i mr    = _mm_set1_epi32(0x001F);
+    const __m128i mg    = _mm_set1_epi32(0x03E0);
+    const __m128i mb    = _mm_set1_epi32(0x7C00);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    auto expand = [&](__m128i c) {
+        __m128i r = _mm_slli_epi32(_mm_and_si128(c, mr), 19);
+        __m128i g = _mm_slli_epi32(_mm_and_si128(c, mg), 6);
+        __m128i b = _mm_srli_epi32(_mm_and_si128(c, mb), 7);
+        return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, alpha));
+    };
+    for (; i + 8 <= n; i += 8) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         expand(_mm_unpacklo_epi16(c, zero)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4),
+                         expand(_mm_unpackhi_epi16(c, zero)));
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t c = (uint32_t)src[i * 2] | ((uint32_t)src[i * 2 + 1] << 8);
+        dst[i] = 0xFF000000 | ((c & 0x001F) << 19) | ((c & 0x03E0) << 6) |
+                 ((c & 0x7C00) >> 7);
+    }
+}
+
+/* Pixels [px0, px1) of a 24-bit row */
+static void convert24(const uint8_t *row, uint32_t *dst, int px0, int px1) {
+    for (int px = px0; px < px1; px++) {
+        const uint8_t *p = row + px * 3;
+        dst[px] = 0xFF000000 | ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    }
+}
+
+/* Palette tables: 8-bit indices and 4-bit index pairs, greyscale ramps */
+struct Lut {
+    uint32_t idx8[256];
+    uint32_t idx4[256][2];   // [byte] -> low nibble pixel, high nibble pixel
+
+    Lut() {
+        for (int i = 0; i < 256; i++) {
+            idx8[i] = 0xFF000000 | (i << 16) | (i << 8) | i;
+            uint32_t lo = (i & 0x0F) * 17, hi = (i >> 4) * 17;
+            idx4[i][0] = 0xFF000000 | (lo << 16) | (lo << 8) | lo;
+            idx4[i][1] = 0xFF000000 | (hi << 16) | (hi << 8) | hi;
+        }
+    }
+};
+static const Lut s_lut;
+
+static void convert8(const uint8_t *src, uint32_t *dst, int n) {
+    for (int i = 0; i < n; i++)
+        dst[i] = s_lut.idx8[src[i]];
+}
+
+/* n source bytes -> 2n pixels */
+static void convert4(const uint8_t *src, uint32_t *dst, int n) {
+    for (int i = 0; i < n; i++)
+        std::memcpy(dst + i * 2, s_lut.idx4[src[i]], sizeof(s_lut.idx4[0]));
+}
+
+static int imageWidth(VramDecoder::Format fmt) {
+    switch (fmt) {
+    case VramDecoder::FMT_15BIT: return VramDecoder::VRAM_HW_W;
+    case VramDecoder::FMT_24BIT: return (VramDecoder::VRAM_HW_W * 2) / 3;
+    case VramDecoder::FMT_8BIT:  return VramDecoder::VRAM_HW_W * 2;
+    case VramDecoder::FMT_4BIT:  return VramDecoder::VRAM_HW_W * 4;
+    }
+    return VramDecoder::VRAM_HW_W;
+}
+
+/* Image columns covering row bytes [b0, b1) */
+static void pixelSpan(VramDecoder::Format fmt, int b0, int b1, int &px0, int &px1) {
+    switch (fmt) {
+    case VramDecoder::FMT_15BIT: px0 = b0 / 2; px1 = b1 / 2; break;
+    case VramDecoder::FMT_8BIT:  px0 = b0;     px1 = b1;     break;
+    case VramDecoder::FMT_4BIT:  px0 = b0 * 2; px1 = b1 * 2; break;
+    case VramDecoder::FMT_24BIT:
+        /* 3-byte pixels straddle tile edges: take every pixel touching the span */
+        px0 = std::max(0, (b0 - 2) / 3);
+        px1 = std::min(imageWidth(fmt), (b1 + 2) / 3);
+        break;
+    }
+}
+
+/* ======================================================================== */
+/* Tile hash                                                                 */
+/* ======================================================================== */
+
+static inline uint64_t rotl64(uint64_t v, int r) {
+    return (v << r) | (v >> (64 - r));
+}
+
+/* xxHash64-style rounds over four independent lanes */
+static uint64_t hashTile(const uint8_t *vram, int tx, int ty) {
+    static constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+    uint64_t acc[4] = { P1 + P2, P2, 0, 0 - P1 };
+
+    const uint8_t *p = vram + (size_t)ty * VramDecoder::TILE * ROW_BYTES
+                            + (size_t)tx * TILE_BYTES_W;
+    for (int line = 0; line < VramDecoder::TILE; line++, p += ROW_BYTES) {
+        for (int off = 0; off < TILE_BYTES_W; off += 32) {
+            for (int l = 0; l < 4; l++) {
+                uint64_t w;
+                std::memcpy(&w, p + off + l * 8, 8);
+                acc[l] = rotl64(acc[l] + w * P2, 31) * P1;
+            }
+        }
+    }
+    return rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+}
+
+/* ======================================================================== */
+/* VramDecoder                                                               */
+/* ======================================================================== */
+
+VramDecoder::VramDecoder(QObject *parent)
+    : QObject(parent)
+{
+    m_worker = std::thread(&VramDecoder::workerMain, this);
+}
+
+VramDecoder::~VramDecoder() {
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_worker.join();
+}
+
+std::vector<uint8_t> VramDecoder::takeBuffer() {
+    std::vector<uint8_t> buf;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (!m_free.empty()) {
+            buf = std::move(m_free.back());
+            m_free.pop_back();
+        }
+    }
+    buf.resize(VRAM_BYTES);
+    return buf;
+}
+
+void VramDecoder::submit(std::vector<uint8_t> buf, Format fmt, const QRect *hint) {
+    if (buf.size() < (size_t)VRAM_BYTES) return;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (m_hasPending) {
+            /* The dropped snapshot was never decoded, so the new hint must
+             * also cover whatever changed in it */
+            m_pendingHinted = m_pendingHinted && hint;
+            if (m_pendingHinted)
+                m_pendingHint = m_pendingHint.united(*hint);
+            if (m_free.size() < MAX_FREE_BUFFERS)
+                m_free.push_back(std::move(m_pending));
+        } else {
+            m_pendingHinted = hint != nullptr;
+            if (hint) m_pendingHint = *hint;
+        }
+        m_pending = std::move(buf);
+        m_pendingFmt = fmt;
+        m_hasPending = true;
+    }
+    m_cv.notify_one();
+}
+
+void VramDecoder::invalidate() {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_invalidate = true;
+}
+
+void VramDecoder::workerMain() {
+    for (;;) {
+        std::vector<uint8_t> buf;
+        Format fmt;
+        bool all, hinted;
+        QRect hint;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_cv.wait(lk, [this] { return m_stop || m_hasPending; });
+            if (m_stop) return;
+            buf.swap(m_pending);
+            fmt = m_pendingFmt;
+            hinted = m_pendingHinted;
+            hint = m_pendingHint;
+            all = m_invalidate;
+            m_invalidate = false;
+            m_hasPending = false;
+        }
+
+        /* After invalidate() every hash is suspect, not just the hinted ones */
+        decode(buf.data(), fmt, all,
+               hinted && !all ? hint : QRect(0, 0, VRAM_HW_W, VRAM_H));
+
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (m_free.size() < MAX_FREE_BUFFERS)
+            m_free.push_back(std::move(buf));
+    }
+}
+
+void VramDecoder::decode(const uint8_t *vram, Format fmt, bool force,
+                         const QRect &scope) {
+    int imgW = imageWidth(fmt);
+    if (m_images[0].isNull() || fmt != m_imageFmt) {
+        for (QImage &img : m_images)
+            img = QImage(imgW, VRAM_H, QImage::Format_RGB32);
+        m_imageFmt = fmt;
+        m_lastChanged = QRect();
+        force = true;
+    }
+
+    /* Tiles outside scope are unchanged and keep their hash */
+    bool dirty[TILES_Y][TILES_X];
+    bool any = false;
+    for (int ty = 0; ty < TILES_Y; ty++) {
+        for (int tx = 0; tx < TILES_X; tx++) {
+            dirty[ty][tx] = force;
+            if (!QRect(tx * TILE, ty * TILE, TILE, TILE).intersects(scope))
+                continue;
+            uint64_t h = hashTile(vram, tx, ty);
+            if (h != m_tileHash[ty][tx]) {
+                m_tileHash[ty][tx] = h;
+                dirty[ty][tx] = true;
+            }
+        }
+        for (int tx = 0; tx < TILES_X; tx++)
+            any |= dirty[ty][tx];
+    }
+    if (!any) return;
+
+    /* Write into the image the UI is not showing.  It is one decode behind
+     * the other, so first copy over what that decode changed.  bits() only
+     * detaches if the UI has not yet picked up the previous image. */
+    QImage &image = m_images[m_back];
+    const QImage &front = m_images[m_back ^ 1];
+    uint8_t *bits = image.bits();
+    qsizetype stride = image.bytesPerLine();
+    if (!m_lastChanged.isEmpty()) {
+        const uint8_t *src = front.constBits();
+        qsizetype srcStride = front.bytesPerLine();
+        size_t x0 = (size_t)m_lastChanged.left() * 4;
+        size_t len = (size_t)m_lastChanged.width() * 4;
+        for (int y = m_lastChanged.top(); y <= m_lastChanged.bottom(); y++)
+            memcpy(bits + y * stride + x0, src + y * srcStride + x0, len);
+    }
+    QRect changed;
+
+    for (int ty = 0; ty < TILES_Y; ty++) {
+        /* Convert runs of adjacent dirty tiles in one pass per line */
+        for (int t0 = 0; t0 < TILES_X; ) {
+            if (!dirty[ty][t0]) { t0++; continue; }
+            int t1 = t0 + 1;
+            while (t1 < TILES_X && dirty[ty][t1]) t1++;
+
+            int b0 = t0 * TILE_BYTES_W, b1 = t1 * TILE_BYTES_W;
+            int px0 = 0, px1 = 0;
+            pixelSpan(fmt, b0, b1, px0, px1);
+
+            for (int y = ty * TILE; y < (ty + 1) * TILE; y++) {
+                const uint8_t *row = vram + (size_t)y * ROW_BYTES;
+                auto *out = reinterpret_cast<uint32_t *>(bits + y * stride);
+                switch (fmt) {
+                case FMT_15BIT: convert15(row + b0, out + px0, px1 - px0); break;
+                case FMT_24BIT: convert24(row, out, px0, px1);             break;
+                case FMT_8BIT:  convert8(row + b0, out + px0, b1 - b0);    break;
+                case FMT_4BIT:  convert4(row + b0, out + px0, b1 - b0);    break;
+                }
+            }
+            changed |= QRect(px0, ty * TILE, px1 - px0, TILE);
+            t0 = t1;
+        }
+    }
+
+    m_lastChanged = changed;
+    m_back ^= 1;
+    emit imageReady(image, (int)fmt, changed);
+}
@@ -0,0 +1,83 @@
+#ifndef PSX_VRAMDECODER_H
+#define PSX_VRAMDECODER_H
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* ======================================================================== */
+/* VramDecoder — converts VRAM snapshots to images on a worker thread        */
+/* ======================================================================== */
+
+/* VRAM is split into 64x64-halfword tiles (16x8 of them).  The worker keeps
+ * a hash per tile and two images, decoding into whichever one the UI is not
+ * holding so the shared pixels never detach, and converts only the tiles
+ * whose bytes changed.  Submissions are latest-wins: a snapshot
+ * still pending when a newer one arrives is dropped.  Finished images are
+ * delivered through imageReady() on the receiver's thread; nothing is
+ * emitted when no tile changed. */
+class VramDecoder : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int VRAM_BYTES = 1048576;
+    static constexpr int VRAM_HW_W  = 1024;
+    static constexpr int VRAM_H     = 512;
+    static constexpr int TILE       = 64;    // tile edge in halfwords / lines
+    static constexpr int TILES_X    = VRAM_HW_W / TILE;
+    static constexpr int TILES_Y    = VRAM_H / TILE;
+
+    /* Same values as VramWidget::Format */
+    enum Format { FMT_15BIT, FMT_24BIT, FMT_8BIT, FMT_4BIT };
+
+    explicit VramDecoder(QObject *parent = nullptr);
+    ~VramDecoder();
+
+    /* Buffer to fill with the next snapshot (VRAM_BYTES).  Reuses a buffer
+     * the worker has finished with when one is available. */
+    std::vector<uint8_t> takeBuffer();
+
+    /* Queue buf for decoding and take ownership of it.  When hint is
+     * given, the caller guarantees that bytes outside it (halfword coords)
+     * are unchanged since the previous submission; only tiles touching it
+     * are hashed.  A format change re-decodes everything. */
+    void submit(std::vector<uint8_t> buf, Format fmt, const QRect *hint = nullptr);
+
+    /* Forget the tile hashes; the next submission converts every tile. */
+    void invalidate();
+
+signals:
+    /* dirty is the changed area in image pixels */
+    void imageReady(const QImage &img, int format, const QRect &dirty);
+
+private:
+    void workerMain();
+    void decode(const uint8_t *vram, Format fmt, bool force, const QRect &scope);
+
+    std::thread             m_worker;
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    bool                    m_stop = false;
+
+    /* Guarded by m_mutex */
+    std::vector<uint8_t> m_pending;
+    Format               m_pendingFmt = FMT_15BIT;
+    bool                 m_hasPending = false;
+    bool                 m_pendingHinted = false;  // false: hash every tile
+    QRect                m_pendingHint;
+    bool                 m_invalidate = true;
+    std::vector<std::vector<uint8_t>> m_free;
+
+    /* Owned by the worker */
+    QImage   m_images[2];
+    int      m_back = 0;             // image the next decode writes
+    QRect    m_lastChanged;          // area m_images[m_back] is missing
+    Format   m_imageFmt = FMT_15BIT;
+    uint64_t m_tileHash[TILES_Y][TILES_X] = {};
+};
+
+#endif // PSX_VRAMDECODER_H
@@ -12,17 +12,22 @@
 #include <QListWidget>
 #include <QTextEdit>
 #include <QPushButton>
+#include <QCheckBox>
 #include <QSplitter>
 #include <QFont>
 #include <QShortcut>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <cstring>
+#include <algorithm>
 
+#include "VramDecoder.h"
 #include "backend.hpp"
+#include "memreader.hpp"
 #include "sys/psx_gpu_decode.hpp"
 #include "sys/psx_gpu_capture.hpp"
 
-static constexpr int VRAM_BYTES = 1048576;
-static constexpr int VRAM_HW_W = 1024;
-static constexpr int VRAM_H = 512;
+static constexpr int VRAM_BYTES = VramDecoder::VRAM_BYTES;
 
 /* ======================================================================== */
 /* VramWidget                                                                */
@@ -34,10 +39,14 @@ VramWidget::VramWidget(QWidget *parent)
     setMouseTracking(false);
 }
 
-void VramWidget::setImage(const QImage &img) {
+void VramWidget::setImage(const QImage &img, const QRect &dirty) {
+    bool resized = img.size() != m_image.size();
     m_image = img;
     setFixedSize(img.isNull() ? QSize(100, 100) : img.size());
-    update();
+    if (resized || !dirty.isValid())
+        update();
+    else
+        update(dirty);
 }
 
 QSize VramWidget::sizeHint() const {
@@ -190,6 +199,15 @@ VramViewer::VramViewer(QWidget *parent)
     auto *captureRow = new QHBoxLayout;
     m_captureBtn = new QPushButton("Capture");
     captureRow->addWidget(m_captureBtn);
+    m_saveBtn = new QPushButton("Save...");
+    m_saveBtn->setToolTip("Save the capture to a file; during a capture, stream it there");
+    captureRow->addWidget(m_saveBtn);
+    m_loadBtn = new QPushButton("Load...");
+    m_loadBtn->setToolTip("Load a saved capture for replay");
+    captureRow->addWidget(m_loadBtn);
+    m_exportStatsBtn = new QPushButton("Export Stats...");
+    m_exportStatsBtn->setToolTip("Write per-frame GPU workload statistics as JSON");
+    captureRow->addWidget(m_exportStatsBtn);
     captureRow->addStretch();
     m_memUsageLabel = new QLabel;
     captureRow->addWidget(m_memUsageLabel);
@@ -210,8 +228,16 @@ VramViewer::VramViewer(QWidget *parent)
     m_eventDetail->setMinimumWidth(200);
     splitter->addWidget(m_eventDetail);
 
+    /* Workload of the selected event's frame */
+    m_statsView = new QTextEdit;
+    m_statsView->setReadOnly(true);
+    m_statsView->setFont(mono);
+    m_statsView->setMinimumWidth(200);
+    splitter->addWidget(m_statsView);
+
     splitter->setStretchFactor(0, 1);
     splitter->setStretchFactor(1, 1);
+    splitter->setStretchFactor(2, 1);
     splitter->setMinimumHeight(200);
     contentVbox->addWidget(splitter, 1);
 
@@ -221,8 +247,12 @@ VramViewer::VramViewer(QWidget *parent)
     m_prevFrameBtn->setToolTip("Previous frame boundary (Left arrow)");
     m_nextFrameBtn = new QPushButton("Next Frame ->");
     m_nextFrameBtn->setToolTip("Next frame boundary (Right arrow)");
+    m_overdrawCheck = new QCheckBox("Overdraw");
+    m_overdrawCheck->setToolTip("Show how often each pixel was drawn in the selected frame");
     navRow->addWidget(m_prevFrameBtn);
     navRow->addStretch();
+    navRow->addWidget(m_overdrawCheck);
+    navRow->addStretch();
     navRow->addWidget(m_nextFrameBtn);
     contentVbox->addLayout(navRow);
 
@@ -232,7 +262,11 @@ VramViewer::VramViewer(QWidget *parent)
     setWidget(main);
     resize(720, 620);
 
+    m_decoder = new VramDecoder(this);
+
     /* Connections */
+    connect(m_decoder, &VramDecoder::imageReady,
+            this, &VramViewer::onImageReady, Qt::QueuedConnection);
     connect(m_formatGroup, &QButtonGroup::idClicked,
             this, &VramViewer::formatChanged);
     connect(m_vramWidget, &VramWidget::clicked,
@@ -242,6 +276,10 @@ VramViewer::VramViewer(QWidget *parent)
     connect(m_captureBtn, &QPushButton::clicked, this, [this]() {
         if (m_capturing) stopCapture(); else startCapture();
     });
+    connect(m_saveBtn, &QPushButton::clicked, this, &VramViewer::saveCapture);
+    connect(m_loadBtn, &QPushButton::clicked, this, &VramViewer::loadCapture);
+    connect(m_exportStatsBtn, &QPushButton::clicked, this, &VramViewer::exportStats);
+    connect(m_overdrawCheck, &QCheckBox::toggled, this, &VramViewer::overdrawToggled);
     connect(m_eventList, &QListWidget::currentRowChanged,
             this, &VramViewer::onEventSelected);
     connect(m_prevFrameBtn, &QPushButton::clicked,
@@ -260,6 +298,8 @@ VramViewer::VramViewer(QWidget *parent)
 VramViewer::~VramViewer() {
     if (m_capturing)
         stopCapture();
+    /* Join the worker before the widgets it reports to go away */
+    delete m_decoder;
 }
 
 /* ======================================================================== */
@@ -274,15 +314,25 @@ void VramViewer::refresh() {
     /* During capture: update memory label, keep VRAM live.
      * Frame boundaries are inserted by the post-frame hook on the core thread. */
     if (m_capturing) {
-        m_memUsageLabel->setText(QString("Capture: %1").arg(
-            formatBytes(sys::gpu_capture_compressed_bytes())));
+        updateMemUsage();
         rebuildImage();
         return;
     }
 
+    /* Workers may still be compressing after the capture ended */
+    if (sys::gpu_capture_pending())
+        updateMemUsage();
+
+    /* Capture replaced behind our back (gpucap load) */
+    if (sys::gpu_capture_generation() != m_captureGen) {
+        m_captureGen = sys::gpu_capture_generation();
+        showLoadedCapture();
+        return;
+    }
+
     /* If group box is checked and we have captured events, preserve captured view */
     if (m_gpuLogGroup->isChecked() && !m_capturing &&
-        !sys::gpu_capture_events().empty()) {
+        !sys::gpu_capture_events(0).empty()) {
         return;
     }
 
@@ -300,9 +350,11 @@ void VramViewer::formatChanged(int id) {
     m_pageLabel->setText("Click VRAM to select texture page");
 
     /* If viewing captured data, re-render from capture buffer */
-    if (m_gpuLogGroup->isChecked() && !sys::gpu_capture_events().empty() &&
+    if (m_gpuLogGroup->isChecked() && !sys::gpu_capture_events(0).empty() &&
         !m_captureVram.empty()) {
         rebuildImageFromBuffer(m_captureVram.data());
+        if (overdrawShown())
+            m_vramWidget->setFormat(VramWidget::FMT_15BIT);
         return;
     }
 
@@ -347,7 +399,8 @@ void VramViewer::gpuLogToggled(bool checked) {
         if (!m_gpuLogChecked && ar_has_debug() && ar_content_loaded())
             checkGpuLogAvailability();
 
-        if (m_gpuLogAvailable) {
+        /* A loaded capture can be browsed even if the core can't capture */
+        if (m_gpuLogAvailable || sys::gpu_capture_event_count() > 0) {
             m_gpuLogContent->show();
             m_gpuLogUnavail->hide();
         } else {
@@ -390,99 +443,28 @@ void VramViewer::checkGpuLogAvailability() {
 /* VRAM read helpers                                                         */
 /* ======================================================================== */
 
-void VramViewer::readLiveVram(std::vector<uint8_t> &buf) {
+bool VramViewer::readLiveVram(std::vector<uint8_t> &buf) {
     if (!m_vramMem) {
         m_vramMem = ar_find_memory_by_id("vram");
-        if (!m_vramMem) return;
+        if (!m_vramMem) return false;
     }
     buf.resize(VRAM_BYTES);
-    if (m_vramMem->v1.peek_range &&
-        m_vramMem->v1.peek_range(m_vramMem, 0, VRAM_BYTES, buf.data()))
-        return;
-    for (int i = 0; i < VRAM_BYTES; i++)
-        buf[i] = m_vramMem->v1.peek(m_vramMem, i, false);
+    ar_mem_read(m_vramMem, 0, VRAM_BYTES, buf.data());
+    return true;
 }
 
-void VramViewer::rebuildImageFromBuffer(const uint8_t *vram) {
-    auto hw = [&](int hw_x, int line) -> uint16_t {
-        int byte_addr = (line * VRAM_HW_W + hw_x) * 2;
-        if (byte_addr + 1 >= VRAM_BYTES) return 0;
-        return (uint16_t)vram[byte_addr] | ((uint16_t)vram[byte_addr + 1] << 8);
-    };
-
-    QImage img;
-
-    switch (m_format) {
-    case VramWidget::FMT_15BIT: {
-        img = QImage(VRAM_HW_W, VRAM_H, QImage::Format_RGB32);
-        for (int y = 0; y < VRAM_H; y++) {
-            auto *scanline = reinterpret_cast<uint32_t *>(img.scanLine(y));
-            for (int x = 0; x < VRAM_HW_W; x++) {
-                uint16_t c = hw(x, y);
-                int r = (c & 0x1F) << 3;
-                int g = ((c >> 5) & 0x1F) << 3;
-                int b = ((c >> 10) & 0x1F) << 3;
-                scanline[x] = 0xFF000000 | (r << 16) | (g << 8) | b;
-            }
-        }
-        break;
-    }
-    case VramWidget::FMT_24BIT: {
-        int imgW = (VRAM_HW_W * 2) / 3;
-        img = QImage(imgW, VRAM_H, QImage::Format_RGB32);
-        for (int y = 0; y < VRAM_H; y++) {
-            auto *scanline = reinterpret_cast<uint32_t *>(img.scanLine(y));
-            int byteRow = y * VRAM_HW_W * 2;
-            for (int px = 0; px < imgW; px++) {
-                int byteOff = byteRow + px * 3;
-                if (byteOff + 2 >= VRAM_BYTES) { scanline[px] = 0xFF000000; continue; }
-                uint8_t r = vram[byteOff];
-                uint8_t g = vram[byteOff + 1];
-                uint8_t b = vram[byteOff + 2];
-                scanline[px] = 0xFF000000 | (r << 16) | (g << 8) | b;
-            }
-        }
-        break;
-    }
-    case VramWidget::FMT_8BIT: {
-        int imgW = VRAM_HW_W * 2;
-        img = QImage(imgW, VRAM_H, QImage::Format_RGB32);
-        for (int y = 0; y < VRAM_H; y++) {
-            auto *scanline = reinterpret_cast<uint32_t *>(img.scanLine(y));
-            int byteRow = y * VRAM_HW_W * 2;
-            for (int px = 0; px < imgW; px++) {
-                int byteOff = byteRow + px;
-                if (byteOff >= VRAM_BYTES) { scanline[px] = 0xFF000000; continue; }
-                uint8_t v = vram[byteOff];
-                scanline[px] = 0xFF000000 | (v << 16) | (v << 8) | v;
-            }
-        }
-        break;
-    }
-    case VramWidget::FMT_4BIT: {
-        int imgW = VRAM_HW_W * 4;
-        img = QImage(imgW, VRAM_H, QImage::Format_RGB32);
-        for (int y = 0; y < VRAM_H; y++) {
-            auto *scanline = reinterpret_cast<uint32_t *>(img.scanLine(y));
-            int byteRow = y * VRAM_HW_W * 2;
-            for (int px = 0; px < imgW; px++) {
-                int byteOff = byteRow + px / 2;
-                if (byteOff >= VRAM_BYTES) { scanline[px] = 0xFF000000; continue; }
-                uint8_t nibble;
-                if (px & 1)
-                    nibble = (vram[byteOff] >> 4) & 0x0F;
-                else
-                    nibble = vram[byteOff] & 0x0F;
-                uint8_t v = nibble * 17;
-                scanline[px] = 0xFF000000 | (v << 16) | (v << 8) | v;
-            }
-        }
-        break;
-    }
-    }
+/* Conversion runs on the decoder's worker; the image arrives in
+ * onImageReady().  hint bounds what changed since the last submission. */
+void VramViewer::rebuildImageFromBuffer(const uint8_t *vram, const QRect *hint) {
+    std::vector<uint8_t> buf = m_decoder->takeBuffer();
+    memcpy(buf.data(), vram, VRAM_BYTES);
+    m_decoder->submit(std::move(buf), (VramDecoder::Format)m_format, hint);
+}
 
-    m_vramWidget->setFormat(m_format);
-    m_vramWidget->setImage(img);
+void VramViewer::onImageReady(const QImage &img, int format, const QRect &dirty) {
+    if (overdrawShown()) return;   // decoded VRAM is kept for when it's turned off
+    m_vramWidget->setFormat((VramWidget::Format)format);
+    m_vramWidget->setImage(img, dirty);
 }
 
 void VramViewer::rebuildImage() {
@@ -492,14 +474,10 @@ void VramViewer::rebuildImage() {
     m_vramMem = ar_find_memory_by_id("vram");
     if (!m_vramMem) return;
 
-    std::vector<uint8_t> buf(VRAM_BYTES);
-    if (!m_vramMem->v1.peek_range ||
-        !m_vramMem->v1.peek_range(m_vramMem, 0, VRAM_BYTES, buf.data())) {
-        for (int i = 0; i < VRAM_BYTES; i++)
-            buf[i] = m_vramMem->v1.peek(m_vramMem, i, false);
-    }
-
-    rebuildImageFromBuffer(buf.data());
+    std::vector<uint8_t> buf = m_decoder->takeBuffer();
+    if (!readLiveVram(buf)) return;
+    m_shownEvent = -1;
+    m_decoder->submit(std::move(buf), (VramDecoder::Format)m_format);
 }
 
 /* ======================================================================== */
@@ -515,6 +493,9 @@ void VramViewer::startCapture() {
     if (!sys::gpu_capture_start(dif)) return;
 
     m_capturing = true;
+    m_captureGen = sys::gpu_capture_generation();
+    m_loadBtn->setEnabled(false);
+    m_exportStatsBtn->setEnabled(false);
     m_captureBtn->setText("End Capture");
     m_eventList->setEnabled(false);
     m_eventDetail->setEnabled(false);
@@ -530,14 +511,61 @@ void VramViewer::stopCapture() {
     sys::gpu_capture_stop(dif);
 
     m_captureBtn->setText("Capture");
+    m_saveBtn->setEnabled(true);
+    m_loadBtn->setEnabled(true);
+    m_exportStatsBtn->setEnabled(true);
     m_eventList->setEnabled(true);
     m_eventDetail->setEnabled(true);
     m_prevFrameBtn->setEnabled(true);
     m_nextFrameBtn->setEnabled(true);
 
-    m_memUsageLabel->setText(QString("Capture: %1").arg(
-        formatBytes(sys::gpu_capture_compressed_bytes())));
+    updateMemUsage();
+    populateEventList();
+}
+
+/* ======================================================================== */
+/* Save / load                                                               */
+/* ======================================================================== */
+
+void VramViewer::saveCapture() {
+    if (!m_capturing && sys::gpu_capture_event_count() == 0) return;
+    if (m_capturing && sys::gpu_capture_streaming()) return;
+
+    QString path = QFileDialog::getSaveFileName(this, "Save GPU Capture", QString(),
+                                                "GPU Captures (*.gpucap);;All Files (*)");
+    if (path.isEmpty()) return;
+
+    if (!sys::gpu_capture_save(path.toUtf8().constData())) {
+        QMessageBox::critical(this, "Save Error",
+            QString("Failed to save capture:\n%1").arg(path));
+        return;
+    }
+    if (m_capturing)
+        m_saveBtn->setEnabled(false);   // streaming until the capture ends
+}
+
+void VramViewer::loadCapture() {
+    if (m_capturing) return;
+
+    QString path = QFileDialog::getOpenFileName(this, "Load GPU Capture", QString(),
+                                                "GPU Captures (*.gpucap);;All Files (*)");
+    if (path.isEmpty()) return;
 
+    if (!sys::gpu_capture_load(path.toUtf8().constData())) {
+        QMessageBox::critical(this, "Load Error",
+            QString("Failed to load capture:\n%1").arg(path));
+        return;
+    }
+    m_captureGen = sys::gpu_capture_generation();
+    showLoadedCapture();
+}
+
+void VramViewer::showLoadedCapture() {
+    if (m_gpuLogGroup->isChecked()) {
+        m_gpuLogContent->show();
+        m_gpuLogUnavail->hide();
+    }
+    updateMemUsage();
     populateEventList();
 }
 
@@ -547,8 +575,14 @@ void VramViewer::stopCapture() {
 
 void VramViewer::populateEventList() {
     m_eventList->clear();
-
-    const auto &events = sys::gpu_capture_events();
+    m_shownEvent = -1;
+
+    /* has_diff and replayed are known without waiting for the compressed diffs */
+    const auto &events = sys::gpu_capture_events(0);
+    m_frameStats = sys::gpu_stats_analyze_all(events);
+    m_statsFrame = -1;
+    m_overdrawFrame = -1;
+    m_overdrawImage = QImage();
     for (unsigned i = 0; i < events.size(); i++) {
         const auto &ev = events[i];
 
@@ -569,7 +603,7 @@ void VramViewer::populateEventList() {
             sys::decode_gp1(line, sizeof(line), ev.words);
 
         auto *item = new QListWidgetItem(QString::fromUtf8(line));
-        if (ev.diff.empty())
+        if ((!ev.has_diff && !ev.replayed) || ev.dropped)
             item->setForeground(Qt::gray);
         m_eventList->addItem(item);
     }
@@ -583,10 +617,12 @@ void VramViewer::populateEventList() {
 /* ======================================================================== */
 
 void VramViewer::onEventSelected(int row) {
-    const auto &events = sys::gpu_capture_events();
+    const auto &events = sys::gpu_capture_events(row < 0 ? 0 : (size_t)row + 1);
 
     if (row < 0 || (unsigned)row >= events.size()) {
         m_eventDetail->clear();
+        m_statsView->clear();
+        m_statsFrame = -1;
         return;
     }
 
@@ -629,10 +665,15 @@ void VramViewer::onEventSelected(int row) {
             detail += "\n";
         }
 
-        if (!ev.diff.empty())
-            detail += QString("\nDiff: %1").arg(formatBytes(ev.diff.size()));
+        if (ev.replayed)
+            detail += ev.has_diff ? QString("\nReplayed, residual: %1").arg(formatBytes(ev.diff_bytes()))
+                                  : QString("\nReplayed exactly");
+        else if (ev.has_diff)
+            detail += QString("\nDiff: %1").arg(formatBytes(ev.diff_bytes()));
         if (ev.is_keyframe)
             detail += " (keyframe)";
+        if (ev.dropped)
+            detail += "\n(dropped: over memory budget)";
     }
 
     m_eventDetail->setPlainText(detail);
@@ -642,7 +683,11 @@ void VramViewer::onEventSelected(int row) {
     else
         m_vramWidget->clearHighlightRect();
 
+    int frame = frameOfEvent((unsigned)row);
+    showFrameStats(frame);
     seekToEvent((unsigned)row);
+    if (overdrawShown())
+        showOverdraw(frame);
 }
 
 /* ======================================================================== */
@@ -653,7 +698,128 @@ void VramViewer::seekToEvent(unsigned idx) {
     m_captureVram.resize(VRAM_BYTES);
     if (!sys::gpu_capture_reconstruct(idx, m_captureVram.data()))
         return;
-    rebuildImageFromBuffer(m_captureVram.data());
+
+    /* Stepping forward one event: only that event's rectangle can differ.
+     * Events neither replayed nor with a diff leave VRAM untouched;
+     * keyframes and full diffs may touch anything. */
+    const auto &events = sys::gpu_capture_events((size_t)idx + 1);
+    const auto &ev = events[idx];
+    QRect hint;
+    bool hinted = false;
+    if (m_shownEvent >= 0 && idx == (unsigned)m_shownEvent + 1) {
+        if (!ev.has_diff && !ev.replayed)
+            hinted = true;
+        else if (!ev.is_keyframe && ev.diff_w > 0 && ev.diff_h > 0) {
+            hint = QRect(ev.diff_x, ev.diff_y, ev.diff_w, ev.diff_h);
+            hinted = true;
+        }
+    }
+    m_shownEvent = (int)idx;
+    rebuildImageFromBuffer(m_captureVram.data(), hinted ? &hint : nullptr);
+}
+
+/* ======================================================================== */
+/* Frame statistics and overdraw heatmap                                     */
+/* ======================================================================== */
+
+/* Index into m_frameStats of the frame containing event idx, or -1 */
+int VramViewer::frameOfEvent(unsigned idx) const {
+    auto it = std::upper_bound(m_frameStats.begin(), m_frameStats.end(), (size_t)idx,
+        [](size_t i, const sys::GpuFrameStats &fs) { return i < fs.end_event; });
+    return it == m_frameStats.end() ? -1 : (int)(it - m_frameStats.begin());
+}
+
+void VramViewer::showFrameStats(int frame) {
+    if (frame == m_statsFrame) return;
+    m_statsFrame = frame;
+    if (frame < 0) {
+        m_statsView->clear();
+        return;
+    }
+
+    const auto &fs = m_frameStats[frame];
+    QString text = fs.frame_number ? QString("Frame %1").arg(fs.frame_number)
+                                   : QString("Unfinished frame");
+    text += QString("  (events %1-%2)\n\n").arg(fs.first_event).arg(fs.end_event - 1);
+
+    for (int k = 0; k < sys::GPU_PRIM_KINDS; k++)
+        if (fs.prims[k])
+            text += QString("%1 %2\n").arg(sys::gpu_prim_kind_names[k], -10).arg(fs.prims[k]);
+
+    text += QString("\nPixels textured   %1\n").arg((qulonglong)fs.textured_pixels);
+    text += QString("       untextured %1\n").arg((qulonglong)fs.untextured_pixels);
+    text += QString("       transfers  %1\n").arg((qulonglong)fs.transfer_pixels);
+    text += QString("Words  CPU        %1\n").arg((qulonglong)fs.cpu_words);
+    text += QString("       DMA        %1\n").arg((qulonglong)fs.dma_words);
+
+    if (!fs.pcs.empty()) {
+        text += "\nTop PCs by pixels:\n";
+        for (size_t i = 0; i < fs.pcs.size() && i < 10; i++)
+            text += QString("  %1 %2 px, %3 prims\n")
+                .arg(QString::number(fs.pcs[i].pc, 16).rightJustified(8, '0').toUpper())
+                .arg((qulonglong)fs.pcs[i].pixels, 8)
+                .arg(fs.pcs[i].prims);
+    }
+    m_statsView->setPlainText(text);
+}
+
+bool VramViewer::overdrawShown() const {
+    return m_overdrawCheck->isChecked() && m_gpuLogGroup->isChecked() &&
+           !m_capturing && !m_frameStats.empty();
+}
+
+/* Replace the VRAM image with the frame's per-pixel draw counts, shaded
+ * from blue (drawn once) to red (the frame's maximum) */
+void VramViewer::showOverdraw(int frame) {
+    if (frame < 0) return;
+    if (frame != m_overdrawFrame) {
+        const auto &info = m_frameStats[frame];
+        auto fs = sys::gpu_stats_analyze(sys::gpu_capture_events(0),
+                                         info.first_event, info.end_event, true);
+        unsigned maxc = std::max(1u, fs.max_overdraw);
+        std::vector<QRgb> ramp(maxc + 1);
+        ramp[0] = qRgb(0, 0, 0);
+        for (unsigned c = 1; c <= maxc; c++) {
+            int hue = maxc > 1 ? (int)(240 - 240 * (c - 1) / (maxc - 1)) : 240;
+            ramp[c] = QColor::fromHsv(hue, 255, 255).rgb();
+        }
+
+        QImage img(1024, 512, QImage::Format_RGB32);
+        for (int y = 0; y < 512; y++) {
+            auto *line = reinterpret_cast<QRgb *>(img.scanLine(y));
+            const uint16_t *counts = fs.overdraw.data() + (size_t)y * 1024;
+            for (int x = 0; x < 1024; x++)
+                line[x] = ramp[counts[x]];
+        }
+        m_overdrawImage = img;
+        m_overdrawFrame = frame;
+        m_pageLabel->setText(QString("Overdraw: up to %1x per pixel (blue: once, red: most)")
+            .arg(fs.max_overdraw));
+    }
+    m_vramWidget->setFormat(VramWidget::FMT_15BIT);
+    m_vramWidget->setImage(m_overdrawImage);
+}
+
+void VramViewer::overdrawToggled(bool checked) {
+    if (checked) {
+        if (overdrawShown())
+            showOverdraw(frameOfEvent((unsigned)std::max(0, m_eventList->currentRow())));
+    } else if (m_gpuLogGroup->isChecked() && m_shownEvent >= 0 && !m_captureVram.empty()) {
+        m_pageLabel->setText("Click VRAM to select texture page");
+        rebuildImageFromBuffer(m_captureVram.data());
+    }
+}
+
+void VramViewer::exportStats() {
+    if (m_capturing || m_frameStats.empty()) return;
+
+    QString path = QFileDialog::getSaveFileName(this, "Export GPU Statistics", QString(),
+                                                "JSON (*.json);;All Files (*)");
+    if (path.isEmpty()) return;
+
+    if (!sys::gpu_stats_write_json(path.toUtf8().constData(), m_frameStats))
+        QMessageBox::critical(this, "Export Error",
+            QString("Failed to write statistics:\n%1").arg(path));
 }
 
 /* ======================================================================== */
@@ -661,7 +827,7 @@ void VramViewer::seekToEvent(unsigned idx) {
 /* ======================================================================== */
 
 void VramViewer::prevFrame() {
-    const auto &events = sys::gpu_capture_events();
+    const auto &events = sys::gpu_capture_events(0);
     int cur = m_eventList->currentRow();
     if (cur < 0) cur = (int)events.size();
 
@@ -676,7 +842,7 @@ void VramViewer::prevFrame() {
 }
 
 void VramViewer::nextFrame() {
-    const auto &events = sys::gpu_capture_events();
+    const auto &events = sys::gpu_capture_events(0);
     int cur = m_eventList->currentRow();
 
     for (unsigned i = (unsigned)(cur + 1); i < events.size(); i++) {
@@ -693,6 +859,32 @@ void VramViewer::nextFrame() {
 /* Utility                                                                   */
 /* ======================================================================== */
 
+/* Stored size, pending diffs; memory use and per-worker throughput in the tooltip */
+void VramViewer::updateMemUsage() {
+    QString text = QString("Capture: %1").arg(
+        formatBytes(sys::gpu_capture_compressed_bytes()));
+    if (size_t pending = sys::gpu_capture_pending())
+        text += QString(" (%1 pending)").arg(pending);
+    m_memUsageLabel->setText(text);
+
+    QString tip = QString("Memory: %1 of %2 budget")
+        .arg(formatBytes(sys::gpu_capture_memory()))
+        .arg(formatBytes(sys::gpu_capture_budget()));
+    auto stats = sys::gpu_capture_worker_stats();
+    for (size_t i = 0; i < stats.size(); i++) {
+        const auto &w = stats[i];
+        double secs = w.busy_ns / 1e9;
+        double mibs = secs > 0 ? w.raw_bytes / (1024.0 * 1024.0) / secs : 0.0;
+        tip += QString("\nWorker %1: %2 diffs, %3 -> %4, %5 MiB/s")
+            .arg(i)
+            .arg((qulonglong)w.jobs)
+            .arg(formatBytes((size_t)w.raw_bytes))
+            .arg(formatBytes((size_t)w.compressed_bytes))
+            .arg(mibs, 0, 'f', 1);
+    }
+    m_memUsageLabel->setToolTip(tip);
+}
+
 QString VramViewer::formatBytes(size_t bytes) {
     if (bytes >= 1024ULL * 1024 * 1024)
         return QString("%1 GiB").arg((double)bytes / (1024.0 * 1024.0 * 1024.0), 0, 'f', 1);
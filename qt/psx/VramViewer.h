@@ -7,6 +7,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "sys/psx_gpu_stats.hpp"
+
 QT_BEGIN_NAMESPACE
 class QLabel;
 class QScrollArea;
@@ -16,10 +18,12 @@ class QGroupBox;
 class QListWidget;
 class QTextEdit;
 class QPushButton;
+class QCheckBox;
 class QSplitter;
 QT_END_NAMESPACE
 
 struct rd_Memory;
+class VramDecoder;
 
 /* ======================================================================== */
 /* VramWidget — custom widget that paints the VRAM image                     */
@@ -30,7 +34,8 @@ class VramWidget : public QWidget {
 public:
     explicit VramWidget(QWidget *parent = nullptr);
 
-    void setImage(const QImage &img);
+    /* dirty limits the repaint when the size is unchanged */
+    void setImage(const QImage &img, const QRect &dirty = QRect());
     void setSelectedPage(int page) { m_selectedPage = page; update(); }
     int selectedPage() const { return m_selectedPage; }
 
@@ -88,14 +93,25 @@ private slots:
     void stopCapture();
     void prevFrame();
     void nextFrame();
+    void saveCapture();
+    void loadCapture();
+    void exportStats();
+    void overdrawToggled(bool checked);
+    void onImageReady(const QImage &img, int format, const QRect &dirty);
 
 private:
     void rebuildImage();
-    void readLiveVram(std::vector<uint8_t> &buf);
-    void rebuildImageFromBuffer(const uint8_t *vram);
+    bool readLiveVram(std::vector<uint8_t> &buf);
+    void rebuildImageFromBuffer(const uint8_t *vram, const QRect *hint = nullptr);
     void checkGpuLogAvailability();
     void populateEventList();
     void seekToEvent(unsigned idx);
+    void updateMemUsage();
+    void showLoadedCapture();
+    int frameOfEvent(unsigned idx) const;
+    void showFrameStats(int frame);
+    void showOverdraw(int frame);
+    bool overdrawShown() const;
     static QString formatBytes(size_t bytes);
 
     /* Existing widgets */
@@ -111,6 +127,7 @@ private:
 
     rd_Memory const *m_vramMem = nullptr;
     VramWidget::Format m_format = VramWidget::FMT_15BIT;
+    VramDecoder *m_decoder;
 
     /* GPU Event Log UI */
     QGroupBox    *m_gpuLogGroup;
@@ -119,12 +136,23 @@ private:
     QListWidget  *m_eventList;
     QTextEdit    *m_eventDetail;
     QPushButton  *m_captureBtn;
+    QPushButton  *m_saveBtn;
+    QPushButton  *m_loadBtn;
+    QPushButton  *m_exportStatsBtn;
+    QTextEdit    *m_statsView;
+    QCheckBox    *m_overdrawCheck;
     QPushButton  *m_prevFrameBtn;
     QPushButton  *m_nextFrameBtn;
     QLabel       *m_memUsageLabel;
 
     /* UI-side state */
     std::vector<uint8_t> m_captureVram;   // 1MB, working buffer for seek/display
+    int m_shownEvent = -1;                // event last sent to the decoder, -1 = live
+    unsigned m_captureGen = 0;            // gpu_capture_generation() shown
+    std::vector<sys::GpuFrameStats> m_frameStats;  // per frame, without heatmaps
+    int m_statsFrame = -1;                // frame shown in m_statsView
+    int m_overdrawFrame = -1;             // frame m_overdrawImage shows
+    QImage m_overdrawImage;
     bool m_capturing = false;
     bool m_gpuLogAvailable = false;
     bool m_gpuLogChecked = false;
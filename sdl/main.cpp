@@ -18,6 +18,7 @@
 #include "backend.hpp"
 #include "breakpoint.hpp"
 #include "symbols.hpp"
+#include "analysis.hpp"
 #include "assets.hpp"
 
 /* ========================================================================
@@ -27,6 +28,7 @@
 static SDL_Window   *sdl_window   = NULL;
 static SDL_Renderer *sdl_renderer = NULL;
 static SDL_Texture  *sdl_texture  = NULL;
+static uint64_t      sdl_texture_seq = UINT64_MAX;  /* frame in sdl_texture */
 static SDL_AudioDeviceID sdl_audio_dev = 0;
 static int scale = 3;
 static bool headless = false;
@@ -165,17 +167,26 @@ static void sdl_cleanup(void) {
 static void sdl_render(void) {
     if (!sdl_texture) return;
 
-    int tw, th;
-    SDL_QueryTexture(sdl_texture, NULL, NULL, &tw, &th);
-    if ((unsigned)tw != ar_frame_width() || (unsigned)th != ar_frame_height()) {
-        SDL_DestroyTexture(sdl_texture);
-        sdl_texture = SDL_CreateTexture(sdl_renderer,
-            SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
-            ar_frame_width(), ar_frame_height());
+    ar_frame frame;
+    ar_frame_acquire(&frame);
+
+    /* Upload only frames not uploaded yet */
+    if (frame.seq != sdl_texture_seq) {
+        int tw, th;
+        SDL_QueryTexture(sdl_texture, NULL, NULL, &tw, &th);
+        if ((unsigned)tw != frame.width || (unsigned)th != frame.height) {
+            SDL_DestroyTexture(sdl_texture);
+            sdl_texture = SDL_CreateTexture(sdl_renderer,
+                SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                frame.width, frame.height);
+        }
+
+        SDL_UpdateTexture(sdl_texture, NULL, frame.pixels,
+                          frame.width * sizeof(uint32_t));
+        sdl_texture_seq = frame.seq;
     }
+    ar_frame_release();
 
-    SDL_UpdateTexture(sdl_texture, NULL, ar_frame_buf(),
-                      ar_frame_width() * sizeof(uint32_t));
     SDL_RenderClear(sdl_renderer);
     SDL_RenderCopy(sdl_renderer, sdl_texture, NULL, NULL);
     SDL_RenderPresent(sdl_renderer);
@@ -254,6 +265,7 @@ static void cb_on_geometry_change(void *user, unsigned w, unsigned h) {
         SDL_DestroyTexture(sdl_texture);
         sdl_texture = SDL_CreateTexture(sdl_renderer,
             SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+        sdl_texture_seq = UINT64_MAX;
         SDL_SetWindowSize(sdl_window, w * scale, h * scale);
     }
 }
@@ -466,6 +478,7 @@ int main(int argc, char **argv) {
         return 1;
 
     ar_sym_auto_load();
+    ar_analysis_auto_start();
 
     /* Default: manual keyboard input only in headed mode */
     ar_set_manual_input(!headless);